@@ -437,56 +437,78 @@ void etc2_decode_rgb_block(const etc1_byte* pIn, bool isPunchthroughAlpha,
                     isPunchthroughAlpha, opaque);
 }
 
+// Converts a float in [-1, 1] to a half float, rounding to nearest even. Values too small to be
+// normal half floats, which decoded EAC channels never are apart from 0, are flushed to 0.
+static etc1_uint16 convertToHalfFloat(float f) {
+    etc1_uint32 bits;
+    memcpy(&bits, &f, sizeof(bits));
+    etc1_uint32 sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    if (exponent <= 0) {
+        return (etc1_uint16)sign;
+    }
+    etc1_uint32 mantissa = bits & 0x7fffff;
+    etc1_uint32 half = ((etc1_uint32)exponent << 10) | (mantissa >> 13);
+    etc1_uint32 remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        // May carry into the exponent, which is still the correctly rounded value.
+        half++;
+    }
+    return (etc1_uint16)(sign | half);
+}
+
 void eac_decode_single_channel_block(const etc1_byte* pIn,
                                      int decodedElementBytes, bool isSigned,
                                      etc1_byte* pOut) {
     assert(decodedElementBytes == 1 || decodedElementBytes == 2 || decodedElementBytes == 4);
-    int base_codeword = isSigned ? reinterpret_cast<const char*>(pIn)[0]
+    int base_codeword = isSigned ? reinterpret_cast<const signed char*>(pIn)[0]
                                  : pIn[0];
     if (base_codeword == -128) base_codeword = -127;
     int multiplier = pIn[1] >> 4;
     int tblIdx = pIn[1] & 15;
     const int* table = kAlphaModifierTable + tblIdx * 8;
-    const etc1_byte* p = pIn + 2;
-    // position in a byte of the next 3-bit index:
+    // The 16 3-bit indices, most significant first:
     // | a a a | b b b | c c c | d d d ...
-    // | byte               | byte...
-    int bitOffset = 5;
-    for (int i = 0; i < 16; i ++) {
+    uint64_t indices = 0;
+    for (int i = 2; i < 8; i++) {
+        indices = (indices << 8) | pIn[i];
+    }
+
+    // The loops below have no data dependent branches so that the compiler can vectorize them.
+    int decoded[16];
+    for (int i = 0; i < 16; i++) {
+        int modifierValue = table[(indices >> (45 - 3 * i)) & 7];
         // flip x, y in output
         int outIdx = (i % 4) * 4 + i / 4;
-        etc1_byte* q = pOut + outIdx * decodedElementBytes;
+        if (decodedElementBytes == 1) {
+            decoded[outIdx] = clamp(base_codeword + modifierValue * multiplier);
+        } else if (isSigned) {
+            int value = (base_codeword + modifierValue * multiplier) * 8;
+            if (multiplier == 0) value += modifierValue;
+            decoded[outIdx] = clampSigned1023(value);
+        } else {
+            int value = (base_codeword + modifierValue * multiplier) * 8 + 4;
+            if (multiplier == 0) value += modifierValue;
+            decoded[outIdx] = clamp2047(value);
+        }
+    }
 
-        int modifier = 0;
-        if (bitOffset < 0) { // (Part of) the index is in the next byte.
-            modifier += p[0] << (-bitOffset);
-            p ++;
-            bitOffset += 8;
+    if (decodedElementBytes == 1) {
+        for (int i = 0; i < 16; i++) {
+            pOut[i] = (etc1_byte)decoded[i];
         }
-        modifier += p[0] >> bitOffset;
-        modifier &= 7;
-        bitOffset -= 3; // move to the next index
-        if (bitOffset == -3) {
-            bitOffset = 5;
-            p++;
+        return;
+    }
+    const double maxValue = isSigned ? 1023.0 : 2047.0;
+    if (decodedElementBytes == 2) {
+        for (int i = 0; i < 16; i++) {
+            etc1_uint16 value = convertToHalfFloat((float)(decoded[i] / maxValue));
+            memcpy(pOut + i * 2, &value, sizeof(value));
         }
-        int modifierValue = table[modifier];
-        int decoded = base_codeword + modifierValue * multiplier;
-        if (decodedElementBytes == 1) {
-            *q = clamp(decoded);
-        } else { // decodedElementBytes == 4
-            decoded *= 8;
-            if (multiplier == 0) {
-                decoded += modifierValue;
-            }
-            if (isSigned) {
-                decoded = clampSigned1023(decoded);
-                reinterpret_cast<float*>(q)[0] = (float)decoded / 1023.0;
-            } else {
-                decoded += 4;
-                decoded = clamp2047(decoded);
-                reinterpret_cast<float*>(q)[0] = (float)decoded / 2047.0;
-            }
+    } else {  // decodedElementBytes == 4
+        for (int i = 0; i < 16; i++) {
+            float value = (float)(decoded[i] / maxValue);
+            memcpy(pOut + i * 4, &value, sizeof(value));
         }
     }
 }
@@ -803,6 +825,19 @@ etc1_uint32 etc_get_decoded_pixel_size(ETC2ImageFormat format) {
     }
 }
 
+etc1_uint32 etc_get_decoded_pixel_size_half_float_eac(ETC2ImageFormat format) {
+    switch (format) {
+        case EtcR11:
+        case EtcSignedR11:
+            return 2;
+        case EtcRG11:
+        case EtcSignedRG11:
+            return 4;
+        default:
+            return etc_get_decoded_pixel_size(format);
+    }
+}
+
 // Encode an entire image.
 // pIn - pointer to the image data. Formatted such that the Red component of
 //       pixel (x,y) is at pIn + pixelSize * x + stride * y + redOffset;
@@ -868,6 +903,18 @@ int etc2_decode_image(const etc1_byte* pIn, ETC2ImageFormat format,
         etc1_byte* pOut,
         etc1_uint32 width, etc1_uint32 height,
         etc1_uint32 stride) {
+    return etc2_decode_image_block_rows(pIn, format, false, pOut, width, height, stride, 0,
+                                        (height + 3) / 4);
+}
+
+// Decode the block rows [firstBlockRow, firstBlockRow + blockRowCount) of an image.
+// pIn and pOut point to the start of the whole image, as for etc2_decode_image.
+
+int etc2_decode_image_block_rows(const etc1_byte* pIn, ETC2ImageFormat format,
+        bool halfFloatEac, etc1_byte* pOut,
+        etc1_uint32 width, etc1_uint32 height,
+        etc1_uint32 stride,
+        etc1_uint32 firstBlockRow, etc1_uint32 blockRowCount) {
     etc1_byte block[std::max({ETC1_DECODED_BLOCK_SIZE,
                               ETC2_DECODED_RGB8A1_BLOCK_SIZE,
                               EAC_DECODED_R11_BLOCK_SIZE,
@@ -876,11 +923,19 @@ int etc2_decode_image(const etc1_byte* pIn, ETC2ImageFormat format,
 
     etc1_uint32 encodedWidth = (width + 3) & ~3;
     etc1_uint32 encodedHeight = (height + 3) & ~3;
+    if (firstBlockRow * 4 > encodedHeight ||
+        blockRowCount > encodedHeight / 4 - firstBlockRow) {
+        return -1;
+    }
 
-    int pixelSize = etc_get_decoded_pixel_size(format);
+    int pixelSize = halfFloatEac ? etc_get_decoded_pixel_size_half_float_eac(format)
+                                 : etc_get_decoded_pixel_size(format);
+    int eacElementBytes = halfFloatEac ? 2 : 4;
     bool isSigned = (format == EtcSignedR11 || format == EtcSignedRG11);
 
-    for (etc1_uint32 y = 0; y < encodedHeight; y += 4) {
+    pIn += etc_get_encoded_data_size(format, width, firstBlockRow * 4);
+
+    for (etc1_uint32 y = firstBlockRow * 4; y < (firstBlockRow + blockRowCount) * 4; y += 4) {
         etc1_uint32 yEnd = height - y;
         if (yEnd > 4) {
             yEnd = 4;
@@ -907,17 +962,17 @@ int etc2_decode_image(const etc1_byte* pIn, ETC2ImageFormat format,
                     break;
                 case EtcR11:
                 case EtcSignedR11:
-                    eac_decode_single_channel_block(pIn, 4, isSigned, block);
+                    eac_decode_single_channel_block(pIn, eacElementBytes, isSigned, block);
                     pIn += EAC_ENCODE_R11_BLOCK_SIZE;
                     break;
                 case EtcRG11:
                 case EtcSignedRG11:
                     // r channel
-                    eac_decode_single_channel_block(pIn, 4, isSigned, block);
+                    eac_decode_single_channel_block(pIn, eacElementBytes, isSigned, block);
                     pIn += EAC_ENCODE_R11_BLOCK_SIZE;
                     // g channel
-                    eac_decode_single_channel_block(pIn, 4, isSigned,
-                            block + EAC_DECODED_R11_BLOCK_SIZE);
+                    eac_decode_single_channel_block(pIn, eacElementBytes, isSigned,
+                            block + 16 * eacElementBytes);
                     pIn += EAC_ENCODE_R11_BLOCK_SIZE;
                     break;
                 default:
@@ -936,9 +991,9 @@ int etc2_decode_image(const etc1_byte* pIn, ETC2ImageFormat format,
                         break;
                     case EtcRG11:
                     case EtcSignedRG11: {
-                            const etc1_byte* r = block + cy * EAC_DECODED_R11_BLOCK_SIZE / 4;
-                            const etc1_byte* g = block + cy * EAC_DECODED_R11_BLOCK_SIZE / 4 + EAC_DECODED_R11_BLOCK_SIZE;
                             int channelSize = pixelSize / 2;
+                            const etc1_byte* r = block + cy * 4 * channelSize;
+                            const etc1_byte* g = r + 16 * channelSize;
                             for (etc1_uint32 cx = 0; cx < xEnd; cx++) {
                                 memcpy(p, r, channelSize);
                                 p += channelSize;
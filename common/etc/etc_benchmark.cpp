@@ -0,0 +1,63 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "gfxstream/etc.h"
+
+namespace {
+
+std::vector<etc1_byte> makeEncodedImage(ETC2ImageFormat format, etc1_uint32 width,
+                                        etc1_uint32 height) {
+    std::vector<etc1_byte> encoded(etc_get_encoded_data_size(format, width, height));
+    for (size_t i = 0; i < encoded.size(); i++) {
+        encoded[i] = static_cast<etc1_byte>(i * 2654435761u >> 13);
+    }
+    return encoded;
+}
+
+// Decodes a square image of state.range(0) pixels per side, the way the GL translator does,
+// see decodeEtcImage().
+void BM_DecodeImage(benchmark::State& state, ETC2ImageFormat format, bool halfFloatEac) {
+    const etc1_uint32 size = static_cast<etc1_uint32>(state.range(0));
+    const std::vector<etc1_byte> encoded = makeEncodedImage(format, size, size);
+    const etc1_uint32 pixelSize = halfFloatEac ? etc_get_decoded_pixel_size_half_float_eac(format)
+                                               : etc_get_decoded_pixel_size(format);
+    const etc1_uint32 stride = pixelSize * size;
+    std::vector<etc1_byte> decoded(stride * size);
+
+    for (auto _ : state) {
+        etc2_decode_image_block_rows(encoded.data(), format, halfFloatEac, decoded.data(), size,
+                                     size, stride, 0, (size + 3) / 4);
+        benchmark::DoNotOptimize(decoded.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * size * size);
+    state.SetBytesProcessed(state.iterations() * decoded.size());
+}
+
+BENCHMARK_CAPTURE(BM_DecodeImage, Rgb8, EtcRGB8, false)->Arg(256)->Arg(1024)->Arg(2048);
+BENCHMARK_CAPTURE(BM_DecodeImage, Rgba8, EtcRGBA8, false)->Arg(256)->Arg(1024)->Arg(2048);
+BENCHMARK_CAPTURE(BM_DecodeImage, Rgb8A1, EtcRGB8A1, false)->Arg(256)->Arg(1024)->Arg(2048);
+BENCHMARK_CAPTURE(BM_DecodeImage, R11, EtcR11, false)->Arg(256)->Arg(1024);
+BENCHMARK_CAPTURE(BM_DecodeImage, R11HalfFloat, EtcR11, true)->Arg(256)->Arg(1024);
+BENCHMARK_CAPTURE(BM_DecodeImage, Rg11, EtcRG11, false)->Arg(256)->Arg(1024);
+BENCHMARK_CAPTURE(BM_DecodeImage, Rg11HalfFloat, EtcRG11, true)->Arg(256)->Arg(1024);
+
+}  // namespace
+
+BENCHMARK_MAIN();
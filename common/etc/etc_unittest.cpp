@@ -12,11 +12,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <GLcommon/etc.h>
+#include "gfxstream/etc.h"
 
 #include <gtest/gtest.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 namespace {
 class Etc2Test : public ::testing::Test {
 protected:
@@ -227,3 +231,85 @@ TEST_F(Etc2Test, ETC2RGB8A1_OP0_Planer) {
         118, 224, 245, 255, 113, 221, 244, 255, 107, 219, 243, 255, 102, 216, 242, 255};
     decodeRgb8A1Test((const etc1_byte*)encoded, (const etc1_byte*)expectedDecoded);
 }
+
+namespace {
+
+std::vector<etc1_byte> makeEncodedImage(ETC2ImageFormat format, etc1_uint32 width,
+                                        etc1_uint32 height) {
+    std::vector<etc1_byte> encoded(etc_get_encoded_data_size(format, width, height));
+    for (size_t i = 0; i < encoded.size(); i++) {
+        encoded[i] = static_cast<etc1_byte>(i * 2654435761u >> 13);
+    }
+    return encoded;
+}
+
+float halfFloatToFloat(uint16_t half) {
+    const float sign = (half & 0x8000) ? -1.0f : 1.0f;
+    const int exponent = (half >> 10) & 0x1f;
+    const int mantissa = half & 0x3ff;
+    if (exponent == 0) {
+        return sign * std::ldexp(static_cast<float>(mantissa), -24);
+    }
+    return sign * std::ldexp(static_cast<float>(mantissa | 0x400), exponent - 25);
+}
+
+}  // namespace
+
+TEST(Etc2ImageTest, BlockRowsMatchWholeImage) {
+    const etc1_uint32 width = 37;
+    const etc1_uint32 height = 29;
+    const etc1_uint32 blockRows = (height + 3) / 4;
+    for (ETC2ImageFormat format : {EtcRGB8, EtcRGBA8, EtcR11, EtcSignedR11, EtcRG11,
+                                   EtcSignedRG11, EtcRGB8A1}) {
+        const std::vector<etc1_byte> encoded = makeEncodedImage(format, width, height);
+        const etc1_uint32 stride = etc_get_decoded_pixel_size(format) * width;
+
+        std::vector<etc1_byte> expected(stride * height);
+        ASSERT_EQ(0, etc2_decode_image(encoded.data(), format, expected.data(), width, height,
+                                       stride));
+
+        std::vector<etc1_byte> decoded(stride * height);
+        for (etc1_uint32 row = 0; row < blockRows; row += 3) {
+            const etc1_uint32 count = std::min(3u, blockRows - row);
+            ASSERT_EQ(0, etc2_decode_image_block_rows(encoded.data(), format, false,
+                                                      decoded.data(), width, height, stride,
+                                                      row, count));
+        }
+        EXPECT_EQ(expected, decoded) << "format " << format;
+    }
+}
+
+TEST(Etc2ImageTest, BlockRowsOutsideOfImage) {
+    const std::vector<etc1_byte> encoded = makeEncodedImage(EtcRGB8, 8, 8);
+    std::vector<etc1_byte> decoded(3 * 8 * 8);
+    EXPECT_NE(0, etc2_decode_image_block_rows(encoded.data(), EtcRGB8, false, decoded.data(),
+                                              8, 8, 3 * 8, 1, 2));
+    EXPECT_NE(0, etc2_decode_image_block_rows(encoded.data(), EtcRGB8, false, decoded.data(),
+                                              8, 8, 3 * 8, 3, 0));
+}
+
+TEST(Etc2ImageTest, HalfFloatEacMatchesFloat) {
+    const etc1_uint32 width = 21;
+    const etc1_uint32 height = 13;
+    for (ETC2ImageFormat format : {EtcR11, EtcSignedR11, EtcRG11, EtcSignedRG11}) {
+        const std::vector<etc1_byte> encoded = makeEncodedImage(format, width, height);
+        const etc1_uint32 floatSize = etc_get_decoded_pixel_size(format);
+        const etc1_uint32 halfSize = etc_get_decoded_pixel_size_half_float_eac(format);
+        ASSERT_EQ(floatSize, 2 * halfSize);
+
+        std::vector<float> expected(floatSize / sizeof(float) * width * height);
+        ASSERT_EQ(0, etc2_decode_image(encoded.data(), format,
+                                       reinterpret_cast<etc1_byte*>(expected.data()), width,
+                                       height, floatSize * width));
+        std::vector<uint16_t> decoded(halfSize / sizeof(uint16_t) * width * height);
+        ASSERT_EQ(0, etc2_decode_image_block_rows(
+                         encoded.data(), format, true, reinterpret_cast<etc1_byte*>(decoded.data()),
+                         width, height, halfSize * width, 0, (height + 3) / 4));
+
+        for (size_t i = 0; i < expected.size(); i++) {
+            // Half floats keep the 11 bits of EAC channels.
+            EXPECT_NEAR(expected[i], halfFloatToFloat(decoded[i]), 1.0f / 4096.0f)
+                << "format " << format << " element " << i;
+        }
+    }
+}
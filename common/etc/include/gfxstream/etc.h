@@ -67,8 +67,9 @@ void etc2_decode_rgb_block(const etc1_byte* pIn, bool isPunchthroughAlpha, etc1_
 // Decode a block of single channel pixels
 // This is used when decoding the alpha channel of RGBA8_ETC2_EAC format, or
 // when decoding R11_EAC format
-// decodedElementBytes: number of bits per element after decoding.
-// For RGBA8_ETC2_EAC it must be 1, for R11_EAC it must be 2
+// decodedElementBytes: number of bytes per element after decoding.
+// For RGBA8_ETC2_EAC it must be 1, for R11_EAC it must be 2 (half float) or
+// 4 (float)
 
 void eac_decode_single_channel_block(const etc1_byte* pIn,
                                      int decodedElementBytes, bool isSigned,
@@ -82,6 +83,11 @@ etc1_uint32 etc_get_encoded_data_size(ETC2ImageFormat format, etc1_uint32 width,
                                       etc1_uint32 height);
 etc1_uint32 etc_get_decoded_pixel_size(ETC2ImageFormat format);
 
+// Same as etc_get_decoded_pixel_size(), except that R11 and RG11 channels are
+// decoded to half floats.
+
+etc1_uint32 etc_get_decoded_pixel_size_half_float_eac(ETC2ImageFormat format);
+
 // Encode an entire image.
 // pIn - pointer to the image data. Formatted such that
 //       pixel (x,y) is at pIn + pixelSize * x + stride * y;
@@ -105,6 +111,20 @@ int etc2_decode_image(const etc1_byte* pIn, ETC2ImageFormat format,
         etc1_uint32 width, etc1_uint32 height,
         etc1_uint32 stride);
 
+// Decode the block rows [firstBlockRow, firstBlockRow + blockRowCount) of an
+// image, a block row being 4 pixel rows. Disjoint ranges can be decoded
+// concurrently.
+// pIn, pOut - pointers to the whole image, as for etc2_decode_image.
+// halfFloatEac - whether R11 and RG11 channels are written as half floats
+//                instead of floats, see etc_get_decoded_pixel_size_half_float_eac.
+// returns non-zero if the range is outside of the image.
+
+int etc2_decode_image_block_rows(const etc1_byte* pIn, ETC2ImageFormat format,
+        bool halfFloatEac, etc1_byte* pOut,
+        etc1_uint32 width, etc1_uint32 height,
+        etc1_uint32 stride,
+        etc1_uint32 firstBlockRow, etc1_uint32 blockRowCount);
+
 // Size of a PKM header, in bytes.
 
 #define ETC_PKM_HEADER_SIZE 16
@@ -25,6 +25,11 @@ struct BorrowedImageInfo {
     uint32_t id = 0;
     uint32_t width = 0;
     uint32_t height = 0;
+
+    // ColorBuffer::getContentGeneration() when the image was borrowed, 0 if unknown. Borrowing
+    // an image as a composition target counts as a change, so its generation after the
+    // composition is this plus one.
+    uint64_t contentGeneration = 0;
 };
 
 }  // namespace gfxstream
@@ -58,6 +58,11 @@ std::shared_ptr<ColorBuffer> ColorBuffer::create(gl::EmulationGl* emulationGl,
     std::shared_ptr<ColorBuffer> colorBuffer(
         new ColorBuffer(handle, width, height, format, frameworkFormat));
 
+    // Guest Vulkan writes are only reported when the decoder tracks ColorBuffer usage.
+    if (emulationVk && emulationVk->isGuestVulkanOnly()) {
+        colorBuffer->mContentGenerationTracked = false;
+    }
+
     if (stream) {
         // When vk snapshot enabled, mNeedRestore will be touched and set to false immediately.
         colorBuffer->mNeedRestore = true;
@@ -162,6 +167,8 @@ void ColorBuffer::onSave(android::base::Stream* stream) {
 }
 
 void ColorBuffer::restore() {
+    markContentChanged();
+
 #if GFXSTREAM_ENABLE_HOST_GLES
     if (mColorBufferGl) {
         mColorBufferGl->restore();
@@ -227,6 +234,7 @@ bool ColorBuffer::updateFromBytes(int x, int y, int width, int height,
                                   FrameworkFormat frameworkFormat, GLenum pixelsFormat,
                                   GLenum pixelsType, const void* pixels, void* metadata) {
     touch();
+    markContentChanged();
 
 #if GFXSTREAM_ENABLE_HOST_GLES
     if (mColorBufferGl) {
@@ -251,6 +259,7 @@ bool ColorBuffer::updateFromBytes(int x, int y, int width, int height,
 bool ColorBuffer::updateFromBytes(int x, int y, int width, int height, GLenum pixelsFormat,
                                   GLenum pixelsType, const void* pixels) {
     touch();
+    markContentChanged();
 
 #if GFXSTREAM_ENABLE_HOST_GLES
     if (mColorBufferGl) {
@@ -270,10 +279,63 @@ bool ColorBuffer::updateFromBytes(int x, int y, int width, int height, GLenum pi
     return false;
 }
 
+bool ColorBuffer::readToCallback(
+    int x, int y, int width, int height, GLenum pixelsFormat, GLenum pixelsType,
+    uint64_t pixelsSize,
+    const std::function<bool(const void* pixels, uint64_t size)>& consumePixels) {
+    touch();
+
+#if GFXSTREAM_ENABLE_HOST_GLES
+    if (mColorBufferGl) {
+        // GL has no mapped staging memory to hand out, so go through a temporary copy.
+        std::vector<uint8_t> pixels(pixelsSize);
+        mColorBufferGl->readPixels(x, y, width, height, pixelsFormat, pixelsType, pixels.data());
+        return consumePixels(pixels.data(), pixels.size());
+    }
+#endif
+
+    if (mColorBufferVk) {
+        return mColorBufferVk->readToCallback(x, y, width, height, consumePixels);
+    }
+
+    GFXSTREAM_ABORT(FatalError(ABORT_REASON_OTHER)) << "No ColorBuffer impl?";
+    return false;
+}
+
+bool ColorBuffer::updateFromCallback(
+    int x, int y, int width, int height, GLenum pixelsFormat, GLenum pixelsType,
+    uint64_t pixelsSize, const std::function<bool(void* pixels, uint64_t size)>& fillPixels) {
+    touch();
+    markContentChanged();
+
+#if GFXSTREAM_ENABLE_HOST_GLES
+    if (mColorBufferGl) {
+        std::vector<uint8_t> pixels(pixelsSize);
+        if (!fillPixels(pixels.data(), pixels.size())) {
+            return false;
+        }
+        bool res = mColorBufferGl->subUpdate(x, y, width, height, pixelsFormat, pixelsType,
+                                             pixels.data());
+        if (res) {
+            flushFromGl();
+        }
+        return res;
+    }
+#endif
+
+    if (mColorBufferVk) {
+        return mColorBufferVk->updateFromCallback(x, y, width, height, fillPixels);
+    }
+
+    GFXSTREAM_ABORT(FatalError(ABORT_REASON_OTHER)) << "No ColorBuffer impl?";
+    return false;
+}
+
 bool ColorBuffer::updateGlFromBytes(const void* bytes, std::size_t bytesSize) {
 #if GFXSTREAM_ENABLE_HOST_GLES
     if (mColorBufferGl) {
         touch();
+        markContentChanged();
 
         return mColorBufferGl->replaceContents(bytes, bytesSize);
     }
@@ -283,24 +345,37 @@ bool ColorBuffer::updateGlFromBytes(const void* bytes, std::size_t bytesSize) {
 }
 
 std::unique_ptr<BorrowedImageInfo> ColorBuffer::borrowForComposition(UsedApi api, bool isTarget) {
+    std::unique_ptr<BorrowedImageInfo> borrowedInfo;
     switch (api) {
         case UsedApi::kGl: {
 #if GFXSTREAM_ENABLE_HOST_GLES
             if (!mColorBufferGl) {
                 GFXSTREAM_ABORT(FatalError(ABORT_REASON_OTHER)) << "ColorBufferGl not available.";
             }
-            return mColorBufferGl->getBorrowedImageInfo();
+            borrowedInfo = mColorBufferGl->getBorrowedImageInfo();
+            break;
 #endif
         }
         case UsedApi::kVk: {
             if (!mColorBufferVk) {
                 GFXSTREAM_ABORT(FatalError(ABORT_REASON_OTHER)) << "ColorBufferGl not available.";
             }
-            return mColorBufferVk->borrowForComposition(isTarget);
+            borrowedInfo = mColorBufferVk->borrowForComposition(isTarget);
+            break;
         }
+        default:
+            GFXSTREAM_ABORT(FatalError(ABORT_REASON_OTHER)) << "Unimplemented";
+            return nullptr;
     }
-    GFXSTREAM_ABORT(FatalError(ABORT_REASON_OTHER)) << "Unimplemented";
-    return nullptr;
+
+    // The composition writes the target, so it counts as a content change. The borrowed image
+    // keeps the generation from before the composition.
+    const uint64_t contentGeneration =
+        isTarget ? mContentGeneration.fetch_add(1) : mContentGeneration.load();
+    if (borrowedInfo && mContentGenerationTracked) {
+        borrowedInfo->contentGeneration = contentGeneration;
+    }
+    return borrowedInfo;
 }
 
 std::unique_ptr<BorrowedImageInfo> ColorBuffer::borrowForDisplay(UsedApi api) {
@@ -325,6 +400,8 @@ std::unique_ptr<BorrowedImageInfo> ColorBuffer::borrowForDisplay(UsedApi api) {
 }
 
 bool ColorBuffer::flushFromGl() {
+    markContentChanged();
+
     if (!(mColorBufferGl && mColorBufferVk)) {
         return true;
     }
@@ -340,6 +417,8 @@ bool ColorBuffer::flushFromGl() {
 }
 
 bool ColorBuffer::flushFromVk() {
+    markContentChanged();
+
     if (!(mColorBufferGl && mColorBufferVk)) {
         return true;
     }
@@ -368,6 +447,8 @@ bool ColorBuffer::flushFromVk() {
 }
 
 bool ColorBuffer::flushFromVkBytes(const void* bytes, size_t bytesSize) {
+    markContentChanged();
+
     if (!(mColorBufferGl && mColorBufferVk)) {
         return true;
     }
@@ -388,6 +469,12 @@ bool ColorBuffer::flushFromVkBytes(const void* bytes, size_t bytesSize) {
     return true;
 }
 
+uint64_t ColorBuffer::getContentGeneration() const {
+    return mContentGenerationTracked ? mContentGeneration.load() : 0;
+}
+
+void ColorBuffer::markContentChanged() { mContentGeneration++; }
+
 bool ColorBuffer::invalidateForGl() {
     if (!(mColorBufferGl && mColorBufferVk)) {
         return true;
@@ -453,6 +540,7 @@ bool ColorBuffer::glOpBlitFromCurrentReadBuffer() {
     }
 
     touch();
+    markContentChanged();
 
     return mColorBufferGl->blitFromCurrentReadBuffer();
 }
@@ -463,6 +551,9 @@ bool ColorBuffer::glOpBindToTexture() {
     }
 
     touch();
+    // The guest may keep rendering to the bound texture for any number of frames without
+    // anything reaching the ColorBuffer, so its contents can no longer be tracked.
+    mContentGenerationTracked = false;
 
     return mColorBufferGl->bindToTexture();
 }
@@ -472,6 +563,9 @@ bool ColorBuffer::glOpBindToTexture2() {
         GFXSTREAM_ABORT(FatalError(ABORT_REASON_OTHER)) << "ColorBufferGl not available.";
     }
 
+    // See glOpBindToTexture().
+    mContentGenerationTracked = false;
+
     return mColorBufferGl->bindToTexture2();
 }
 
@@ -481,6 +575,9 @@ bool ColorBuffer::glOpBindToRenderbuffer() {
     }
 
     touch();
+    // Rendering to the renderbuffer can go on for any number of frames without anything
+    // reaching the ColorBuffer, so its contents can no longer be tracked.
+    mContentGenerationTracked = false;
 
     return mColorBufferGl->bindToRenderbuffer();
 }
@@ -520,6 +617,8 @@ bool ColorBuffer::glOpImportEglNativePixmap(void* pixmap, bool preserveContent)
         GFXSTREAM_ABORT(FatalError(ABORT_REASON_OTHER)) << "ColorBufferGl not available.";
     }
 
+    markContentChanged();
+
     return mColorBufferGl->importEglNativePixmap(pixmap, preserveContent);
 }
 
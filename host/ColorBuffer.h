@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
 #include <memory>
 
 #include "BorrowedImage.h"
@@ -80,6 +82,17 @@ class ColorBuffer : public android::snapshot::LazySnapshotObj<ColorBuffer> {
                          void* metadata = nullptr);
     bool updateGlFromBytes(const void* bytes, std::size_t bytesSize);
 
+    // Like readToBytes() and updateFromBytes(), but the pixels are handed to or filled in by
+    // the callback. With Vulkan this is the mapped staging memory, so that the callback can
+    // scatter/gather the pixels without an intermediate copy. `pixelsSize` is the size of the
+    // pixels in `pixelsFormat`/`pixelsType`. The callback returns false to fail the transfer.
+    bool readToCallback(int x, int y, int width, int height, GLenum pixelsFormat,
+                        GLenum pixelsType, uint64_t pixelsSize,
+                        const std::function<bool(const void* pixels, uint64_t size)>& consumePixels);
+    bool updateFromCallback(int x, int y, int width, int height, GLenum pixelsFormat,
+                            GLenum pixelsType, uint64_t pixelsSize,
+                            const std::function<bool(void* pixels, uint64_t size)>& fillPixels);
+
     enum class UsedApi {
         kGl,
         kVk,
@@ -93,6 +106,13 @@ class ColorBuffer : public android::snapshot::LazySnapshotObj<ColorBuffer> {
     bool invalidateForGl();
     bool invalidateForVk();
 
+    // Increases every time the contents may have changed, so that compositors can tell
+    // whether a layer needs to be drawn again. Returns 0 when some writes to this ColorBuffer
+    // are not reported, in which case the contents must be assumed to change at any time.
+    uint64_t getContentGeneration() const;
+    // Called for writes which do not go through this class, e.g. guest Vulkan presents.
+    void markContentChanged();
+
     std::optional<BlobDescriptorInfo> exportBlob();
 
 #if GFXSTREAM_ENABLE_HOST_GLES
@@ -134,6 +154,9 @@ class ColorBuffer : public android::snapshot::LazySnapshotObj<ColorBuffer> {
 
     bool mGlAndVkAreSharingExternalMemory = false;
     bool mGlTexDirty = false;
+
+    std::atomic<uint64_t> mContentGeneration{1};
+    std::atomic<bool> mContentGenerationTracked{true};
 };
 
 typedef std::shared_ptr<ColorBuffer> ColorBufferPtr;
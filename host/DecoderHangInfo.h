@@ -0,0 +1,135 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either expresso or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "aemu/base/HealthMonitor.h"
+
+namespace gfxstream {
+
+// Raw details about what a render thread is currently decoding. The decode loops only
+// store integers and pointers here, which is cheap enough to do for every packet. The
+// values are converted into HangAnnotations from the health monitor's hang callback, so
+// the string formatting cost is only paid when a hang is actually detected.
+//
+// Each render thread owns exactly one slot, see `forCurrentThread()`. Fields are written
+// by the owning thread and read by the health monitor thread.
+class DecoderHangInfo {
+   public:
+    static DecoderHangInfo& forCurrentThread() {
+        static thread_local DecoderHangInfo sInfo;
+        return sInfo;
+    }
+
+    // `processName` must outlive any watchdog using this slot.
+    void setProcessName(const char* processName) {
+        mProcessName.store(processName, std::memory_order_relaxed);
+    }
+
+    void setBuffer(uint32_t firstOpcode, uint64_t bufferLength) {
+        mFirstOpcode.store(firstOpcode, std::memory_order_relaxed);
+        mBufferLength.store(bufferLength, std::memory_order_relaxed);
+    }
+
+    void setPacket(uint32_t opcode, uint32_t packetLength,
+                   const std::optional<uint32_t>& previousSeqno) {
+        mOpcode.store(opcode, std::memory_order_relaxed);
+        mPacketLength.store(packetLength, std::memory_order_relaxed);
+        mSeqno.store(kUnset, std::memory_order_relaxed);
+        if (previousSeqno) {
+            mPreviousSeqno.store(*previousSeqno, std::memory_order_relaxed);
+        }
+    }
+
+    void setSeqno(uint32_t seqno) { mSeqno.store(seqno, std::memory_order_relaxed); }
+
+    // Builds a render thread watchdog that reports the current packet if it hangs. If
+    // `sequenceNumber` is set, its value at the time of the hang is reported too.
+    template <typename HealthMonitorT>
+    auto buildPacketWatchdog(HealthMonitorT* healthMonitor, const char* message,
+                             const std::atomic<uint32_t>* sequenceNumber = nullptr) {
+        return WATCHDOG_BUILDER(healthMonitor, message)
+            .setHangType(android::base::EventHangMetadata::HangType::kRenderThread)
+            .setOnHangCallback([this, sequenceNumber]() {
+                auto annotations = toAnnotations(/*includePacket=*/true);
+                if (sequenceNumber) {
+                    annotations->insert(
+                        {"seqnoPtr",
+                         std::to_string(sequenceNumber->load(std::memory_order_seq_cst))});
+                }
+                return annotations;
+            })
+            .build();
+    }
+
+    // Returns a callback suitable for `HealthWatchdogBuilder::setOnHangCallback()`.
+    // `includePacket` selects whether the per-packet fields are reported in addition to the
+    // per-buffer fields.
+    std::function<std::unique_ptr<android::base::EventHangMetadata::HangAnnotations>()>
+    annotationsCallback(bool includePacket) {
+        return [this, includePacket]() { return toAnnotations(includePacket); };
+    }
+
+    std::unique_ptr<android::base::EventHangMetadata::HangAnnotations> toAnnotations(
+        bool includePacket) const {
+        auto annotations = std::make_unique<android::base::EventHangMetadata::HangAnnotations>();
+        const char* processName = mProcessName.load(std::memory_order_relaxed);
+        if (processName) {
+            annotations->insert({"renderthread_guest_process", std::string(processName)});
+        }
+        if (!includePacket) {
+            const uint64_t bufferLength = mBufferLength.load(std::memory_order_relaxed);
+            if (bufferLength != kUnset) {
+                annotations->insert(
+                    {{"first_opcode", std::to_string(mFirstOpcode.load(std::memory_order_relaxed))},
+                     {"buffer_length", std::to_string(bufferLength)}});
+            }
+            return annotations;
+        }
+        annotations->insert(
+            {{"packet_length", std::to_string(mPacketLength.load(std::memory_order_relaxed))},
+             {"opcode", std::to_string(mOpcode.load(std::memory_order_relaxed))}});
+        const uint64_t seqno = mSeqno.load(std::memory_order_relaxed);
+        if (seqno != kUnset) {
+            annotations->insert({"seqno", std::to_string(seqno)});
+        }
+        const uint64_t previousSeqno = mPreviousSeqno.load(std::memory_order_relaxed);
+        if (previousSeqno != kUnset) {
+            annotations->insert({"previous_seqno", std::to_string(previousSeqno)});
+        }
+        return annotations;
+    }
+
+   private:
+    static constexpr uint64_t kUnset = UINT64_MAX;
+
+    DecoderHangInfo() = default;
+
+    std::atomic<const char*> mProcessName{nullptr};
+    std::atomic<uint32_t> mFirstOpcode{0};
+    std::atomic<uint64_t> mBufferLength{kUnset};
+    std::atomic<uint32_t> mOpcode{0};
+    std::atomic<uint32_t> mPacketLength{0};
+    std::atomic<uint64_t> mSeqno{kUnset};
+    std::atomic<uint64_t> mPreviousSeqno{kUnset};
+};
+
+}  // namespace gfxstream
@@ -1622,6 +1622,8 @@ void FrameBuffer::readColorBuffer(HandleType p_colorbuffer, int x, int y, int wi
     GFXSTREAM_TRACE_EVENT(GFXSTREAM_TRACE_DEFAULT_CATEGORY, "FrameBuffer::readColorBuffer()",
                           "ColorBuffer", p_colorbuffer);
 
+    waitForColorBufferPendingFlushFromVk(p_colorbuffer);
+
     AutoLock mutex(m_lock);
 
     ColorBufferPtr colorBuffer = findColorBuffer(p_colorbuffer);
@@ -1635,6 +1637,8 @@ void FrameBuffer::readColorBuffer(HandleType p_colorbuffer, int x, int y, int wi
 
 void FrameBuffer::readColorBufferYUV(HandleType p_colorbuffer, int x, int y, int width, int height,
                                      void* outPixels, uint32_t outPixelsSize) {
+    waitForColorBufferPendingFlushFromVk(p_colorbuffer);
+
     AutoLock mutex(m_lock);
 
     ColorBufferPtr colorBuffer = findColorBuffer(p_colorbuffer);
@@ -1673,6 +1677,8 @@ bool FrameBuffer::updateColorBuffer(HandleType p_colorbuffer,
         return false;
     }
 
+    waitForColorBufferPendingFlushFromVk(p_colorbuffer);
+
     AutoLock mutex(m_lock);
 
     ColorBufferPtr colorBuffer = findColorBuffer(p_colorbuffer);
@@ -1686,6 +1692,53 @@ bool FrameBuffer::updateColorBuffer(HandleType p_colorbuffer,
     return true;
 }
 
+bool FrameBuffer::readColorBufferToCallback(
+    HandleType p_colorbuffer, int x, int y, int width, int height, GLenum format, GLenum type,
+    uint64_t pixelsSize,
+    const std::function<bool(const void* pixels, uint64_t size)>& consumePixels) {
+    GFXSTREAM_TRACE_EVENT(GFXSTREAM_TRACE_DEFAULT_CATEGORY,
+                          "FrameBuffer::readColorBufferToCallback()", "ColorBuffer",
+                          p_colorbuffer);
+
+    waitForColorBufferPendingFlushFromVk(p_colorbuffer);
+
+    AutoLock mutex(m_lock);
+
+    ColorBufferPtr colorBuffer = findColorBuffer(p_colorbuffer);
+    if (!colorBuffer) {
+        // bad colorbuffer handle
+        return false;
+    }
+
+    return colorBuffer->readToCallback(x, y, width, height, format, type, pixelsSize,
+                                       consumePixels);
+}
+
+bool FrameBuffer::updateColorBufferFromCallback(
+    HandleType p_colorbuffer, int x, int y, int width, int height, GLenum format, GLenum type,
+    uint64_t pixelsSize, const std::function<bool(void* pixels, uint64_t size)>& fillPixels) {
+    GFXSTREAM_TRACE_EVENT(GFXSTREAM_TRACE_DEFAULT_CATEGORY,
+                          "FrameBuffer::updateColorBufferFromCallback()", "ColorBuffer",
+                          p_colorbuffer);
+
+    if (width == 0 || height == 0) {
+        return false;
+    }
+
+    waitForColorBufferPendingFlushFromVk(p_colorbuffer);
+
+    AutoLock mutex(m_lock);
+
+    ColorBufferPtr colorBuffer = findColorBuffer(p_colorbuffer);
+    if (!colorBuffer) {
+        // bad colorbuffer handle
+        return false;
+    }
+
+    return colorBuffer->updateFromCallback(x, y, width, height, format, type, pixelsSize,
+                                           fillPixels);
+}
+
 bool FrameBuffer::updateColorBufferFromFrameworkFormat(HandleType p_colorbuffer, int x, int y,
                                                        int width, int height,
                                                        FrameworkFormat fwkFormat, GLenum format,
@@ -1694,6 +1747,8 @@ bool FrameBuffer::updateColorBufferFromFrameworkFormat(HandleType p_colorbuffer,
         return false;
     }
 
+    waitForColorBufferPendingFlushFromVk(p_colorbuffer);
+
     AutoLock mutex(m_lock);
 
     ColorBufferMap::iterator c(m_colorbuffers.find(p_colorbuffer));
@@ -1794,6 +1849,10 @@ bool FrameBuffer::postImplSync(HandleType p_colorbuffer, bool needLockAndBind, b
 
 AsyncResult FrameBuffer::postImpl(HandleType p_colorbuffer, Post::CompletionCallback callback,
                                   bool needLockAndBind, bool repaint) {
+    if (needLockAndBind) {
+        waitForColorBufferPendingFlushFromVk(p_colorbuffer);
+    }
+
     ColorBufferPtr colorBuffer = nullptr;
     {
         AutoLock colorBufferMapLock(m_colorBufferMapLock);
@@ -1937,14 +1996,20 @@ void FrameBuffer::flushReadPipeline(int displayId) {
 }
 
 void FrameBuffer::ensureReadbackWorker() {
+    if (m_readbackWorker) {
+        return;
+    }
 #if GFXSTREAM_ENABLE_HOST_GLES
-    if (!m_readbackWorker) {
-        if (!m_emulationGl) {
-            GFXSTREAM_ABORT(FatalError(ABORT_REASON_OTHER)) << "GL/EGL emulation not enabled.";
-        }
+    if (m_emulationGl) {
         m_readbackWorker = m_emulationGl->getReadbackWorker();
+        return;
     }
 #endif
+    if (m_emulationVk) {
+        m_readbackWorker = m_emulationVk->getReadbackWorker();
+        return;
+    }
+    GFXSTREAM_ABORT(FatalError(ABORT_REASON_OTHER)) << "Neither GL nor Vulkan emulation enabled.";
 }
 
 static void sFrameBuffer_ReadPixelsCallback(void* pixels, uint32_t bytes, uint32_t displayId) {
@@ -1957,10 +2022,12 @@ static void sFrameBuffer_FlushReadPixelPipeline(int displayId) {
 
 bool FrameBuffer::asyncReadbackSupported() {
 #if GFXSTREAM_ENABLE_HOST_GLES
-    return m_emulationGl && m_emulationGl->isAsyncReadbackSupported();
-#else
-    return false;
+    if (m_emulationGl) {
+        return m_emulationGl->isAsyncReadbackSupported();
+    }
 #endif
+    // Without GL every ColorBuffer has a VkImage that the Vulkan worker can read back.
+    return m_emulationVk && m_emulationVk->getReadbackWorker();
 }
 
 Renderer::ReadPixelsCallback FrameBuffer::getReadPixelsCallback() {
@@ -2932,7 +2999,9 @@ bool FrameBuffer::flushColorBufferFromVk(HandleType colorBufferHandle) {
     AutoLock mutex(m_lock);
     auto colorBuffer = findColorBuffer(colorBufferHandle);
     if (!colorBuffer) {
-        ERR("%s: Failed to find ColorBuffer:%d", __func__, colorBufferHandle);
+        // Flushes run asynchronously after vkQueueSubmit, so the guest may have already
+        // destroyed the ColorBuffer.
+        VERBOSE("%s: Failed to find ColorBuffer:%d", __func__, colorBufferHandle);
         return false;
     }
     return colorBuffer->flushFromVk();
@@ -2944,13 +3013,15 @@ bool FrameBuffer::flushColorBufferFromVkBytes(HandleType colorBufferHandle, cons
 
     auto colorBuffer = findColorBuffer(colorBufferHandle);
     if (!colorBuffer) {
-        ERR("%s: Failed to find ColorBuffer:%d", __func__, colorBufferHandle);
+        VERBOSE("%s: Failed to find ColorBuffer:%d", __func__, colorBufferHandle);
         return false;
     }
     return colorBuffer->flushFromVkBytes(bytes, bytesSize);
 }
 
 bool FrameBuffer::invalidateColorBufferForVk(HandleType colorBufferHandle) {
+    waitForColorBufferPendingFlushFromVk(colorBufferHandle);
+
     // It reads contents from GL, which requires a context lock.
     // Also we should not do this in PostWorkerGl, otherwise it will deadlock.
     //
@@ -2965,6 +3036,23 @@ bool FrameBuffer::invalidateColorBufferForVk(HandleType colorBufferHandle) {
     return colorBuffer->invalidateForVk();
 }
 
+void FrameBuffer::markColorBufferContentChanged(HandleType colorBufferHandle) {
+    AutoLock mutex(m_lock);
+    auto colorBuffer = findColorBuffer(colorBufferHandle);
+    if (!colorBuffer) {
+        VERBOSE("%s: Failed to find ColorBuffer:%d", __func__, colorBufferHandle);
+        return;
+    }
+    colorBuffer->markContentChanged();
+}
+
+void FrameBuffer::waitForColorBufferPendingFlushFromVk(HandleType colorBufferHandle) {
+    if (!m_emulationVk) {
+        return;
+    }
+    m_emulationVk->waitForColorBufferPendingFlush(colorBufferHandle);
+}
+
 std::optional<BlobDescriptorInfo> FrameBuffer::exportColorBuffer(HandleType colorBufferHandle) {
     AutoLock mutex(m_lock);
 
@@ -3627,6 +3715,8 @@ bool FrameBuffer::flushColorBufferFromGl(HandleType colorBufferHandle) {
 }
 
 bool FrameBuffer::invalidateColorBufferForGl(HandleType colorBufferHandle) {
+    waitForColorBufferPendingFlushFromVk(colorBufferHandle);
+
     auto colorBuffer = findColorBuffer(colorBufferHandle);
     if (!colorBuffer) {
         VERBOSE("%s: Failed to find ColorBuffer:%d", __func__, colorBufferHandle);
@@ -3861,6 +3951,8 @@ void FrameBuffer::swapTexturesAndUpdateColorBuffer(uint32_t p_colorbuffer, int x
 
 bool FrameBuffer::readColorBufferContents(HandleType p_colorbuffer, size_t* numBytes,
                                           void* pixels) {
+    waitForColorBufferPendingFlushFromVk(p_colorbuffer);
+
     AutoLock mutex(m_lock);
 
     ColorBufferPtr colorBuffer = findColorBuffer(p_colorbuffer);
@@ -313,6 +313,22 @@ class FrameBuffer : public android::base::EventNotificationSupport<FrameBufferCh
                                               int height, FrameworkFormat fwkFormat, GLenum format,
                                               GLenum type, void* pixels, void* metadata = nullptr);
 
+    // Like readColorBuffer() and updateColorBuffer(), but the pixel data is
+    // handed to |consumePixels| or written by |fillPixels| instead of going
+    // through a caller-provided buffer. With Vulkan this is the mapped staging
+    // memory, which lets callers scatter/gather guest memory without an
+    // intermediate copy. |pixelsSize| is the size of the pixel data in
+    // |format| and |type|. The callbacks return false to fail the transfer.
+    // Returns true on success, false otherwise.
+    bool readColorBufferToCallback(
+        HandleType p_colorbuffer, int x, int y, int width, int height, GLenum format,
+        GLenum type, uint64_t pixelsSize,
+        const std::function<bool(const void* pixels, uint64_t size)>& consumePixels);
+    bool updateColorBufferFromCallback(
+        HandleType p_colorbuffer, int x, int y, int width, int height, GLenum format,
+        GLenum type, uint64_t pixelsSize,
+        const std::function<bool(void* pixels, uint64_t size)>& fillPixels);
+
     bool getColorBufferInfo(HandleType p_colorbuffer, int* width, int* height,
                             GLint* internalformat,
                             FrameworkFormat* frameworkFormat = nullptr);
@@ -508,6 +524,7 @@ class FrameBuffer : public android::base::EventNotificationSupport<FrameBufferCh
     bool flushColorBufferFromVkBytes(HandleType colorBufferHandle, const void* bytes,
                                      size_t bytesSize);
     bool invalidateColorBufferForVk(HandleType colorBufferHandle);
+    void markColorBufferContentChanged(HandleType colorBufferHandle);
 
     std::optional<BlobDescriptorInfo> exportColorBuffer(HandleType colorBufferHandle);
     std::optional<BlobDescriptorInfo> exportBuffer(HandleType bufferHandle);
@@ -732,6 +749,10 @@ class FrameBuffer : public android::base::EventNotificationSupport<FrameBufferCh
 
     std::future<void> blockPostWorker(std::future<void> continueSignal);
 
+    // Waits for any asynchronous flush of the ColorBuffer's Vulkan contents that was
+    // scheduled after a guest vkQueueSubmit(). Must be called without holding m_lock.
+    void waitForColorBufferPendingFlushFromVk(HandleType colorBufferHandle);
+
    private:
 
     static FrameBuffer* s_theFrameBuffer;
@@ -16,12 +16,146 @@
 #ifndef _PROCESS_RESOURCES_H
 #define _PROCESS_RESOURCES_H
 
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+
+#include "DecoderHangInfo.h"
 #include "aemu/base/Compiler.h"
 
 namespace gfxstream {
 
+// Orders commands from the render threads of a single guest process by the sequence
+// numbers that the guest assigned to them. A thread waiting for its turn spins briefly, as
+// the previous command is usually about to finish, and then parks.
+//
+// The generated decoders advance the sequence number with a plain fetch_add() on
+// getSequenceNumberPtr(), so parked threads are woken by wakeNext() instead: render threads
+// call it before waiting for their own next turn and when they are done decoding, and hooks
+// that block after the sequence number was advanced call it before blocking. It only wakes
+// the parking slot of the thread next in line (and any thread that hashes to the same slot).
+// Parked threads also recheck the sequence number every kParkRecheckInterval, in case the
+// thread that advanced it blocks somewhere that does not call wakeNext().
+class SequenceNumberOrdering {
+   public:
+    struct Stats {
+        uint64_t waits = 0;
+        uint64_t parks = 0;
+        uint64_t spinTimeUs = 0;
+        uint64_t parkTimeUs = 0;
+    };
+
+    SequenceNumberOrdering() = default;
+    DISALLOW_COPY_ASSIGN_AND_MOVE(SequenceNumberOrdering);
+
+    std::atomic<uint32_t>* getSequenceNumberPtr() { return &mSequenceNumber; }
+
+    bool isTurn(uint32_t seqno) const {
+        return seqno - mSequenceNumber.load(std::memory_order_seq_cst) == 1;
+    }
+
+    // Blocks until all commands before `seqno` have executed.
+    void waitForTurn(uint32_t seqno) {
+        // The caller usually just advanced the sequence number itself.
+        wakeNext();
+        if (isTurn(seqno)) {
+            return;
+        }
+
+        using Clock = std::chrono::steady_clock;
+        const auto spinStart = Clock::now();
+        mWaits.fetch_add(1, std::memory_order_relaxed);
+
+        for (uint32_t i = 0; i < kSpinIterations; i++) {
+            if (isTurn(seqno)) {
+                mSpinTimeUs.fetch_add(elapsedUs(spinStart, Clock::now()),
+                                      std::memory_order_relaxed);
+                return;
+            }
+            pause();
+        }
+
+        const auto parkStart = Clock::now();
+        mSpinTimeUs.fetch_add(elapsedUs(spinStart, parkStart), std::memory_order_relaxed);
+        mParks.fetch_add(1, std::memory_order_relaxed);
+
+        ParkingSlot& slot = slotFor(seqno);
+        {
+            std::unique_lock<std::mutex> lock(slot.mutex);
+            slot.waiters.fetch_add(1, std::memory_order_seq_cst);
+            while (!slot.cv.wait_for(lock, kParkRecheckInterval,
+                                     [this, seqno] { return isTurn(seqno); })) {
+            }
+            slot.waiters.fetch_sub(1, std::memory_order_seq_cst);
+        }
+        mParkTimeUs.fetch_add(elapsedUs(parkStart, Clock::now()), std::memory_order_relaxed);
+    }
+
+    // Wakes up the thread waiting to execute the command after the current sequence number,
+    // if any.
+    void wakeNext() {
+        const uint32_t seqno = mSequenceNumber.load(std::memory_order_seq_cst);
+        ParkingSlot& slot = slotFor(seqno + 1);
+        if (slot.waiters.load(std::memory_order_seq_cst) == 0) {
+            return;
+        }
+        // Taking the lock guarantees the waiter either has not checked the sequence number
+        // yet or is already blocked on the condition variable.
+        { std::lock_guard<std::mutex> lock(slot.mutex); }
+        slot.cv.notify_all();
+    }
+
+    Stats getStats() const {
+        return Stats{
+            .waits = mWaits.load(std::memory_order_relaxed),
+            .parks = mParks.load(std::memory_order_relaxed),
+            .spinTimeUs = mSpinTimeUs.load(std::memory_order_relaxed),
+            .parkTimeUs = mParkTimeUs.load(std::memory_order_relaxed),
+        };
+    }
+
+   private:
+    static constexpr uint32_t kSpinIterations = 4096;
+    static constexpr std::chrono::milliseconds kParkRecheckInterval{1};
+    static constexpr size_t kNumParkingSlots = 16;
+
+    struct ParkingSlot {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::atomic<uint32_t> waiters{0};
+    };
+
+    ParkingSlot& slotFor(uint32_t seqno) { return mParkingSlots[seqno % kNumParkingSlots]; }
+
+    static void pause() {
+#if (defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64)))
+        _mm_pause();
+#elif (defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)))
+        __asm__ __volatile__("pause;");
+#endif
+    }
+
+    static uint64_t elapsedUs(std::chrono::steady_clock::time_point start,
+                              std::chrono::steady_clock::time_point end) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    }
+
+    std::atomic<uint32_t> mSequenceNumber{0};
+    std::array<ParkingSlot, kNumParkingSlots> mParkingSlots;
+
+    std::atomic<uint64_t> mWaits{0};
+    std::atomic<uint64_t> mParks{0};
+    std::atomic<uint64_t> mSpinTimeUs{0};
+    std::atomic<uint64_t> mParkTimeUs{0};
+};
+
 class ProcessResources {
    public:
     // We only allow ProcessResources to be created on the heap, because the pointer to
@@ -32,11 +166,32 @@ class ProcessResources {
     DISALLOW_COPY_ASSIGN_AND_MOVE(ProcessResources);
 
     ~ProcessResources() = default;
-    std::atomic<uint32_t>* getSequenceNumberPtr() const { return &mSequenceNumber; }
+    std::atomic<uint32_t>* getSequenceNumberPtr() const {
+        return mSequenceNumber.getSequenceNumberPtr();
+    }
+
+    // Blocks until all commands before `seqno` have executed. A hang while waiting is reported
+    // with the current thread's DecoderHangInfo.
+    template <typename HealthMonitorT>
+    void waitForSequenceNumberTurn(uint32_t seqno, HealthMonitorT* healthMonitor) const {
+        if (mSequenceNumber.isTurn(seqno)) {
+            return;
+        }
+        // Only pay for a watchdog when this thread actually has to wait its turn.
+        auto watchdog = DecoderHangInfo::forCurrentThread().buildPacketWatchdog(
+            healthMonitor, "RenderThread seqno loop", mSequenceNumber.getSequenceNumberPtr());
+        mSequenceNumber.waitForTurn(seqno);
+    }
+
+    void wakeNextSequenceNumberWaiter() const { mSequenceNumber.wakeNext(); }
+
+    SequenceNumberOrdering::Stats getSequenceNumberStats() const {
+        return mSequenceNumber.getStats();
+    }
 
    private:
-    ProcessResources() : mSequenceNumber(0) {}
-    mutable std::atomic<uint32_t> mSequenceNumber;
+    ProcessResources() = default;
+    mutable SequenceNumberOrdering mSequenceNumber;
 };
 
 }  // namespace gfxstream
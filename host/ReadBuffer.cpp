@@ -20,6 +20,7 @@
 #include <algorithm>
 
 #include <assert.h>
+#include <inttypes.h>
 #include <string.h>
 #include <limits.h>
 
@@ -33,6 +34,9 @@ ReadBuffer::ReadBuffer(size_t bufsize) {
 }
 
 ReadBuffer::~ReadBuffer() {
+    if (m_inPlaceStream) {
+        m_inPlaceStream->releaseInPlace();
+    }
     free(m_buf);
 }
 
@@ -44,6 +48,25 @@ int ReadBuffer::getData(IOStream* stream, size_t minSize) {
     assert(stream);
     assert(minSize > m_validData);
 
+    if (m_inPlaceStream) {
+        // The rest of the chunk does not hold enough data, e.g. because a packet wraps
+        // around the end of the ring. Continue from a copy.
+        if (detachInPlace() < 0) {
+            return -1;
+        }
+    } else if (m_validData == 0) {
+        // Nothing is pending, so the decoders can work straight out of the stream's memory
+        // if it holds enough contiguous data.
+        size_t inPlaceSize = 0;
+        const unsigned char* inPlace = stream->readInPlace(minSize, &inPlaceSize);
+        if (inPlace) {
+            m_inPlaceStream = stream;
+            m_readPtr = const_cast<unsigned char*>(inPlace);
+            m_validData = inPlaceSize;
+            return static_cast<int>(inPlaceSize);
+        }
+    }
+
     const size_t minSizeToRead = minSize - m_validData;
     const size_t neededFreeTailThisTime =
         std::max(minSizeToRead,
@@ -100,6 +123,7 @@ int ReadBuffer::getData(IOStream* stream, size_t minSize) {
         }
         readTotal += readNow;
         m_validData += readNow;
+        m_stats.bytesCopied += readNow;
     } while (readTotal < minSizeToRead);
 
     return readTotal;
@@ -109,6 +133,38 @@ void ReadBuffer::consume(size_t amount) {
     assert(amount <= m_validData);
     m_validData -= amount;
     m_readPtr += amount;
+
+    if (m_inPlaceStream) {
+        m_stats.bytesInPlace += amount;
+        if (m_validData == 0) {
+            // Hand the chunk back to the guest as soon as it has been decoded.
+            m_inPlaceStream->releaseInPlace();
+            m_inPlaceStream = nullptr;
+            m_readPtr = m_buf;
+        }
+    }
+}
+
+int ReadBuffer::detachInPlace() {
+    if (m_validData > m_size) {
+        const size_t new_size = std::max(m_validData, 2 * m_size);
+        const auto new_buf = (unsigned char*)malloc(new_size);
+        if (!new_buf) {
+            ERR("Failed to alloc %zu bytes for ReadBuffer\n", new_size);
+            return -1;
+        }
+        free(m_buf);
+        m_buf = new_buf;
+        m_size = new_size;
+    }
+
+    memcpy(m_buf, m_readPtr, m_validData);
+    m_stats.bytesCopied += m_validData;
+    m_readPtr = m_buf;
+
+    m_inPlaceStream->releaseInPlace();
+    m_inPlaceStream = nullptr;
+    return 0;
 }
 
 void ReadBuffer::onSave(android::base::Stream* stream) {
@@ -131,8 +187,10 @@ void ReadBuffer::onLoad(android::base::Stream* stream) {
 }
 
 void ReadBuffer::printStats() {
-    printf("ReadBuffer::%s: tail move time %f ms\n", __func__,
-            (float)m_tailMoveTimeUs / 1000.0f);
+    printf("ReadBuffer::%s: tail move time %f ms, bytes copied %" PRIu64
+           ", bytes decoded in place %" PRIu64 "\n",
+           __func__, (float)m_tailMoveTimeUs / 1000.0f, m_stats.bytesCopied,
+           m_stats.bytesInPlace);
     m_tailMoveTimeUs = 0;
 }
 }  // namespace gfxstream
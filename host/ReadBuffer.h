@@ -24,6 +24,13 @@ public:
     explicit ReadBuffer(size_t bufSize);
     ~ReadBuffer();
 
+    struct Stats {
+        // Bytes copied out of the stream into this buffer.
+        uint64_t bytesCopied = 0;
+        // Bytes consumed directly from the stream's memory, see IOStream::readInPlace().
+        uint64_t bytesInPlace = 0;
+    };
+
     void setNeededFreeTailSize(size_t size);
     int getData(IOStream *stream, size_t minSize); // get fresh data from the stream
     unsigned char *buf() { return m_readPtr; } // return the next read location
@@ -33,15 +40,23 @@ public:
     void onLoad(android::base::Stream* stream);
     void onSave(android::base::Stream* stream);
 
+    Stats getStats() const { return m_stats; }
     void printStats();
 private:
+    // Copies the unconsumed part of an in place chunk into m_buf and releases the chunk.
+    int detachInPlace();
+
     unsigned char *m_buf;
     unsigned char *m_readPtr;
     size_t m_size;
     size_t m_validData;
 
+    // Set while m_readPtr points into memory owned by this stream instead of m_buf.
+    IOStream* m_inPlaceStream = nullptr;
+
     uint64_t m_tailMoveTimeUs = 0;
     size_t m_neededFreeTailSize = 0;
+    Stats m_stats;
 };
 
 }  // namespace gfxstream
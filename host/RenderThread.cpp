@@ -16,11 +16,13 @@
 #include "RenderThread.h"
 
 #include "ChannelStream.h"
+#include "DecoderHangInfo.h"
 #include "FrameBuffer.h"
 #include "ReadBuffer.h"
 #include "RenderChannelImpl.h"
 #include "RenderThreadInfo.h"
 #include "RingStream.h"
+#include "StreamCapture.h"
 #include "VkDecoderContext.h"
 #include "aemu/base/HealthMonitor.h"
 #include "aemu/base/Metrics.h"
@@ -47,6 +49,7 @@
 #include <assert.h>
 #include <string.h>
 
+#include <string>
 #include <unordered_map>
 
 namespace gfxstream {
@@ -73,6 +76,91 @@ static bool getBenchmarkEnabledFromEnv() {
     return false;
 }
 
+static std::string formatWaitStats(const RingStreamWaitStats& stats) {
+    return "spins=" + std::to_string(stats.spins) + " yields=" + std::to_string(stats.yields) +
+           " blocks=" + std::to_string(stats.blocks) +
+           " blocked_us=" + std::to_string(stats.blockedUs);
+}
+
+static void addWaitStats(RingStreamWaitStats* total, const RingStreamWaitStats& stats) {
+    total->spins += stats.spins;
+    total->yields += stats.yields;
+    total->blocks += stats.blocks;
+    total->blockedUs += stats.blockedUs;
+}
+
+// How much all finished ring streams waited on their guests, so that the
+// RingStreamWaitPolicy can be tuned for a deployment.
+struct RingStreamWaitTotals {
+    android::base::Lock lock;
+    uint64_t streams = 0;
+    RingStreamWaitStats read;
+    RingStreamWaitStats write;
+};
+
+static RingStreamWaitTotals& getRingStreamWaitTotals() {
+    static RingStreamWaitTotals* sTotals = new RingStreamWaitTotals();
+    return *sTotals;
+}
+
+static void logRingStreamWaitStats(uint32_t contextId, const RingStream& ringStream) {
+    VERBOSE("RingStream wait stats for context %u: read wait %s, write wait %s", contextId,
+            formatWaitStats(ringStream.getReadWaitStats()).c_str(),
+            formatWaitStats(ringStream.getWriteWaitStats()).c_str());
+
+    auto& totals = getRingStreamWaitTotals();
+    android::base::AutoLock lock(totals.lock);
+    ++totals.streams;
+    addWaitStats(&totals.read, ringStream.getReadWaitStats());
+    addWaitStats(&totals.write, ringStream.getWriteWaitStats());
+}
+
+// Event codes of the ring stream wait totals reported through
+// MetricsLogger::add_instant_event_with_metric_callback.
+enum RingStreamWaitMetricEvent : int64_t {
+    kRingStreamWaitMetricStreams = 10200,
+    kRingStreamWaitMetricReadSpins = 10201,
+    kRingStreamWaitMetricReadYields = 10202,
+    kRingStreamWaitMetricReadBlocks = 10203,
+    kRingStreamWaitMetricReadBlockedUs = 10204,
+    kRingStreamWaitMetricWriteSpins = 10205,
+    kRingStreamWaitMetricWriteYields = 10206,
+    kRingStreamWaitMetricWriteBlocks = 10207,
+    kRingStreamWaitMetricWriteBlockedUs = 10208,
+};
+
+// static
+void RenderThread::logRingStreamWaitTotals() {
+    auto& totals = getRingStreamWaitTotals();
+    android::base::AutoLock lock(totals.lock);
+    if (!totals.streams) {
+        return;
+    }
+    INFO("RingStream wait stats over %llu render threads: read wait %s, write wait %s",
+         static_cast<unsigned long long>(totals.streams), formatWaitStats(totals.read).c_str(),
+         formatWaitStats(totals.write).c_str());
+
+    if (auto addMetric = android::base::MetricsLogger::add_instant_event_with_metric_callback) {
+        auto add = [addMetric](RingStreamWaitMetricEvent event, uint64_t value) {
+            addMetric(event, static_cast<int64_t>(value));
+        };
+        add(kRingStreamWaitMetricStreams, totals.streams);
+        add(kRingStreamWaitMetricReadSpins, totals.read.spins);
+        add(kRingStreamWaitMetricReadYields, totals.read.yields);
+        add(kRingStreamWaitMetricReadBlocks, totals.read.blocks);
+        add(kRingStreamWaitMetricReadBlockedUs, totals.read.blockedUs);
+        add(kRingStreamWaitMetricWriteSpins, totals.write.spins);
+        add(kRingStreamWaitMetricWriteYields, totals.write.yields);
+        add(kRingStreamWaitMetricWriteBlocks, totals.write.blocks);
+        add(kRingStreamWaitMetricWriteBlockedUs, totals.write.blockedUs);
+    }
+
+    // Only exported once, a later renderer in the same process starts over.
+    totals.streams = 0;
+    totals.read = RingStreamWaitStats();
+    totals.write = RingStreamWaitStats();
+}
+
 // Start with a smaller buffer to not waste memory on a low-used render threads.
 static constexpr int kStreamBufferSize = 128 * 1024;
 
@@ -82,6 +170,60 @@ static constexpr int kMinThreadsToRunUnlimited = 5;
 // A thread run limiter that limits render threads to run one slice at a time.
 static android::base::Lock sThreadRunLimiter;
 
+// The API families multiplexed on a render thread's stream. Each family owns a range of
+// opcodes, starting at the base assigned by the guest side encoder generators and ending at
+// the base of the next family:
+//   GLESv1: 1024, GLESv2: 2048, renderControl: 10000, Vulkan: 20000 and 200000000,
+//   Magma: 100000.
+// GLESv1 and GLESv2 are grouped together as they are decoded under the same lock.
+enum class ApiFamily {
+    kUnknown,
+    kGles,
+    kRenderControl,
+    kVulkan,
+    kMagma,
+};
+
+static ApiFamily getApiFamily(uint32_t opcode) {
+    if (opcode >= 1024 && opcode < 10000) return ApiFamily::kGles;
+    if (opcode >= 10000 && opcode < 20000) return ApiFamily::kRenderControl;
+    if (opcode >= 20000 && opcode < 30000) return ApiFamily::kVulkan;
+    if (opcode >= 100000 && opcode < 200000) return ApiFamily::kMagma;
+    if (opcode >= 200000000 && opcode < 300000000) return ApiFamily::kVulkan;
+    return ApiFamily::kUnknown;
+}
+
+// Peeks at the packets at the start of |buf| and returns the length of the longest prefix of
+// complete packets that belong to the same API family as the first one. Returns 0 if there
+// is no complete packet yet.
+static size_t getApiFamilyRun(const uint8_t* buf, size_t len, ApiFamily* outFamily) {
+    *outFamily = ApiFamily::kUnknown;
+    if (len < 8) {
+        return 0;
+    }
+
+    uint32_t opcode;
+    memcpy(&opcode, buf, sizeof(opcode));
+    const ApiFamily family = getApiFamily(opcode);
+    *outFamily = family;
+
+    size_t pos = 0;
+    while (len - pos >= 8) {
+        uint32_t packetLen;
+        memcpy(&opcode, buf + pos, sizeof(opcode));
+        memcpy(&packetLen, buf + pos + 4, sizeof(packetLen));
+        if (packetLen < 8) {
+            // Malformed packet: hand everything to the decoder, which knows how to report it.
+            return pos == 0 ? len : pos;
+        }
+        if (getApiFamily(opcode) != family || len - pos < packetLen) {
+            break;
+        }
+        pos += packetLen;
+    }
+    return pos;
+}
+
 RenderThread::RenderThread(RenderChannelImpl* channel,
                            android::base::Stream* loadStream,
                            uint32_t virtioGpuContextId)
@@ -323,6 +465,11 @@ intptr_t RenderThread::main() {
     // it's completely initialized before running any GL commands.
     FrameBuffer::waitUntilInitialized();
 
+    if (mRingStream) {
+        mRingStream->setInPlaceReadsEnabled(
+            FrameBuffer::getFB()->getFeatures().RingStreamInPlaceDecode.enabled);
+    }
+
     if (FrameBuffer::getFB()->hasEmulationVk()) {
         tInfo->m_vkInfo.emplace();
     }
@@ -361,25 +508,13 @@ intptr_t RenderThread::main() {
     auto stats_t0 = android::base::getHighResTimeUs() / 1000;
     bool benchmarkEnabled = getBenchmarkEnabledFromEnv();
 
-    //
-    // open dump file if RENDER_DUMP_DIR is defined
-    //
-    const char* dump_dir = getenv("RENDERER_DUMP_DIR");
-    FILE* dumpFP = nullptr;
-    if (dump_dir) {
-        // size_t bsize = strlen(dump_dir) + 32;
-        // char* fname = new char[bsize];
-        // snprintf(fname, bsize, "%s" PATH_SEP "stream_%p", dump_dir, this);
-        // dumpFP = android_fopen(fname, "wb");
-        // if (!dumpFP) {
-        //     fprintf(stderr, "Warning: stream dump failed to open file %s\n",
-        //             fname);
-        // }
-        // delete[] fname;
-    }
+    // Capture the guest stream if RENDERER_DUMP_DIR is set, see StreamCapture.h.
+    std::unique_ptr<StreamCaptureWriter> capture = StreamCaptureWriter::createFromEnv(mContextId);
+    bool captureHasProcessName = false;
 
     GfxApiLogger gfxLogger;
     auto& metricsLogger = FrameBuffer::getFB()->getMetricsLogger();
+    DecoderHangInfo& hangInfo = DecoderHangInfo::forCurrentThread();
 
     const ProcessResources* processResources = nullptr;
     bool anyProgress = false;
@@ -450,21 +585,24 @@ intptr_t RenderThread::main() {
             }
         }
 
-        //
-        // dump stream to file if needed
-        //
-        if (dumpFP) {
-            int skip = readBuf.validData() - stat;
-            fwrite(readBuf.buf() + skip, 1, readBuf.validData() - skip, dumpFP);
-            fflush(dumpFP);
+        if (capture && stat > 0) {
+            // The guest usually only reports its process name through renderControl after
+            // the thread has started, so look it up again until it is known.
+            if (!captureHasProcessName) {
+                const std::optional<std::string>& processName =
+                    tInfo->m_processName ? tInfo->m_processName : mNameOpt;
+                if (processName) {
+                    capture->writeProcessName(*processName);
+                    captureHasProcessName = true;
+                }
+            }
+            capture->writeGuestData(readBuf.buf() + readBuf.validData() - stat, stat);
         }
 
         bool progress = false;
         anyProgress = false;
         do {
             anyProgress |= progress;
-            std::unique_ptr<EventHangMetadata::HangAnnotations> renderThreadData =
-                std::make_unique<EventHangMetadata::HangAnnotations>();
 
             const char* contextName = nullptr;
             if (mNameOpt) {
@@ -473,20 +611,16 @@ intptr_t RenderThread::main() {
 
             auto* healthMonitor = FrameBuffer::getFB()->getHealthMonitor();
             if (healthMonitor) {
-                if (contextName) {
-                    renderThreadData->insert(
-                        {{"renderthread_guest_process", contextName}});
-                }
+                hangInfo.setProcessName(contextName);
                 if (readBuf.validData() >= 4) {
-                    renderThreadData->insert(
-                        {{"first_opcode", std::to_string(*(uint32_t*)readBuf.buf())},
-                         {"buffer_length", std::to_string(readBuf.validData())}});
+                    hangInfo.setBuffer(*(uint32_t*)readBuf.buf(), readBuf.validData());
                 }
             }
-            auto watchdog = WATCHDOG_BUILDER(healthMonitor, "RenderThread decode operation")
-                                .setHangType(EventHangMetadata::HangType::kRenderThread)
-                                .setAnnotations(std::move(renderThreadData))
-                                .build();
+            auto watchdog =
+                WATCHDOG_BUILDER(healthMonitor, "RenderThread decode operation")
+                    .setHangType(EventHangMetadata::HangType::kRenderThread)
+                    .setOnHangCallback(hangInfo.annotationsCallback(/*includePacket=*/false))
+                    .build();
 
             if (!tInfo->m_puid) {
                 tInfo->m_puid = mContextId;
@@ -499,118 +633,133 @@ intptr_t RenderThread::main() {
             progress = false;
             size_t last;
 
-            //
-            // try to process some of the command buffer using the
-            // Vulkan decoder
-            //
-            // Note: It's risky to limit Vulkan decoding to one thread,
-            // so we do it outside the limiter
-            if (tInfo->m_vkInfo) {
-                tInfo->m_vkInfo->ctx_id = mContextId;
-                VkDecoderContext context = {
-                    .processName = contextName,
-                    .gfxApiLogger = &gfxLogger,
-                    .healthMonitor = FrameBuffer::getFB()->getHealthMonitor(),
-                    .metricsLogger = &metricsLogger,
-                };
-                last = tInfo->m_vkInfo->m_vkDec.decode(readBuf.buf(), readBuf.validData(), ioStream,
-                                                      processResources, context);
-                if (last > 0) {
-                    if (!processResources) {
-                        ERR("Processed some Vulkan packets without process resources created. "
-                            "That's problematic.");
-                    }
-                    readBuf.consume(last);
-                    progress = true;
-                }
+            // Route the run of packets at the front of the buffer straight to the decoder for
+            // its API family, so that only the locks that family needs are taken, once per
+            // run, instead of offering the buffer to every decoder in turn.
+            ApiFamily family;
+            const size_t runLength = getApiFamilyRun(readBuf.buf(), readBuf.validData(), &family);
+            if (runLength == 0) {
+                break;
             }
 
             std::optional<android::base::AutoLock> limitedModeLock;
-            if (mRunInLimitedMode) {
+            if (mRunInLimitedMode && family != ApiFamily::kVulkan) {
                 limitedModeLock.emplace(sThreadRunLimiter);
             }
 
-            // try to process some of the command buffer using the GLESv1
-            // decoder
-            //
-            // DRIVER WORKAROUND:
-            // On Linux with NVIDIA GPU's at least, we need to avoid performing
-            // GLES ops while someone else holds the FrameBuffer write lock.
-            //
-            // To be more specific, on Linux with NVIDIA Quadro K2200 v361.xx,
-            // we get a segfault in the NVIDIA driver when glTexSubImage2D
-            // is called at the same time as glXMake(Context)Current.
-            //
-            // To fix, this driver workaround avoids calling
-            // any sort of GLES call when we are creating/destroying EGL
-            // contexts.
-            {
-                FrameBuffer::getFB()->lockContextStructureRead();
-            }
-
-#if GFXSTREAM_ENABLE_HOST_GLES
-            if (tInfo->m_glInfo) {
-                {
-                    last = tInfo->m_glInfo->m_glDec.decode(
-                            readBuf.buf(), readBuf.validData(), ioStream, &checksumCalc);
+            switch (family) {
+                case ApiFamily::kVulkan: {
+                    // Note: It's risky to limit Vulkan decoding to one thread,
+                    // so we do it outside the limiter
+                    if (!tInfo->m_vkInfo) {
+                        break;
+                    }
+                    tInfo->m_vkInfo->ctx_id = mContextId;
+                    VkDecoderContext context = {
+                        .processName = contextName,
+                        .gfxApiLogger = &gfxLogger,
+                        .healthMonitor = FrameBuffer::getFB()->getHealthMonitor(),
+                        .metricsLogger = &metricsLogger,
+                        .processResources = processResources,
+                    };
+                    last = tInfo->m_vkInfo->m_vkDec.decode(readBuf.buf(), runLength, ioStream,
+                                                          processResources, context);
+                    if (processResources) {
+                        // The last command decoded may have advanced the sequence number.
+                        processResources->wakeNextSequenceNumberWaiter();
+                    }
                     if (last > 0) {
-                        progress = true;
+                        if (!processResources) {
+                            ERR("Processed some Vulkan packets without process resources "
+                                "created. That's problematic.");
+                        }
                         readBuf.consume(last);
+                        progress = true;
                     }
+                    break;
                 }
+                case ApiFamily::kGles: {
+#if GFXSTREAM_ENABLE_HOST_GLES
+                    if (!tInfo->m_glInfo) {
+                        break;
+                    }
 
-                //
-                // try to process some of the command buffer using the GLESv2
-                // decoder
-                //
-                {
-                    last = tInfo->m_glInfo->m_gl2Dec.decode(readBuf.buf(), readBuf.validData(),
-                                                           ioStream, &checksumCalc);
+                    // DRIVER WORKAROUND:
+                    // On Linux with NVIDIA GPU's at least, we need to avoid performing
+                    // GLES ops while someone else holds the FrameBuffer write lock.
+                    //
+                    // To be more specific, on Linux with NVIDIA Quadro K2200 v361.xx,
+                    // we get a segfault in the NVIDIA driver when glTexSubImage2D
+                    // is called at the same time as glXMake(Context)Current.
+                    //
+                    // To fix, this driver workaround avoids calling
+                    // any sort of GLES call when we are creating/destroying EGL
+                    // contexts.
+                    FrameBuffer::getFB()->lockContextStructureRead();
+
+                    // The run may interleave GLESv1 and GLESv2 packets; each decoder stops at
+                    // the first packet of the other one.
+                    size_t remaining = runLength;
+                    bool glProgress = true;
+                    while (remaining > 0 && glProgress) {
+                        glProgress = false;
+                        last = tInfo->m_glInfo->m_glDec.decode(readBuf.buf(), remaining,
+                                                               ioStream, &checksumCalc);
+                        if (last > 0) {
+                            readBuf.consume(last);
+                            remaining -= last;
+                            glProgress = true;
+                        }
+
+                        last = tInfo->m_glInfo->m_gl2Dec.decode(readBuf.buf(), remaining,
+                                                                ioStream, &checksumCalc);
+                        if (last > 0) {
+                            readBuf.consume(last);
+                            remaining -= last;
+                            glProgress = true;
+                        }
+                        progress |= glProgress;
+                    }
 
+                    FrameBuffer::getFB()->unlockContextStructureRead();
+#endif
+                    break;
+                }
+                case ApiFamily::kRenderControl: {
+#if GFXSTREAM_ENABLE_HOST_GLES
+                    last = tInfo->m_rcDec.decode(readBuf.buf(), runLength, ioStream,
+                                                &checksumCalc);
                     if (last > 0) {
-                        progress = true;
                         readBuf.consume(last);
+                        progress = true;
                     }
-                }
-            }
 #endif
-
-            FrameBuffer::getFB()->unlockContextStructureRead();
-            //
-            // try to process some of the command buffer using the
-            // renderControl decoder
-            //
-#if GFXSTREAM_ENABLE_HOST_GLES
-            {
-                last = tInfo->m_rcDec.decode(readBuf.buf(), readBuf.validData(),
-                                            ioStream, &checksumCalc);
-                if (last > 0) {
-                    readBuf.consume(last);
-                    progress = true;
+                    break;
                 }
-            }
-#endif
-
-            //
-            // try to process some of the command buffer using the Magma
-            // decoder
-            //
+                case ApiFamily::kMagma: {
 #if GFXSTREAM_ENABLE_HOST_MAGMA
-            if (tInfo->m_magmaInfo && tInfo->m_magmaInfo->mMagmaDec)
-            {
-                last = tInfo->m_magmaInfo->mMagmaDec->decode(readBuf.buf(), readBuf.validData(),
-                                                            ioStream, &checksumCalc);
-                if (last > 0) {
-                    readBuf.consume(last);
-                    progress = true;
+                    if (tInfo->m_magmaInfo && tInfo->m_magmaInfo->mMagmaDec) {
+                        last = tInfo->m_magmaInfo->mMagmaDec->decode(readBuf.buf(), runLength,
+                                                                    ioStream, &checksumCalc);
+                        if (last > 0) {
+                            readBuf.consume(last);
+                            progress = true;
+                        }
+                    }
+#endif
+                    break;
                 }
+                case ApiFamily::kUnknown:
+                    // No decoder accepts this opcode.
+                    break;
             }
-#endif
         } while (progress);
     }
 
-    if (dumpFP) {
-        fclose(dumpFP);
+    capture.reset();
+
+    if (mRingStream) {
+        logRingStreamWaitStats(mContextId, *mRingStream);
     }
 
 #if GFXSTREAM_ENABLE_HOST_GLES
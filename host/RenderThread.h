@@ -53,6 +53,10 @@ public:
         std::optional<std::string> nameOpt);
     virtual ~RenderThread();
 
+    // Logs how much the ring streams of all finished render threads waited on their guests and
+    // reports it through the MetricsLogger callbacks. Called once at renderer shutdown.
+    static void logRingStreamWaitTotals();
+
     // Returns true iff the thread has finished.
     bool isFinished() const { return mFinished.load(std::memory_order_relaxed); }
     void waitForFinished();
@@ -66,6 +66,18 @@ public:
             using android::base::WorkerProcessingResult;
             struct {
                 WorkerProcessingResult operator()(CleanProcessResources resources) {
+                    if (resources.resource) {
+                        const auto stats = resources.resource->getSequenceNumberStats();
+                        if (stats.waits > 0) {
+                            INFO("Process %llu waited %llu times for its sequence number turn: "
+                                 "%llu us spinning, %llu us parked over %llu parks.",
+                                 (unsigned long long)resources.puid,
+                                 (unsigned long long)stats.waits,
+                                 (unsigned long long)stats.spinTimeUs,
+                                 (unsigned long long)stats.parkTimeUs,
+                                 (unsigned long long)stats.parks);
+                        }
+                    }
                     FrameBuffer::getFB()->cleanupProcGLObjects(resources.puid);
                     // resources.resource are destroyed automatically when going out of the scope.
                     return WorkerProcessingResult::Continue;
@@ -123,6 +135,8 @@ RendererImpl::~RendererImpl() {
         mLoaderRenderThread->wait();
     }
     mRenderWindow.reset();
+
+    RenderThread::logRingStreamWaitTotals();
 }
 
 bool RendererImpl::initialize(int width, int height, gfxstream::host::FeatureSet features,
@@ -22,13 +22,59 @@
 #include "host-common/dma_device.h"
 #include "host-common/GfxstreamFatalError.h"
 
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+
 #include <assert.h>
+#include <inttypes.h>
 #include <memory.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
 
 using emugl::ABORT_REASON_OTHER;
 using emugl::FatalError;
 
 namespace gfxstream {
+namespace {
+
+constexpr uint32_t kMinSleepUs = 10;
+
+uint32_t getUint32FromEnv(const char* name, uint32_t defaultValue) {
+    const std::string value = android::base::getEnvironmentVariable(name);
+    if (value.empty()) {
+        return defaultValue;
+    }
+    return static_cast<uint32_t>(strtoul(value.c_str(), nullptr, 10));
+}
+
+void cpuRelax() {
+#if (defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64)))
+    _mm_pause();
+#elif (defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)))
+    __asm__ __volatile__("pause;");
+#endif
+}
+
+}  // namespace
+
+// static
+const RingStreamWaitPolicy& RingStreamWaitPolicy::get() {
+    static const RingStreamWaitPolicy sPolicy = []() {
+        RingStreamWaitPolicy policy;
+        policy.spinIterations =
+            getUint32FromEnv("ANDROID_GFXSTREAM_RING_SPIN_ITERATIONS", policy.spinIterations);
+        policy.yieldIterations =
+            getUint32FromEnv("ANDROID_GFXSTREAM_RING_YIELD_ITERATIONS", policy.yieldIterations);
+        policy.maxSleepUs = std::max(
+            kMinSleepUs, getUint32FromEnv("ANDROID_GFXSTREAM_RING_MAX_SLEEP_US", policy.maxSleepUs));
+        return policy;
+    }();
+    return sPolicy;
+}
 
 RingStream::RingStream(
     struct asg_context context,
@@ -36,9 +82,36 @@ RingStream::RingStream(
     size_t bufsize) :
     IOStream(bufsize),
     mContext(context),
-    mCallbacks(callbacks) { }
+    mCallbacks(callbacks),
+    mWaitPolicy(RingStreamWaitPolicy::get()) { }
 RingStream::~RingStream() = default;
 
+RingStream::WaitStep RingStream::waitStep(uint32_t* attempt, RingStreamWaitStats* stats) const {
+    const uint32_t current = (*attempt)++;
+    if (current < mWaitPolicy.spinIterations) {
+        cpuRelax();
+        ++stats->spins;
+        return WaitStep::kSpin;
+    }
+    if (current - mWaitPolicy.spinIterations < mWaitPolicy.yieldIterations) {
+        std::this_thread::yield();
+        ++stats->yields;
+        return WaitStep::kYield;
+    }
+    --(*attempt);
+    return WaitStep::kBlock;
+}
+
+void RingStream::backOff(uint32_t* attempt, uint32_t* sleepUs, RingStreamWaitStats* stats) const {
+    if (waitStep(attempt, stats) != WaitStep::kBlock) {
+        return;
+    }
+    android::base::sleepUs(*sleepUs);
+    ++stats->blocks;
+    stats->blockedUs += *sleepUs;
+    *sleepUs = std::min(*sleepUs * 2, mWaitPolicy.maxSleepUs);
+}
+
 int RingStream::getNeededFreeTailSize() const {
     return mContext.ring_config->flush_interval;
 }
@@ -54,11 +127,10 @@ int RingStream::commitBuffer(size_t size) {
     size_t sent = 0;
     auto data = mWriteBuffer.data();
 
-    size_t iters = 0;
-    size_t backedOffIters = 0;
-    const size_t kBackoffIters = 10000000ULL;
+    uint32_t waitAttempt = 0;
+    uint32_t sleepUs = kMinSleepUs;
+    const uint64_t blocksBefore = mWriteWaitStats.blocks;
     while (sent < size) {
-        ++iters;
         auto avail = ring_buffer_available_write(
             mContext.from_host_large_xfer.ring,
             &mContext.from_host_large_xfer.view);
@@ -67,15 +139,12 @@ int RingStream::commitBuffer(size_t size) {
         if (!avail) {
             if (*(mContext.host_state) == ASG_HOST_STATE_EXIT) {
                 return sent;
-            } else {
-                ring_buffer_yield();
-                if (iters > kBackoffIters) {
-                    android::base::sleepUs(10);
-                    ++backedOffIters;
-                }
             }
+            backOff(&waitAttempt, &sleepUs, &mWriteWaitStats);
             continue;
         }
+        waitAttempt = 0;
+        sleepUs = kMinSleepUs;
 
         auto remaining = size - sent;
         auto todo = remaining < avail ? remaining : avail;
@@ -88,8 +157,9 @@ int RingStream::commitBuffer(size_t size) {
         sent += todo;
     }
 
+    const uint64_t backedOffIters = mWriteWaitStats.blocks - blocksBefore;
     if (backedOffIters > 0) {
-        WARN("Backed off %zu times to avoid overloading the guest system. This "
+        WARN("Backed off %" PRIu64 " times to avoid overloading the guest system. This "
              "may indicate resource constraints or performance issues.",
              backedOffIters);
     }
@@ -104,8 +174,8 @@ const unsigned char* RingStream::readRaw(void* buf, size_t* inout_len) {
     uint32_t ringAvailable = 0;
     uint32_t ringLargeXferAvailable = 0;
 
-    const uint32_t maxSpins = 30;
-    uint32_t spins = 0;
+    uint32_t waitAttempt = 0;
+    uint32_t sleepUs = kMinSleepUs;
     bool inLargeXfer = true;
 
     *(mContext.host_state) = ASG_HOST_STATE_CAN_CONSUME;
@@ -151,6 +221,11 @@ const unsigned char* RingStream::readRaw(void* buf, size_t* inout_len) {
         auto current = dst + count;
         auto ptrEnd = dst + wanted;
 
+        if (ringAvailable || ringLargeXferAvailable) {
+            waitAttempt = 0;
+            sleepUs = kMinSleepUs;
+        }
+
         if (ringAvailable) {
             inLargeXfer = false;
             uint32_t transferMode =
@@ -181,6 +256,9 @@ const unsigned char* RingStream::readRaw(void* buf, size_t* inout_len) {
             }
         } else {
             if (inLargeXfer && 0 != __atomic_load_n(&mContext.ring_config->transfer_size, __ATOMIC_ACQUIRE)) {
+                // The guest is in the middle of a large transfer and will not notify us
+                // about the rest of it, so back off without blocking on a notification.
+                backOff(&waitAttempt, &sleepUs, &mReadWaitStats);
                 continue;
             }
 
@@ -188,11 +266,8 @@ const unsigned char* RingStream::readRaw(void* buf, size_t* inout_len) {
                 inLargeXfer = false;
             }
 
-            if (++spins < maxSpins) {
-                ring_buffer_yield();
+            if (waitStep(&waitAttempt, &mReadWaitStats) != WaitStep::kBlock) {
                 continue;
-            } else {
-                spins = 0;
             }
 
             if (mShouldExit) {
@@ -203,7 +278,10 @@ const unsigned char* RingStream::readRaw(void* buf, size_t* inout_len) {
                 return nullptr;
             }
 
+            const uint64_t blockStartUs = android::base::getHighResTimeUs();
             int unavailReadResult = mCallbacks.onUnavailableRead();
+            ++mReadWaitStats.blocks;
+            mReadWaitStats.blockedUs += android::base::getHighResTimeUs() - blockStartUs;
 
             if (-1 == unavailReadResult) {
                 mShouldExit = true;
@@ -346,6 +424,81 @@ void* RingStream::getDmaForReading(uint64_t guest_paddr) {
 
 void RingStream::unlockDma(uint64_t guest_paddr) { emugl::g_emugl_dma_unlock(guest_paddr); }
 
+const unsigned char* RingStream::readInPlace(size_t minLen, size_t* outLen) {
+    assert(mInPlaceSource == InPlaceSource::kNone);
+
+    // Data already copied out of the rings has to be returned first, in order.
+    if (!mInPlaceReadsEnabled || mReadBufferLeft || mShouldExit) {
+        return nullptr;
+    }
+
+    // Same order as readRaw(): small transfers first, then the large transfer ring.
+    const uint32_t ringAvailable = ring_buffer_available_read(mContext.to_host, 0);
+    if (ringAvailable) {
+        if (mContext.ring_config->transfer_mode != 1 ||
+            ringAvailable < sizeof(struct asg_type1_xfer)) {
+            return nullptr;
+        }
+        struct asg_type1_xfer xfer;
+        ring_buffer_copy_contents(mContext.to_host, 0, sizeof(xfer), (uint8_t*)&xfer);
+        if (xfer.size < minLen) {
+            return nullptr;
+        }
+        mInPlaceSource = InPlaceSource::kType1Xfer;
+        mInPlaceSize = xfer.size;
+        *outLen = xfer.size;
+        ++mXmits;
+        mTotalRecv += xfer.size;
+        return reinterpret_cast<const unsigned char*>(mContext.buffer + xfer.offset);
+    }
+
+    const uint32_t transferSize =
+        __atomic_load_n(&mContext.ring_config->transfer_size, __ATOMIC_ACQUIRE);
+    const uint32_t largeXferAvailable = ring_buffer_available_read(
+        mContext.to_host_large_xfer.ring, &mContext.to_host_large_xfer.view);
+    if (!transferSize || !largeXferAvailable) {
+        return nullptr;
+    }
+
+    // Only the part up to the end of the view is contiguous. Whatever wraps around is left
+    // for readRaw() to copy.
+    const struct ring_buffer_view& view = mContext.to_host_large_xfer.view;
+    const uint32_t readPos = ring_buffer_view_get_ring_pos(
+        &view, __atomic_load_n(&mContext.to_host_large_xfer.ring->read_pos, __ATOMIC_ACQUIRE));
+    const uint32_t contiguous =
+        std::min(std::min(largeXferAvailable, transferSize), view.size - readPos);
+    if (contiguous < minLen) {
+        return nullptr;
+    }
+    mInPlaceSource = InPlaceSource::kLargeXfer;
+    mInPlaceSize = contiguous;
+    *outLen = contiguous;
+    ++mXmits;
+    mTotalRecv += contiguous;
+    return view.buf + readPos;
+}
+
+void RingStream::releaseInPlace() {
+    switch (mInPlaceSource) {
+        case InPlaceSource::kNone:
+            return;
+        case InPlaceSource::kType1Xfer:
+            ring_buffer_advance_read(mContext.to_host, sizeof(struct asg_type1_xfer), 1);
+            __atomic_fetch_add(&mContext.ring_config->host_consumed_pos, mInPlaceSize,
+                               __ATOMIC_RELEASE);
+            break;
+        case InPlaceSource::kLargeXfer:
+            // As in type3Read(), update transfer_size before the guest can make progress.
+            __atomic_fetch_sub(&mContext.ring_config->transfer_size, mInPlaceSize,
+                               __ATOMIC_RELEASE);
+            __atomic_add_fetch(&mContext.to_host_large_xfer.ring->read_pos, mInPlaceSize,
+                               __ATOMIC_SEQ_CST);
+            break;
+    }
+    mInPlaceSource = InPlaceSource::kNone;
+    mInPlaceSize = 0;
+}
+
 int RingStream::writeFully(const void* buf, size_t len) {
     void* dstBuf = alloc(len);
     memcpy(dstBuf, buf, len);
@@ -24,6 +24,30 @@
 
 namespace gfxstream {
 
+// How a RingStream waits on the guest: for room in the from-host ring when writing replies,
+// and for more guest data when reading. A wait first spins, then yields the CPU, and only
+// then blocks. Reads block on a notification from the guest (see
+// ConsumerCallbacks::onUnavailableRead). Nothing notifies the host when the guest drains the
+// from-host ring, so writes sleep instead, backing off exponentially up to `maxSleepUs`.
+struct RingStreamWaitPolicy {
+    uint32_t spinIterations = 1024;
+    uint32_t yieldIterations = 64;
+    uint32_t maxSleepUs = 1000;
+
+    // The defaults, overridden by the ANDROID_GFXSTREAM_RING_SPIN_ITERATIONS,
+    // ANDROID_GFXSTREAM_RING_YIELD_ITERATIONS and ANDROID_GFXSTREAM_RING_MAX_SLEEP_US
+    // environment variables.
+    static const RingStreamWaitPolicy& get();
+};
+
+struct RingStreamWaitStats {
+    uint64_t spins = 0;
+    uint64_t yields = 0;
+    // Sleeps or blocking waits for a guest notification.
+    uint64_t blocks = 0;
+    uint64_t blockedUs = 0;
+};
+
 // An IOStream instance that can be used by the host RenderThread to process
 // messages from a pair of ring buffers (to host and from host).  It also takes
 // a callback that does something when there are no available bytes to read in
@@ -47,6 +71,10 @@ public:
 
     void printStats();
 
+    // Time spent waiting for the guest to drain replies, and for the guest to send data.
+    const RingStreamWaitStats& getWriteWaitStats() const { return mWriteWaitStats; }
+    const RingStreamWaitStats& getReadWaitStats() const { return mReadWaitStats; }
+
     void pausePreSnapshot() {
         mInSnapshotOperation = true;
     }
@@ -59,16 +87,33 @@ public:
         return mInSnapshotOperation;
     }
 
+    // Allows readInPlace() to hand out guest memory, see the RingStreamInPlaceDecode feature.
+    // Disabled by default: the guest can still write to a chunk while it is being decoded.
+    void setInPlaceReadsEnabled(bool enabled) { mInPlaceReadsEnabled = enabled; }
+
 protected:
     virtual void* allocBuffer(size_t minSize) override final;
     virtual int commitBuffer(size_t size) override final;
     virtual const unsigned char* readRaw(void* buf, size_t* inout_len) override final;
     virtual void* getDmaForReading(uint64_t guest_paddr) override final;
     virtual void unlockDma(uint64_t guest_paddr) override final;
+    virtual const unsigned char* readInPlace(size_t minLen, size_t* outLen) override final;
+    virtual void releaseInPlace() override final;
 
     void onSave(android::base::Stream* stream) override;
     unsigned char* onLoad(android::base::Stream* stream) override;
 
+    enum class WaitStep {
+        kSpin,
+        kYield,
+        kBlock,
+    };
+    // Spins or yields for the first attempts of a wait, as configured by the policy, and
+    // returns kBlock once the caller should block.
+    WaitStep waitStep(uint32_t* attempt, RingStreamWaitStats* stats) const;
+    // Like waitStep(), but sleeps with exponential backoff instead of returning kBlock.
+    void backOff(uint32_t* attempt, uint32_t* sleepUs, RingStreamWaitStats* stats) const;
+
     void type1Read(uint32_t available, char* begin, size_t* count, char** current, const char* ptrEnd);
     void type2Read(uint32_t available, size_t* count, char** current, const char* ptrEnd);
     void type3Read(uint32_t available, size_t* count, char** current, const char* ptrEnd);
@@ -83,6 +128,20 @@ protected:
     RenderChannel::Buffer mWriteBuffer;
     size_t mReadBufferLeft = 0;
 
+    // The chunk handed out by readInPlace(), if any.
+    enum class InPlaceSource {
+        kNone,
+        kType1Xfer,
+        kLargeXfer,
+    };
+    bool mInPlaceReadsEnabled = false;
+    InPlaceSource mInPlaceSource = InPlaceSource::kNone;
+    uint32_t mInPlaceSize = 0;
+
+    const RingStreamWaitPolicy& mWaitPolicy;
+    RingStreamWaitStats mWriteWaitStats;
+    RingStreamWaitStats mReadWaitStats;
+
     size_t mXmits = 0;
     size_t mTotalRecv = 0;
     bool mBenchmarkEnabled = false;
@@ -0,0 +1,385 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "SnapshotCompressedStream.h"
+
+#include <lz4.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <thread>
+
+#include "aemu/base/threads/ThreadPool.h"
+#include "host-common/GfxstreamFatalError.h"
+#include "host-common/logging.h"
+
+namespace gfxstream {
+
+struct SnapshotChunk {
+    uint32_t uncompressedSize = 0;
+    uint32_t flags = 0;
+    uint32_t crc = 0;
+    std::vector<uint8_t> stored;
+    std::vector<uint8_t> uncompressed;
+    bool valid = true;
+};
+
+namespace {
+
+constexpr char kMagic[8] = {'G', 'F', 'X', 'S', 'N', 'A', 'P', '\0'};
+constexpr uint32_t kVersion = 1;
+
+constexpr size_t kChunkSize = 4 * 1024 * 1024;
+constexpr size_t kChunkHeaderSize = 4 * sizeof(uint32_t);
+
+constexpr uint32_t kChunkFlagCompressed = 1;
+
+uint32_t getThreadCount() {
+    static const uint32_t count = std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+    return count;
+}
+
+// Bounds the memory used by chunks waiting to be written, or decompressed ahead of the reader.
+size_t getMaxPendingChunks() { return 2 * getThreadCount(); }
+
+using ChunkTask = std::packaged_task<std::unique_ptr<SnapshotChunk>()>;
+using ChunkThreadPool = android::base::ThreadPool<ChunkTask>;
+
+// Compresses and decompresses chunks. Lives for the whole process, snapshots are taken
+// repeatedly.
+ChunkThreadPool& getChunkThreadPool() {
+    static ChunkThreadPool* sPool = [] {
+        auto pool = new ChunkThreadPool(
+            getThreadCount(), [](ChunkTask&& task, android::base::ThreadPoolWorkerId) { task(); });
+        pool->start();
+        return pool;
+    }();
+    return *sPool;
+}
+
+template <typename Work>
+std::future<std::unique_ptr<SnapshotChunk>> postChunkWork(Work work) {
+    ChunkTask task(std::move(work));
+    auto future = task.get_future();
+    getChunkThreadPool().enqueue(std::move(task));
+    return future;
+}
+
+uint32_t computeCrc(const std::vector<uint8_t>& data) {
+    return crc32(crc32(0L, Z_NULL, 0), data.data(), static_cast<uInt>(data.size()));
+}
+
+void putLe32(uint8_t* dst, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        dst[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint32_t getLe32(const uint8_t* src) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(src[i]) << (8 * i);
+    }
+    return value;
+}
+
+std::unique_ptr<SnapshotChunk> compressChunk(std::vector<uint8_t> data) {
+    auto chunk = std::make_unique<SnapshotChunk>();
+    chunk->uncompressedSize = static_cast<uint32_t>(data.size());
+    chunk->crc = computeCrc(data);
+
+    chunk->stored.resize(LZ4_compressBound(static_cast<int>(data.size())));
+    const int compressedSize = LZ4_compress_default(
+        reinterpret_cast<const char*>(data.data()), reinterpret_cast<char*>(chunk->stored.data()),
+        static_cast<int>(data.size()), static_cast<int>(chunk->stored.size()));
+    if (compressedSize > 0 && static_cast<size_t>(compressedSize) < data.size()) {
+        chunk->stored.resize(compressedSize);
+        chunk->flags = kChunkFlagCompressed;
+    } else {
+        // Incompressible, e.g. already compressed textures.
+        chunk->stored = std::move(data);
+    }
+    return chunk;
+}
+
+std::unique_ptr<SnapshotChunk> decompressChunk(std::unique_ptr<SnapshotChunk> chunk) {
+    if (chunk->flags & kChunkFlagCompressed) {
+        chunk->uncompressed.resize(chunk->uncompressedSize);
+        const int size = LZ4_decompress_safe(reinterpret_cast<const char*>(chunk->stored.data()),
+                                             reinterpret_cast<char*>(chunk->uncompressed.data()),
+                                             static_cast<int>(chunk->stored.size()),
+                                             static_cast<int>(chunk->uncompressed.size()));
+        chunk->valid = size == static_cast<int>(chunk->uncompressedSize);
+    } else {
+        chunk->uncompressed = std::move(chunk->stored);
+        chunk->valid = chunk->uncompressed.size() == chunk->uncompressedSize;
+    }
+    chunk->stored.clear();
+    chunk->valid = chunk->valid && computeCrc(chunk->uncompressed) == chunk->crc;
+    return chunk;
+}
+
+}  // namespace
+
+SnapshotCompressingStream::SnapshotCompressingStream(FILE* file) : mFile(file) {
+    if (!mFile) {
+        mFailed = true;
+        return;
+    }
+    uint8_t version[4];
+    putLe32(version, kVersion);
+    mFailed = fwrite(kMagic, sizeof(kMagic), 1, mFile) != 1 ||
+              fwrite(version, sizeof(version), 1, mFile) != 1;
+    mCurrentChunk.reserve(kChunkSize);
+}
+
+SnapshotCompressingStream::~SnapshotCompressingStream() { close(); }
+
+ssize_t SnapshotCompressingStream::read(void* buffer, size_t size) {
+    GFXSTREAM_ABORT(emugl::FatalError(emugl::ABORT_REASON_OTHER))
+        << "SnapshotCompressingStream is write only.";
+    return -1;
+}
+
+ssize_t SnapshotCompressingStream::write(const void* buffer, size_t size) {
+    const uint8_t* data = static_cast<const uint8_t*>(buffer);
+    size_t remaining = size;
+    while (remaining > 0) {
+        const size_t count = std::min(remaining, kChunkSize - mCurrentChunk.size());
+        mCurrentChunk.insert(mCurrentChunk.end(), data, data + count);
+        data += count;
+        remaining -= count;
+        if (mCurrentChunk.size() == kChunkSize) {
+            submitChunk();
+        }
+    }
+    return static_cast<ssize_t>(size);
+}
+
+void SnapshotCompressingStream::submitChunk() {
+    if (mCurrentChunk.empty()) {
+        return;
+    }
+    if (mPendingChunks.size() >= getMaxPendingChunks()) {
+        writeOldestChunk();
+    }
+    mUncompressedBytes += mCurrentChunk.size();
+    mPendingChunks.push_back(postChunkWork(
+        [data = std::move(mCurrentChunk)]() mutable { return compressChunk(std::move(data)); }));
+    mCurrentChunk = std::vector<uint8_t>();
+    mCurrentChunk.reserve(kChunkSize);
+}
+
+void SnapshotCompressingStream::writeOldestChunk() {
+    std::unique_ptr<SnapshotChunk> chunk = mPendingChunks.front().get();
+    mPendingChunks.pop_front();
+    if (mFailed) {
+        return;
+    }
+
+    uint8_t header[kChunkHeaderSize];
+    putLe32(header, chunk->uncompressedSize);
+    putLe32(header + 4, static_cast<uint32_t>(chunk->stored.size()));
+    putLe32(header + 8, chunk->flags);
+    putLe32(header + 12, chunk->crc);
+    mFailed = fwrite(header, sizeof(header), 1, mFile) != 1 ||
+              fwrite(chunk->stored.data(), chunk->stored.size(), 1, mFile) != 1;
+    mStoredBytes += sizeof(header) + chunk->stored.size();
+}
+
+bool SnapshotCompressingStream::close() {
+    if (!mFile) {
+        return !mFailed;
+    }
+    submitChunk();
+    while (!mPendingChunks.empty()) {
+        writeOldestChunk();
+    }
+
+    uint8_t endChunk[kChunkHeaderSize] = {};
+    if (!mFailed) {
+        mFailed = fwrite(endChunk, sizeof(endChunk), 1, mFile) != 1;
+    }
+    mFailed = (fclose(mFile) != 0) || mFailed;
+    mFile = nullptr;
+
+    if (mFailed) {
+        ERR("Failed to write compressed snapshot stream.");
+    } else {
+        INFO("Compressed snapshot stream: %llu bytes to %llu bytes.",
+             static_cast<unsigned long long>(mUncompressedBytes),
+             static_cast<unsigned long long>(mStoredBytes));
+    }
+    return !mFailed;
+}
+
+SnapshotDecompressingStream::SnapshotDecompressingStream(FILE* file) : mFile(file) {
+    if (!mFile) {
+        mFailed = true;
+        mEndOfStream = true;
+        return;
+    }
+    char magic[sizeof(kMagic)];
+    uint8_t version[4];
+    if (fread(magic, sizeof(magic), 1, mFile) != 1 || memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+        // Saved before snapshots were compressed.
+        fseek(mFile, 0, SEEK_SET);
+        return;
+    }
+    mCompressed = true;
+    if (fread(version, sizeof(version), 1, mFile) != 1 || getLe32(version) != kVersion) {
+        ERR("Unsupported compressed snapshot stream version.");
+        mFailed = true;
+        mEndOfStream = true;
+        return;
+    }
+    if (!checkChunkHeaders()) {
+        mFailed = true;
+        mEndOfStream = true;
+    }
+}
+
+bool SnapshotDecompressingStream::checkChunkHeaders() {
+    const long start = ftell(mFile);
+    if (start < 0 || fseek(mFile, 0, SEEK_END) != 0) {
+        ERR("Failed to seek in compressed snapshot stream.");
+        return false;
+    }
+    const uint64_t fileSize = static_cast<uint64_t>(ftell(mFile));
+    uint64_t offset = static_cast<uint64_t>(start);
+    bool complete = false;
+    while (!complete) {
+        uint8_t header[kChunkHeaderSize];
+        if (offset + sizeof(header) > fileSize ||
+            fseek(mFile, static_cast<long>(offset), SEEK_SET) != 0 ||
+            fread(header, sizeof(header), 1, mFile) != 1) {
+            ERR("Compressed snapshot stream is truncated.");
+            return false;
+        }
+        const uint32_t uncompressedSize = getLe32(header);
+        const uint32_t storedSize = getLe32(header + 4);
+        if (uncompressedSize > kChunkSize ||
+            storedSize > static_cast<uint32_t>(LZ4_compressBound(kChunkSize))) {
+            ERR("Compressed snapshot stream has an invalid chunk.");
+            return false;
+        }
+        complete = uncompressedSize == 0;
+        offset += sizeof(header) + storedSize;
+    }
+    if (offset > fileSize) {
+        ERR("Compressed snapshot stream is truncated.");
+        return false;
+    }
+    return fseek(mFile, start, SEEK_SET) == 0;
+}
+
+SnapshotDecompressingStream::~SnapshotDecompressingStream() {
+    // Let the queued decompressions finish before their results go away.
+    for (auto& pending : mPendingChunks) {
+        pending.wait();
+    }
+    if (mFile) {
+        fclose(mFile);
+    }
+}
+
+ssize_t SnapshotDecompressingStream::read(void* buffer, size_t size) {
+    if (!mCompressed) {
+        return mFile ? static_cast<ssize_t>(fread(buffer, 1, size, mFile)) : -1;
+    }
+
+    uint8_t* dst = static_cast<uint8_t*>(buffer);
+    size_t copied = 0;
+    while (copied < size) {
+        if (!mCurrentChunk || mCurrentChunkOffset == mCurrentChunk->uncompressed.size()) {
+            if (!nextChunk()) {
+                break;
+            }
+        }
+        const size_t count =
+            std::min(size - copied, mCurrentChunk->uncompressed.size() - mCurrentChunkOffset);
+        memcpy(dst + copied, mCurrentChunk->uncompressed.data() + mCurrentChunkOffset, count);
+        mCurrentChunkOffset += count;
+        copied += count;
+    }
+    return static_cast<ssize_t>(copied);
+}
+
+ssize_t SnapshotDecompressingStream::write(const void* buffer, size_t size) {
+    GFXSTREAM_ABORT(emugl::FatalError(emugl::ABORT_REASON_OTHER))
+        << "SnapshotDecompressingStream is read only.";
+    return -1;
+}
+
+void SnapshotDecompressingStream::readAhead() {
+    while (!mEndOfStream && mPendingChunks.size() < getMaxPendingChunks()) {
+        uint8_t header[kChunkHeaderSize];
+        if (fread(header, sizeof(header), 1, mFile) != 1) {
+            ERR("Compressed snapshot stream is truncated.");
+            mFailed = true;
+            mEndOfStream = true;
+            return;
+        }
+
+        auto chunk = std::make_unique<SnapshotChunk>();
+        chunk->uncompressedSize = getLe32(header);
+        const uint32_t storedSize = getLe32(header + 4);
+        chunk->flags = getLe32(header + 8);
+        chunk->crc = getLe32(header + 12);
+        if (chunk->uncompressedSize == 0) {
+            mEndOfStream = true;
+            return;
+        }
+        if (chunk->uncompressedSize > kChunkSize ||
+            storedSize > static_cast<uint32_t>(LZ4_compressBound(kChunkSize))) {
+            ERR("Compressed snapshot stream has an invalid chunk.");
+            mFailed = true;
+            mEndOfStream = true;
+            return;
+        }
+        chunk->stored.resize(storedSize);
+        if (fread(chunk->stored.data(), storedSize, 1, mFile) != 1) {
+            ERR("Compressed snapshot stream is truncated.");
+            mFailed = true;
+            mEndOfStream = true;
+            return;
+        }
+
+        mPendingChunks.push_back(postChunkWork(
+            [chunk = std::move(chunk)]() mutable { return decompressChunk(std::move(chunk)); }));
+    }
+}
+
+bool SnapshotDecompressingStream::nextChunk() {
+    readAhead();
+    if (mPendingChunks.empty()) {
+        return false;
+    }
+    mCurrentChunk = mPendingChunks.front().get();
+    mPendingChunks.pop_front();
+    mCurrentChunkOffset = 0;
+    if (!mCurrentChunk->valid) {
+        ERR("Compressed snapshot stream chunk failed its checksum.");
+        mFailed = true;
+        mEndOfStream = true;
+        mCurrentChunk.reset();
+        return false;
+    }
+    // Keep the pool busy while the caller consumes this chunk.
+    readAhead();
+    return true;
+}
+
+}  // namespace gfxstream
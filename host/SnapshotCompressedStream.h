@@ -0,0 +1,102 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdio.h>
+
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "aemu/base/files/Stream.h"
+
+namespace gfxstream {
+
+// Snapshot streams are split into chunks which are compressed with LZ4 on a pool of threads, so
+// that compressing texture and image contents does not hold up the renderer's save. Each chunk
+// has a header with its sizes and the CRC32 of its contents:
+//
+//   file:  char[8] magic "GFXSNAP\0", u32 version, chunk..., end chunk
+//   chunk: u32 uncompressed size, u32 stored size, u32 flags, u32 crc32, stored bytes
+//
+// The end chunk has an uncompressed size of 0. Chunks which LZ4 can not shrink are stored as is.
+// All integers are little endian.
+
+struct SnapshotChunk;
+
+// Writes a compressed snapshot stream to a file.
+class SnapshotCompressingStream : public android::base::Stream {
+   public:
+    // Takes ownership of `file`.
+    explicit SnapshotCompressingStream(FILE* file);
+    ~SnapshotCompressingStream() override;
+
+    ssize_t read(void* buffer, size_t size) override;
+    ssize_t write(const void* buffer, size_t size) override;
+
+    // Writes everything that is still buffered and closes the file. Returns false if anything
+    // failed to be written.
+    bool close();
+
+   private:
+    void submitChunk();
+    void writeOldestChunk();
+
+    FILE* mFile;
+    bool mFailed = false;
+    std::vector<uint8_t> mCurrentChunk;
+    std::deque<std::future<std::unique_ptr<SnapshotChunk>>> mPendingChunks;
+    uint64_t mUncompressedBytes = 0;
+    uint64_t mStoredBytes = 0;
+};
+
+// Reads a stream written by SnapshotCompressingStream. Chunks are decompressed on a pool of
+// threads ahead of the reader. Files that do not start with the magic, saved before snapshots
+// were compressed, are read as is.
+//
+// The chunk headers are checked when the stream is opened, so that a truncated file fails before
+// anything is read from it. Checksums are only checked as chunks are read.
+class SnapshotDecompressingStream : public android::base::Stream {
+   public:
+    // Takes ownership of `file`.
+    explicit SnapshotDecompressingStream(FILE* file);
+    ~SnapshotDecompressingStream() override;
+
+    ssize_t read(void* buffer, size_t size) override;
+    ssize_t write(const void* buffer, size_t size) override;
+
+    // Whether the file was truncated or a chunk failed its checksum.
+    bool failed() const { return mFailed; }
+
+   private:
+    // Walks the chunk headers up to the end chunk, without reading the chunks. Returns false if
+    // the file ends before the end chunk does.
+    bool checkChunkHeaders();
+    // Reads chunks from the file and queues their decompression, until enough are in flight.
+    void readAhead();
+    bool nextChunk();
+
+    FILE* mFile;
+    bool mCompressed = false;
+    bool mEndOfStream = false;
+    bool mFailed = false;
+    std::deque<std::future<std::unique_ptr<SnapshotChunk>>> mPendingChunks;
+    std::unique_ptr<SnapshotChunk> mCurrentChunk;
+    size_t mCurrentChunkOffset = 0;
+};
+
+}  // namespace gfxstream
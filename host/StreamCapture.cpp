@@ -0,0 +1,297 @@
+// Copyright (C) 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "StreamCapture.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+
+#ifdef GFXSTREAM_BUILD_WITH_LZ4
+#include <lz4.h>
+#endif
+
+#include "aemu/base/system/System.h"
+#include "host-common/logging.h"
+
+namespace gfxstream {
+namespace {
+
+constexpr char kMagic[8] = {'G', 'F', 'X', 'S', 'C', 'A', 'P', '\0'};
+// Version 2 added compressed guest data records, version 1 captures are still read.
+constexpr uint32_t kVersion = 2;
+constexpr uint32_t kMinReadableVersion = 1;
+
+// Captures are written from the render thread, so keep it from hitting the disk on every
+// (usually small) guest write.
+constexpr size_t kFileBufferSize = 1 << 20;
+
+// Smaller guest writes hardly compress and are not worth the render thread's time.
+constexpr size_t kMinCompressedRecordSize = 4096;
+
+constexpr size_t kFileHeaderSize = 24;
+constexpr size_t kRecordHeaderSize = 16;
+constexpr size_t kCompressedPayloadHeaderSize = 4;
+
+void putLe32(uint8_t* dst, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        dst[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+void putLe64(uint8_t* dst, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        dst[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint32_t getLe32(const uint8_t* src) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(src[i]) << (8 * i);
+    }
+    return value;
+}
+
+uint64_t getLe64(const uint8_t* src) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(src[i]) << (8 * i);
+    }
+    return value;
+}
+
+}  // namespace
+
+// static
+std::unique_ptr<StreamCaptureWriter> StreamCaptureWriter::create(const std::string& directory,
+                                                                 uint32_t contextId,
+                                                                 bool compress) {
+    // Several render threads can share a context id (or have none), so add a sequence
+    // number to keep their captures apart.
+    static std::atomic<uint32_t> sNextCaptureId{0};
+
+    const uint64_t startTimeUnixUs = android::base::getUnixTimeUs();
+    const std::string path = directory + "/stream_ctx" + std::to_string(contextId) + "_" +
+                             std::to_string(startTimeUnixUs) + "_" +
+                             std::to_string(sNextCaptureId.fetch_add(1)) + ".gfxcap";
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        ERR("Failed to open stream capture file %s.", path.c_str());
+        return nullptr;
+    }
+
+    uint8_t header[kFileHeaderSize];
+    memcpy(header, kMagic, sizeof(kMagic));
+    putLe32(header + 8, kVersion);
+    putLe32(header + 12, contextId);
+    putLe64(header + 16, startTimeUnixUs);
+    if (fwrite(header, sizeof(header), 1, file) != 1) {
+        ERR("Failed to write stream capture header to %s.", path.c_str());
+        fclose(file);
+        return nullptr;
+    }
+
+    if (compress && !supportsCompression()) {
+        WARN("Stream capture compression is not supported in this build, %s is uncompressed.",
+             path.c_str());
+        compress = false;
+    }
+
+    INFO("Capturing render thread stream to %s.", path.c_str());
+    return std::unique_ptr<StreamCaptureWriter>(
+        new StreamCaptureWriter(file, path, android::base::getHighResTimeUs(), compress));
+}
+
+// static
+std::unique_ptr<StreamCaptureWriter> StreamCaptureWriter::createFromEnv(uint32_t contextId) {
+    const std::string directory = android::base::getEnvironmentVariable("RENDERER_DUMP_DIR");
+    if (directory.empty()) {
+        return nullptr;
+    }
+    const bool compress = android::base::getEnvironmentVariable("RENDERER_DUMP_COMPRESS") == "1";
+    return create(directory, contextId, compress);
+}
+
+// static
+bool StreamCaptureWriter::supportsCompression() {
+#ifdef GFXSTREAM_BUILD_WITH_LZ4
+    return true;
+#else
+    return false;
+#endif
+}
+
+StreamCaptureWriter::StreamCaptureWriter(FILE* file, std::string path, uint64_t startTimeUs,
+                                         bool compress)
+    : mFile(file),
+      mPath(std::move(path)),
+      mStartTimeUs(startTimeUs),
+      mCompress(compress),
+      mFileBuffer(new char[kFileBufferSize]) {
+    setvbuf(mFile, mFileBuffer.get(), _IOFBF, kFileBufferSize);
+}
+
+StreamCaptureWriter::~StreamCaptureWriter() {
+    if (fclose(mFile) != 0) {
+        ERR("Failed to finish stream capture %s.", mPath.c_str());
+    }
+}
+
+void StreamCaptureWriter::writeProcessName(const std::string& processName) {
+    writeRecord(StreamCaptureRecordType::kProcessName, processName.data(), processName.size());
+}
+
+void StreamCaptureWriter::writeGuestData(const void* data, size_t size) {
+    // Keep each record within the 32 bit size field.
+    constexpr size_t kMaxRecordSize = UINT32_MAX;
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const size_t recordSize = std::min(size, kMaxRecordSize);
+        if (!mCompress || recordSize < kMinCompressedRecordSize ||
+            !writeCompressedRecord(bytes, recordSize)) {
+            writeRecord(StreamCaptureRecordType::kGuestData, bytes, recordSize);
+        }
+        bytes += recordSize;
+        size -= recordSize;
+    }
+}
+
+void StreamCaptureWriter::writeRecord(StreamCaptureRecordType type, const void* payload,
+                                      size_t size) {
+    if (mFailed) {
+        return;
+    }
+
+    uint8_t header[kRecordHeaderSize];
+    putLe32(header, static_cast<uint32_t>(type));
+    putLe32(header + 4, static_cast<uint32_t>(size));
+    putLe64(header + 8, android::base::getHighResTimeUs() - mStartTimeUs);
+    if (fwrite(header, sizeof(header), 1, mFile) != 1 ||
+        (size > 0 && fwrite(payload, size, 1, mFile) != 1)) {
+        // Stop rather than leave a capture that can not be parsed past this point.
+        ERR("Failed to write to stream capture %s, stopping the capture.", mPath.c_str());
+        mFailed = true;
+    }
+}
+
+bool StreamCaptureWriter::writeCompressedRecord(const void* payload, size_t size) {
+#ifdef GFXSTREAM_BUILD_WITH_LZ4
+    if (size > LZ4_MAX_INPUT_SIZE) {
+        return false;
+    }
+    const int maxCompressedSize = LZ4_compressBound(static_cast<int>(size));
+    mCompressBuffer.resize(kCompressedPayloadHeaderSize + maxCompressedSize);
+    const int compressedSize = LZ4_compress_default(
+        static_cast<const char*>(payload), mCompressBuffer.data() + kCompressedPayloadHeaderSize,
+        static_cast<int>(size), maxCompressedSize);
+    const size_t compressedPayloadSize = kCompressedPayloadHeaderSize + compressedSize;
+    if (compressedSize <= 0 || compressedPayloadSize >= size) {
+        return false;
+    }
+    putLe32(reinterpret_cast<uint8_t*>(mCompressBuffer.data()), static_cast<uint32_t>(size));
+    writeRecord(StreamCaptureRecordType::kCompressedGuestData, mCompressBuffer.data(),
+                compressedPayloadSize);
+    return true;
+#else
+    (void)payload;
+    (void)size;
+    return false;
+#endif
+}
+
+// static
+std::unique_ptr<StreamCaptureReader> StreamCaptureReader::open(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        ERR("Failed to open stream capture %s.", path.c_str());
+        return nullptr;
+    }
+
+    uint8_t header[kFileHeaderSize];
+    if (fread(header, sizeof(header), 1, file) != 1 ||
+        memcmp(header, kMagic, sizeof(kMagic)) != 0) {
+        ERR("%s is not a stream capture.", path.c_str());
+        fclose(file);
+        return nullptr;
+    }
+    const uint32_t version = getLe32(header + 8);
+    if (version < kMinReadableVersion || version > kVersion) {
+        ERR("Stream capture %s has unsupported version %u.", path.c_str(), version);
+        fclose(file);
+        return nullptr;
+    }
+
+    return std::unique_ptr<StreamCaptureReader>(
+        new StreamCaptureReader(file, getLe32(header + 12), getLe64(header + 16)));
+}
+
+StreamCaptureReader::StreamCaptureReader(FILE* file, uint32_t contextId,
+                                         uint64_t startTimeUnixUs)
+    : mFile(file), mContextId(contextId), mStartTimeUnixUs(startTimeUnixUs) {}
+
+StreamCaptureReader::~StreamCaptureReader() { fclose(mFile); }
+
+bool StreamCaptureReader::next(StreamCaptureRecord* record) {
+    uint8_t header[kRecordHeaderSize];
+    if (fread(header, sizeof(header), 1, mFile) != 1) {
+        return false;
+    }
+
+    const uint32_t size = getLe32(header + 4);
+    record->type = static_cast<StreamCaptureRecordType>(getLe32(header));
+    record->timestampUs = getLe64(header + 8);
+    record->payload.resize(size);
+    if (size > 0 && fread(record->payload.data(), size, 1, mFile) != 1) {
+        WARN("Stream capture is truncated.");
+        return false;
+    }
+
+    if (record->type == StreamCaptureRecordType::kCompressedGuestData) {
+        return decompress(record);
+    }
+    return true;
+}
+
+bool StreamCaptureReader::decompress(StreamCaptureRecord* record) {
+#ifdef GFXSTREAM_BUILD_WITH_LZ4
+    if (record->payload.size() < kCompressedPayloadHeaderSize) {
+        WARN("Stream capture has a corrupted compressed record.");
+        return false;
+    }
+    const uint32_t uncompressedSize =
+        getLe32(reinterpret_cast<const uint8_t*>(record->payload.data()));
+    std::vector<char> uncompressed(uncompressedSize);
+    const int compressedSize =
+        static_cast<int>(record->payload.size() - kCompressedPayloadHeaderSize);
+    const int decompressedSize = LZ4_decompress_safe(
+        record->payload.data() + kCompressedPayloadHeaderSize, uncompressed.data(),
+        compressedSize, static_cast<int>(uncompressedSize));
+    if (decompressedSize < 0 || static_cast<uint32_t>(decompressedSize) != uncompressedSize) {
+        WARN("Stream capture has a corrupted compressed record.");
+        return false;
+    }
+    record->type = StreamCaptureRecordType::kGuestData;
+    record->payload = std::move(uncompressed);
+    return true;
+#else
+    (void)record;
+    WARN("Stream capture is compressed, which is not supported in this build.");
+    return false;
+#endif
+}
+
+}  // namespace gfxstream
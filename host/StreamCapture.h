@@ -0,0 +1,122 @@
+// Copyright (C) 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdio.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gfxstream {
+
+// Captures of the raw guest -> host byte stream of a single render thread, so that it can
+// be replayed offline (see host/tools/gfxstream_replay.cpp).
+//
+// A capture file is a header followed by a sequence of records. All integers are little
+// endian.
+//
+//   header: char[8] magic "GFXSCAP\0", u32 version, u32 context id,
+//           u64 capture start time in microseconds since the Unix epoch
+//   record: u32 type, u32 payload size, u64 microseconds since the capture start,
+//           followed by the payload
+//
+// Guest data records hold the bytes exactly as the render thread received them, excluding
+// the initial connection flags.
+enum class StreamCaptureRecordType : uint32_t {
+    kGuestData = 1,
+    // The payload is the guest process name, without a terminating null. Written once, before
+    // the first guest data record that follows the name becoming known.
+    kProcessName = 2,
+    // A guest data record compressed with LZ4. The payload is the u32 uncompressed size
+    // followed by an LZ4 block. Only written by compressing writers, and never returned by
+    // StreamCaptureReader, which hands it out as kGuestData.
+    kCompressedGuestData = 3,
+};
+
+struct StreamCaptureRecord {
+    StreamCaptureRecordType type;
+    uint64_t timestampUs;
+    std::vector<char> payload;
+};
+
+class StreamCaptureWriter {
+   public:
+    // Starts a new capture file for `contextId` in `directory`. Returns nullptr on failure.
+    // With `compress`, larger guest data records are compressed with LZ4 when that is
+    // available in this build and makes them smaller.
+    static std::unique_ptr<StreamCaptureWriter> create(const std::string& directory,
+                                                       uint32_t contextId,
+                                                       bool compress = false);
+
+    // Returns a writer if the RENDERER_DUMP_DIR environment variable names a directory to
+    // capture render thread streams into, nullptr otherwise. Setting RENDERER_DUMP_COMPRESS
+    // to 1 compresses the capture.
+    static std::unique_ptr<StreamCaptureWriter> createFromEnv(uint32_t contextId);
+
+    // Whether this build can write and read compressed captures.
+    static bool supportsCompression();
+
+    ~StreamCaptureWriter();
+
+    const std::string& path() const { return mPath; }
+
+    void writeProcessName(const std::string& processName);
+    void writeGuestData(const void* data, size_t size);
+
+   private:
+    StreamCaptureWriter(FILE* file, std::string path, uint64_t startTimeUs, bool compress);
+
+    void writeRecord(StreamCaptureRecordType type, const void* payload, size_t size);
+    // Returns false if the record was not worth compressing and still has to be written.
+    bool writeCompressedRecord(const void* payload, size_t size);
+
+    FILE* mFile = nullptr;
+    const std::string mPath;
+    const uint64_t mStartTimeUs;
+    const bool mCompress;
+    std::unique_ptr<char[]> mFileBuffer;
+    // Reused across records to avoid an allocation per guest write.
+    std::vector<char> mCompressBuffer;
+    bool mFailed = false;
+};
+
+class StreamCaptureReader {
+   public:
+    // Returns nullptr if `path` can not be opened or is not a capture file.
+    static std::unique_ptr<StreamCaptureReader> open(const std::string& path);
+
+    ~StreamCaptureReader();
+
+    uint32_t contextId() const { return mContextId; }
+    uint64_t startTimeUnixUs() const { return mStartTimeUnixUs; }
+
+    // Reads the next record. Returns false at the end of the capture, or if the capture is
+    // truncated.
+    bool next(StreamCaptureRecord* record);
+
+   private:
+    StreamCaptureReader(FILE* file, uint32_t contextId, uint64_t startTimeUnixUs);
+
+    // Turns a kCompressedGuestData record into the kGuestData record it was made from.
+    bool decompress(StreamCaptureRecord* record);
+
+    FILE* mFile = nullptr;
+    const uint32_t mContextId;
+    const uint64_t mStartTimeUnixUs;
+};
+
+}  // namespace gfxstream
@@ -217,43 +217,45 @@ static inline bool is_drm_format_supported(uint32_t* mask, uint32_t drm_format)
     return (mask[index] & bit_offset) ? true : false;
 }
 
+// Returns the bytes per pixel of a non YUV virgl format, or 0 if the format is unknown.
+static inline uint32_t virgl_format_to_bpp(uint32_t format) {
+    switch (format) {
+        case VIRGL_FORMAT_R16G16B16A16_FLOAT:
+        case VIRGL_FORMAT_Z32_FLOAT_S8X24_UINT:
+            return 8;
+        case VIRGL_FORMAT_B8G8R8X8_UNORM:
+        case VIRGL_FORMAT_B8G8R8A8_UNORM:
+        case VIRGL_FORMAT_R8G8B8X8_UNORM:
+        case VIRGL_FORMAT_R8G8B8A8_UNORM:
+        case VIRGL_FORMAT_R10G10B10A2_UNORM:
+        case VIRGL_FORMAT_Z24X8_UNORM:
+        case VIRGL_FORMAT_Z24_UNORM_S8_UINT:
+        case VIRGL_FORMAT_Z32_FLOAT:
+            return 4;
+        case VIRGL_FORMAT_R8G8B8_UNORM:
+            return 3;
+        case VIRGL_FORMAT_B5G6R5_UNORM:
+        case VIRGL_FORMAT_R8G8_UNORM:
+        case VIRGL_FORMAT_R16_UNORM:
+        case VIRGL_FORMAT_Z16_UNORM:
+            return 2;
+        case VIRGL_FORMAT_R8_UNORM:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
 static inline size_t virgl_format_to_linear_base(uint32_t format, uint32_t totalWidth,
                                                  uint32_t totalHeight, uint32_t x, uint32_t y,
                                                  uint32_t w, uint32_t h) {
     if (virgl_format_is_yuv(format)) {
         return 0;
     } else {
-        uint32_t bpp = 4;
-        switch (format) {
-            case VIRGL_FORMAT_R16G16B16A16_FLOAT:
-            case VIRGL_FORMAT_Z32_FLOAT_S8X24_UINT:
-                bpp = 8;
-                break;
-            case VIRGL_FORMAT_B8G8R8X8_UNORM:
-            case VIRGL_FORMAT_B8G8R8A8_UNORM:
-            case VIRGL_FORMAT_R8G8B8X8_UNORM:
-            case VIRGL_FORMAT_R8G8B8A8_UNORM:
-            case VIRGL_FORMAT_R10G10B10A2_UNORM:
-            case VIRGL_FORMAT_Z24X8_UNORM:
-            case VIRGL_FORMAT_Z24_UNORM_S8_UINT:
-            case VIRGL_FORMAT_Z32_FLOAT:
-                bpp = 4;
-                break;
-            case VIRGL_FORMAT_R8G8B8_UNORM:
-                bpp = 3;
-                break;
-            case VIRGL_FORMAT_B5G6R5_UNORM:
-            case VIRGL_FORMAT_R8G8_UNORM:
-            case VIRGL_FORMAT_R16_UNORM:
-            case VIRGL_FORMAT_Z16_UNORM:
-                bpp = 2;
-                break;
-            case VIRGL_FORMAT_R8_UNORM:
-                bpp = 1;
-                break;
-            default:
-                stream_renderer_error("Unknown virgl format: 0x%x", format);
-                return 0;
+        const uint32_t bpp = virgl_format_to_bpp(format);
+        if (bpp == 0) {
+            stream_renderer_error("Unknown virgl format: 0x%x", format);
+            return 0;
         }
 
         uint32_t stride = totalWidth * bpp;
@@ -310,37 +312,10 @@ static inline size_t virgl_format_to_total_xfer_len(uint32_t format, uint32_t to
         uint32_t dataSize = ySize + uvSize;
         return dataSize;
     } else {
-        uint32_t bpp = 4;
-        switch (format) {
-            case VIRGL_FORMAT_R16G16B16A16_FLOAT:
-            case VIRGL_FORMAT_Z32_FLOAT_S8X24_UINT:
-                bpp = 8;
-                break;
-            case VIRGL_FORMAT_B8G8R8X8_UNORM:
-            case VIRGL_FORMAT_B8G8R8A8_UNORM:
-            case VIRGL_FORMAT_R8G8B8X8_UNORM:
-            case VIRGL_FORMAT_R8G8B8A8_UNORM:
-            case VIRGL_FORMAT_R10G10B10A2_UNORM:
-            case VIRGL_FORMAT_Z24X8_UNORM:
-            case VIRGL_FORMAT_Z24_UNORM_S8_UINT:
-            case VIRGL_FORMAT_Z32_FLOAT:
-                bpp = 4;
-                break;
-            case VIRGL_FORMAT_R8G8B8_UNORM:
-                bpp = 3;
-                break;
-            case VIRGL_FORMAT_B5G6R5_UNORM:
-            case VIRGL_FORMAT_R16_UNORM:
-            case VIRGL_FORMAT_R8G8_UNORM:
-            case VIRGL_FORMAT_Z16_UNORM:
-                bpp = 2;
-                break;
-            case VIRGL_FORMAT_R8_UNORM:
-                bpp = 1;
-                break;
-            default:
-                stream_renderer_error("Unknown virgl format: 0x%x", format);
-                return 0;
+        const uint32_t bpp = virgl_format_to_bpp(format);
+        if (bpp == 0) {
+            stream_renderer_error("Unknown virgl format: 0x%x", format);
+            return 0;
         }
 
         uint32_t stride = totalWidth * bpp;
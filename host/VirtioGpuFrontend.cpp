@@ -21,6 +21,8 @@
 // anyone with a `Status` type.
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/text_format.h>
+
+#include "SnapshotCompressedStream.h"
 #endif  // ifdef GFXSTREAM_BUILD_WITH_SNAPSHOT_FRONTEND_SUPPORT
 
 #include <vulkan/vulkan.h>
@@ -988,13 +990,21 @@ int VirtioGpuFrontend::snapshotRenderer(const char* directory) {
     const std::filesystem::path snapshotDirectory = std::string(directory);
     const std::filesystem::path snapshotPath = snapshotDirectory / kSnapshotBasenameRenderer;
 
-    android::base::StdioStream stream(fopen(snapshotPath.c_str(), "wb"),
-                                      android::base::StdioStream::kOwner);
+    FILE* file = fopen(snapshotPath.c_str(), "wb");
+    if (!file) {
+        stream_renderer_error("Failed to save snapshot: failed to open %s", snapshotPath.c_str());
+        return -1;
+    }
+    SnapshotCompressingStream stream(file);
     android::snapshot::SnapshotSaveStream saveStream{
         .stream = &stream,
     };
 
     android_getOpenglesRenderer()->save(saveStream.stream, saveStream.textureSaver);
+    if (!stream.close()) {
+        stream_renderer_error("Failed to save snapshot: failed to write %s", snapshotPath.c_str());
+        return -1;
+    }
     return 0;
 }
 
@@ -1093,13 +1103,26 @@ int VirtioGpuFrontend::restoreRenderer(const char* directory) {
     const std::filesystem::path snapshotDirectory = std::string(directory);
     const std::filesystem::path snapshotPath = snapshotDirectory / kSnapshotBasenameRenderer;
 
-    android::base::StdioStream stream(fopen(snapshotPath.c_str(), "rb"),
-                                      android::base::StdioStream::kOwner);
+    FILE* file = fopen(snapshotPath.c_str(), "rb");
+    if (!file) {
+        stream_renderer_error("Failed to restore snapshot: failed to open %s",
+                              snapshotPath.c_str());
+        return -1;
+    }
+    SnapshotDecompressingStream stream(file);
+    if (stream.failed()) {
+        stream_renderer_error("Failed to restore snapshot: %s is truncated.", snapshotPath.c_str());
+        return -1;
+    }
     android::snapshot::SnapshotLoadStream loadStream{
         .stream = &stream,
     };
 
     android_getOpenglesRenderer()->load(loadStream.stream, loadStream.textureLoader);
+    if (stream.failed()) {
+        stream_renderer_error("Failed to restore snapshot: %s is corrupted.", snapshotPath.c_str());
+        return -1;
+    }
     return 0;
 }
 
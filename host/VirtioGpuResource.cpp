@@ -126,6 +126,20 @@ VirtioGpuResourceType GetResourceType(const struct stream_renderer_resource_crea
     return VirtioGpuResourceType::BUFFER;
 }
 
+bool IsValidTransferBox(const struct stream_renderer_resource_create_args& args,
+                        const stream_renderer_box* box) {
+    if (box->w == 0U || box->h == 0U) {
+        stream_renderer_error("failed to transfer: empty transfer");
+        return false;
+    }
+    if (box->x > args.width || box->w > args.width - box->x || box->y > args.height ||
+        box->h > args.height - box->y) {
+        stream_renderer_error("failed to transfer: box out of range of resource");
+        return false;
+    }
+    return true;
+}
+
 }  // namespace
 
 /*static*/
@@ -381,15 +395,23 @@ void VirtioGpuResource::AttachIov(struct iovec* iov, uint32_t num_iovs) {
     mIovs.clear();
     mLinear.clear();
 
-    size_t linearSize = 0;
     if (num_iovs) {
         mIovs.reserve(num_iovs);
         for (uint32_t i = 0; i < num_iovs; ++i) {
             mIovs.push_back(iov[i]);
-            linearSize += iov[i].iov_len;
         }
     }
+}
+
+void VirtioGpuResource::EnsureLinear() {
+    if (!mLinear.empty()) {
+        return;
+    }
 
+    size_t linearSize = 0;
+    for (const struct iovec& iov : mIovs) {
+        linearSize += iov.iov_len;
+    }
     if (linearSize > 0) {
         mLinear.resize(linearSize, 0);
     }
@@ -523,6 +545,13 @@ int VirtioGpuResource::GetCaching(uint32_t* outCaching) const {
 int VirtioGpuResource::TransferRead(const GoldfishPipeServiceOps* ops, uint64_t offset,
                                     stream_renderer_box* box,
                                     std::optional<std::vector<struct iovec>> iovs) {
+    if (mResourceType == VirtioGpuResourceType::COLOR_BUFFER && mCreateArgs &&
+        virgl_format_to_bpp(mCreateArgs->format) != 0) {
+        return ReadFromColorBufferToIov(box, iovs ? *iovs : mIovs);
+    }
+
+    EnsureLinear();
+
     // First, copy from the underlying backend resource to this resource's linear buffer:
     int ret = 0;
     if (mResourceType == VirtioGpuResourceType::BLOB) {
@@ -559,6 +588,15 @@ int VirtioGpuResource::TransferRead(const GoldfishPipeServiceOps* ops, uint64_t
 VirtioGpuResource::TransferWriteResult VirtioGpuResource::TransferWrite(
     const GoldfishPipeServiceOps* ops, uint64_t offset, stream_renderer_box* box,
     std::optional<std::vector<struct iovec>> iovs) {
+    if (mResourceType == VirtioGpuResourceType::COLOR_BUFFER && mCreateArgs &&
+        virgl_format_to_bpp(mCreateArgs->format) != 0) {
+        return TransferWriteResult{
+            .status = WriteToColorBufferFromIov(box, iovs ? *iovs : mIovs),
+        };
+    }
+
+    EnsureLinear();
+
     // First, copy from the desired iov to this resource's linear buffer:
     int ret = 0;
     if (iovs) {
@@ -785,6 +823,82 @@ int VirtioGpuResource::WriteToColorBufferFromLinear(uint64_t offset, stream_rend
     return 0;
 }
 
+int VirtioGpuResource::ReadFromColorBufferToIov(const stream_renderer_box* box,
+                                                const std::vector<struct iovec>& iovs) {
+    if (!IsValidTransferBox(*mCreateArgs, box)) {
+        return -EINVAL;
+    }
+
+    auto glformat = virgl_format_to_gl(mCreateArgs->format);
+    auto gltype = gl_format_to_natural_type(glformat);
+    const size_t boxSize =
+        static_cast<size_t>(box->w) * box->h * virgl_format_to_bpp(mCreateArgs->format);
+
+    // Read straight into the guest memory when possible.
+    if (char* boxInIov = GetContiguousBoxInIov(box, iovs)) {
+        FrameBuffer::getFB()->readColorBuffer(mCreateArgs->handle, box->x, box->y, box->w,
+                                              box->h, glformat, gltype, boxInIov, boxSize);
+        return 0;
+    }
+
+    // Otherwise scatter the rows straight from the staging memory.
+    int ret = 0;
+    const bool success = FrameBuffer::getFB()->readColorBufferToCallback(
+        mCreateArgs->handle, box->x, box->y, box->w, box->h, glformat, gltype, boxSize,
+        [&](const void* pixels, uint64_t size) {
+            if (size < boxSize) {
+                stream_renderer_error("Failed to transfer: ColorBuffer read smaller than box.");
+                ret = -EINVAL;
+                return false;
+            }
+            ret = TransferBoxWithIov(box, static_cast<char*>(const_cast<void*>(pixels)), iovs,
+                                     TransferDirection::LINEAR_TO_IOV);
+            return ret == 0;
+        });
+    if (!success && ret == 0) {
+        ret = -EINVAL;
+    }
+    return ret;
+}
+
+int VirtioGpuResource::WriteToColorBufferFromIov(const stream_renderer_box* box,
+                                                 const std::vector<struct iovec>& iovs) {
+    if (!IsValidTransferBox(*mCreateArgs, box)) {
+        return -EINVAL;
+    }
+
+    auto glformat = virgl_format_to_gl(mCreateArgs->format);
+    auto gltype = gl_format_to_natural_type(glformat);
+
+    // Update straight from the guest memory when possible.
+    if (char* boxInIov = GetContiguousBoxInIov(box, iovs)) {
+        FrameBuffer::getFB()->updateColorBuffer(mCreateArgs->handle, box->x, box->y, box->w,
+                                                box->h, glformat, gltype, boxInIov);
+        return 0;
+    }
+
+    // Otherwise gather the rows straight into the staging memory.
+    const size_t boxSize =
+        static_cast<size_t>(box->w) * box->h * virgl_format_to_bpp(mCreateArgs->format);
+    int ret = 0;
+    const bool success = FrameBuffer::getFB()->updateColorBufferFromCallback(
+        mCreateArgs->handle, box->x, box->y, box->w, box->h, glformat, gltype, boxSize,
+        [&](void* pixels, uint64_t size) {
+            if (size < boxSize) {
+                stream_renderer_error("Failed to transfer: ColorBuffer update smaller than box.");
+                ret = -EINVAL;
+                return false;
+            }
+            ret = TransferBoxWithIov(box, static_cast<char*>(pixels), iovs,
+                                     TransferDirection::IOV_TO_LINEAR);
+            return ret == 0;
+        });
+    if (!success && ret == 0) {
+        ret = -EINVAL;
+    }
+    return ret;
+}
+
 int VirtioGpuResource::TransferToIov(uint64_t offset, const stream_renderer_box* box,
                                      std::optional<std::vector<struct iovec>> iovs) {
     if (iovs) {
@@ -886,6 +1000,81 @@ int VirtioGpuResource::TransferWithIov(uint64_t offset, const stream_renderer_bo
     return 0;
 }
 
+int VirtioGpuResource::TransferBoxWithIov(const stream_renderer_box* box, char* boxData,
+                                          const std::vector<struct iovec>& iovs,
+                                          TransferDirection direction) {
+    const size_t bpp = virgl_format_to_bpp(mCreateArgs->format);
+    const size_t stride = static_cast<size_t>(mCreateArgs->width) * bpp;
+    const size_t rowSize = static_cast<size_t>(box->w) * bpp;
+
+    // Rows are visited in increasing offset order, so the iov walk never goes backwards.
+    uint32_t iovIndex = 0;
+    size_t iovOffset = 0;
+    for (uint32_t row = 0; row < box->h; ++row) {
+        size_t offset = (static_cast<size_t>(box->y) + row) * stride + box->x * bpp;
+        char* data = boxData + row * rowSize;
+        size_t remaining = rowSize;
+        while (remaining > 0) {
+            if (iovIndex >= iovs.size()) {
+                stream_renderer_error("failed to transfer: box overflowed iovs");
+                return -EINVAL;
+            }
+            const size_t iovLen = iovs[iovIndex].iov_len;
+            if (offset >= iovOffset + iovLen) {
+                iovOffset += iovLen;
+                ++iovIndex;
+                continue;
+            }
+
+            char* iovData = static_cast<char*>(iovs[iovIndex].iov_base) + (offset - iovOffset);
+            const size_t toCopy = std::min(remaining, iovOffset + iovLen - offset);
+            switch (direction) {
+                case TransferDirection::IOV_TO_LINEAR:
+                    memcpy(data, iovData, toCopy);
+                    break;
+                case TransferDirection::LINEAR_TO_IOV:
+                    memcpy(iovData, data, toCopy);
+                    break;
+                default:
+                    stream_renderer_error("failed to transfer: invalid synchronization dir");
+                    return -EINVAL;
+            }
+            offset += toCopy;
+            data += toCopy;
+            remaining -= toCopy;
+        }
+    }
+
+    return 0;
+}
+
+char* VirtioGpuResource::GetContiguousBoxInIov(const stream_renderer_box* box,
+                                               const std::vector<struct iovec>& iovs) const {
+    // Rows are only tightly packed in the resource layout if they span its whole width.
+    if (box->w != mCreateArgs->width && box->h != 1) {
+        return nullptr;
+    }
+
+    const size_t bpp = virgl_format_to_bpp(mCreateArgs->format);
+    const size_t start = virgl_format_to_linear_base(mCreateArgs->format, mCreateArgs->width,
+                                                     mCreateArgs->height, box->x, box->y,
+                                                     box->w, box->h);
+    const size_t end = start + static_cast<size_t>(box->w) * box->h * bpp;
+
+    size_t iovOffset = 0;
+    for (const struct iovec& iov : iovs) {
+        const size_t iovEnd = iovOffset + iov.iov_len;
+        if (start < iovEnd) {
+            if (end > iovEnd) {
+                return nullptr;
+            }
+            return static_cast<char*>(iov.iov_base) + (start - iovOffset);
+        }
+        iovOffset = iovEnd;
+    }
+    return nullptr;
+}
+
 int VirtioGpuResource::ExportBlob(struct stream_renderer_handle* outHandle) {
     if (!mBlobMemory) {
         return -EINVAL;
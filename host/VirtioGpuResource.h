@@ -125,6 +125,10 @@ class VirtioGpuResource {
 #endif
 
    private:
+    // Allocates this resource's linear buffer for the attached iovs, which is only needed by
+    // the transfers that go through it.
+    void EnsureLinear();
+
     int ReadFromPipeToLinear(const GoldfishPipeServiceOps* ops, uint64_t offset,
                              stream_renderer_box* box);
     TransferWriteResult WriteToPipeFromLinear(const GoldfishPipeServiceOps* ops, uint64_t offset,
@@ -136,6 +140,13 @@ class VirtioGpuResource {
     int ReadFromColorBufferToLinear(uint64_t offset, stream_renderer_box* box);
     int WriteToColorBufferFromLinear(uint64_t offset, stream_renderer_box* box);
 
+    // Transfers only the `box` region between `iovs` and a non YUV COLOR_BUFFER resource,
+    // without going through this resource's linear buffer.
+    int ReadFromColorBufferToIov(const stream_renderer_box* box,
+                                 const std::vector<struct iovec>& iovs);
+    int WriteToColorBufferFromIov(const stream_renderer_box* box,
+                                  const std::vector<struct iovec>& iovs);
+
     // If `iovs` provided, copy from this resource's linear buffer to the given `iovs`.
     // Otherwise, copy from this resource's linear buffer into its previously attached
     // iovs.
@@ -155,6 +166,16 @@ class VirtioGpuResource {
     int TransferWithIov(uint64_t offset, const stream_renderer_box* box,
                         const std::vector<struct iovec>& iovs, TransferDirection direction);
 
+    // Copies the rows of `box` between `iovs`, which hold the whole resource, and `boxData`,
+    // which holds only the `box` region with tightly packed rows.
+    int TransferBoxWithIov(const stream_renderer_box* box, char* boxData,
+                           const std::vector<struct iovec>& iovs, TransferDirection direction);
+
+    // Returns the start of the `box` region within `iovs` if it is stored contiguously in a
+    // single iov with tightly packed rows, or nullptr otherwise.
+    char* GetContiguousBoxInIov(const stream_renderer_box* box,
+                                const std::vector<struct iovec>& iovs) const;
+
     // LINT.IfChange(virtio_gpu_resource)
     VirtioGpuResourceId mId = -1;
     VirtioGpuResourceType mResourceType = VirtioGpuResourceType::UNKNOWN;
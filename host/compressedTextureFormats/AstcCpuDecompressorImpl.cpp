@@ -12,9 +12,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <array>
-#include <future>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "AstcCpuDecompressor.h"
 #include "astcenc.h"
@@ -23,10 +30,27 @@ namespace gfxstream {
 namespace vk {
 namespace {
 
-constexpr uint32_t kNumThreads = 2;
+// Upper bound for the number of threads a single decompression uses.
+constexpr uint32_t kMaxThreads = 16;
+
+// Below this many blocks per thread, waking up more threads costs more than it saves.
+constexpr uint32_t kMinBlocksPerThread = 256;
 
 const astcenc_swizzle kSwizzle = {ASTCENC_SWZ_R, ASTCENC_SWZ_G, ASTCENC_SWZ_B, ASTCENC_SWZ_A};
 
+// Returns how many threads a single decompression may use, including the calling thread. Can be
+// set with ANDROID_EMU_ASTC_CPU_THREADS, defaults to the number of cores.
+uint32_t getThreadBudget() {
+    static const uint32_t budget = [] {
+        uint32_t threads = std::thread::hardware_concurrency();
+        if (const char* env = std::getenv("ANDROID_EMU_ASTC_CPU_THREADS")) {
+            threads = static_cast<uint32_t>(std::strtoul(env, nullptr, 10));
+        }
+        return std::clamp(threads, 1u, kMaxThreads);
+    }();
+    return budget;
+}
+
 // Used by std::unique_ptr to release the context when the pointer is destroyed
 struct AstcencContextDeleter {
     void operator()(astcenc_context* c) { astcenc_context_free(c); }
@@ -37,10 +61,11 @@ using AstcencContextUniquePtr = std::unique_ptr<astcenc_context, AstcencContextD
 // Creates a new astcenc_context and wraps it in a smart pointer.
 // It is not needed to call astcenc_context_free() on the returned pointer.
 // blockWith, blockSize: ASTC block size for the context
+// threadCount: number of threads that may decompress an image together with the context
 // Error: (output param) Where to put the error status. Must not be null.
 // Returns nullptr in case of error.
 AstcencContextUniquePtr makeDecoderContext(uint32_t blockWidth, uint32_t blockHeight,
-                                           astcenc_error* error) {
+                                           uint32_t threadCount, astcenc_error* error) {
     astcenc_config config = {};
     *error =
         // TODO(gregschlom): Do we need to pass ASTCENC_PRF_LDR_SRGB here?
@@ -51,7 +76,7 @@ AstcencContextUniquePtr makeDecoderContext(uint32_t blockWidth, uint32_t blockHe
     }
 
     astcenc_context* context;
-    *error = astcenc_context_alloc(&config, kNumThreads, &context);
+    *error = astcenc_context_alloc(&config, threadCount, &context);
     if (*error != ASTCENC_SUCCESS) {
         return nullptr;
     }
@@ -97,34 +122,51 @@ bool isAstcDecoderAvailable() {
     if (!cpuSupportsAvx2()) return false;
     astcenc_error error;
     // Try getting an arbitrary context. If it works, the decoder is available.
-    auto context = makeDecoderContext(5, 5, &error);
+    auto context = makeDecoderContext(5, 5, 1, &error);
     return context != nullptr;
 }
 
-// Caches and manages astcenc_context objects.
-//
-// Each context is fairly large (around 30 MB) and takes a while to construct, so it's important to
-// reuse them as much as possible.
+// Pools astcenc_context objects.
 //
-// While context objects can be reused across multiple threads, they must be used sequentially. To
-// avoid having to lock and manage access between threads, we keep one cache per thread. This avoids
-// any concurrency issues, at the cost of extra memory.
+// Each context is fairly large and takes a while to construct, so it's important to reuse them
+// as much as possible.
 //
-// Currently, there is no eviction strategy. Each cache could grow to a maximum of ~400 MB in size
-// since they are 13 possible ASTC block sizes.
+// A context can only be used by one decompression at a time, so concurrent decompressions with
+// the same block size each get their own context. The pool holds on to as many contexts per
+// block size as were ever in use at the same time, which is bounded by the number of threads
+// decompressing concurrently.
 //
-// Thread-safety: not thread safe.
-class AstcDecoderContextCache {
+// Thread-safety: all public methods are thread-safe
+class AstcDecoderContextPool {
    public:
+    explicit AstcDecoderContextPool(uint32_t threadCount) : mThreadCount(threadCount) {}
+
     // Returns a context object for a given ASTC block size, along with the error code if the
     // context initialization failed.
     // In this case, the context will be null, and the status code will be non-zero.
-    std::pair<astcenc_context*, astcenc_error> get(uint32_t blockWidth, uint32_t blockHeight) {
-        Value& value = mContexts[{blockWidth, blockHeight}];
-        if (value.context == nullptr) {
-            value.context = makeDecoderContext(blockWidth, blockHeight, &value.error);
+    std::pair<AstcencContextUniquePtr, astcenc_error> acquire(uint32_t blockWidth,
+                                                              uint32_t blockHeight) {
+        {
+            std::lock_guard lock(mMutex);
+            std::vector<AstcencContextUniquePtr>& contexts = mContexts[{blockWidth, blockHeight}];
+            if (!contexts.empty()) {
+                AstcencContextUniquePtr context = std::move(contexts.back());
+                contexts.pop_back();
+                return {std::move(context), ASTCENC_SUCCESS};
+            }
         }
-        return {value.context.get(), value.error};
+
+        astcenc_error error = ASTCENC_SUCCESS;
+        AstcencContextUniquePtr context =
+            makeDecoderContext(blockWidth, blockHeight, mThreadCount, &error);
+        return {std::move(context), error};
+    }
+
+    // Returns a context obtained from acquire() to the pool. The context must have been reset
+    // with astcenc_decompress_reset().
+    void release(uint32_t blockWidth, uint32_t blockHeight, AstcencContextUniquePtr context) {
+        std::lock_guard lock(mMutex);
+        mContexts[{blockWidth, blockHeight}].push_back(std::move(context));
     }
 
    private:
@@ -138,11 +180,6 @@ class AstcDecoderContextCache {
         }
     };
 
-    struct Value {
-        AstcencContextUniquePtr context = nullptr;
-        astcenc_error error = ASTCENC_SUCCESS;
-    };
-
     // Computes the hash of a Key
     struct KeyHash {
         std::size_t operator()(const Key& k) const {
@@ -151,72 +188,117 @@ class AstcDecoderContextCache {
         }
     };
 
-    std::unordered_map<Key, Value, KeyHash> mContexts;
+    const uint32_t mThreadCount;
+    std::mutex mMutex;
+    std::unordered_map<Key, std::vector<AstcencContextUniquePtr>, KeyHash> mContexts;
 };
 
+// Threads shared by all decompressions. Tasks run in the order they were posted.
+//
 // Thread-safety: all public methods are thread-safe
-class WorkerThread {
+class WorkerPool {
    public:
-    explicit WorkerThread() : mThread(&WorkerThread::main, this) {}
+    explicit WorkerPool(uint32_t threadCount) {
+        for (uint32_t i = 0; i < threadCount; ++i) {
+            mThreads.emplace_back(&WorkerPool::main, this);
+        }
+    }
 
-    // Terminates the thread. Call wait() to wait until the thread fully exits.
-    void terminate() {
-        std::lock_guard lock(mWorkerMutex);
-        mTerminated = true;
-        mWorkerCondition.notify_one();
+    // Stops the threads, otherwise the process would hang upon exit. Tasks that have not
+    // started yet are dropped.
+    ~WorkerPool() {
+        {
+            std::lock_guard lock(mMutex);
+            mTerminated = true;
+        }
+        mCondition.notify_all();
+        for (auto& thread : mThreads) {
+            thread.join();
+        }
     }
 
-    // Blocks until the thread exits.
-    void wait() { mThread.join(); }
-
-    std::future<astcenc_error> decompress(astcenc_context* context, uint32_t threadIndex,
-                                          const uint8_t* data, size_t dataLength,
-                                          astcenc_image* image) {
-        std::lock_guard lock(mWorkerMutex);
-        mTask = std::packaged_task<astcenc_error()>{[=] {
-            return astcenc_decompress_image(context, data, dataLength, image, &kSwizzle,
-                                            threadIndex);
-        }};
-        mWorkerCondition.notify_one();
-        return mTask.get_future();
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard lock(mMutex);
+            mTasks.push_back(std::move(task));
+        }
+        mCondition.notify_one();
     }
 
    private:
     // Thread's main loop
     void main() {
         while (true) {
-            std::packaged_task<astcenc_error()> task;
+            std::function<void()> task;
             {
-                std::unique_lock lock(mWorkerMutex);
-                mWorkerCondition.wait(lock, [this] { return mTask.valid() || mTerminated; });
+                std::unique_lock lock(mMutex);
+                mCondition.wait(lock, [this] { return !mTasks.empty() || mTerminated; });
                 if (mTerminated) return;
-                task = std::move(mTask);
+                task = std::move(mTasks.front());
+                mTasks.pop_front();
             }
             task();
         }
     }
 
     bool mTerminated = false;
-    std::condition_variable mWorkerCondition = {};  // Signals availability of work
-    std::mutex mWorkerMutex = {};                   // Mutex used with mWorkerCondition.
-    std::packaged_task<astcenc_error()> mTask = {};
-    std::thread mThread = {};
+    std::condition_variable mCondition;  // Signals availability of work
+    std::mutex mMutex;                   // Mutex used with mCondition.
+    std::deque<std::function<void()>> mTasks;
+    std::vector<std::thread> mThreads;
+};
+
+// Tracks the pool threads helping with a single decompression.
+//
+// The pool may be busy with other decompressions, so the decompressing thread does not wait for
+// helpers that have not started by the time it is done: it cancels them instead, and only waits
+// for the ones already working.
+class DecompressionHelpers {
+   public:
+    // Returns false if the decompression is already done and the helper must not touch it.
+    bool begin() {
+        std::lock_guard lock(mMutex);
+        if (mCancelled) return false;
+        ++mRunning;
+        return true;
+    }
+
+    void end(astcenc_error status) {
+        std::lock_guard lock(mMutex);
+        if (status != ASTCENC_SUCCESS) mStatus = status;
+        --mRunning;
+        mCondition.notify_all();
+    }
+
+    // Keeps helpers from starting and waits for the running ones. Returns the last error
+    // reported by a helper.
+    astcenc_error cancelAndWait() {
+        std::unique_lock lock(mMutex);
+        mCancelled = true;
+        mCondition.wait(lock, [this] { return mRunning == 0; });
+        return mStatus;
+    }
+
+   private:
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    uint32_t mRunning = 0;
+    bool mCancelled = false;
+    astcenc_error mStatus = ASTCENC_SUCCESS;
 };
 
 // Performs ASTC decompression of an image on the CPU
+//
+// Decompressions run concurrently, each with its own astcenc context. astcenc hands out the
+// image's blocks to the threads working on a context in small batches, so the decompressing
+// thread works on its image together with up to getThreadBudget() - 1 pool threads.
 class AstcCpuDecompressorImpl : public AstcCpuDecompressor {
    public:
     AstcCpuDecompressorImpl()
-        : AstcCpuDecompressor(), mContextCache(std::make_unique<AstcDecoderContextCache>()) {}
-
-    ~AstcCpuDecompressorImpl() override {
-        // Stop the worker threads, otherwise the process would hang upon exit.
-        std::lock_guard global_lock(mMutex);
-        for (auto& worker : mWorkerThreads) {
-            worker.terminate();
-            worker.wait();
-        }
-    }
+        : AstcCpuDecompressor(),
+          mThreadBudget(getThreadBudget()),
+          mContextPool(mThreadBudget),
+          mWorkerPool(mThreadBudget - 1) {}
 
     bool available() const override {
         static bool available = isAstcDecoderAvailable();
@@ -226,11 +308,7 @@ class AstcCpuDecompressorImpl : public AstcCpuDecompressor {
     int32_t decompress(const uint32_t imgWidth, const uint32_t imgHeight, const uint32_t blockWidth,
                        const uint32_t blockHeight, const uint8_t* astcData, size_t astcDataLength,
                        uint8_t* output) override {
-        std::array<std::future<astcenc_error>, kNumThreads> futures;
-
-        std::lock_guard global_lock(mMutex);
-
-        auto [context, context_status] = mContextCache->get(blockWidth, blockHeight);
+        auto [context, context_status] = mContextPool.acquire(blockWidth, blockHeight);
         if (context_status != ASTCENC_SUCCESS) return context_status;
 
         astcenc_image image = {
@@ -241,21 +319,32 @@ class AstcCpuDecompressorImpl : public AstcCpuDecompressor {
             .data = reinterpret_cast<void**>(&output),
         };
 
-        for (uint32_t i = 0; i < kNumThreads; ++i) {
-            futures[i] = mWorkerThreads[i].decompress(context, i, astcData, astcDataLength, &image);
+        const uint32_t numBlocks = ((imgWidth + blockWidth - 1) / blockWidth) *
+                                   ((imgHeight + blockHeight - 1) / blockHeight);
+        const uint32_t numHelpers =
+            std::min(mThreadBudget - 1, numBlocks / kMinBlocksPerThread);
+
+        auto helpers = std::make_shared<DecompressionHelpers>();
+        astcenc_context* rawContext = context.get();
+        for (uint32_t i = 1; i <= numHelpers; ++i) {
+            mWorkerPool.post([=, &image] {
+                if (!helpers->begin()) return;
+                helpers->end(astcenc_decompress_image(rawContext, astcData, astcDataLength,
+                                                      &image, &kSwizzle, i));
+            });
         }
 
-        astcenc_error result = ASTCENC_SUCCESS;
+        astcenc_error result = astcenc_decompress_image(rawContext, astcData, astcDataLength,
+                                                        &image, &kSwizzle, 0);
 
-        // Wait for all threads to be done
-        for (auto& future : futures) {
-            astcenc_error status = future.get();
-            if (status != ASTCENC_SUCCESS) {
-                result = status;
-            }
+        // Wait for the helpers that are still working on this image.
+        astcenc_error helperResult = helpers->cancelAndWait();
+        if (result == ASTCENC_SUCCESS) {
+            result = helperResult;
         }
 
-        astcenc_decompress_reset(context);
+        astcenc_decompress_reset(rawContext);
+        mContextPool.release(blockWidth, blockHeight, std::move(context));
 
         return result;
     }
@@ -266,9 +355,9 @@ class AstcCpuDecompressorImpl : public AstcCpuDecompressor {
     }
 
    private:
-    std::unique_ptr<AstcDecoderContextCache> mContextCache;
-    std::mutex mMutex;  // Locked while calling `decompress()`
-    std::array<WorkerThread, kNumThreads> mWorkerThreads;
+    const uint32_t mThreadBudget;
+    AstcDecoderContextPool mContextPool;
+    WorkerPool mWorkerPool;
 };
 
 }  // namespace
@@ -0,0 +1,83 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "AstcCpuDecompressor.h"
+
+namespace gfxstream {
+namespace vk {
+namespace {
+
+// One block of the checkerboard of AstcCpuDecompressor_unittest.cpp, compressed with 8x8 block
+// size. All of its blocks are identical.
+const uint8_t kCheckerboardBlock[] = {0x44, 0x05, 0x00, 0xfe, 0x01, 0x00, 0x00, 0x00,
+                                      0x55, 0xaa, 0x55, 0xaa, 0x55, 0xaa, 0x55, 0xaa};
+
+std::vector<uint8_t> makeCheckerboard(uint32_t size) {
+    const size_t numBlocks = (size / 8) * (size / 8);
+    std::vector<uint8_t> data(numBlocks * sizeof(kCheckerboardBlock));
+    for (size_t i = 0; i < numBlocks; ++i) {
+        std::copy(std::begin(kCheckerboardBlock), std::end(kCheckerboardBlock),
+                  data.begin() + i * sizeof(kCheckerboardBlock));
+    }
+    return data;
+}
+
+// Decompresses a checkerboard of state.range(0) pixels per side. With several benchmark threads,
+// each of them decompresses its own image at the same time, like render threads uploading
+// textures concurrently. The threads that a single decompression may use are set with
+// ANDROID_EMU_ASTC_CPU_THREADS.
+void BM_Decompress(benchmark::State& state) {
+    auto& decompressor = AstcCpuDecompressor::get();
+    if (!decompressor.available()) {
+        state.SkipWithError("ASTC decompressor not available");
+        return;
+    }
+
+    const uint32_t size = static_cast<uint32_t>(state.range(0));
+    const std::vector<uint8_t> compressed = makeCheckerboard(size);
+    std::vector<uint8_t> output(static_cast<size_t>(size) * size * 4);
+
+    for (auto _ : state) {
+        const int32_t status = decompressor.decompress(size, size, 8, 8, compressed.data(),
+                                                       compressed.size(), output.data());
+        if (status != 0) {
+            state.SkipWithError(decompressor.getStatusString(status));
+            break;
+        }
+        benchmark::DoNotOptimize(output.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * size * size);
+    state.SetBytesProcessed(state.iterations() * output.size());
+}
+
+BENCHMARK(BM_Decompress)
+    ->Arg(16)
+    ->Arg(256)
+    ->Arg(1024)
+    ->Arg(2048)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace vk
+}  // namespace gfxstream
+
+BENCHMARK_MAIN();
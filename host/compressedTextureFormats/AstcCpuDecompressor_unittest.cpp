@@ -14,6 +14,9 @@
 
 #include <gmock/gmock.h>
 
+#include <thread>
+#include <vector>
+
 #include "AstcCpuDecompressor.h"
 
 namespace gfxstream {
@@ -35,6 +38,32 @@ struct Rgba {
     bool operator==(const Rgba& o) const { return r == o.r && g == o.g && b == o.b && a == o.a; }
 };
 
+// Returns a `size`x`size` checkerboard, compressed with 8x8 block size. All the blocks of
+// kCheckerboard are identical, so repeating them yields a bigger checkerboard.
+std::vector<uint8_t> makeCheckerboard(uint32_t size) {
+    constexpr size_t kBlockSize = 16;
+    const size_t numBlocks = (size / 8) * (size / 8);
+    std::vector<uint8_t> data(numBlocks * kBlockSize);
+    for (size_t i = 0; i < numBlocks; ++i) {
+        std::copy(kCheckerboard, kCheckerboard + kBlockSize, data.begin() + i * kBlockSize);
+    }
+    return data;
+}
+
+// Returns the number of pixels of a decompressed `size`x`size` checkerboard that are wrong.
+size_t countCheckerboardErrors(const std::vector<Rgba>& pixels, uint32_t size) {
+    const Rgba W = {0xFF, 0xFF, 0xFF, 0xFF};
+    const Rgba B = {0, 0, 0, 0xFF};
+    size_t errors = 0;
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+            const Rgba& expected = (x + y) % 2 == 0 ? W : B;
+            if (!(pixels[y * size + x] == expected)) ++errors;
+        }
+    }
+    return errors;
+}
+
 TEST(AstcCpuDecompressor, Decompress) {
     auto& decompressor = AstcCpuDecompressor::get();
     if (!decompressor.available()) GTEST_SKIP() << "ASTC decompressor not available";
@@ -69,6 +98,51 @@ TEST(AstcCpuDecompressor, Decompress) {
     ASSERT_THAT(output, ElementsAreArray(expected));
 }
 
+TEST(AstcCpuDecompressor, DecompressLargeImage) {
+    auto& decompressor = AstcCpuDecompressor::get();
+    if (!decompressor.available()) GTEST_SKIP() << "ASTC decompressor not available";
+
+    // Big enough to be split across several threads.
+    constexpr uint32_t kSize = 1024;
+    const std::vector<uint8_t> compressed = makeCheckerboard(kSize);
+
+    std::vector<Rgba> output(kSize * kSize);
+    int32_t status = decompressor.decompress(kSize, kSize, 8, 8, compressed.data(),
+                                             compressed.size(), (uint8_t*)output.data());
+    EXPECT_EQ(status, 0);
+    EXPECT_EQ(countCheckerboardErrors(output, kSize), 0u);
+}
+
+TEST(AstcCpuDecompressor, DecompressConcurrently) {
+    auto& decompressor = AstcCpuDecompressor::get();
+    if (!decompressor.available()) GTEST_SKIP() << "ASTC decompressor not available";
+
+    constexpr uint32_t kNumThreads = 8;
+    constexpr uint32_t kIterations = 10;
+    const uint32_t sizes[] = {16, 256, 512};
+
+    std::vector<size_t> errors(kNumThreads);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < kNumThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (uint32_t i = 0; i < kIterations; ++i) {
+                const uint32_t size = sizes[(t + i) % std::size(sizes)];
+                const std::vector<uint8_t> compressed = makeCheckerboard(size);
+                std::vector<Rgba> output(size * size);
+                int32_t status = decompressor.decompress(size, size, 8, 8, compressed.data(),
+                                                         compressed.size(),
+                                                         (uint8_t*)output.data());
+                errors[t] += status != 0 ? 1 : countCheckerboardErrors(output, size);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_THAT(errors, ::testing::Each(0u));
+}
+
 TEST(AstcCpuDecompressor, getStatusStringAlwaysNonNull) {
     EXPECT_THAT(AstcCpuDecompressor::get().getStatusString(-10000), NotNull());
 }
@@ -323,6 +323,15 @@ struct FeatureSet {
         "device properties for the guest queries.",
         &map,
     };
+    FeatureInfo RingStreamInPlaceDecode = {
+        "RingStreamInPlaceDecode",
+        "If enabled, render threads decode guest commands directly out of the address space "
+        "graphics ring memory instead of copying them to host memory first. This saves a copy "
+        "of every command buffer, but the memory stays writable by the guest while it is "
+        "decoded, so a guest can change lengths or handles after the host has validated them. "
+        "Only enable this for trusted guests.",
+        &map,
+    };
     FeatureInfo VulkanRobustness = {
         "VulkanRobustness",
         "If enabled, robustness extensions with all supported features will be enabled on "
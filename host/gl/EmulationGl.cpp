@@ -534,6 +534,10 @@ EmulationGl::~EmulationGl() {
         }
         mEglDisplay = EGL_NO_DISPLAY;
     }
+
+    if (s_egl.eglShutdownBlobCache) {
+        s_egl.eglShutdownBlobCache();
+    }
 }
 
 std::unique_ptr<gfxstream::DisplaySurface> EmulationGl::createFakeWindowSurface() {
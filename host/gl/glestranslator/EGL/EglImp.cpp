@@ -45,6 +45,7 @@
 #include "EglOsApi.h"
 #include "GraphicsDriverLock.h"
 #include "ClientAPIExts.h"
+#include "ShaderCache.h"
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
@@ -152,6 +153,7 @@ EGLAPI EGLBoolean EGLAPIENTRY eglPostLoadAllImages(EGLDisplay display, EGLStream
 EGLAPI void EGLAPIENTRY eglUseOsEglApi(EGLBoolean enable, EGLBoolean nullEgl);
 EGLAPI void EGLAPIENTRY eglSetMaxGLESVersion(EGLint version);
 EGLAPI void EGLAPIENTRY eglFillUsages(void* usages);
+EGLAPI void EGLAPIENTRY eglShutdownBlobCache();
 
 EGLAPI EGLDisplay EGLAPIENTRY eglGetNativeDisplayANDROID(EGLDisplay);
 EGLAPI EGLContext EGLAPIENTRY eglGetNativeContextANDROID(EGLDisplay, EGLContext);
@@ -1823,6 +1825,11 @@ EGLAPI void EGLAPIENTRY eglFillUsages(void* usages) {
     // }
 }
 
+EGLAPI void EGLAPIENTRY eglShutdownBlobCache() {
+    MEM_TRACE("EMUGL");
+    ShutdownBlobCache();
+}
+
 EGLAPI EGLDisplay EGLAPIENTRY eglGetNativeDisplayANDROID(EGLDisplay display) {
     VALIDATE_DISPLAY_RETURN(display, (EGLDisplay)0);
     return dpy->getHostDriverDisplay();
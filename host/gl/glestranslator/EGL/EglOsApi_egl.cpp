@@ -324,6 +324,8 @@ public:
     }
 
 private:
+    void initBlobCache(EGLSurface surface, EGLContext context);
+
     bool mVerbose = false;
     EGLDisplay mDisplay = EGL_NO_DISPLAY;
     EglOsEglDispatcher mDispatcher;
@@ -410,7 +412,9 @@ EglOsEglDisplay::EglOsEglDisplay(bool nullEgl) {
     else mGlxDisplay = getX11Api()->XOpenDisplay(0);
 #endif // __linux__
 
-    if (clientExts != nullptr && emugl::hasExtension(clientExts, "EGL_ANDROID_blob_cache")) {
+    const bool hasBlobCache =
+        clientExts != nullptr && emugl::hasExtension(clientExts, "EGL_ANDROID_blob_cache");
+    if (hasBlobCache) {
         mDispatcher.eglSetBlobCacheFuncsANDROID(mDisplay, SetBlob, GetBlob);
     }
 
@@ -452,6 +456,9 @@ EglOsEglDisplay::EglOsEglDisplay(bool nullEgl) {
                     mGlesVersion = GlesVersion::ES30;
                 }
             }
+            if (ctx != EGL_NO_CONTEXT && hasBlobCache) {
+                initBlobCache(surface, ctx);
+            }
             mDispatcher.eglDestroySurface(mDisplay, surface);
             if (ctx != EGL_NO_CONTEXT) {
                 mDispatcher.eglDestroyContext(mDisplay, ctx);
@@ -460,6 +467,27 @@ EglOsEglDisplay::EglOsEglDisplay(bool nullEgl) {
     }
 };
 
+// Blobs are only valid for the driver that produced them, so the saved blobs are keyed on the
+// renderer and the driver version as well as the vendor. Without a context to query those, the
+// blobs are only cached in memory.
+void EglOsEglDisplay::initBlobCache(EGLSurface surface, EGLContext context) {
+    auto getString = reinterpret_cast<PFNGLGETSTRINGPROC>(
+        mDispatcher.eglGetProcAddress("glGetString"));
+    if (!getString || !mDispatcher.eglMakeCurrent(mDisplay, surface, surface, context)) {
+        return;
+    }
+    auto renderer = reinterpret_cast<const char*>(getString(GL_RENDERER));
+    auto glVersion = reinterpret_cast<const char*>(getString(GL_VERSION));
+    mDispatcher.eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (!renderer || !glVersion) {
+        return;
+    }
+
+    auto eglVersion = mDispatcher.eglQueryString(mDisplay, EGL_VERSION);
+    InitBlobCache(mVendor + "\n" + renderer + "\n" + glVersion + "\n" +
+                  (eglVersion ? eglVersion : ""));
+}
+
 EglOsEglDisplay::~EglOsEglDisplay() {
 #ifdef ANDROID
 #elif defined(__linux__)
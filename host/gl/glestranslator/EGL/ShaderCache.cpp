@@ -14,75 +14,320 @@
 
 #include "ShaderCache.h"
 
-#include "aemu/base/MruCache.h"
 #include <string.h>
+
+#include <chrono>
 #include <cstdio>
 
-#include <map>
-#include <vector>
+#include "aemu/base/system/System.h"
+#include "host-common/logging.h"
 
 namespace {
-    using BlobCacheType = std::vector<uint8_t>;
-
-    template <class K, class V>
-    class CacheObserver : android::base::MruCache<K, V>::MruCacheObserver {
-    public:
-        int count = 0;
-        CacheObserver(android::base::MruCache<K, V>* cacheReference) {
-            mCacheRef = cacheReference;
-            cacheReference->setObserver(this);
-        }
 
-        void cacheChanged() override {
-            // TODO: This will dictate when we flatten the cache.
-        }
+constexpr char kMagic[8] = {'E', 'G', 'L', 'B', 'L', 'O', 'B', '\0'};
+constexpr uint32_t kVersion = 1;
 
-    private:
-        android::base::MruCache<K, V>* mCacheRef;
-    };
+// ~32MB of shaders, very rough estimate.
+constexpr size_t kMaxCacheBytes = 32 * 1024 * 1024;
 
-    template <class K, class V>
-    class CacheFlattener : public android::base::MruCache<K, V>::CacheFlattener {
-        using MruCache = std::map<typename android::base::MruCache<K, V>::template EntryWithSize<K>,
-            typename android::base::MruCache<K, V>::template EntryWithSize<V>>;
+// Drivers set blobs in bursts while an app compiles its shaders, so wait for the burst to
+// end instead of rewriting the file for each of them.
+constexpr auto kFlushDelay = std::chrono::seconds(5);
 
-    public:
-        void handleFlatten(MruCache &mCache, void* buf, size_t bufSize) {
-            // TODO: This will handle the actual serialization.
-        }
+// Sizes are stored little endian so a cache file reads back the same on any host.
+bool writeU32(FILE* file, uint32_t value) {
+    const uint8_t bytes[4] = {
+        static_cast<uint8_t>(value),
+        static_cast<uint8_t>(value >> 8),
+        static_cast<uint8_t>(value >> 16),
+        static_cast<uint8_t>(value >> 24),
     };
+    return fwrite(bytes, sizeof(bytes), 1, file) == 1;
+}
 
-    CacheFlattener<BlobCacheType, BlobCacheType> testFlattener;
-    // 3200 is ~32MB of shaders, very rough estimate.
-    android::base::MruCache<BlobCacheType, BlobCacheType> mruCache(3200, &testFlattener);
-    CacheObserver<BlobCacheType, BlobCacheType> sss(&mruCache);
+bool readU32(FILE* file, uint32_t* value) {
+    uint8_t bytes[4];
+    if (fread(bytes, sizeof(bytes), 1, file) != 1) {
+        return false;
+    }
+    *value = static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+             (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    return true;
 }
 
-void SetBlob(const void* key, EGLsizeiANDROID keySize, const void* value, EGLsizeiANDROID valueSize) {
-    std::vector<uint8_t> keyVec(keySize);
-    memcpy(keyVec.data(), key, keySize);
+// 64 bit FNV-1a, which unlike std::hash gives the same file name across builds and platforms.
+uint64_t hashDriverId(const std::string& driverId) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const char c : driverId) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+}  // namespace
 
-    std::vector<uint8_t> valueVec(valueSize);
-    memcpy(valueVec.data(), value, valueSize);
+BlobCache::BlobCache(size_t maxBytes) : mMaxBytes(maxBytes) {}
 
-    mruCache.put(keyVec, keySize, std::move(valueVec), valueSize);
+BlobCache::~BlobCache() { shutdown(); }
+
+std::string BlobCache::getPath(const std::string& directory, const std::string& driverId) {
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx",
+             static_cast<unsigned long long>(hashDriverId(driverId)));
+    return directory + "/egl_blob_cache_" + hash + ".bin";
 }
 
-EGLsizeiANDROID GetBlob(const void* key, EGLsizeiANDROID keySize, void* value, EGLsizeiANDROID valueSize) {
-    std::vector<uint8_t> keyVec(keySize);
-    memcpy(keyVec.data(), key, keySize);
+void BlobCache::init(const std::string& directory, const std::string& driverId) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mThread.joinable()) {
+        return;
+    }
+
+    // Keep the caches of different drivers apart so that switching between host GPUs
+    // does not throw away the other's blobs.
+    mPath = getPath(directory, driverId);
+    mDriverId = driverId;
+    mStopping = false;
+    mThread = std::thread([this]() { threadMain(); });
+}
+
+void BlobCache::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCv.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void BlobCache::set(const void* key, size_t keySize, const void* value, size_t valueSize) {
+    if (keySize + valueSize > mMaxBytes) {
+        return;
+    }
+
+    auto valueVec = std::make_shared<std::vector<uint8_t>>(valueSize);
+    memcpy(valueVec->data(), value, valueSize);
 
-    const std::vector<uint8_t> *result;
-    auto found = mruCache.get(keyVec, &result);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::string keyStr(static_cast<const char*>(key), keySize);
+        auto it = mEntries.find(keyStr);
+        if (it != mEntries.end()) {
+            mBytes -= it->second->key.size() + it->second->value->size();
+            mLru.erase(it->second);
+            mEntries.erase(it);
+        }
+        insertLocked(std::move(keyStr), std::move(valueVec), /*mostRecent=*/true);
+        mDirty = true;
+    }
+    mCv.notify_all();
+}
 
-    if (!found) {
+size_t BlobCache::get(const void* key, size_t keySize, void* value, size_t valueSize) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(std::string(static_cast<const char*>(key), keySize));
+    if (it == mEntries.end()) {
+        mMisses.fetch_add(1, std::memory_order_relaxed);
         return 0;
     }
+    mHits.fetch_add(1, std::memory_order_relaxed);
 
-    if (result->size() <= static_cast<size_t>(valueSize)) {
-        memcpy(value, result->data(), result->size());
+    mLru.splice(mLru.begin(), mLru, it->second);
+    const std::vector<uint8_t>& result = *it->second->value;
+    if (result.size() <= valueSize) {
+        memcpy(value, result.data(), result.size());
     }
 
     // If the size provided was too small, return the right size regardless.
-    return result->size();
+    return result.size();
+}
+
+BlobCacheStats BlobCache::stats() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return BlobCacheStats{
+        .hits = mHits.load(std::memory_order_relaxed),
+        .misses = mMisses.load(std::memory_order_relaxed),
+        .entries = mEntries.size(),
+        .bytes = mBytes,
+    };
+}
+
+void BlobCache::insertLocked(std::string key, std::shared_ptr<const std::vector<uint8_t>> value,
+                             bool mostRecent) {
+    mBytes += key.size() + value->size();
+    auto it = mLru.insert(mostRecent ? mLru.begin() : mLru.end(),
+                          Entry{std::move(key), std::move(value)});
+    mEntries[it->key] = it;
+
+    while (mBytes > mMaxBytes) {
+        const Entry& oldest = mLru.back();
+        mBytes -= oldest.key.size() + oldest.value->size();
+        mEntries.erase(oldest.key);
+        mLru.pop_back();
+    }
+}
+
+void BlobCache::threadMain() {
+    load();
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mCv.wait(lock, [this]() { return mDirty || mStopping; });
+        if (!mStopping) {
+            mCv.wait_for(lock, kFlushDelay, [this]() { return mStopping; });
+        }
+        if (mDirty) {
+            mDirty = false;
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+        if (mStopping) {
+            return;
+        }
+    }
+}
+
+void BlobCache::load() {
+    FILE* file = fopen(mPath.c_str(), "rb");
+    if (!file) {
+        return;
+    }
+
+    char magic[sizeof(kMagic)];
+    uint32_t version = 0;
+    uint32_t driverIdSize = 0;
+    std::string driverId;
+    bool valid = fread(magic, sizeof(magic), 1, file) == 1 &&
+                 memcmp(magic, kMagic, sizeof(kMagic)) == 0 && readU32(file, &version) &&
+                 version == kVersion && readU32(file, &driverIdSize) &&
+                 driverIdSize == mDriverId.size();
+    if (valid) {
+        driverId.resize(driverIdSize);
+        valid = fread(driverId.data(), driverIdSize, 1, file) == 1 && driverId == mDriverId;
+    }
+    if (!valid) {
+        // Left over from another driver or version, the next flush replaces it.
+        INFO("Ignoring EGL blob cache %s from a different driver or version.", mPath.c_str());
+        fclose(file);
+        return;
+    }
+
+    std::vector<Entry> loaded;
+    size_t loadedBytes = 0;
+    uint32_t keySize = 0;
+    uint32_t valueSize = 0;
+    while (readU32(file, &keySize) && readU32(file, &valueSize)) {
+        if (loadedBytes + keySize + valueSize > mMaxBytes) {
+            break;
+        }
+        std::string key(keySize, '\0');
+        auto value = std::make_shared<std::vector<uint8_t>>(valueSize);
+        if ((keySize > 0 && fread(key.data(), keySize, 1, file) != 1) ||
+            (valueSize > 0 && fread(value->data(), valueSize, 1, file) != 1)) {
+            WARN("EGL blob cache %s is truncated.", mPath.c_str());
+            break;
+        }
+        loadedBytes += keySize + valueSize;
+        loaded.push_back(Entry{std::move(key), std::move(value)});
+    }
+    fclose(file);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (Entry& entry : loaded) {
+        // Blobs set while loading are newer than the saved ones.
+        if (mEntries.find(entry.key) == mEntries.end()) {
+            insertLocked(std::move(entry.key), std::move(entry.value), /*mostRecent=*/false);
+        }
+    }
+    INFO("Loaded %zu EGL blobs (%zu bytes) from %s.", loaded.size(), loadedBytes, mPath.c_str());
+}
+
+void BlobCache::flush() {
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        entries.assign(mLru.begin(), mLru.end());
+    }
+
+    // Write a new file and move it into place, so that a crash while flushing leaves the
+    // previous cache intact.
+    const std::string tmpPath = mPath + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        ERR("Failed to open EGL blob cache %s.", tmpPath.c_str());
+        return;
+    }
+
+    bool ok = fwrite(kMagic, sizeof(kMagic), 1, file) == 1 && writeU32(file, kVersion) &&
+              writeU32(file, static_cast<uint32_t>(mDriverId.size())) &&
+              (mDriverId.empty() || fwrite(mDriverId.data(), mDriverId.size(), 1, file) == 1);
+    for (const Entry& entry : entries) {
+        if (!ok) {
+            break;
+        }
+        const std::vector<uint8_t>& value = *entry.value;
+        ok = writeU32(file, static_cast<uint32_t>(entry.key.size())) &&
+             writeU32(file, static_cast<uint32_t>(value.size())) &&
+             (entry.key.empty() || fwrite(entry.key.data(), entry.key.size(), 1, file) == 1) &&
+             (value.empty() || fwrite(value.data(), value.size(), 1, file) == 1);
+    }
+    ok = (fclose(file) == 0) && ok;
+
+#ifdef _WIN32
+    // rename() does not replace existing files on Windows.
+    if (ok) {
+        std::remove(mPath.c_str());
+    }
+#endif
+    if (!ok || std::rename(tmpPath.c_str(), mPath.c_str()) != 0) {
+        ERR("Failed to write EGL blob cache %s.", mPath.c_str());
+        std::remove(tmpPath.c_str());
+        return;
+    }
+
+    VERBOSE("Saved %zu EGL blobs to %s.", entries.size(), mPath.c_str());
+}
+
+namespace {
+
+// Never destroyed, ShutdownBlobCache() stops its thread.
+BlobCache& getBlobCache() {
+    static BlobCache* sBlobCache = new BlobCache(kMaxCacheBytes);
+    return *sBlobCache;
+}
+
+}  // namespace
+
+void InitBlobCache(const std::string& driverId) {
+    const std::string directory =
+        android::base::getEnvironmentVariable("ANDROID_EMUGL_SHADER_CACHE_DIR");
+    if (directory.empty()) {
+        return;
+    }
+    getBlobCache().init(directory, driverId);
+}
+
+void ShutdownBlobCache() {
+    getBlobCache().shutdown();
+
+    const BlobCacheStats stats = GetBlobCacheStats();
+    INFO("EGL blob cache: %llu hits, %llu misses, %llu blobs (%llu bytes).",
+         static_cast<unsigned long long>(stats.hits),
+         static_cast<unsigned long long>(stats.misses),
+         static_cast<unsigned long long>(stats.entries),
+         static_cast<unsigned long long>(stats.bytes));
+}
+
+BlobCacheStats GetBlobCacheStats() { return getBlobCache().stats(); }
+
+void SetBlob(const void* key, EGLsizeiANDROID keySize, const void* value, EGLsizeiANDROID valueSize) {
+    getBlobCache().set(key, keySize, value, valueSize);
+}
+
+EGLsizeiANDROID GetBlob(const void* key, EGLsizeiANDROID keySize, void* value, EGLsizeiANDROID valueSize) {
+    return getBlobCache().get(key, keySize, value, valueSize);
 }
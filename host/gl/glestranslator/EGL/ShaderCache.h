@@ -17,11 +17,100 @@
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
-#include <map>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+struct BlobCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t entries = 0;
+    uint64_t bytes = 0;
+};
+
+// An LRU cache of blobs which is optionally saved to a file, see InitBlobCache(). Exposed for
+// tests, the EGL translator uses the one instance behind SetBlob() and GetBlob().
+//
+// The file is a header followed by the entries, most recently used first. All integers are
+// little endian.
+//
+//   header: char[8] magic "EGLBLOB\0", u32 version, u32 driver id size, driver id
+//   entry:  u32 key size, u32 value size, key, value
+class BlobCache {
+   public:
+    explicit BlobCache(size_t maxBytes);
+    ~BlobCache();
+
+    // Starts loading the blobs saved in `directory` by the same driver, and saving them there
+    // once they change.
+    void init(const std::string& directory, const std::string& driverId);
+
+    // Saves the blobs if they changed and stops the thread started by init(). The blobs stay
+    // available in memory.
+    void shutdown();
+
+    void set(const void* key, size_t keySize, const void* value, size_t valueSize);
+    size_t get(const void* key, size_t keySize, void* value, size_t valueSize);
+
+    BlobCacheStats stats();
+
+    // The file that the blobs of `driverId` are saved to.
+    static std::string getPath(const std::string& directory, const std::string& driverId);
+
+   private:
+    struct Entry {
+        std::string key;
+        // Shared so that a flush can hold on to the values without copying them under the lock.
+        std::shared_ptr<const std::vector<uint8_t>> value;
+    };
+
+    void insertLocked(std::string key, std::shared_ptr<const std::vector<uint8_t>> value,
+                      bool mostRecent);
+    void threadMain();
+    void load();
+    void flush();
+
+    const size_t mMaxBytes;
+
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    // Most recently used first.
+    std::list<Entry> mLru;
+    std::unordered_map<std::string, std::list<Entry>::iterator> mEntries;
+    size_t mBytes = 0;
+    bool mDirty = false;
+    bool mStopping = false;
+
+    std::string mPath;
+    std::string mDriverId;
+    std::thread mThread;
+
+    std::atomic<uint64_t> mHits{0};
+    std::atomic<uint64_t> mMisses{0};
+};
+
+// Makes the blob cache persistent if the ANDROID_EMUGL_SHADER_CACHE_DIR environment
+// variable names a directory to keep it in. `driverId` identifies the host driver, blobs
+// saved by a different driver are discarded. The saved blobs are loaded in the background,
+// blobs set in the meantime take precedence over them.
+void InitBlobCache(const std::string& driverId);
+
+// Saves the blobs set since the last save and stops saving them, logging the cache's stats.
+// Called when the renderer is torn down, rather than from a static destructor at exit.
+void ShutdownBlobCache();
+
+BlobCacheStats GetBlobCacheStats();
+
 void SetBlob(const void* key, EGLsizeiANDROID keySize, const void* value, EGLsizeiANDROID valueSize);
 
 EGLsizeiANDROID GetBlob(const void* key, EGLsizeiANDROID keySize, void* value, EGLsizeiANDROID valueSize);
 
-#endif
\ No newline at end of file
+#endif
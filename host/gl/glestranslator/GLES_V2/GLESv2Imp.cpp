@@ -927,6 +927,10 @@ GL_APICALL void  GL_APIENTRY glCompileShader(GLuint shader){
 
 GL_APICALL void  GL_APIENTRY glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid* pixels);
 
+void s_glInitTexImage2D(GLenum target, GLint level, GLint internalformat,
+        GLsizei width, GLsizei height, GLint border, GLint samples, GLenum* format,
+        GLenum* type, GLint* internalformat_out);
+
 GL_APICALL void  GL_APIENTRY glCompressedTexImage2D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const GLvoid* data)
 {
     GET_CTX();
@@ -939,9 +943,26 @@ GL_APICALL void  GL_APIENTRY glCompressedTexImage2D(GLenum target, GLint level,
         doCompressedTexImage2DNative(ctx, target, level, internalformat,
                                           width, height, border, imageSize, data);
     } else {
+        // glTexImage2D() hands |pixels| to the host as is, so it can also
+        // upload from the host's unpack buffer.
         doCompressedTexImage2D(ctx, target, level, internalformat,
                                     width, height, border,
-                                    imageSize, data, funcPtr);
+                                    imageSize, data, funcPtr, funcPtr,
+                                    [ctx](GLenum target, GLint level,
+                                    GLenum internalformat, GLsizei width, GLsizei height,
+                                    GLint border, GLsizei imageSize,
+                                    const GLvoid* data) {
+                                        // Images transcoded to BC3 keep it as their
+                                        // internal format, which the sub-images go by.
+                                        GLenum format = GL_RGBA;
+                                        GLenum type = GL_UNSIGNED_BYTE;
+                                        s_glInitTexImage2D(target, level, internalformat,
+                                                width, height, border, 0, &format, &type,
+                                                nullptr);
+                                        doCompressedTexImage2DNative(ctx, target, level,
+                                                internalformat, width, height, border,
+                                                imageSize, data);
+                                    });
     }
 
     TextureData* texData = getTextureTargetData(target);
@@ -956,6 +977,8 @@ GL_APICALL void  GL_APIENTRY glCompressedTexImage2D(GLenum target, GLint level,
 
 GL_APICALL void  GL_APIENTRY glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* pixels);
 
+static void sTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* pixels, bool hostUnpackBuffer);
+
 GL_APICALL void  GL_APIENTRY glCompressedTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const GLvoid* data){
     GET_CTX();
     SET_ERROR_IF(!GLESv2Validate::textureTargetEx(ctx, target),GL_INVALID_ENUM);
@@ -984,6 +1007,19 @@ GL_APICALL void  GL_APIENTRY glCompressedTexSubImage2D(GLenum target, GLint leve
             doCompressedTexSubImage2DNative(ctx, target, level, xoffset, yoffset,
                                                  width, height, format, imageSize, data);
         } else {
+            const bool transcodedToBc3 = texData &&
+                    (texData->internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ||
+                     texData->internalFormat == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT);
+            glCompressedTexImage2D_t compressedSubImage2D;
+            if (transcodedToBc3) {
+                compressedSubImage2D = [ctx, xoffset, yoffset](GLenum target,
+                        GLint level, GLenum internalformat, GLsizei width,
+                        GLsizei height, GLint border, GLsizei imageSize,
+                        const GLvoid* data) {
+                    doCompressedTexSubImage2DNative(ctx, target, level, xoffset,
+                            yoffset, width, height, internalformat, imageSize, data);
+                };
+            }
             doCompressedTexImage2D(ctx, target, level, format,
                     width, height, 0, imageSize, data,
                     [xoffset, yoffset](GLenum target, GLint level,
@@ -992,7 +1028,16 @@ GL_APICALL void  GL_APIENTRY glCompressedTexSubImage2D(GLenum target, GLint leve
                     const GLvoid* data) {
                         glTexSubImage2D(target, level, xoffset, yoffset,
                             width, height, format, type, data);
-                    });
+                    },
+                    [xoffset, yoffset](GLenum target, GLint level,
+                    GLint internalformat, GLsizei width, GLsizei height,
+                    GLint border, GLenum format, GLenum type,
+                    const GLvoid* data) {
+                        sTexSubImage2D(target, level, xoffset, yoffset,
+                            width, height, format, type, data,
+                            true /* hostUnpackBuffer */);
+                    },
+                    compressedSubImage2D);
         }
     }
 }
@@ -3870,7 +3915,9 @@ GL_APICALL void GL_APIENTRY glPopDebugGroupKHR(void) {
     ctx->dispatcher().glPopDebugGroupKHR();
 }
 
-GL_APICALL void  GL_APIENTRY glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* pixels){
+// |hostUnpackBuffer| means that |pixels| is an offset into a buffer that is
+// bound to GL_PIXEL_UNPACK_BUFFER on the host, but not by the guest.
+static void sTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* pixels, bool hostUnpackBuffer){
     GET_CTX_V2();
     SET_ERROR_IF(!(GLESv2Validate::textureTarget(ctx, target) ||
                    GLESv2Validate::textureTargetEx(ctx, target)), GL_INVALID_ENUM);
@@ -3889,7 +3936,8 @@ GL_APICALL void  GL_APIENTRY glTexSubImage2D(GLenum target, GLint level, GLint x
     SET_ERROR_IF(!(GLESv2Validate::pixelFrmt(ctx,format) &&
                    GLESv2Validate::pixelType(ctx,type)),GL_INVALID_ENUM);
     SET_ERROR_IF(!GLESv2Validate::pixelOp(format,type),GL_INVALID_OPERATION);
-    SET_ERROR_IF(!pixels && !ctx->isBindedBuffer(GL_PIXEL_UNPACK_BUFFER),GL_INVALID_OPERATION);
+    SET_ERROR_IF(!pixels && !hostUnpackBuffer &&
+                 !ctx->isBindedBuffer(GL_PIXEL_UNPACK_BUFFER),GL_INVALID_OPERATION);
     if (type==GL_HALF_FLOAT_OES)
         type = GL_HALF_FLOAT_NV;
 
@@ -3902,6 +3950,11 @@ GL_APICALL void  GL_APIENTRY glTexSubImage2D(GLenum target, GLint level, GLint x
     ctx->dispatcher().glTexSubImage2D(target,level,xoffset,yoffset,width,height,format,type,pixels);
 }
 
+GL_APICALL void  GL_APIENTRY glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid* pixels){
+    sTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels,
+                   false /* hostUnpackBuffer */);
+}
+
 static int s_getHostLocOrSetError(GLESv2Context* ctx, GLint location) {
     if (!ctx) return -1;
     ProgramData* pData = ctx->getUseProgram();
@@ -19,8 +19,10 @@
 #include "aemu/base/synchronization/Lock.h"
 #include "aemu/base/containers/Lookup.h"
 #include "aemu/base/files/StreamSerializing.h"
+#include "aemu/base/system/System.h"
 #include "host-common/logging.h"
 
+#include <GLcommon/GpuTextureDecoder.h>
 #include <GLcommon/GLconversion_macros.h>
 #include <GLcommon/GLSnapshotSerializers.h>
 #include <GLcommon/GLESmacros.h>
@@ -587,6 +589,8 @@ GLEScontext::~GLEScontext() {
         gl.glDeleteFramebuffers(1, &m_blitState.fbo);
     }
 
+    m_gpuTextureDecoder.reset();
+
     if (m_textureEmulationProg) {
         gl.glDeleteProgram(m_textureEmulationProg);
         gl.glDeleteTextures(2, m_textureEmulationTextures);
@@ -2630,6 +2634,24 @@ void GLEScontext::initTexImageEmulation() {
     gl.glGenVertexArrays(1, &m_textureEmulationVAO);
 }
 
+GpuTextureDecoder* GLEScontext::getGpuTextureDecoder() {
+    if (!m_gpuTextureDecoderInitialized) {
+        m_gpuTextureDecoderInitialized = true;
+        const std::string mode =
+            android::base::getEnvironmentVariable("ANDROID_EMUGL_GPU_TEXTURE_DECODE");
+        if ((mode == "1" || mode == "bc3") && m_glesMajorVersion >= 3) {
+            m_gpuTextureDecoder = GpuTextureDecoder::create();
+            m_gpuTextureDecoderTranscodesToBc3 =
+                m_gpuTextureDecoder && mode == "bc3" && getCaps()->hasS3tcSupport;
+        }
+    }
+    return m_gpuTextureDecoder.get();
+}
+
+bool GLEScontext::gpuTextureDecoderTranscodesToBc3() {
+    return getGpuTextureDecoder() && m_gpuTextureDecoderTranscodesToBc3;
+}
+
 void GLEScontext::copyTexImageWithEmulation(
         TextureData* texData,
         bool isSubImage,
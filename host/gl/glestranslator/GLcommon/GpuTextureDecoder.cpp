@@ -0,0 +1,628 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "GLcommon/GpuTextureDecoder.h"
+
+#include <GLES3/gl31.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "GLcommon/GLEScontext.h"
+#include "GLcommon/GLutils.h"
+#include "GLcommon/ScopedGLState.h"
+#include "host-common/logging.h"
+#include "vulkan/emulated_textures/shaders/DecompressionShaderSources.h"
+
+namespace {
+
+namespace sources = gfxstream::decompression_shader_sources;
+
+constexpr GLuint kLocalSize = 64;
+constexpr GLuint kMaxWorkGroupCount = 65535;
+constexpr GLsizei kBc3BlockSize = 16;
+
+// Values of u_format, see kEtcFormats.
+constexpr GLuint kShaderFormatRgb8 = 0;
+constexpr GLuint kShaderFormatRgba8 = 1;
+constexpr GLuint kShaderFormatRgb8A1 = 2;
+constexpr GLuint kShaderFormatR11 = 3;
+constexpr GLuint kShaderFormatSignedR11 = 4;
+constexpr GLuint kShaderFormatRg11 = 5;
+constexpr GLuint kShaderFormatSignedRg11 = 6;
+
+// Declarations shared by all the shaders. Each invocation writes whole words of u_output.
+constexpr char kShaderHeader[] = R"(#version 430 core
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 0) readonly buffer Input {
+    uint u_input[];
+};
+layout(std430, binding = 1) writeonly buffer Output {
+    uint u_output[];
+};
+
+uniform uint u_format;
+uniform uvec2 u_blockSize;
+uniform uint u_width;
+uniform uint u_height;
+// Bytes per decoded row, a multiple of 4.
+uniform uint u_stride;
+
+// The dispatch is 2D when there are more work groups than fit in one dimension.
+uint getInvocationIndex() {
+    return gl_GlobalInvocationID.y * gl_NumWorkGroups.x * gl_WorkGroupSize.x +
+           gl_GlobalInvocationID.x;
+}
+)";
+
+constexpr char kEtcFormats[] = R"(
+const uint kFormatRgb8 = 0u;
+const uint kFormatRgba8 = 1u;
+const uint kFormatRgb8A1 = 2u;
+const uint kFormatR11 = 3u;
+const uint kFormatSignedR11 = 4u;
+const uint kFormatRg11 = 5u;
+const uint kFormatSignedRg11 = 6u;
+
+// ETC blocks are stored big endian.
+uint readEtcWord(uint index) {
+    return flip32(u_input[index]);
+}
+
+uint packRgba(ivec4 color) {
+    uvec4 bytes = uvec4(color) & 0xffu;
+    return bytes.r | (bytes.g << 8) | (bytes.b << 16) | (bytes.a << 24);
+}
+)";
+
+// Each invocation decodes one 4x4 block.
+constexpr char kEtcDecodeMain[] = R"(
+void main() {
+    uint blocksPerRow = (u_width + 3u) / 4u;
+    uint block = getInvocationIndex();
+    if (block >= blocksPerRow * ((u_height + 3u) / 4u)) {
+        return;
+    }
+
+    // The texels of the block, in the first |texelSize| bytes.
+    uint texels[16];
+    uint texelSize = 4u;
+    if (u_format == kFormatRgba8) {
+        uint alpha[16] =
+            eac_decode_single_channel_block(readEtcWord(block * 4u), readEtcWord(block * 4u + 1u),
+                                            false);
+        ivec4 rgb[16] = etc2_decode_rgb_block(readEtcWord(block * 4u + 2u),
+                                              readEtcWord(block * 4u + 3u), false);
+        for (uint i = 0u; i < 16u; i++) {
+            texels[i] = packRgba(ivec4(rgb[i].rgb, int(alpha[i])));
+        }
+    } else if (u_format == kFormatRgb8 || u_format == kFormatRgb8A1) {
+        ivec4 rgba[16] = etc2_decode_rgb_block(readEtcWord(block * 2u),
+                                               readEtcWord(block * 2u + 1u),
+                                               u_format == kFormatRgb8A1);
+        for (uint i = 0u; i < 16u; i++) {
+            texels[i] = packRgba(rgba[i]);
+        }
+        if (u_format == kFormatRgb8) {
+            texelSize = 3u;
+        }
+    } else if (u_format == kFormatR11 || u_format == kFormatSignedR11) {
+        float r[16] = eac_decode_single_channel_block_float(
+            readEtcWord(block * 2u), readEtcWord(block * 2u + 1u), u_format == kFormatSignedR11);
+        for (uint i = 0u; i < 16u; i++) {
+            texels[i] = packHalf2x16(vec2(r[i], 0.0));
+        }
+        texelSize = 2u;
+    } else {
+        bool isSigned = u_format == kFormatSignedRg11;
+        float r[16] = eac_decode_single_channel_block_float(
+            readEtcWord(block * 4u), readEtcWord(block * 4u + 1u), isSigned);
+        float g[16] = eac_decode_single_channel_block_float(
+            readEtcWord(block * 4u + 2u), readEtcWord(block * 4u + 3u), isSigned);
+        for (uint i = 0u; i < 16u; i++) {
+            texels[i] = packHalf2x16(vec2(r[i], g[i]));
+        }
+    }
+
+    uint blockX = block % blocksPerRow;
+    uint blockY = block / blocksPerRow;
+    uint width = min(4u, u_width - blockX * 4u);
+    uint height = min(4u, u_height - blockY * 4u);
+    for (uint y = 0u; y < height; y++) {
+        // Rows are packed into whole words. The bytes past the last texel of a row are padding
+        // since the stride is a multiple of 4.
+        uint words[4] = uint[4](0u, 0u, 0u, 0u);
+        for (uint x = 0u; x < width; x++) {
+            for (uint c = 0u; c < texelSize; c++) {
+                uint byteIndex = x * texelSize + c;
+                uint value = (texels[x + 4u * y] >> (c * 8u)) & 0xffu;
+                words[byteIndex >> 2] |= value << ((byteIndex & 3u) * 8u);
+            }
+        }
+        uint rowStart = ((blockY * 4u + y) * u_stride + blockX * 4u * texelSize) / 4u;
+        for (uint w = 0u; w < (width * texelSize + 3u) / 4u; w++) {
+            u_output[rowStart + w] = words[w];
+        }
+    }
+}
+)";
+
+constexpr char kAstcBlocks[] = R"(
+// Returns the ASTC block at |blockPos| in the order astcDecoderInitialize() expects.
+uvec4 readAstcBlock(uvec2 blockPos) {
+    uint blocksPerRow = (u_width + u_blockSize.x - 1u) / u_blockSize.x;
+    uint block = blockPos.y * blocksPerRow + blockPos.x;
+    return uvec4(u_input[block * 4u], u_input[block * 4u + 1u], u_input[block * 4u + 2u],
+                 u_input[block * 4u + 3u]).wzyx;
+}
+)";
+
+// Each invocation decodes one texel, like AstcToRgb.comp.
+constexpr char kAstcDecodeMain[] = R"(
+void main() {
+    uint texel = getInvocationIndex();
+    if (texel >= u_width * u_height) {
+        return;
+    }
+    uvec2 pos = uvec2(texel % u_width, texel / u_width);
+    astcDecoderInitialize(readAstcBlock(pos / u_blockSize), u_blockSize);
+    uvec4 color = astcDecodeTexel(pos % u_blockSize);
+    u_output[pos.y * (u_stride / 4u) + pos.x] =
+        color.r | (color.g << 8) | (color.b << 16) | (color.a << 24);
+}
+)";
+
+// decodeBlockTexels() of the BC3 encoder for ETC2 images.
+constexpr char kEtcBlockTexels[] = R"(
+void decodeBlockTexels(uint block, uvec2 blockPos, out uvec4 texels[16]) {
+    ivec4 rgba[16];
+    if (u_format == kFormatRgba8) {
+        rgba = etc2_decode_rgb_block(readEtcWord(block * 4u + 2u), readEtcWord(block * 4u + 3u),
+                                     false);
+        uint alpha[16] =
+            eac_decode_single_channel_block(readEtcWord(block * 4u), readEtcWord(block * 4u + 1u),
+                                            false);
+        for (uint i = 0u; i < 16u; i++) {
+            rgba[i].a = int(alpha[i]);
+        }
+    } else {
+        rgba = etc2_decode_rgb_block(readEtcWord(block * 2u), readEtcWord(block * 2u + 1u),
+                                     u_format == kFormatRgb8A1);
+    }
+    for (uint i = 0u; i < 16u; i++) {
+        texels[i] = uvec4(rgba[i]);
+    }
+}
+)";
+
+// decodeBlockTexels() of the BC3 encoder for ASTC images. The ASTC block sizes are multiples of 4,
+// so each BC3 block is inside of a single ASTC block.
+constexpr char kAstcBlockTexels[] = R"(
+void decodeBlockTexels(uint block, uvec2 blockPos, out uvec4 texels[16]) {
+    uvec2 pos = blockPos * 4u;
+    astcDecoderInitialize(readAstcBlock(pos / u_blockSize), u_blockSize);
+    for (uint i = 0u; i < 16u; i++) {
+        texels[i] = astcDecodeTexel(pos % u_blockSize + uvec2(i % 4u, i / 4u));
+    }
+}
+)";
+
+// Each invocation encodes one 4x4 block. This is the algorithm of AstcToBc3.comp, with the
+// subgroup operations across the 16 texels of a block replaced by loops, since OpenGL doesn't
+// have them.
+constexpr char kBc3EncodeMain[] = R"(
+void computeBlockEndpoints(uvec4 texels[16], out uvec3 minEndpoint, out uvec3 maxEndpoint) {
+    uvec3 colorSum = uvec3(0u);
+    uvec3 minColor = uvec3(255u);
+    uvec3 maxColor = uvec3(0u);
+    for (uint i = 0u; i < 16u; i++) {
+        colorSum += texels[i].rgb;
+        minColor = min(minColor, texels[i].rgb);
+        maxColor = max(maxColor, texels[i].rgb);
+    }
+    uvec3 avgColor = (colorSum + 8u) >> 4;
+
+    if (minColor == maxColor) {
+        minEndpoint = minColor;
+        maxEndpoint = minColor;
+        return;
+    }
+
+    ivec3 cov1 = ivec3(0);
+    ivec3 cov2 = ivec3(0);
+    for (uint i = 0u; i < 16u; i++) {
+        ivec3 dx = ivec3(texels[i].rgb) - ivec3(avgColor);
+        cov1 += dx.r * dx;
+        cov2 += dx.ggb * dx.gbb;
+    }
+    mat3 covMat = mat3(vec3(cov1), vec3(cov1.y, cov2.xy), vec3(cov1.z, cov2.yz));
+    vec3 principalAxis = covMat * (covMat * (covMat * (covMat * vec3(maxColor - minColor))));
+    float magn = max(max(abs(principalAxis.r), abs(principalAxis.g)), abs(principalAxis.b));
+    principalAxis = (magn < 4.0) ? vec3(0.299, 0.587, 0.114) : principalAxis / magn;
+
+    // Ties go to the last texel, like the subgroupClusteredMax() of AstcToBc3.comp.
+    float minDistance = dot(vec3(texels[0].rgb), principalAxis);
+    float maxDistance = minDistance;
+    uint minIndex = 0u;
+    uint maxIndex = 0u;
+    for (uint i = 1u; i < 16u; i++) {
+        float distance = dot(vec3(texels[i].rgb), principalAxis);
+        if (distance <= minDistance) {
+            minDistance = distance;
+            minIndex = i;
+        }
+        if (distance >= maxDistance) {
+            maxDistance = distance;
+            maxIndex = i;
+        }
+    }
+    minEndpoint = texels[minIndex].rgb;
+    maxEndpoint = texels[maxIndex].rgb;
+}
+
+uvec2 encodeBlockAlpha(uvec4 texels[16]) {
+    uint minValue = 255u;
+    uint maxValue = 0u;
+    for (uint i = 0u; i < 16u; i++) {
+        minValue = min(minValue, texels[i].a);
+        maxValue = max(maxValue, texels[i].a);
+    }
+
+    // The 3-bit indices start at bit 16 of the 64 bit alpha block.
+    uvec2 indexBits = uvec2(0u);
+    for (uint texelId = 0u; texelId < 16u; texelId++) {
+        uint index = 0u;
+        if (minValue != maxValue) {
+            index = getAlphaIndex(texels[texelId].a, minValue, maxValue);
+        }
+        if (texelId >= 5u) {
+            indexBits.y |= (index << 29) >> (45u - 3u * texelId);
+        }
+        if (texelId <= 5u) {
+            indexBits.x |= index << (3u * texelId + 16u);
+        }
+    }
+    return uvec2((maxValue & 0xffu) | ((minValue & 0xffu) << 8) | indexBits.x, indexBits.y);
+}
+
+void main() {
+    uint blocksPerRow = (u_width + 3u) / 4u;
+    uint block = getInvocationIndex();
+    if (block >= blocksPerRow * ((u_height + 3u) / 4u)) {
+        return;
+    }
+
+    uvec4 texels[16];
+    decodeBlockTexels(block, uvec2(block % blocksPerRow, block / blocksPerRow), texels);
+
+    uvec3 minEndpoint, maxEndpoint;
+    computeBlockEndpoints(texels, minEndpoint, maxEndpoint);
+    uvec2 endpoints = uvec2(packColorToRGB565(minEndpoint), packColorToRGB565(maxEndpoint));
+    bool swapEndpoints = endpoints.x > endpoints.y;
+
+    uint colorIndices = 0u;
+    for (uint i = 0u; i < 16u; i++) {
+        uint index = 0u;
+        if (endpoints.x != endpoints.y) {
+            index = getColorIndex(vec3(texels[i].rgb), vec3(minEndpoint), vec3(maxEndpoint));
+        }
+        if (swapEndpoints) {
+            index ^= 1u;
+        }
+        colorIndices |= index << (2u * i);
+    }
+    if (swapEndpoints) {
+        endpoints = endpoints.yx;
+    }
+
+    uvec2 alpha = encodeBlockAlpha(texels);
+    u_output[block * 4u] = alpha.x;
+    u_output[block * 4u + 1u] = alpha.y;
+    u_output[block * 4u + 2u] = endpoints.y | (endpoints.x << 16);
+    u_output[block * 4u + 3u] = colorIndices;
+}
+)";
+
+GLuint getShaderFormat(ETC2ImageFormat format) {
+    switch (format) {
+        case EtcRGBA8:
+            return kShaderFormatRgba8;
+        case EtcRGB8A1:
+            return kShaderFormatRgb8A1;
+        case EtcR11:
+            return kShaderFormatR11;
+        case EtcSignedR11:
+            return kShaderFormatSignedR11;
+        case EtcRG11:
+            return kShaderFormatRg11;
+        case EtcSignedRG11:
+            return kShaderFormatSignedRg11;
+        default:
+            return kShaderFormatRgb8;
+    }
+}
+
+GLuint getBlockCount(GLsizei width, GLsizei height) {
+    return ((width + 3) / 4) * ((height + 3) / 4);
+}
+
+struct IndexedBufferBinding {
+    GLint buffer = 0;
+    GLint64 start = 0;
+    GLint64 size = 0;
+};
+
+IndexedBufferBinding getShaderStorageBinding(GLuint index) {
+    auto& gl = GLEScontext::dispatcher();
+    IndexedBufferBinding binding;
+    gl.glGetIntegeri_v(GL_SHADER_STORAGE_BUFFER_BINDING, index, &binding.buffer);
+    gl.glGetInteger64i_v(GL_SHADER_STORAGE_BUFFER_START, index, &binding.start);
+    gl.glGetInteger64i_v(GL_SHADER_STORAGE_BUFFER_SIZE, index, &binding.size);
+    return binding;
+}
+
+void restoreShaderStorageBinding(GLuint index, const IndexedBufferBinding& binding) {
+    auto& gl = GLEScontext::dispatcher();
+    if (binding.buffer && binding.size) {
+        gl.glBindBufferRange(GL_SHADER_STORAGE_BUFFER, index, binding.buffer, binding.start,
+                             binding.size);
+    } else {
+        gl.glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, binding.buffer);
+    }
+}
+
+}  // namespace
+
+// static
+std::unique_ptr<GpuTextureDecoder> GpuTextureDecoder::create() {
+    // The shader libraries use GLSL 4.20 features that OpenGL ES doesn't have.
+    if (isGles2Gles()) {
+        return nullptr;
+    }
+    auto& gl = GLEScontext::dispatcher();
+    if (!gl.glDispatchCompute || !gl.glMemoryBarrier || !gl.glGetInteger64i_v) {
+        return nullptr;
+    }
+
+    std::unique_ptr<GpuTextureDecoder> decoder(new GpuTextureDecoder());
+    gl.glGenBuffers(1, &decoder->m_inputBuffer);
+    gl.glGenBuffers(1, &decoder->m_outputBuffer);
+    return decoder;
+}
+
+GpuTextureDecoder::GpuTextureDecoder() = default;
+
+// static
+std::string GpuTextureDecoder::getShaderSource(Shader shader) {
+    std::string src = kShaderHeader;
+    switch (shader) {
+        case Shader::EtcDecode:
+            src += sources::Etc2ShaderLib;
+            src += kEtcFormats;
+            src += kEtcDecodeMain;
+            break;
+        case Shader::AstcDecode:
+            src += sources::AstcLookupTables;
+            src += sources::AstcDecompressor;
+            src += kAstcBlocks;
+            src += kAstcDecodeMain;
+            break;
+        case Shader::EtcToBc3:
+            src += sources::Etc2ShaderLib;
+            src += kEtcFormats;
+            src += kEtcBlockTexels;
+            src += sources::Bc3Encoder;
+            src += kBc3EncodeMain;
+            break;
+        case Shader::AstcToBc3:
+            src += sources::AstcLookupTables;
+            src += sources::AstcDecompressor;
+            src += kAstcBlocks;
+            src += kAstcBlockTexels;
+            src += sources::Bc3Encoder;
+            src += kBc3EncodeMain;
+            break;
+        case Shader::Count:
+            break;
+    }
+    return src;
+}
+
+// static
+const char* GpuTextureDecoder::getShaderName(Shader shader) {
+    switch (shader) {
+        case Shader::EtcDecode:
+            return "ETC decode";
+        case Shader::AstcDecode:
+            return "ASTC decode";
+        case Shader::EtcToBc3:
+            return "ETC to BC3";
+        case Shader::AstcToBc3:
+            return "ASTC to BC3";
+        case Shader::Count:
+            break;
+    }
+    return "unknown";
+}
+
+GpuTextureDecoder::~GpuTextureDecoder() {
+    auto& gl = GLEScontext::dispatcher();
+    gl.glDeleteBuffers(1, &m_inputBuffer);
+    gl.glDeleteBuffers(1, &m_outputBuffer);
+    for (const Program& program : m_programs) {
+        if (program.program) {
+            gl.glDeleteProgram(program.program);
+        }
+    }
+}
+
+const GpuTextureDecoder::Program* GpuTextureDecoder::getProgram(Shader shader) {
+    Program& program = m_programs[static_cast<size_t>(shader)];
+    if (program.initialized) {
+        return program.program ? &program : nullptr;
+    }
+    program.initialized = true;
+
+    auto& gl = GLEScontext::dispatcher();
+    const std::string src = getShaderSource(shader);
+    const GLuint shaderObject =
+        GLEScontext::compileAndValidateCoreShader(GL_COMPUTE_SHADER, src.c_str());
+    const GLuint programObject = gl.glCreateProgram();
+    gl.glAttachShader(programObject, shaderObject);
+    gl.glLinkProgram(programObject);
+    gl.glDeleteShader(shaderObject);
+
+    GLint linkStatus = GL_FALSE;
+    gl.glGetProgramiv(programObject, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE) {
+        GLint infoLogLength = 0;
+        gl.glGetProgramiv(programObject, GL_INFO_LOG_LENGTH, &infoLogLength);
+        std::vector<char> infoLog(infoLogLength + 1, 0);
+        gl.glGetProgramInfoLog(programObject, infoLogLength, nullptr, infoLog.data());
+        ERR("Failed to link the %s shader, decoding on the CPU: %s", getShaderName(shader),
+            infoLog.data());
+        gl.glDeleteProgram(programObject);
+        return nullptr;
+    }
+
+    program.program = programObject;
+    program.formatLoc = gl.glGetUniformLocation(programObject, "u_format");
+    program.blockSizeLoc = gl.glGetUniformLocation(programObject, "u_blockSize");
+    program.widthLoc = gl.glGetUniformLocation(programObject, "u_width");
+    program.heightLoc = gl.glGetUniformLocation(programObject, "u_height");
+    program.strideLoc = gl.glGetUniformLocation(programObject, "u_stride");
+    return &program;
+}
+
+// static
+bool GpuTextureDecoder::canTranscodeEtcToBc3(ETC2ImageFormat format) {
+    switch (format) {
+        case EtcRGB8:
+        case EtcRGBA8:
+        case EtcRGB8A1:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// static
+bool GpuTextureDecoder::canTranscodeAstcToBc3(uint32_t blockWidth, uint32_t blockHeight) {
+    return blockWidth % 4 == 0 && blockHeight % 4 == 0;
+}
+
+// static
+GLsizei GpuTextureDecoder::getBc3ImageSize(GLsizei width, GLsizei height) {
+    return getBlockCount(width, height) * kBc3BlockSize;
+}
+
+bool GpuTextureDecoder::decodeEtc(const Image& image, ETC2ImageFormat format, GLsizei stride,
+                                  const UploadCallback& upload) {
+    Params params;
+    params.format = getShaderFormat(format);
+    params.invocationCount = getBlockCount(image.width, image.height);
+    params.stride = stride;
+    params.outputSize = static_cast<size_t>(stride) * image.height;
+    return run(Shader::EtcDecode, image, params, upload);
+}
+
+bool GpuTextureDecoder::decodeAstc(const Image& image, uint32_t blockWidth, uint32_t blockHeight,
+                                   GLsizei stride, const UploadCallback& upload) {
+    Params params;
+    params.blockWidth = blockWidth;
+    params.blockHeight = blockHeight;
+    params.invocationCount = image.width * image.height;
+    params.stride = stride;
+    params.outputSize = static_cast<size_t>(stride) * image.height;
+    return run(Shader::AstcDecode, image, params, upload);
+}
+
+bool GpuTextureDecoder::transcodeEtcToBc3(const Image& image, ETC2ImageFormat format,
+                                          const UploadCallback& upload) {
+    if (!canTranscodeEtcToBc3(format)) {
+        return false;
+    }
+    Params params;
+    params.format = getShaderFormat(format);
+    params.invocationCount = getBlockCount(image.width, image.height);
+    params.outputSize = getBc3ImageSize(image.width, image.height);
+    return run(Shader::EtcToBc3, image, params, upload);
+}
+
+bool GpuTextureDecoder::transcodeAstcToBc3(const Image& image, uint32_t blockWidth,
+                                           uint32_t blockHeight, const UploadCallback& upload) {
+    if (!canTranscodeAstcToBc3(blockWidth, blockHeight)) {
+        return false;
+    }
+    Params params;
+    params.blockWidth = blockWidth;
+    params.blockHeight = blockHeight;
+    params.invocationCount = getBlockCount(image.width, image.height);
+    params.outputSize = getBc3ImageSize(image.width, image.height);
+    return run(Shader::AstcToBc3, image, params, upload);
+}
+
+bool GpuTextureDecoder::run(Shader shader, const Image& image, const Params& params,
+                            const UploadCallback& upload) {
+    if (image.width <= 0 || image.height <= 0 || params.stride % 4 != 0) {
+        return false;
+    }
+    const GLuint workGroupCount = (params.invocationCount + kLocalSize - 1) / kLocalSize;
+    const GLuint workGroupCountX = std::min(workGroupCount, kMaxWorkGroupCount);
+    const GLuint workGroupCountY = (workGroupCount + workGroupCountX - 1) / workGroupCountX;
+    if (workGroupCountY > kMaxWorkGroupCount) {
+        return false;
+    }
+    const Program* program = getProgram(shader);
+    if (!program) {
+        return false;
+    }
+
+    auto& gl = GLEScontext::dispatcher();
+
+    ScopedGLState state;
+    state.push({GL_CURRENT_PROGRAM, GL_SHADER_STORAGE_BUFFER_BINDING,
+                GL_PIXEL_UNPACK_BUFFER_BINDING});
+    const IndexedBufferBinding prevInputBinding = getShaderStorageBinding(0);
+    const IndexedBufferBinding prevOutputBinding = getShaderStorageBinding(1);
+
+    gl.glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_inputBuffer);
+    gl.glBufferData(GL_SHADER_STORAGE_BUFFER, image.dataSize, image.data, GL_STREAM_DRAW);
+
+    gl.glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_outputBuffer);
+    if (params.outputSize > m_outputBufferSize) {
+        gl.glBufferData(GL_SHADER_STORAGE_BUFFER, params.outputSize, nullptr, GL_STREAM_COPY);
+        m_outputBufferSize = params.outputSize;
+    }
+
+    gl.glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_inputBuffer);
+    gl.glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_outputBuffer);
+    gl.glUseProgram(program->program);
+    gl.glUniform1ui(program->formatLoc, params.format);
+    gl.glUniform2ui(program->blockSizeLoc, params.blockWidth, params.blockHeight);
+    gl.glUniform1ui(program->widthLoc, image.width);
+    gl.glUniform1ui(program->heightLoc, image.height);
+    gl.glUniform1ui(program->strideLoc, params.stride);
+    gl.glDispatchCompute(workGroupCountX, workGroupCountY, 1);
+    gl.glMemoryBarrier(GL_PIXEL_BUFFER_BARRIER_BIT);
+
+    restoreShaderStorageBinding(0, prevInputBinding);
+    restoreShaderStorageBinding(1, prevOutputBinding);
+
+    gl.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_outputBuffer);
+    upload();
+    return true;
+}
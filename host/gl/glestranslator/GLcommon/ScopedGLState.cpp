@@ -35,6 +35,8 @@ void ScopedGLState::push(GLenum name) {
     case GL_CURRENT_PROGRAM:
     case GL_VERTEX_ARRAY_BINDING:
     case GL_ARRAY_BUFFER_BINDING:
+    case GL_PIXEL_UNPACK_BUFFER_BINDING:
+    case GL_SHADER_STORAGE_BUFFER_BINDING:
     case GL_TEXTURE_BINDING_2D:
     case GL_TEXTURE_BINDING_CUBE_MAP:
     case GL_VIEWPORT:
@@ -114,6 +116,12 @@ ScopedGLState::~ScopedGLState() {
             case GL_ARRAY_BUFFER_BINDING:
                 gl.glBindBuffer(GL_ARRAY_BUFFER, v.intData[0]);
                 break;
+            case GL_PIXEL_UNPACK_BUFFER_BINDING:
+                gl.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, v.intData[0]);
+                break;
+            case GL_SHADER_STORAGE_BUFFER_BINDING:
+                gl.glBindBuffer(GL_SHADER_STORAGE_BUFFER, v.intData[0]);
+                break;
             case GL_TEXTURE_BINDING_2D:
                 gl.glBindTexture(GL_TEXTURE_2D, v.intData[0]);
                 break;
@@ -14,14 +14,20 @@
 * limitations under the License.
 */
 #include <GLcommon/TextureUtils.h>
+#include <GLcommon/GpuTextureDecoder.h>
 #include <GLcommon/GLESmacros.h>
 #include <GLcommon/GLDispatch.h>
 #include <GLcommon/GLESvalidate.h>
 #include <stdio.h>
+#include <algorithm>
 #include <cmath>
+#include <future>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include "aemu/base/AlignedBuf.h"
+#include "aemu/base/threads/ThreadPool.h"
 #include "compressedTextureFormats/AstcCpuDecompressor.h"
 
 using android::AlignedBuf;
@@ -295,10 +301,10 @@ GLenum decompressedInternalFormat(GLEScontext* ctx, GLenum compressedFormat) {
             return GL_SRGB8_ALPHA8;
         case GL_COMPRESSED_R11_EAC:
         case GL_COMPRESSED_SIGNED_R11_EAC:
-            return GL_R32F;
+            return GL_R16F;
         case GL_COMPRESSED_RG11_EAC:
         case GL_COMPRESSED_SIGNED_RG11_EAC:
-            return GL_RG32F;
+            return GL_RG16F;
         case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
             return GL_SRGB8_ALPHA8;
         // ASTC formats
@@ -358,6 +364,79 @@ GLenum decompressedInternalFormat(GLEScontext* ctx, GLenum compressedFormat) {
     }
 }
 
+namespace {
+
+// Images smaller than this are decoded on the calling thread, handing them to
+// the pool would cost more than it saves.
+constexpr size_t kMinParallelEtcDecodePixels = 256 * 256;
+
+// Decoded images up to this size, 1024x1024 RGBA8, are decoded into memory kept
+// by the render thread until it exits, larger ones into a temporary allocation.
+constexpr size_t kMaxRetainedEtcScratchBytes = 4 * 1024 * 1024;
+
+using EtcDecodeTask = std::packaged_task<int()>;
+using EtcDecodeThreadPool = android::base::ThreadPool<EtcDecodeTask>;
+
+uint32_t etcDecodeThreadCount() {
+    static const uint32_t sCount = std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+    return sCount;
+}
+
+// Decodes parts of ETC2 images for all render threads.
+EtcDecodeThreadPool& getEtcDecodeThreadPool() {
+    static EtcDecodeThreadPool* sPool = [] {
+        auto pool = new EtcDecodeThreadPool(
+                etcDecodeThreadCount(),
+                [](EtcDecodeTask&& task, android::base::ThreadPoolWorkerId) { task(); });
+        pool->start();
+        return pool;
+    }();
+    return *sPool;
+}
+
+etc1_byte* getEtcDecodeScratch(size_t size) {
+    thread_local std::unique_ptr<etc1_byte[]> tScratch;
+    thread_local size_t tScratchSize = 0;
+    if (tScratchSize < size) {
+        tScratch.reset(new etc1_byte[size]);
+        tScratchSize = size;
+    }
+    return tScratch.get();
+}
+
+// Splits the image into ranges of block rows, which are decoded on the pool
+// and on the calling thread.
+int decodeEtcImage(const etc1_byte* data, ETC2ImageFormat format,
+                   etc1_byte* out, GLsizei width, GLsizei height, int32_t bpr) {
+    const etc1_uint32 blockRows = (height + 3) / 4;
+    uint32_t taskCount = 1;
+    if (static_cast<size_t>(width) * height >= kMinParallelEtcDecodePixels) {
+        taskCount = std::min(etcDecodeThreadCount() + 1, blockRows);
+    }
+    const etc1_uint32 blockRowsPerTask = (blockRows + taskCount - 1) / taskCount;
+
+    std::vector<std::future<int>> pending;
+    for (etc1_uint32 row = blockRowsPerTask; row < blockRows; row += blockRowsPerTask) {
+        const etc1_uint32 count = std::min(blockRowsPerTask, blockRows - row);
+        EtcDecodeTask task([=]() {
+            return etc2_decode_image_block_rows(data, format, true, out, width, height, bpr,
+                                                row, count);
+        });
+        pending.push_back(task.get_future());
+        getEtcDecodeThreadPool().enqueue(std::move(task));
+    }
+    int res = etc2_decode_image_block_rows(data, format, true, out, width, height, bpr, 0,
+                                           std::min(blockRowsPerTask, blockRows));
+    for (auto& future : pending) {
+        if (int taskRes = future.get()) {
+            res = taskRes;
+        }
+    }
+    return res;
+}
+
+}  // namespace
+
 class ScopedFetchUnpackData {
     public:
         ScopedFetchUnpackData(GLEScontext* ctx, GLintptr offset,
@@ -388,11 +467,18 @@ class ScopedFetchUnpackData {
         GLint mUnpackBuffer = 0;
 };
 
+// The BC3 format that ETC2 and ASTC images are transcoded to on the GPU.
+static GLenum getBc3Format(bool srgb) {
+    return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
 void doCompressedTexImage2D(GLEScontext* ctx, GLenum target, GLint level,
                             GLenum internalformat, GLsizei width,
                             GLsizei height, GLint border,
                             GLsizei imageSize, const GLvoid* data,
-                            glTexImage2D_t glTexImage2DPtr) {
+                            glTexImage2D_t glTexImage2DPtr,
+                            glTexImage2D_t glTexImage2DFromUnpackBufferPtr,
+                            glCompressedTexImage2D_t glCompressedTexImage2DFromUnpackBufferPtr) {
     /* XXX: This is just a hack to fix the resolve of glTexImage2D problem
        It will be removed when we'll no longer link against ligGL */
     /*typedef void (GLAPIENTRY *glTexImage2DPtr_t ) (
@@ -411,11 +497,19 @@ void doCompressedTexImage2D(GLEScontext* ctx, GLenum target, GLint level,
     }
     TextureUnpackReset unpack(ctx);
     const int32_t unpackAlignment = TextureUnpackReset::kUnpackAlignment;
+    GpuTextureDecoder* gpuDecoder =
+        glTexImage2DFromUnpackBufferPtr &&
+                (isEtcFormat(internalformat) || isAstcFormat(internalformat))
+            ? ctx->getGpuTextureDecoder()
+            : nullptr;
+    const bool transcodeToBc3 = gpuDecoder && glCompressedTexImage2DFromUnpackBufferPtr &&
+                                ctx->gpuTextureDecoderTranscodesToBc3();
     if (isEtcFormat(internalformat)) {
         GLint format = GL_RGB;
         GLint type = GL_UNSIGNED_BYTE;
         GLint convertedInternalFormat = decompressedInternalFormat(ctx, internalformat);
         ETC2ImageFormat etcFormat = EtcRGB8;
+        bool srgb = false;
         switch (internalformat) {
             case GL_COMPRESSED_RGB8_ETC2:
             case GL_ETC1_RGB8_OES:
@@ -425,30 +519,32 @@ void doCompressedTexImage2D(GLEScontext* ctx, GLenum target, GLint level,
                 format = GL_RGBA;
                 break;
             case GL_COMPRESSED_SRGB8_ETC2:
+                srgb = true;
                 break;
             case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
                 etcFormat = EtcRGBA8;
                 format = GL_RGBA;
+                srgb = true;
                 break;
             case GL_COMPRESSED_R11_EAC:
                 etcFormat = EtcR11;
                 format = GL_RED;
-                type = GL_FLOAT;
+                type = GL_HALF_FLOAT;
                 break;
             case GL_COMPRESSED_SIGNED_R11_EAC:
                 etcFormat = EtcSignedR11;
                 format = GL_RED;
-                type = GL_FLOAT;
+                type = GL_HALF_FLOAT;
                 break;
             case GL_COMPRESSED_RG11_EAC:
                 etcFormat = EtcRG11;
                 format = GL_RG;
-                type = GL_FLOAT;
+                type = GL_HALF_FLOAT;
                 break;
             case GL_COMPRESSED_SIGNED_RG11_EAC:
                 etcFormat = EtcSignedRG11;
                 format = GL_RG;
-                type = GL_FLOAT;
+                type = GL_HALF_FLOAT;
                 break;
             case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
                 etcFormat = EtcRGB8A1;
@@ -457,9 +553,10 @@ void doCompressedTexImage2D(GLEScontext* ctx, GLenum target, GLint level,
             case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
                 etcFormat = EtcRGB8A1;
                 format = GL_RGBA;
+                srgb = true;
                 break;
         }
-        int pixelSize = etc_get_decoded_pixel_size(etcFormat);
+        int pixelSize = etc_get_decoded_pixel_size_half_float_eac(etcFormat);
         GLsizei compressedSize =
             etc_get_encoded_data_size(etcFormat, width, height);
         SET_ERROR_IF((compressedSize != imageSize), GL_INVALID_VALUE);
@@ -479,17 +576,40 @@ void doCompressedTexImage2D(GLEScontext* ctx, GLenum target, GLint level,
 
         const int32_t align = unpackAlignment - 1;
         const int32_t bpr = ((width * pixelSize) + align) & ~align;
+
+        const GpuTextureDecoder::Image image = {data, static_cast<size_t>(compressedSize),
+                                                width, height};
+        if (transcodeToBc3 &&
+            gpuDecoder->transcodeEtcToBc3(image, etcFormat, [&]() {
+                glCompressedTexImage2DFromUnpackBufferPtr(
+                    target, level, getBc3Format(srgb), width, height, border,
+                    GpuTextureDecoder::getBc3ImageSize(width, height), nullptr);
+            })) {
+            return;
+        }
+        if (gpuDecoder && gpuDecoder->decodeEtc(image, etcFormat, bpr, [&]() {
+                glTexImage2DFromUnpackBufferPtr(target, level, convertedInternalFormat, width,
+                                                height, border, format, type, nullptr);
+            })) {
+            return;
+        }
+
         const size_t size = bpr * height;
-        std::unique_ptr<etc1_byte[]> pOut(new etc1_byte[size]);
+        std::unique_ptr<etc1_byte[]> oversizedOut;
+        etc1_byte* pOut = nullptr;
+        if (size > kMaxRetainedEtcScratchBytes) {
+            oversizedOut.reset(new etc1_byte[size]);
+            pOut = oversizedOut.get();
+        } else {
+            pOut = getEtcDecodeScratch(size);
+        }
 
-        int res =
-            etc2_decode_image(
-                    (const etc1_byte*)data, etcFormat, pOut.get(),
-                    width, height, bpr);
+        int res = decodeEtcImage((const etc1_byte*)data, etcFormat, pOut,
+                                 width, height, bpr);
         SET_ERROR_IF(res!=0, GL_INVALID_VALUE);
 
         glTexImage2DPtr(target, level, convertedInternalFormat,
-                        width, height, border, format, type, pOut.get());
+                        width, height, border, format, type, pOut);
     } else if (isAstcFormat(internalformat)) {
         std::unique_ptr<ScopedFetchUnpackData> unpackData;
         std::unique_ptr<char[]> emulatedData;
@@ -513,6 +633,30 @@ void doCompressedTexImage2D(GLEScontext* ctx, GLenum target, GLint level,
         const int32_t stride = ((width * 4) + align) & ~align;
         const size_t size = stride * height;
 
+        // Images of the wrong size are left to astcDecompress() to reject.
+        const GLsizei blockCount = ((width + blockWidth - 1) / blockWidth) *
+                                   ((height + blockHeight - 1) / blockHeight);
+        if (gpuDecoder && imageSize == blockCount * 16) {
+            const GpuTextureDecoder::Image image = {data, static_cast<size_t>(imageSize),
+                                                    width, height};
+            if (transcodeToBc3 &&
+                gpuDecoder->transcodeAstcToBc3(image, blockWidth, blockHeight, [&]() {
+                    glCompressedTexImage2DFromUnpackBufferPtr(
+                        target, level, getBc3Format(srgb), width, height, border,
+                        GpuTextureDecoder::getBc3ImageSize(width, height), nullptr);
+                })) {
+                return;
+            }
+            if (gpuDecoder->decodeAstc(image, blockWidth, blockHeight, stride, [&]() {
+                    glTexImage2DFromUnpackBufferPtr(target, level,
+                                                    srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, width,
+                                                    height, border, GL_RGBA, GL_UNSIGNED_BYTE,
+                                                    nullptr);
+                })) {
+                return;
+            }
+        }
+
         AlignedBuf<uint8_t, 64> alignedUncompressedData(size);
 
         const bool result = astcDecompress(
@@ -224,6 +224,7 @@ struct VAOStateRef {
     VAOStateMap::iterator it;
 };
 
+class GpuTextureDecoder;
 class FramebufferData;
 
 class GLESConversionArrays
@@ -459,6 +460,13 @@ public:
     ObjectLocalName getFBOLocalName(unsigned int p_globalName) const;
     int queryCurrFboBits(ObjectLocalName localFboName, GLenum pname);
 
+    // Returns the decoder for ETC2 and ASTC images on the host GPU, or nullptr to decode them on
+    // the CPU. Enabled with ANDROID_EMUGL_GPU_TEXTURE_DECODE=1 on OpenGL 4.3 hosts. With
+    // ANDROID_EMUGL_GPU_TEXTURE_DECODE=bc3, color images are transcoded to BC3 instead when the
+    // host supports GL_EXT_texture_compression_s3tc, see gpuTextureDecoderTranscodesToBc3().
+    GpuTextureDecoder* getGpuTextureDecoder();
+    bool gpuTextureDecoderTranscodesToBc3();
+
     // Texture emulation
     void copyTexImageWithEmulation(
         TextureData* texData,
@@ -667,6 +675,10 @@ protected:
     GLuint m_textureEmulationVBO = 0;
     GLuint m_textureEmulationSamplerLoc = 0;
 
+    std::unique_ptr<GpuTextureDecoder> m_gpuTextureDecoder;
+    bool m_gpuTextureDecoderInitialized = false;
+    bool m_gpuTextureDecoderTranscodesToBc3 = false;
+
     std::function<GLESbuffer*(GLuint)> getBufferObj
             = [this] (GLuint bufferName) -> GLESbuffer* {
                 return (GLESbuffer*)m_shareGroup->getObjectData(
@@ -0,0 +1,119 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <GLES3/gl31.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "aemu/base/Compiler.h"
+#include "gfxstream/etc.h"
+
+// Decodes ETC2, EAC and ASTC images with compute shaders, for hosts without native support for
+// them. ETC2 and ASTC color images can also be transcoded to BC3 instead, so that they stay
+// compressed on hosts with GL_EXT_texture_compression_s3tc.
+//
+// The shaders are built from the libraries of the Vulkan decompression shaders, see
+// vulkan/emulated_textures/shaders/DecompressionShaderSources.h.
+//
+// The output is written to a buffer, which is then bound as the host's pixel unpack buffer, behind
+// the back of the translator's own unpack buffer state. The upload callback has to be one that
+// sends its data straight to the host, see doCompressedTexImage2D(), so that the pixels never go
+// through system memory.
+//
+// Needs OpenGL 4.3 on the host. Must be used with the context that created it current.
+class GpuTextureDecoder {
+public:
+    // Returns nullptr if the host can't run the decode shaders.
+    static std::unique_ptr<GpuTextureDecoder> create();
+    ~GpuTextureDecoder();
+
+    // An image of |width| x |height| pixels, compressed into the |dataSize| bytes of |data|.
+    struct Image {
+        const void* data;
+        size_t dataSize;
+        GLsizei width;
+        GLsizei height;
+    };
+
+    // Called with the output bound as the host's pixel unpack buffer, starting at offset 0.
+    using UploadCallback = std::function<void()>;
+
+    // Decodes |image| into rows of |stride| bytes, which must be a multiple of 4, and calls
+    // |upload|. ETC images have the layout of etc2_decode_image_block_rows() with half float EAC
+    // channels, ASTC images are decoded to RGBA8. All GL state that is used is restored before
+    // returning. Returns false, without calling |upload|, if the image could not be decoded.
+    bool decodeEtc(const Image& image, ETC2ImageFormat format, GLsizei stride,
+                   const UploadCallback& upload);
+    bool decodeAstc(const Image& image, uint32_t blockWidth, uint32_t blockHeight,
+                    GLsizei stride, const UploadCallback& upload);
+
+    // EAC images have no color to transcode. ASTC blocks must be made of whole BC3 blocks, so
+    // that sub-images start at the start of a BC3 block.
+    static bool canTranscodeEtcToBc3(ETC2ImageFormat format);
+    static bool canTranscodeAstcToBc3(uint32_t blockWidth, uint32_t blockHeight);
+    static GLsizei getBc3ImageSize(GLsizei width, GLsizei height);
+
+    // Same as above, but transcodes |image| to getBc3ImageSize() bytes of BC3 blocks.
+    bool transcodeEtcToBc3(const Image& image, ETC2ImageFormat format,
+                           const UploadCallback& upload);
+    bool transcodeAstcToBc3(const Image& image, uint32_t blockWidth, uint32_t blockHeight,
+                            const UploadCallback& upload);
+
+private:
+    enum class Shader { EtcDecode, AstcDecode, EtcToBc3, AstcToBc3, Count };
+
+    struct Program {
+        bool initialized = false;
+        GLuint program = 0;
+        GLint formatLoc = -1;
+        GLint blockSizeLoc = -1;
+        GLint widthLoc = -1;
+        GLint heightLoc = -1;
+        GLint strideLoc = -1;
+    };
+
+    // What a shader runs on. |format| is only used by the ETC shaders and |blockWidth| and
+    // |blockHeight| by the ASTC ones.
+    struct Params {
+        GLuint format = 0;
+        uint32_t blockWidth = 0;
+        uint32_t blockHeight = 0;
+        GLuint invocationCount = 0;
+        GLsizei stride = 0;
+        size_t outputSize = 0;
+    };
+
+    GpuTextureDecoder();
+
+    static std::string getShaderSource(Shader shader);
+    static const char* getShaderName(Shader shader);
+
+    // Builds the program of |shader| on first use. Returns nullptr if it doesn't build.
+    const Program* getProgram(Shader shader);
+    bool run(Shader shader, const Image& image, const Params& params,
+             const UploadCallback& upload);
+
+    Program m_programs[static_cast<size_t>(Shader::Count)];
+
+    GLuint m_inputBuffer = 0;
+    GLuint m_outputBuffer = 0;
+    size_t m_outputBufferSize = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(GpuTextureDecoder);
+};
@@ -30,6 +30,11 @@ typedef std::function<void(GLenum target, GLint level,
     GLint border, GLenum format, GLenum type, const GLvoid * data)>
         glTexImage2D_t;
 
+typedef std::function<void(GLenum target, GLint level,
+    GLenum internalformat, GLsizei width, GLsizei height,
+    GLint border, GLsizei imageSize, const GLvoid * data)>
+        glCompressedTexImage2D_t;
+
 ETC2ImageFormat getEtcFormat(GLenum internalformat);
 void getAstcFormats(const GLint** formats, size_t* formatsCount);
 bool isAstcFormat(GLenum internalformat);
@@ -40,10 +45,18 @@ bool isS3tcFormat(GLenum internalformat);
 bool isPaletteFormat(GLenum internalformat);
 bool isRgtcFormat(GLenum internalformat);
 int getCompressedFormats(int majorVersion, int* formats);
+// |glTexImage2DFromUnpackBufferPtr|, if set, must pass |data| to the host as
+// is, without looking at the guest's unpack buffer. It is then used to upload
+// images decoded on the GPU from the host's unpack buffer, with |data| being
+// the offset into it.
+// |glCompressedTexImage2DFromUnpackBufferPtr| is the same for images
+// transcoded to BC3 on the GPU, see GLEScontext::getGpuTextureDecoder().
 void doCompressedTexImage2D(GLEScontext* ctx, GLenum target, GLint level,
                             GLenum internalformat, GLsizei width,
                             GLsizei height, GLint border, GLsizei imageSize,
-                            const GLvoid* data, glTexImage2D_t glTexImage2DPtr);
+                            const GLvoid* data, glTexImage2D_t glTexImage2DPtr,
+                            glTexImage2D_t glTexImage2DFromUnpackBufferPtr = nullptr,
+                            glCompressedTexImage2D_t glCompressedTexImage2DFromUnpackBufferPtr = nullptr);
 void deleteRenderbufferGlobal(GLuint rbo);
 GLenum decompressedInternalFormat(GLEScontext* ctx, GLenum compressedFormat);
 
@@ -1014,6 +1014,137 @@ TEST_F(CompositorVkTest, MultipleLayers) {
                               kDefaultSaveImageIfComparisonFailed);
 }
 
+TEST_F(CompositorVkTest, OnlyRedrawsChanges) {
+    auto compositor = createCompositor();
+    ASSERT_NE(compositor, nullptr);
+
+    auto target = TargetImage::create(*k_vk, m_vkDevice, m_vkPhysicalDevice, m_compositorVkQueue,
+                                      m_vkCommandPool, 256, 256);
+    ASSERT_NE(target, nullptr);
+    fillImageWith(target.get(), kColorBlack);
+
+    const std::unique_ptr<BorrowedImageInfoVk> targetInfo = createBorrowedImageInfo(target.get());
+    uint64_t targetContentGeneration = 1;
+
+    ComposeLayer layerProps = {
+        .composeMode = HWC2_COMPOSITION_SOLID_COLOR,
+        .displayFrame =
+            {
+                .left = 0,
+                .top = 0,
+                .right = 64,
+                .bottom = 64,
+            },
+        .alpha = 1.0f,
+        .color =
+            {
+                .r = 255,
+                .g = 0,
+                .b = 0,
+                .a = 255,
+            },
+    };
+    auto compose = [&]() {
+        // The composition bumps the generation of a ColorBuffer target.
+        auto borrowedTarget = std::make_unique<BorrowedImageInfoVk>(*targetInfo);
+        borrowedTarget->contentGeneration = targetContentGeneration++;
+
+        Compositor::CompositionRequest compositionRequest = {
+            .target = std::move(borrowedTarget),
+        };
+        compositionRequest.layers.push_back(Compositor::CompositionRequestLayer{
+            .source = nullptr,
+            .props = layerProps,
+        });
+        compositor->compose(compositionRequest).wait();
+    };
+    auto getPixel = [&](uint32_t x, uint32_t y) -> uint32_t {
+        auto pixels = target->read();
+        EXPECT_TRUE(pixels.has_value());
+        return pixels ? (*pixels)[y * target->m_width + x] : 0;
+    };
+
+    compose();
+    EXPECT_EQ(getPixel(32, 32), kColorRed);
+    EXPECT_EQ(getPixel(128, 128), kColorBlack);
+    EXPECT_EQ(compositor->getStats().composedPixels, 256u * 256u);
+
+    // Anything the compositor draws would overwrite the green.
+    fillImageWith(target.get(), kColorGreen);
+
+    compose();
+    EXPECT_EQ(getPixel(32, 32), kColorGreen);
+    EXPECT_EQ(compositor->getStats().skippedCompositions, 1u);
+
+    // Both where the layer was and where it is now are redrawn.
+    layerProps.displayFrame = {
+        .left = 64,
+        .top = 64,
+        .right = 128,
+        .bottom = 128,
+    };
+    compose();
+    EXPECT_EQ(getPixel(32, 32), kColorBlack);
+    EXPECT_EQ(getPixel(96, 96), kColorRed);
+    EXPECT_EQ(getPixel(192, 192), kColorGreen);
+
+    const CompositorVk::Stats stats = compositor->getStats();
+    EXPECT_EQ(stats.compositions, 3u);
+    EXPECT_EQ(stats.damageCompositions, 1u);
+    EXPECT_EQ(stats.composedPixels, 256u * 256u + 128u * 128u);
+}
+
+TEST_F(CompositorVkTest, SingleOpaqueLayerIsCopied) {
+    auto compositor = createCompositor();
+    ASSERT_NE(compositor, nullptr);
+
+    // The alpha of the source is ignored, the copy has to leave an opaque target.
+    auto source = createImageWithColor<SourceImage>(256, 256, kColorGreen & 0x00FFFFFF);
+    ASSERT_NE(source, nullptr);
+
+    auto target = createImageWithColor<TargetImage>(256, 256, kColorBlack);
+    ASSERT_NE(target, nullptr);
+
+    Compositor::CompositionRequest compositionRequest = {
+        .target = createBorrowedImageInfo(target.get()),
+    };
+    compositionRequest.layers.emplace_back(Compositor::CompositionRequestLayer{
+        .source = createBorrowedImageInfo(source.get()),
+        .props =
+            {
+                .composeMode = HWC2_COMPOSITION_DEVICE,
+                .displayFrame =
+                    {
+                        .left = 0,
+                        .top = 0,
+                        .right = static_cast<int>(target->m_width),
+                        .bottom = static_cast<int>(target->m_height),
+                    },
+                .crop =
+                    {
+                        .left = 0,
+                        .top = 0,
+                        .right = static_cast<float>(source->m_width),
+                        .bottom = static_cast<float>(source->m_height),
+                    },
+                .blendMode = HWC2_BLEND_MODE_NONE,
+                .alpha = 1.0,
+                .transform = HWC_TRANSFORM_NONE,
+            },
+    });
+
+    compositor->compose(compositionRequest).wait();
+    checkImageFilledWith(target.get(), kColorGreen);
+    EXPECT_EQ(compositor->getStats().directCopies, 1u);
+
+    // Blending needs the graphics pipeline.
+    compositionRequest.target = createBorrowedImageInfo(target.get());
+    compositionRequest.layers[0].props.blendMode = HWC2_BLEND_MODE_PREMULTIPLIED;
+    compositor->compose(compositionRequest).wait();
+    checkImageFilledWith(target.get(), kColorGreen);
+    EXPECT_EQ(compositor->getStats().directCopies, 1u);
+}
+
 }  // namespace
 }  // namespace vk
 }  // namespace gfxstream
@@ -0,0 +1,171 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "DecoderHangInfo.h"
+#include "aemu/base/HealthMonitor.h"
+#include "aemu/base/Metrics.h"
+
+namespace gfxstream {
+namespace {
+
+using android::base::EventHangMetadata;
+
+constexpr uint32_t kFirstOpcode = 20000;
+constexpr uint32_t kOpcodeCount = 300;
+constexpr char kProcessName[] = "com.example.benchmark";
+
+// Builds a stream of `packetCount` packets in the framing of VkDecoder::Impl::decode(): an
+// opcode, the packet length and a seqno, followed by `argumentsSize` bytes of arguments.
+std::vector<uint8_t> makeStream(uint32_t packetCount, uint32_t argumentsSize) {
+    const uint32_t packetLength = 8 + sizeof(uint32_t) + argumentsSize;
+    std::vector<uint8_t> stream(static_cast<size_t>(packetCount) * packetLength);
+    uint8_t* ptr = stream.data();
+    for (uint32_t i = 0; i < packetCount; i++) {
+        const uint32_t opcode = kFirstOpcode + (i * 2654435761u >> 16) % kOpcodeCount;
+        const uint32_t seqno = i + 1;
+        memcpy(ptr, &opcode, sizeof(opcode));
+        memcpy(ptr + 4, &packetLength, sizeof(packetLength));
+        memcpy(ptr + 8, &seqno, sizeof(seqno));
+        ptr += packetLength;
+    }
+    return stream;
+}
+
+// Stands in for the unmarshaling and dispatch of a packet.
+uint32_t executePacket(const uint8_t* arguments, uint32_t size) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < size; i += sizeof(uint32_t)) {
+        uint32_t value;
+        memcpy(&value, arguments + i, sizeof(value));
+        sum += value;
+    }
+    return sum;
+}
+
+// Walks the stream with the per-packet hang bookkeeping of VkDecoder::Impl::decode(), with
+// `healthMonitor` null when the health monitor is off.
+void decodeLazy(const std::vector<uint8_t>& stream, emugl::HealthMonitor<>* healthMonitor,
+                std::optional<uint32_t>& prevSeqno) {
+    DecoderHangInfo& hangInfo = DecoderHangInfo::forCurrentThread();
+    hangInfo.setProcessName(kProcessName);
+    const uint8_t* ptr = stream.data();
+    const uint8_t* const end = stream.data() + stream.size();
+    while (end - ptr >= 8) {
+        uint32_t opcode;
+        uint32_t packetLen;
+        memcpy(&opcode, ptr, sizeof(opcode));
+        memcpy(&packetLen, ptr + 4, sizeof(packetLen));
+
+        hangInfo.setPacket(opcode, packetLen, prevSeqno);
+
+        uint32_t seqno;
+        memcpy(&seqno, ptr + 8, sizeof(seqno));
+        hangInfo.setSeqno(seqno);
+        prevSeqno = seqno;
+
+        auto executionWatchdog =
+            hangInfo.buildPacketWatchdog(healthMonitor, "RenderThread VkDecoder command execution");
+
+        benchmark::DoNotOptimize(executePacket(ptr + 12, packetLen - 12));
+        ptr += packetLen;
+    }
+}
+
+// Same as decodeLazy(), but formats the annotations of every packet up front, the way the
+// decoder did before DecoderHangInfo.
+void decodeEager(const std::vector<uint8_t>& stream, emugl::HealthMonitor<>* healthMonitor,
+                 std::optional<uint32_t>& prevSeqno) {
+    const uint8_t* ptr = stream.data();
+    const uint8_t* const end = stream.data() + stream.size();
+    while (end - ptr >= 8) {
+        uint32_t opcode;
+        uint32_t packetLen;
+        memcpy(&opcode, ptr, sizeof(opcode));
+        memcpy(&packetLen, ptr + 4, sizeof(packetLen));
+
+        std::unique_ptr<EventHangMetadata::HangAnnotations> executionData =
+            std::make_unique<EventHangMetadata::HangAnnotations>();
+        if (healthMonitor) {
+            executionData->insert(
+                {{"packet_length", std::to_string(packetLen)}, {"opcode", std::to_string(opcode)}});
+            executionData->insert({{"renderthread_guest_process", std::string(kProcessName)}});
+            if (prevSeqno) {
+                executionData->insert({{"previous_seqno", std::to_string(prevSeqno.value())}});
+            }
+        }
+
+        uint32_t seqno;
+        memcpy(&seqno, ptr + 8, sizeof(seqno));
+        if (healthMonitor) executionData->insert({{"seqno", std::to_string(seqno)}});
+        prevSeqno = seqno;
+
+        auto executionWatchdog =
+            WATCHDOG_BUILDER(healthMonitor, "RenderThread VkDecoder command execution")
+                .setHangType(EventHangMetadata::HangType::kRenderThread)
+                .setAnnotations(std::move(executionData))
+                .build();
+
+        benchmark::DoNotOptimize(executePacket(ptr + 12, packetLen - 12));
+        ptr += packetLen;
+    }
+}
+
+using DecodeFunction = void (*)(const std::vector<uint8_t>&, emugl::HealthMonitor<>*,
+                                std::optional<uint32_t>&);
+
+// Decodes a stream of state.range(0) packets with state.range(1) bytes of arguments each.
+void BM_Decode(benchmark::State& state, DecodeFunction decode, bool withHealthMonitor) {
+    const uint32_t packetCount = static_cast<uint32_t>(state.range(0));
+    const std::vector<uint8_t> stream =
+        makeStream(packetCount, static_cast<uint32_t>(state.range(1)));
+
+    std::unique_ptr<android::base::MetricsLogger> metricsLogger =
+        android::base::CreateMetricsLogger();
+    std::unique_ptr<emugl::HealthMonitor<>> healthMonitor;
+    if (withHealthMonitor) {
+        healthMonitor = std::make_unique<emugl::HealthMonitor<>>(*metricsLogger);
+    }
+
+    std::optional<uint32_t> prevSeqno;
+    for (auto _ : state) {
+        decode(stream, healthMonitor.get(), prevSeqno);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * packetCount);
+    state.SetBytesProcessed(state.iterations() * stream.size());
+}
+
+BENCHMARK_CAPTURE(BM_Decode, HealthMonitorOff, decodeLazy, false)
+    ->Args({1024, 16})
+    ->Args({1024, 256});
+BENCHMARK_CAPTURE(BM_Decode, HealthMonitorOn, decodeLazy, true)
+    ->Args({1024, 16})
+    ->Args({1024, 256});
+BENCHMARK_CAPTURE(BM_Decode, HealthMonitorOnEagerAnnotations, decodeEager, true)
+    ->Args({1024, 16})
+    ->Args({1024, 256});
+
+}  // namespace
+}  // namespace gfxstream
+
+BENCHMARK_MAIN();
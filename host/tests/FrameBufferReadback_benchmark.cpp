@@ -0,0 +1,146 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "FrameBuffer.h"
+#include "aemu/base/GLObjectCounter.h"
+#include "host-common/GraphicsAgentFactory.h"
+#include "host-common/opengl/misc.h"
+#include "host-common/testing/MockGraphicsAgentFactory.h"
+
+namespace gfxstream {
+namespace {
+
+constexpr uint32_t kDisplayId = 0;
+
+enum class Consumer {
+    // No post callback, what a post costs without readback.
+    None,
+    // A post callback that only counts the frames, so the readback is never waited for.
+    Notified,
+    // A post callback, and the frame copied out after each post, as a screen recorder does.
+    CopiesOut,
+};
+
+void countFrame(void* context, uint32_t, int, int, int, int, int, unsigned char*) {
+    static_cast<std::atomic<uint64_t>*>(context)->fetch_add(1);
+}
+
+// A FrameBuffer without GL emulation or window, so that its posts only read back the
+// ColorBuffer for the post callbacks, with ReadbackWorkerVk.
+class ReadbackFrameBuffer {
+   public:
+    ReadbackFrameBuffer(uint32_t width, uint32_t height) {
+        static const bool sAgentsInjected = [] {
+            android::emulation::injectGraphicsAgents(
+                android::emulation::MockGraphicsAgentFactory());
+            return true;
+        }();
+        (void)sAgentsInjected;
+        emugl::setGLObjectCounter(android::base::GLObjectCounter::get());
+        emugl::set_emugl_window_operations(*getGraphicsAgents()->emu);
+        emugl::set_emugl_multi_display_operations(*getGraphicsAgents()->multi_display);
+        getGraphicsAgents()->multi_display->setMultiDisplay(kDisplayId, 0, 0, width, height, 160,
+                                                            0, true);
+
+        gfxstream::host::FeatureSet features;
+        features.Vulkan.enabled = true;
+        features.GuestVulkanOnly.enabled = true;
+        if (!FrameBuffer::initialize(width, height, features, false, false)) {
+            return;
+        }
+        mFb = FrameBuffer::getFB();
+        mColorBuffer =
+            mFb->createColorBuffer(width, height, GL_RGBA, FRAMEWORK_FORMAT_GL_COMPATIBLE);
+    }
+
+    ~ReadbackFrameBuffer() {
+        if (!mFb) {
+            return;
+        }
+        if (mColorBuffer) {
+            mFb->closeColorBuffer(mColorBuffer);
+        }
+        FrameBuffer::finalize();
+    }
+
+    FrameBuffer* fb() const { return mFb; }
+    HandleType colorBuffer() const { return mColorBuffer; }
+
+   private:
+    FrameBuffer* mFb = nullptr;
+    HandleType mColorBuffer = 0;
+};
+
+// Posts a ColorBuffer of state.range(0) x state.range(1) pixels to a display of the same size.
+// The post thread records and submits the copy into one of the display's readback buffers
+// without waiting for it, and drops the frame if all of them are still in flight, so the
+// "frames" counter is the share of posts that reached the post callback.
+void BM_Post(benchmark::State& state, Consumer consumer) {
+    const uint32_t width = static_cast<uint32_t>(state.range(0));
+    const uint32_t height = static_cast<uint32_t>(state.range(1));
+    ReadbackFrameBuffer frameBuffer(width, height);
+    FrameBuffer* fb = frameBuffer.fb();
+    if (!fb || !frameBuffer.colorBuffer()) {
+        state.SkipWithError("Failed to create the FrameBuffer");
+        return;
+    }
+
+    std::atomic<uint64_t> frames = 0;
+    if (consumer != Consumer::None) {
+        fb->setPostCallback(countFrame, &frames, kDisplayId);
+    }
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+
+    for (auto _ : state) {
+        const uint64_t framesBefore = frames.load();
+        fb->post(frameBuffer.colorBuffer());
+        if (consumer == Consumer::CopiesOut && frames.load() != framesBefore) {
+            fb->getPixels(pixels.data(), static_cast<uint32_t>(pixels.size()), kDisplayId);
+        }
+    }
+
+    if (consumer != Consumer::None) {
+        fb->setPostCallback(nullptr, nullptr, kDisplayId);
+        if (frames.load() == 0) {
+            state.SkipWithError("No frame was read back");
+            return;
+        }
+    }
+    state.counters["frames"] =
+        benchmark::Counter(static_cast<double>(frames.load()), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations());
+}
+
+void displayArgs(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"w", "h"});
+    benchmark->Args({1280, 720});
+    benchmark->Args({1920, 1080});
+}
+
+// The copies run on the GPU and the frames are copied out on the readback thread, so use the
+// wall time.
+BENCHMARK_CAPTURE(BM_Post, None, Consumer::None)->Apply(displayArgs)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Post, Notified, Consumer::Notified)->Apply(displayArgs)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Post, CopiesOut, Consumer::CopiesOut)->Apply(displayArgs)->UseRealTime();
+
+}  // namespace
+}  // namespace gfxstream
+
+BENCHMARK_MAIN();
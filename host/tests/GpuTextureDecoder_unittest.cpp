@@ -0,0 +1,273 @@
+// Copyright (C) 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <GLES3/gl31.h>
+#include <GLES2/gl2ext.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "GLTestUtils.h"
+#include "OpenGLTestContext.h"
+#include "ShaderUtils.h"
+#include "aemu/base/system/System.h"
+#include "gfxstream/etc.h"
+
+namespace gfxstream {
+namespace gl {
+namespace {
+
+// 8x8 checkerboard of single texels, compressed as an ASTC 8x8 block.
+const uint8_t kAstcCheckerboardBlock[] = {0x44, 0x05, 0x00, 0xfe, 0x01, 0x00, 0x00, 0x00,
+                                          0x55, 0xaa, 0x55, 0xaa, 0x55, 0xaa, 0x55, 0xaa};
+
+// Uploads compressed images through the translator with GPU decoding enabled and compares them
+// with images decoded on the CPU. Hosts with native support for the formats or without compute
+// shaders still decode on the CPU, in which case this only checks the upload.
+//
+// The textures are read back by drawing them, since BC3 textures can't be attached to
+// framebuffers.
+class GpuTextureDecoderTest : public GLTest {
+protected:
+    // Read by each context, at its first ETC2 or ASTC upload.
+    virtual const char* decodeMode() const { return "1"; }
+
+    void SetUp() override {
+        android::base::setEnvironmentVariable("ANDROID_EMUGL_GPU_TEXTURE_DECODE", decodeMode());
+        GLTest::SetUp();
+    }
+
+    void TearDown() override {
+        GLTest::TearDown();
+        android::base::setEnvironmentVariable("ANDROID_EMUGL_GPU_TEXTURE_DECODE", "");
+    }
+
+    // Any bit pattern is a valid ETC block.
+    static std::vector<etc1_byte> randomBlocks(ETC2ImageFormat format, int width, int height,
+                                               uint32_t seed) {
+        std::vector<etc1_byte> data(etc_get_encoded_data_size(format, width, height));
+        std::mt19937 generator(seed);
+        for (etc1_byte& byte : data) {
+            byte = static_cast<etc1_byte>(generator());
+        }
+        return data;
+    }
+
+    // ETC1 blocks that are either all black or all white, in a checkerboard of blocks. BC3 keeps
+    // them exact.
+    static std::vector<etc1_byte> blackAndWhiteBlocks(int width, int height) {
+        std::vector<etc1_byte> rgb(width * height * 3);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const etc1_byte value = (x / 4 + y / 4) % 2 ? 0xff : 0;
+                std::fill_n(&rgb[(y * width + x) * 3], 3, value);
+            }
+        }
+        std::vector<etc1_byte> data(etc1_get_encoded_data_size(width, height));
+        EXPECT_EQ(0, etc1_encode_image(rgb.data(), width, height, 3, width * 3, data.data()));
+        return data;
+    }
+
+    static std::vector<uint8_t> astcCheckerboard(int width, int height) {
+        std::vector<uint8_t> data;
+        for (int i = 0; i < ((width + 7) / 8) * ((height + 7) / 8); i++) {
+            data.insert(data.end(), std::begin(kAstcCheckerboardBlock),
+                        std::end(kAstcCheckerboardBlock));
+        }
+        return data;
+    }
+
+    // Decodes |data| on the CPU into RGBA8 rows of |width| pixels, at (|x|, |y|) of |rgba|.
+    static void decodeOnCpu(ETC2ImageFormat format, const std::vector<etc1_byte>& data, int x,
+                            int y, int width, int height, int rgbaWidth,
+                            std::vector<uint8_t>* rgba) {
+        const int pixelSize = etc_get_decoded_pixel_size(format);
+        std::vector<etc1_byte> decoded(width * height * pixelSize);
+        ASSERT_EQ(0, etc2_decode_image(data.data(), format, decoded.data(), width, height,
+                                       width * pixelSize));
+        for (int row = 0; row < height; row++) {
+            for (int column = 0; column < width; column++) {
+                const etc1_byte* in = &decoded[(row * width + column) * pixelSize];
+                uint8_t* out = &(*rgba)[((y + row) * rgbaWidth + x + column) * 4];
+                out[0] = in[0];
+                out[1] = in[1];
+                out[2] = in[2];
+                out[3] = pixelSize == 4 ? in[3] : 0xff;
+            }
+        }
+    }
+
+    static std::vector<uint8_t> checkerboardPixels(int width, int height) {
+        std::vector<uint8_t> rgba(width * height * 4, 0xff);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                std::fill_n(&rgba[(y * width + x) * 4], 3, (x + y) % 2 ? 0 : 0xff);
+            }
+        }
+        return rgba;
+    }
+
+    // Copies the texels of |texture| to an RGBA8 framebuffer and reads them back.
+    std::vector<uint8_t> readTexture(GLuint texture, int width, int height) {
+        static constexpr char kVertexShader[] = R"(#version 300 es
+void main() {
+    vec2 position = vec2(gl_VertexID % 2, gl_VertexID / 2) * 4.0 - 1.0;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
+)";
+        static constexpr char kFragmentShader[] = R"(#version 300 es
+precision highp float;
+uniform highp sampler2D u_texture;
+out vec4 color;
+void main() {
+    color = texelFetch(u_texture, ivec2(gl_FragCoord.xy), 0);
+}
+)";
+        const GLuint program = compileAndLinkShaderProgram(kVertexShader, kFragmentShader);
+        EXPECT_NE(0u, program);
+
+        GLuint target = 0;
+        gl->glGenTextures(1, &target);
+        gl->glBindTexture(GL_TEXTURE_2D, target);
+        gl->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         nullptr);
+
+        GLuint framebuffer = 0;
+        gl->glGenFramebuffers(1, &framebuffer);
+        gl->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+        EXPECT_EQ((GLenum)GL_FRAMEBUFFER_COMPLETE, gl->glCheckFramebufferStatus(GL_FRAMEBUFFER));
+
+        gl->glBindTexture(GL_TEXTURE_2D, texture);
+        gl->glUseProgram(program);
+        gl->glUniform1i(gl->glGetUniformLocation(program, "u_texture"), 0);
+        gl->glViewport(0, 0, width, height);
+        gl->glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        std::vector<uint8_t> pixels(width * height * 4);
+        gl->glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        gl->glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        EXPECT_EQ((GLenum)GL_NO_ERROR, gl->glGetError());
+
+        gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        gl->glDeleteFramebuffers(1, &framebuffer);
+        gl->glDeleteTextures(1, &target);
+        gl->glDeleteProgram(program);
+        return pixels;
+    }
+
+    void expectNoUnpackBuffer() {
+        // The decoder's unpack buffer must not leak into the guest's state.
+        GLint unpackBuffer = -1;
+        gl->glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpackBuffer);
+        EXPECT_EQ(0, unpackBuffer);
+    }
+
+    void testImage(GLenum internalformat, ETC2ImageFormat format,
+                   const std::vector<etc1_byte>& image, const std::vector<etc1_byte>& subImage) {
+        constexpr int kWidth = 16;
+        constexpr int kHeight = 16;
+        constexpr int kSubX = 4;
+        constexpr int kSubY = 8;
+        constexpr int kSubWidth = kWidth - kSubX;
+        constexpr int kSubHeight = 8;
+        ASSERT_EQ(etc_get_encoded_data_size(format, kWidth, kHeight), image.size());
+        ASSERT_EQ(etc_get_encoded_data_size(format, kSubWidth, kSubHeight), subImage.size());
+
+        GLuint texture = 0;
+        gl->glGenTextures(1, &texture);
+        gl->glBindTexture(GL_TEXTURE_2D, texture);
+
+        gl->glCompressedTexImage2D(GL_TEXTURE_2D, 0, internalformat, kWidth, kHeight, 0,
+                                   image.size(), image.data());
+        EXPECT_EQ((GLenum)GL_NO_ERROR, gl->glGetError());
+
+        gl->glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, kSubX, kSubY, kSubWidth, kSubHeight,
+                                      internalformat, subImage.size(), subImage.data());
+        EXPECT_EQ((GLenum)GL_NO_ERROR, gl->glGetError());
+        expectNoUnpackBuffer();
+
+        std::vector<uint8_t> expected(kWidth * kHeight * 4);
+        decodeOnCpu(format, image, 0, 0, kWidth, kHeight, kWidth, &expected);
+        decodeOnCpu(format, subImage, kSubX, kSubY, kSubWidth, kSubHeight, kWidth, &expected);
+
+        std::vector<uint8_t> actual = readTexture(texture, kWidth, kHeight);
+        EXPECT_TRUE(ImageMatches(kWidth, kHeight, 4, kWidth, expected.data(), actual.data()));
+
+        gl->glDeleteTextures(1, &texture);
+    }
+
+    void testFormat(GLenum internalformat, ETC2ImageFormat format) {
+        testImage(internalformat, format, randomBlocks(format, 16, 16, 1),
+                  randomBlocks(format, 12, 8, 2));
+    }
+
+    void testAstcCheckerboard() {
+        constexpr int kWidth = 24;
+        constexpr int kHeight = 16;
+
+        GLuint texture = 0;
+        gl->glGenTextures(1, &texture);
+        gl->glBindTexture(GL_TEXTURE_2D, texture);
+
+        const std::vector<uint8_t> image = astcCheckerboard(kWidth, kHeight);
+        gl->glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGBA_ASTC_8x8_KHR, kWidth,
+                                   kHeight, 0, image.size(), image.data());
+        EXPECT_EQ((GLenum)GL_NO_ERROR, gl->glGetError());
+
+        const std::vector<uint8_t> subImage = astcCheckerboard(8, 8);
+        gl->glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 8, 8, 8, 8,
+                                      GL_COMPRESSED_RGBA_ASTC_8x8_KHR, subImage.size(),
+                                      subImage.data());
+        EXPECT_EQ((GLenum)GL_NO_ERROR, gl->glGetError());
+        expectNoUnpackBuffer();
+
+        std::vector<uint8_t> expected = checkerboardPixels(kWidth, kHeight);
+        std::vector<uint8_t> actual = readTexture(texture, kWidth, kHeight);
+        EXPECT_TRUE(ImageMatches(kWidth, kHeight, 4, kWidth, expected.data(), actual.data()));
+
+        gl->glDeleteTextures(1, &texture);
+    }
+};
+
+TEST_F(GpuTextureDecoderTest, Rgb8) { testFormat(GL_COMPRESSED_RGB8_ETC2, EtcRGB8); }
+
+TEST_F(GpuTextureDecoderTest, Rgba8) { testFormat(GL_COMPRESSED_RGBA8_ETC2_EAC, EtcRGBA8); }
+
+TEST_F(GpuTextureDecoderTest, Rgb8A1) {
+    testFormat(GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, EtcRGB8A1);
+}
+
+TEST_F(GpuTextureDecoderTest, Astc) { testAstcCheckerboard(); }
+
+// Same as above, but transcoding to BC3 on hosts that support it. The images are black and white,
+// so that BC3 keeps them exact.
+class GpuTextureDecoderBc3Test : public GpuTextureDecoderTest {
+protected:
+    const char* decodeMode() const override { return "bc3"; }
+};
+
+TEST_F(GpuTextureDecoderBc3Test, Rgb8) {
+    testImage(GL_COMPRESSED_RGB8_ETC2, EtcRGB8, blackAndWhiteBlocks(16, 16),
+              blackAndWhiteBlocks(12, 8));
+}
+
+TEST_F(GpuTextureDecoderBc3Test, Astc) { testAstcCheckerboard(); }
+
+}  // namespace
+}  // namespace gl
+}  // namespace gfxstream
@@ -0,0 +1,143 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "gl/glestranslator/EGL/ShaderCache.h"
+
+namespace {
+
+constexpr char kDriverId[] = "Vendor\nRenderer\nOpenGL ES 3.2 Driver 1.2.3\n1.5";
+
+// Large enough to hold every blob of the benchmarks.
+constexpr size_t kMaxCacheBytes = 256 * 1024 * 1024;
+
+// The blobs that a driver sets while an app compiles its shaders: `programCount` programs of
+// `blobSize` bytes each, keyed by a 32 byte hash of their sources.
+struct AppLaunch {
+    AppLaunch(size_t programCount, size_t blobSize) {
+        for (size_t i = 0; i < programCount; i++) {
+            std::string key(32, '\0');
+            for (size_t j = 0; j < key.size(); j++) {
+                key[j] = static_cast<char>((i + 1) * 2654435761u >> (j % 24));
+            }
+            keys.push_back(std::move(key));
+        }
+        blob.resize(blobSize);
+        for (size_t i = 0; i < blob.size(); i++) {
+            blob[i] = static_cast<uint8_t>(i * 2654435761u >> 13);
+        }
+    }
+
+    std::vector<std::string> keys;
+    std::vector<uint8_t> blob;
+};
+
+std::filesystem::path makeDirectory(const char* name) {
+    const std::filesystem::path directory =
+        std::filesystem::temp_directory_path() / (std::string("gfxstream_blob_cache_") + name);
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    return directory;
+}
+
+// Looks up the blob of every program, and sets the ones that are missing, as a driver does
+// when it compiles them.
+void launchApp(BlobCache* cache, const AppLaunch& app, std::vector<uint8_t>* value) {
+    for (const std::string& key : app.keys) {
+        if (cache->get(key.data(), key.size(), value->data(), value->size()) == 0) {
+            cache->set(key.data(), key.size(), app.blob.data(), app.blob.size());
+        }
+    }
+}
+
+// Reports the hits and misses of `total` per launch.
+void setCounters(benchmark::State& state, const BlobCacheStats& total, const AppLaunch& app) {
+    state.counters["hits"] = benchmark::Counter(total.hits, benchmark::Counter::kAvgIterations);
+    state.counters["misses"] =
+        benchmark::Counter(total.misses, benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations() * app.keys.size());
+    state.SetBytesProcessed(state.iterations() * app.keys.size() * app.blob.size());
+}
+
+// The first launch of an app: the cache directory is empty, so every program misses and has
+// its blob set. Saving the blobs happens in the background and is not timed.
+void BM_ColdLaunch(benchmark::State& state) {
+    const AppLaunch app(state.range(0), state.range(1));
+    const std::filesystem::path directory = makeDirectory("cold");
+    std::vector<uint8_t> value(app.blob.size());
+    BlobCacheStats total;
+
+    for (auto _ : state) {
+        BlobCache cache(kMaxCacheBytes);
+        cache.init(directory.string(), kDriverId);
+        launchApp(&cache, app, &value);
+
+        state.PauseTiming();
+        cache.shutdown();
+        const BlobCacheStats stats = cache.stats();
+        total.hits += stats.hits;
+        total.misses += stats.misses;
+        std::filesystem::remove(BlobCache::getPath(directory.string(), kDriverId));
+        state.ResumeTiming();
+    }
+
+    setCounters(state, total, app);
+    std::filesystem::remove_all(directory);
+}
+
+// A later launch of the same app: the blobs saved by the first one are loaded, and every
+// program hits. Waiting for the load is timed, since a launch right at startup would race
+// with it.
+void BM_WarmLaunch(benchmark::State& state) {
+    const AppLaunch app(state.range(0), state.range(1));
+    const std::filesystem::path directory = makeDirectory("warm");
+    std::vector<uint8_t> value(app.blob.size());
+    {
+        BlobCache cache(kMaxCacheBytes);
+        cache.init(directory.string(), kDriverId);
+        launchApp(&cache, app, &value);
+        cache.shutdown();
+    }
+    BlobCacheStats total;
+
+    for (auto _ : state) {
+        BlobCache cache(kMaxCacheBytes);
+        cache.init(directory.string(), kDriverId);
+        // Only returns once the blobs are loaded, and nothing is left to save.
+        cache.shutdown();
+        launchApp(&cache, app, &value);
+
+        state.PauseTiming();
+        const BlobCacheStats stats = cache.stats();
+        total.hits += stats.hits;
+        total.misses += stats.misses;
+        state.ResumeTiming();
+    }
+
+    setCounters(state, total, app);
+    std::filesystem::remove_all(directory);
+}
+
+// The blobs are loaded and saved on the cache's own thread, so use the wall time.
+BENCHMARK(BM_ColdLaunch)->Args({100, 16 * 1024})->Args({1000, 16 * 1024})->UseRealTime();
+BENCHMARK(BM_WarmLaunch)->Args({100, 16 * 1024})->Args({1000, 16 * 1024})->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
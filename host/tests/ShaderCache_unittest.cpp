@@ -0,0 +1,218 @@
+// Copyright (C) 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gl/glestranslator/EGL/ShaderCache.h"
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr char kDriverId[] = "Vendor\nRenderer\nOpenGL ES 3.2 Driver 1.2.3\n1.5";
+
+class ShaderCacheTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        const auto* info = ::testing::UnitTest::GetInstance()->current_test_info();
+        mDirectory = std::filesystem::temp_directory_path() /
+                     (std::string("gfxstream_blob_cache_") + info->name());
+        std::filesystem::remove_all(mDirectory);
+        std::filesystem::create_directories(mDirectory);
+    }
+
+    void TearDown() override { std::filesystem::remove_all(mDirectory); }
+
+    static void set(BlobCache* cache, const std::string& key, const std::string& value) {
+        cache->set(key.data(), key.size(), value.data(), value.size());
+    }
+
+    // Returns the value of `key`, or "<missing>".
+    static std::string get(BlobCache* cache, const std::string& key) {
+        const size_t size = cache->get(key.data(), key.size(), nullptr, 0);
+        if (size == 0) {
+            return "<missing>";
+        }
+        std::string value(size, '\0');
+        EXPECT_EQ(size, cache->get(key.data(), key.size(), value.data(), value.size()));
+        return value;
+    }
+
+    std::vector<uint8_t> readFile(const std::string& driverId) {
+        const std::string path = BlobCache::getPath(mDirectory.string(), driverId);
+        std::vector<uint8_t> bytes(std::filesystem::file_size(path));
+        FILE* file = fopen(path.c_str(), "rb");
+        EXPECT_EQ(1u, fread(bytes.data(), bytes.size(), 1, file));
+        fclose(file);
+        return bytes;
+    }
+
+    std::filesystem::path mDirectory;
+};
+
+void putLe32(std::vector<uint8_t>* bytes, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        bytes->push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void putString(std::vector<uint8_t>* bytes, const std::string& str) {
+    bytes->insert(bytes->end(), str.begin(), str.end());
+}
+
+TEST_F(ShaderCacheTest, FileNameIsStable) {
+    // The name must not change between builds, or every update throws the cache away.
+    EXPECT_EQ(mDirectory.string() + "/egl_blob_cache_c85b78e3dea334ff.bin",
+              BlobCache::getPath(mDirectory.string(), "driver"));
+    EXPECT_NE(BlobCache::getPath(mDirectory.string(), "driver"),
+              BlobCache::getPath(mDirectory.string(), "other driver"));
+}
+
+TEST_F(ShaderCacheTest, SavesFileFormat) {
+    {
+        BlobCache cache(1024);
+        cache.init(mDirectory.string(), kDriverId);
+        set(&cache, "key1", "value1");
+        set(&cache, "key2", "value22");
+        cache.shutdown();
+    }
+
+    std::vector<uint8_t> expected;
+    putString(&expected, std::string("EGLBLOB\0", 8));
+    putLe32(&expected, 1);
+    putLe32(&expected, sizeof(kDriverId) - 1);
+    putString(&expected, kDriverId);
+    // Most recently used first.
+    putLe32(&expected, 4);
+    putLe32(&expected, 7);
+    putString(&expected, "key2value22");
+    putLe32(&expected, 4);
+    putLe32(&expected, 6);
+    putString(&expected, "key1value1");
+    EXPECT_EQ(expected, readFile(kDriverId));
+}
+
+TEST_F(ShaderCacheTest, LoadsSavedBlobs) {
+    {
+        BlobCache cache(1024);
+        cache.init(mDirectory.string(), kDriverId);
+        set(&cache, "key1", "value1");
+        set(&cache, "key2", "value2");
+        cache.shutdown();
+    }
+
+    BlobCache cache(1024);
+    cache.init(mDirectory.string(), kDriverId);
+    // Waits for the load.
+    cache.shutdown();
+    EXPECT_EQ("value1", get(&cache, "key1"));
+    EXPECT_EQ("value2", get(&cache, "key2"));
+    EXPECT_EQ("<missing>", get(&cache, "key3"));
+
+    const BlobCacheStats stats = cache.stats();
+    EXPECT_EQ(4u, stats.hits);
+    EXPECT_EQ(1u, stats.misses);
+    EXPECT_EQ(2u, stats.entries);
+    EXPECT_EQ(20u, stats.bytes);
+}
+
+TEST_F(ShaderCacheTest, IgnoresOtherDriversBlobs) {
+    {
+        BlobCache cache(1024);
+        cache.init(mDirectory.string(), kDriverId);
+        set(&cache, "key1", "value1");
+        cache.shutdown();
+    }
+
+    // Another driver, which happens to have the same file.
+    const std::string otherDriverId = "Vendor\nRenderer\nOpenGL ES 3.2 Driver 1.2.4\n1.5";
+    std::filesystem::rename(BlobCache::getPath(mDirectory.string(), kDriverId),
+                            BlobCache::getPath(mDirectory.string(), otherDriverId));
+
+    BlobCache cache(1024);
+    cache.init(mDirectory.string(), otherDriverId);
+    cache.shutdown();
+    EXPECT_EQ("<missing>", get(&cache, "key1"));
+}
+
+TEST_F(ShaderCacheTest, IgnoresTruncatedEntries) {
+    {
+        BlobCache cache(1024);
+        cache.init(mDirectory.string(), kDriverId);
+        set(&cache, "key1", "value1");
+        set(&cache, "key2", "value2");
+        cache.shutdown();
+    }
+    const std::string path = BlobCache::getPath(mDirectory.string(), kDriverId);
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+
+    BlobCache cache(1024);
+    cache.init(mDirectory.string(), kDriverId);
+    cache.shutdown();
+    EXPECT_EQ("value2", get(&cache, "key2"));
+    EXPECT_EQ("<missing>", get(&cache, "key1"));
+}
+
+TEST_F(ShaderCacheTest, EvictsLeastRecentlyUsed) {
+    // Room for three 10 byte blobs.
+    BlobCache cache(30);
+    set(&cache, "key1", "value1");
+    set(&cache, "key2", "value2");
+    set(&cache, "key3", "value3");
+
+    // Makes key1 the most recently used.
+    EXPECT_EQ("value1", get(&cache, "key1"));
+
+    set(&cache, "key4", "value4");
+    EXPECT_EQ("<missing>", get(&cache, "key2"));
+    EXPECT_EQ("value1", get(&cache, "key1"));
+    EXPECT_EQ("value3", get(&cache, "key3"));
+    EXPECT_EQ("value4", get(&cache, "key4"));
+    EXPECT_EQ(30u, cache.stats().bytes);
+
+    // Replacing a blob only counts it once.
+    set(&cache, "key3", "value3");
+    EXPECT_EQ(3u, cache.stats().entries);
+    EXPECT_EQ(30u, cache.stats().bytes);
+
+    // Too large to ever fit.
+    set(&cache, "key5", std::string(100, 'x'));
+    EXPECT_EQ("<missing>", get(&cache, "key5"));
+    EXPECT_EQ(3u, cache.stats().entries);
+}
+
+TEST_F(ShaderCacheTest, KeepsMostRecentlyUsedOnLoad) {
+    {
+        BlobCache cache(1024);
+        cache.init(mDirectory.string(), kDriverId);
+        set(&cache, "key1", "value1");
+        set(&cache, "key2", "value2");
+        set(&cache, "key3", "value3");
+        cache.shutdown();
+    }
+
+    // Only two of the saved blobs fit, the most recently used ones.
+    BlobCache cache(20);
+    cache.init(mDirectory.string(), kDriverId);
+    cache.shutdown();
+    EXPECT_EQ("<missing>", get(&cache, "key1"));
+    EXPECT_EQ("value2", get(&cache, "key2"));
+    EXPECT_EQ("value3", get(&cache, "key3"));
+}
+
+}  // namespace
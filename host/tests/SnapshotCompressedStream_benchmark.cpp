@@ -0,0 +1,114 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "SnapshotCompressedStream.h"
+
+#include <benchmark/benchmark.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace gfxstream {
+namespace {
+
+// Larger than the chunks in flight, so that the pool of threads is kept busy.
+constexpr size_t kSnapshotSize = 64 * 1024 * 1024;
+
+// The renderer writes its snapshot in pieces of many sizes, the contents of an image at a time.
+constexpr size_t kWriteSize = 1024 * 1024;
+
+enum class Contents {
+    // Render targets and textures with large flat areas, which LZ4 shrinks well.
+    Compressible,
+    // Already compressed textures, which LZ4 can not shrink and which are stored as is.
+    Incompressible,
+};
+
+std::vector<uint8_t> makeSnapshot(Contents contents) {
+    std::vector<uint8_t> data(kSnapshotSize);
+    std::mt19937 generator(42);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = contents == Contents::Compressible ? static_cast<uint8_t>(i / 1024)
+                                                     : static_cast<uint8_t>(generator());
+    }
+    return data;
+}
+
+std::filesystem::path getPath(const char* name) {
+    return std::filesystem::temp_directory_path() /
+           (std::string("gfxstream_snapshot_benchmark_") + name);
+}
+
+void save(const std::filesystem::path& path, const std::vector<uint8_t>& data) {
+    SnapshotCompressingStream stream(fopen(path.c_str(), "wb"));
+    for (size_t offset = 0; offset < data.size(); offset += kWriteSize) {
+        stream.write(data.data() + offset, std::min(kWriteSize, data.size() - offset));
+    }
+    stream.close();
+}
+
+void setCounters(benchmark::State& state, const std::filesystem::path& path) {
+    state.counters["ratio"] =
+        static_cast<double>(std::filesystem::file_size(path)) / kSnapshotSize;
+    state.SetBytesProcessed(state.iterations() * kSnapshotSize);
+}
+
+// Compressing a snapshot and writing it to a file, until the file is closed.
+void BM_Compress(benchmark::State& state, Contents contents) {
+    const std::vector<uint8_t> data = makeSnapshot(contents);
+    const std::filesystem::path path = getPath("compress");
+
+    for (auto _ : state) {
+        save(path, data);
+    }
+
+    setCounters(state, path);
+    std::filesystem::remove(path);
+}
+
+// Reading back and decompressing what BM_Compress wrote.
+void BM_Decompress(benchmark::State& state, Contents contents) {
+    const std::filesystem::path path = getPath("decompress");
+    save(path, makeSnapshot(contents));
+    std::vector<uint8_t> buffer(kWriteSize);
+
+    for (auto _ : state) {
+        SnapshotDecompressingStream stream(fopen(path.c_str(), "rb"));
+        for (size_t offset = 0; offset < kSnapshotSize; offset += kWriteSize) {
+            stream.read(buffer.data(), std::min(kWriteSize, kSnapshotSize - offset));
+        }
+        if (stream.failed()) {
+            state.SkipWithError("Failed to read the snapshot");
+            break;
+        }
+    }
+
+    setCounters(state, path);
+    std::filesystem::remove(path);
+}
+
+// Chunks are compressed and decompressed on their own threads, so use the wall time.
+BENCHMARK_CAPTURE(BM_Compress, Compressible, Contents::Compressible)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Compress, Incompressible, Contents::Incompressible)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Decompress, Compressible, Contents::Compressible)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Decompress, Incompressible, Contents::Incompressible)->UseRealTime();
+
+}  // namespace
+}  // namespace gfxstream
+
+BENCHMARK_MAIN();
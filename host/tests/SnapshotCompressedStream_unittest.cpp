@@ -0,0 +1,195 @@
+// Copyright (C) 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "SnapshotCompressedStream.h"
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace gfxstream {
+namespace {
+
+// More than two chunks, so that several are in flight at once.
+constexpr size_t kDataSize = 9 * 1024 * 1024 + 123;
+
+// Offset of the first chunk header, after the magic and the version.
+constexpr size_t kFirstChunkOffset = 12;
+constexpr size_t kChunkHeaderSize = 16;
+
+class SnapshotCompressedStreamTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        const auto* info = ::testing::UnitTest::GetInstance()->current_test_info();
+        mPath = std::filesystem::temp_directory_path() /
+                (std::string("gfxstream_snapshot_") + info->name());
+    }
+
+    void TearDown() override { std::filesystem::remove(mPath); }
+
+    // The first half compresses well and the second half not at all, so that both kinds of
+    // stored chunks are written.
+    static std::vector<uint8_t> makeData() {
+        std::vector<uint8_t> data(kDataSize);
+        std::mt19937 generator(42);
+        for (size_t i = 0; i < data.size(); i++) {
+            data[i] = i < data.size() / 2 ? static_cast<uint8_t>(i / 1024)
+                                          : static_cast<uint8_t>(generator());
+        }
+        return data;
+    }
+
+    void save(const std::vector<uint8_t>& data) {
+        SnapshotCompressingStream stream(fopen(mPath.c_str(), "wb"));
+        // Odd sized writes, crossing chunk boundaries.
+        constexpr size_t kWriteSize = 1000003;
+        for (size_t offset = 0; offset < data.size(); offset += kWriteSize) {
+            const size_t size = std::min(kWriteSize, data.size() - offset);
+            ASSERT_EQ(static_cast<ssize_t>(size), stream.write(data.data() + offset, size));
+        }
+        ASSERT_TRUE(stream.close());
+    }
+
+    std::vector<uint8_t> readFile() {
+        std::vector<uint8_t> bytes(std::filesystem::file_size(mPath));
+        FILE* file = fopen(mPath.c_str(), "rb");
+        EXPECT_EQ(1u, fread(bytes.data(), bytes.size(), 1, file));
+        fclose(file);
+        return bytes;
+    }
+
+    void writeFile(const std::vector<uint8_t>& bytes) {
+        FILE* file = fopen(mPath.c_str(), "wb");
+        EXPECT_EQ(1u, fwrite(bytes.data(), bytes.size(), 1, file));
+        fclose(file);
+    }
+
+    // Reads everything in the stream, in reads of `readSize` bytes.
+    static std::vector<uint8_t> load(SnapshotDecompressingStream* stream, size_t readSize) {
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> buffer(readSize);
+        while (true) {
+            const ssize_t size = stream->read(buffer.data(), buffer.size());
+            if (size <= 0) {
+                break;
+            }
+            data.insert(data.end(), buffer.begin(), buffer.begin() + size);
+        }
+        return data;
+    }
+
+    std::filesystem::path mPath;
+};
+
+TEST_F(SnapshotCompressedStreamTest, RoundTrip) {
+    const std::vector<uint8_t> data = makeData();
+    save(data);
+    EXPECT_LT(std::filesystem::file_size(mPath), data.size());
+
+    SnapshotDecompressingStream stream(fopen(mPath.c_str(), "rb"));
+    EXPECT_FALSE(stream.failed());
+    EXPECT_EQ(data, load(&stream, 777777));
+    EXPECT_FALSE(stream.failed());
+}
+
+TEST_F(SnapshotCompressedStreamTest, RoundTripEmpty) {
+    save({});
+
+    SnapshotDecompressingStream stream(fopen(mPath.c_str(), "rb"));
+    EXPECT_FALSE(stream.failed());
+    EXPECT_TRUE(load(&stream, 4096).empty());
+    EXPECT_FALSE(stream.failed());
+}
+
+TEST_F(SnapshotCompressedStreamTest, CorruptedChunkFails) {
+    const std::vector<uint8_t> data = makeData();
+    save(data);
+
+    // Flip a byte of the first chunk's contents.
+    std::vector<uint8_t> bytes = readFile();
+    bytes[kFirstChunkOffset + kChunkHeaderSize + 100] ^= 0x5a;
+    writeFile(bytes);
+
+    SnapshotDecompressingStream stream(fopen(mPath.c_str(), "rb"));
+    const std::vector<uint8_t> loaded = load(&stream, 777777);
+    EXPECT_TRUE(stream.failed());
+    EXPECT_LT(loaded.size(), data.size());
+}
+
+TEST_F(SnapshotCompressedStreamTest, CorruptedChecksumFails) {
+    save(makeData());
+
+    // Flip a bit of the last chunk's checksum, which is read after the others.
+    std::vector<uint8_t> bytes = readFile();
+    size_t offset = kFirstChunkOffset;
+    size_t lastChunkOffset = offset;
+    while (true) {
+        const uint8_t* header = &bytes[offset];
+        const uint32_t uncompressedSize =
+            header[0] | header[1] << 8 | header[2] << 16 | uint32_t(header[3]) << 24;
+        const uint32_t storedSize =
+            header[4] | header[5] << 8 | header[6] << 16 | uint32_t(header[7]) << 24;
+        if (uncompressedSize == 0) {
+            break;
+        }
+        lastChunkOffset = offset;
+        offset += kChunkHeaderSize + storedSize;
+    }
+    bytes[lastChunkOffset + 12] ^= 0x01;
+    writeFile(bytes);
+
+    SnapshotDecompressingStream stream(fopen(mPath.c_str(), "rb"));
+    EXPECT_FALSE(stream.failed());
+    load(&stream, 777777);
+    EXPECT_TRUE(stream.failed());
+}
+
+TEST_F(SnapshotCompressedStreamTest, TruncatedFileFailsOnOpen) {
+    save(makeData());
+    const std::vector<uint8_t> bytes = readFile();
+
+    // Cut inside a chunk, inside a chunk header, and right before the end chunk.
+    for (const size_t size : {bytes.size() / 2, kFirstChunkOffset + kChunkHeaderSize / 2,
+                              bytes.size() - kChunkHeaderSize}) {
+        writeFile(std::vector<uint8_t>(bytes.begin(), bytes.begin() + size));
+
+        SnapshotDecompressingStream stream(fopen(mPath.c_str(), "rb"));
+        EXPECT_TRUE(stream.failed()) << "truncated to " << size;
+        uint8_t buffer[16];
+        EXPECT_EQ(0, stream.read(buffer, sizeof(buffer))) << "truncated to " << size;
+    }
+}
+
+TEST_F(SnapshotCompressedStreamTest, LegacyUncompressedFile) {
+    const std::vector<uint8_t> data = makeData();
+    writeFile(data);
+
+    SnapshotDecompressingStream stream(fopen(mPath.c_str(), "rb"));
+    EXPECT_FALSE(stream.failed());
+    EXPECT_EQ(data, load(&stream, 777777));
+    EXPECT_FALSE(stream.failed());
+}
+
+TEST_F(SnapshotCompressedStreamTest, MissingFileFails) {
+    SnapshotDecompressingStream stream(nullptr);
+    EXPECT_TRUE(stream.failed());
+}
+
+}  // namespace
+}  // namespace gfxstream
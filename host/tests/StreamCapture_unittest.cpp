@@ -0,0 +1,131 @@
+// Copyright (C) 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "StreamCapture.h"
+
+namespace gfxstream {
+namespace {
+
+std::string readPayload(const StreamCaptureRecord& record) {
+    return std::string(record.payload.begin(), record.payload.end());
+}
+
+TEST(StreamCaptureTest, RoundTrip) {
+    const std::string directory = std::filesystem::temp_directory_path().string();
+
+    std::string path;
+    {
+        auto writer = StreamCaptureWriter::create(directory, 42);
+        ASSERT_NE(writer, nullptr);
+        path = writer->path();
+
+        writer->writeProcessName("com.example.app");
+        writer->writeGuestData("first", 5);
+        writer->writeGuestData("", 0);
+        writer->writeGuestData("second", 6);
+    }
+
+    auto reader = StreamCaptureReader::open(path);
+    ASSERT_NE(reader, nullptr);
+    EXPECT_EQ(reader->contextId(), 42u);
+    EXPECT_GT(reader->startTimeUnixUs(), 0u);
+
+    StreamCaptureRecord record;
+    ASSERT_TRUE(reader->next(&record));
+    EXPECT_EQ(record.type, StreamCaptureRecordType::kProcessName);
+    EXPECT_EQ(readPayload(record), "com.example.app");
+
+    ASSERT_TRUE(reader->next(&record));
+    EXPECT_EQ(record.type, StreamCaptureRecordType::kGuestData);
+    EXPECT_EQ(readPayload(record), "first");
+    const uint64_t firstTimestampUs = record.timestampUs;
+
+    ASSERT_TRUE(reader->next(&record));
+    EXPECT_EQ(record.type, StreamCaptureRecordType::kGuestData);
+    EXPECT_EQ(readPayload(record), "second");
+    EXPECT_GE(record.timestampUs, firstTimestampUs);
+
+    EXPECT_FALSE(reader->next(&record));
+
+    reader.reset();
+    std::filesystem::remove(path);
+}
+
+TEST(StreamCaptureTest, CompressedRoundTrip) {
+    if (!StreamCaptureWriter::supportsCompression()) {
+        GTEST_SKIP() << "Stream capture compression is not supported in this build.";
+    }
+
+    const std::string directory = std::filesystem::temp_directory_path().string();
+
+    std::string compressible(64 * 1024, '\0');
+    for (size_t i = 0; i < compressible.size(); i++) {
+        compressible[i] = static_cast<char>(i % 16);
+    }
+
+    std::string path;
+    {
+        auto writer = StreamCaptureWriter::create(directory, 7, /*compress=*/true);
+        ASSERT_NE(writer, nullptr);
+        path = writer->path();
+
+        writer->writeGuestData("small", 5);
+        writer->writeGuestData(compressible.data(), compressible.size());
+    }
+
+    EXPECT_LT(std::filesystem::file_size(path), compressible.size());
+
+    auto reader = StreamCaptureReader::open(path);
+    ASSERT_NE(reader, nullptr);
+    EXPECT_EQ(reader->contextId(), 7u);
+
+    StreamCaptureRecord record;
+    ASSERT_TRUE(reader->next(&record));
+    EXPECT_EQ(record.type, StreamCaptureRecordType::kGuestData);
+    EXPECT_EQ(readPayload(record), "small");
+
+    ASSERT_TRUE(reader->next(&record));
+    EXPECT_EQ(record.type, StreamCaptureRecordType::kGuestData);
+    EXPECT_EQ(readPayload(record), compressible);
+
+    EXPECT_FALSE(reader->next(&record));
+
+    reader.reset();
+    std::filesystem::remove(path);
+}
+
+TEST(StreamCaptureTest, RejectsOtherFiles) {
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "not_a_stream_capture.gfxcap").string();
+    FILE* file = fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    fputs("definitely not a capture", file);
+    fclose(file);
+
+    EXPECT_EQ(StreamCaptureReader::open(path), nullptr);
+    EXPECT_EQ(StreamCaptureReader::open(path + ".missing"), nullptr);
+
+    std::filesystem::remove(path);
+}
+
+}  // namespace
+}  // namespace gfxstream
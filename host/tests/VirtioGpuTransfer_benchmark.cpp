@@ -0,0 +1,148 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "gfxstream/virtio-gpu-gfxstream-renderer.h"
+#include "virgl_hw.h"
+
+namespace {
+
+constexpr uint32_t kResourceId = 1;
+constexpr uint32_t kResourceWidth = 1920;
+constexpr uint32_t kResourceHeight = 1080;
+constexpr uint32_t kBytesPerPixel = 4;
+
+// Guest memory in pages, like the scatter list of a virtio-gpu resource.
+constexpr size_t kPageSize = 4096;
+
+void writeFence(void*, struct stream_renderer_fence*) {}
+
+enum class Direction { Read, Write };
+
+// Creates a R8G8B8A8 COLOR_BUFFER resource, backed by guest memory split into iovs of
+// `iovSize` bytes.
+class TransferResource {
+   public:
+    explicit TransferResource(size_t iovSize)
+        : mGuestMemory(static_cast<size_t>(kResourceWidth) * kResourceHeight * kBytesPerPixel) {
+        std::vector<stream_renderer_param> params = {
+            {STREAM_RENDERER_PARAM_USER_DATA, 0},
+            {STREAM_RENDERER_PARAM_FENCE_CALLBACK,
+             static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&writeFence))},
+            {STREAM_RENDERER_PARAM_RENDERER_FLAGS,
+             STREAM_RENDERER_FLAGS_USE_SURFACELESS_BIT | STREAM_RENDERER_FLAGS_USE_GLES_BIT |
+                 STREAM_RENDERER_FLAGS_USE_EGL_BIT},
+        };
+        mInitialized = stream_renderer_init(params.data(), params.size()) == 0;
+        if (!mInitialized) return;
+
+        struct stream_renderer_resource_create_args args = {
+            .handle = kResourceId,
+            .target = 2,  // PIPE_TEXTURE_2D
+            .format = VIRGL_FORMAT_R8G8B8A8_UNORM,
+            .bind = VIRGL_BIND_SAMPLER_VIEW | VIRGL_BIND_SCANOUT | VIRGL_BIND_SHARED,
+            .width = kResourceWidth,
+            .height = kResourceHeight,
+            .depth = 1,
+            .array_size = 1,
+        };
+        for (size_t offset = 0; offset < mGuestMemory.size(); offset += iovSize) {
+            mIovs.push_back(iovec{
+                .iov_base = mGuestMemory.data() + offset,
+                .iov_len = std::min(iovSize, mGuestMemory.size() - offset),
+            });
+        }
+        mInitialized = stream_renderer_resource_create(&args, mIovs.data(), mIovs.size()) == 0;
+    }
+
+    ~TransferResource() {
+        if (mInitialized) stream_renderer_resource_unref(kResourceId);
+        stream_renderer_teardown();
+    }
+
+    bool initialized() const { return mInitialized; }
+
+   private:
+    bool mInitialized = false;
+    std::vector<char> mGuestMemory;
+    std::vector<struct iovec> mIovs;
+};
+
+// Transfers a box of state.range(0) x state.range(1) pixels, at the center of the resource,
+// between its guest memory in iovs of state.range(2) bytes and its ColorBuffer.
+void BM_Transfer(benchmark::State& state, Direction direction) {
+    TransferResource resource(static_cast<size_t>(state.range(2)));
+    if (!resource.initialized()) {
+        state.SkipWithError("Failed to create the resource");
+        return;
+    }
+
+    const uint32_t width = static_cast<uint32_t>(state.range(0));
+    const uint32_t height = static_cast<uint32_t>(state.range(1));
+    struct stream_renderer_box box = {
+        .x = (kResourceWidth - width) / 2,
+        .y = (kResourceHeight - height) / 2,
+        .z = 0,
+        .w = width,
+        .h = height,
+        .d = 1,
+    };
+
+    for (auto _ : state) {
+        int ret = 0;
+        switch (direction) {
+            case Direction::Read:
+                ret = stream_renderer_transfer_read_iov(kResourceId, 0, 0, 0, 0, &box, 0, nullptr,
+                                                        0);
+                break;
+            case Direction::Write:
+                ret = stream_renderer_transfer_write_iov(kResourceId, 0, 0, 0, 0, &box, 0,
+                                                         nullptr, 0);
+                break;
+        }
+        if (ret != 0) {
+            state.SkipWithError("Transfer failed");
+            break;
+        }
+    }
+
+    // Only the box should move, whatever the size of the resource.
+    const int64_t boxBytes = static_cast<int64_t>(width) * height * kBytesPerPixel;
+    state.counters["box_bytes"] = boxBytes;
+    state.SetBytesProcessed(state.iterations() * boxBytes);
+}
+
+void transferArgs(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"w", "h", "iov"});
+    const size_t resourceSize =
+        static_cast<size_t>(kResourceWidth) * kResourceHeight * kBytesPerPixel;
+    for (int64_t iovSize : {static_cast<int64_t>(kPageSize), static_cast<int64_t>(resourceSize)}) {
+        // A cursor, a partial update and the whole resource.
+        benchmark->Args({64, 64, iovSize});
+        benchmark->Args({512, 256, iovSize});
+        benchmark->Args({kResourceWidth, kResourceHeight, iovSize});
+    }
+}
+
+BENCHMARK_CAPTURE(BM_Transfer, Read, Direction::Read)->Apply(transferArgs);
+BENCHMARK_CAPTURE(BM_Transfer, Write, Direction::Write)->Apply(transferArgs);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,238 @@
+// Copyright (C) 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Replays a render thread stream capture (see StreamCapture.h) through the host decoders and
+// reports how long decoding took. Captures are recorded by setting RENDERER_DUMP_DIR.
+//
+// The renderer runs surfaceless, so the capture can be replayed on a machine without a GPU
+// by pointing it at software implementations, e.g. VK_ICD_FILENAMES for lavapipe or
+// SwiftShader Vulkan, and --gles for SwiftShader/ANGLE EGL.
+//
+// The guest stream refers to host objects by the handles the host returned while it was
+// captured. Those handles are only reproduced if the replay creates exactly the same host
+// objects in the same order, so captures should come from a session where the captured
+// context was the only one creating host objects. Each replay needs a fresh process for the
+// same reason.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RenderChannelImpl.h"
+#include "RenderThread.h"
+#include "StreamCapture.h"
+#include "aemu/base/system/System.h"
+#include "gfxstream/virtio-gpu-gfxstream-renderer.h"
+#include "host-common/opengles.h"
+
+namespace gfxstream {
+namespace {
+
+using IoResult = RenderChannel::IoResult;
+
+struct Options {
+    std::string capturePath;
+    bool vulkan = false;
+    bool gles = false;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+};
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [--vulkan] [--gles] [--width W] [--height H] <capture>\n"
+            "\n"
+            "Replays a render thread stream capture recorded with RENDERER_DUMP_DIR.\n"
+            "Without --vulkan or --gles, both are enabled.\n",
+            program);
+}
+
+bool parseOptions(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--vulkan") {
+            options->vulkan = true;
+        } else if (arg == "--gles") {
+            options->gles = true;
+        } else if ((arg == "--width" || arg == "--height") && i + 1 < argc) {
+            const uint32_t value = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+            (arg == "--width" ? options->width : options->height) = value;
+        } else if (!arg.empty() && arg[0] != '-' && options->capturePath.empty()) {
+            options->capturePath = arg;
+        } else {
+            return false;
+        }
+    }
+    if (!options->vulkan && !options->gles) {
+        options->vulkan = true;
+        options->gles = true;
+    }
+    return !options->capturePath.empty();
+}
+
+void onFence(void* /*cookie*/, struct stream_renderer_fence* /*fence*/) {}
+
+int initRenderer(const Options& options) {
+    uint64_t flags = STREAM_RENDERER_FLAGS_USE_SURFACELESS_BIT;
+    if (options.vulkan) {
+        flags |= STREAM_RENDERER_FLAGS_USE_VK_BIT;
+    }
+    if (options.gles) {
+        flags |= STREAM_RENDERER_FLAGS_USE_GLES_BIT | STREAM_RENDERER_FLAGS_USE_EGL_BIT;
+    }
+
+    std::vector<stream_renderer_param> params = {
+        {STREAM_RENDERER_PARAM_USER_DATA, 0},
+        {STREAM_RENDERER_PARAM_FENCE_CALLBACK,
+         static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&onFence))},
+        {STREAM_RENDERER_PARAM_RENDERER_FLAGS, flags},
+        {STREAM_RENDERER_PARAM_WIN0_WIDTH, options.width},
+        {STREAM_RENDERER_PARAM_WIN0_HEIGHT, options.height},
+    };
+    return stream_renderer_init(params.data(), params.size());
+}
+
+bool writeToChannel(RenderChannelImpl* channel, const char* data, size_t size) {
+    RenderChannel::Buffer buffer;
+    buffer.resize_noinit(size);
+    memcpy(buffer.data(), data, size);
+    while (true) {
+        const IoResult result = channel->tryWrite(std::move(buffer));
+        if (result == IoResult::Ok) {
+            return true;
+        }
+        if (result != IoResult::TryAgain) {
+            return false;
+        }
+        channel->waitUntilWritable();
+    }
+}
+
+int replay(const Options& options) {
+    auto reader = StreamCaptureReader::open(options.capturePath);
+    if (!reader) {
+        return EXIT_FAILURE;
+    }
+
+    // Load the whole capture up front so that disk reads do not show up in the timings.
+    std::vector<StreamCaptureRecord> records;
+    std::string processName = "<unknown>";
+    uint64_t captureBytes = 0;
+    StreamCaptureRecord record;
+    while (reader->next(&record)) {
+        if (record.type == StreamCaptureRecordType::kProcessName) {
+            processName.assign(record.payload.begin(), record.payload.end());
+        } else if (record.type == StreamCaptureRecordType::kGuestData) {
+            captureBytes += record.payload.size();
+            records.push_back(std::move(record));
+        }
+    }
+    const uint32_t contextId = reader->contextId();
+    const uint64_t captureDurationUs = records.empty() ? 0 : records.back().timestampUs;
+    reader.reset();
+
+    printf("Capture: %s\n", options.capturePath.c_str());
+    printf("  context id:   %" PRIu32 "\n", contextId);
+    printf("  process:      %s\n", processName.c_str());
+    printf("  records:      %zu\n", records.size());
+    printf("  guest bytes:  %" PRIu64 "\n", captureBytes);
+    printf("  captured in:  %.3f ms\n", captureDurationUs / 1000.0);
+
+    if (initRenderer(options) != 0) {
+        fprintf(stderr, "Failed to initialize the renderer.\n");
+        return EXIT_FAILURE;
+    }
+
+    const bool hasContextId = contextId != RenderThread::INVALID_CONTEXT_ID;
+    if (hasContextId) {
+        android_onGuestGraphicsProcessCreate(contextId);
+    }
+
+    const uint64_t startUs = android::base::getHighResTimeUs();
+
+    auto channel = std::make_shared<RenderChannelImpl>(nullptr, contextId);
+
+    // The render thread blocks once the host -> guest queue is full, so keep draining it.
+    std::atomic<uint64_t> hostBytes{0};
+    std::thread hostReader([&channel, &hostBytes]() {
+        RenderChannel::Buffer buffer;
+        while (true) {
+            const IoResult result =
+                channel->readBefore(&buffer, android::base::getUnixTimeUs() + 100000);
+            if (result == IoResult::Ok) {
+                hostBytes.fetch_add(buffer.size(), std::memory_order_relaxed);
+            } else if (result == IoResult::Error) {
+                break;
+            }
+        }
+    });
+
+    // The render thread starts by reading the connection flags, which are not captured.
+    const uint32_t connectionFlags = 0;
+    bool ok = writeToChannel(channel.get(), reinterpret_cast<const char*>(&connectionFlags),
+                             sizeof(connectionFlags));
+    for (const StreamCaptureRecord& guestData : records) {
+        if (!ok) {
+            break;
+        }
+        ok = writeToChannel(channel.get(), guestData.payload.data(), guestData.payload.size());
+    }
+    const uint64_t submittedUs = android::base::getHighResTimeUs();
+
+    // Stopping the channel lets the render thread decode what is still queued and then exit.
+    channel->stop();
+    channel->renderThread()->waitForFinished();
+    const uint64_t finishedUs = android::base::getHighResTimeUs();
+
+    hostReader.join();
+    channel.reset();
+
+    if (hasContextId) {
+        android_cleanupProcGLObjects(contextId);
+    }
+    stream_renderer_teardown();
+
+    if (!ok) {
+        fprintf(stderr, "The render thread stopped before the whole capture was submitted.\n");
+    }
+
+    const double elapsedMs = (finishedUs - startUs) / 1000.0;
+    printf("Replay:\n");
+    printf("  submitted in: %.3f ms\n", (submittedUs - startUs) / 1000.0);
+    printf("  decoded in:   %.3f ms\n", elapsedMs);
+    printf("  throughput:   %.3f MB/s\n",
+           elapsedMs > 0 ? (captureBytes / (1024.0 * 1024.0)) / (elapsedMs / 1000.0) : 0.0);
+    printf("  host bytes:   %" PRIu64 "\n", hostBytes.load(std::memory_order_relaxed));
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+}  // namespace
+}  // namespace gfxstream
+
+int main(int argc, char** argv) {
+    gfxstream::Options options;
+    if (!gfxstream::parseOptions(argc, argv, &options)) {
+        gfxstream::printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    return gfxstream::replay(options);
+}
@@ -30,9 +30,9 @@ struct BorrowedImageInfoVk : public BorrowedImageInfo {
 
     // The image layout that `image` is in before composition.
     //
-    // This is currently ignored for composition target images as
-    // composition targets are expected to be cleared during
-    // composition.
+    // For composition target images, this is only used when the
+    // composition keeps the previous contents outside of the
+    // damaged area. Otherwise targets are cleared.
     VkImageLayout preBorrowLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     // The queue family index that owns `image` before composition.
@@ -71,6 +71,18 @@ bool ColorBufferVk::updateFromBytes(uint32_t x, uint32_t y, uint32_t w, uint32_t
     return mVkEmulation.updateColorBufferFromBytes(mHandle, x, y, w, h, bytes);
 }
 
+bool ColorBufferVk::readToCallback(
+    uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+    const std::function<bool(const void* bytes, uint64_t size)>& consumeBytes) {
+    return mVkEmulation.readColorBufferToCallback(mHandle, x, y, w, h, consumeBytes);
+}
+
+bool ColorBufferVk::updateFromCallback(
+    uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+    const std::function<bool(void* bytes, uint64_t size)>& fillBytes) {
+    return mVkEmulation.updateColorBufferFromCallback(mHandle, x, y, w, h, fillBytes);
+}
+
 std::unique_ptr<BorrowedImageInfo> ColorBufferVk::borrowForComposition(bool colorBufferIsTarget) {
     return mVkEmulation.borrowColorBufferForComposition(mHandle, colorBufferIsTarget);
 }
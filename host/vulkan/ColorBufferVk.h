@@ -14,6 +14,7 @@
 
 #include <GLES2/gl2.h>
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -44,6 +45,12 @@ class ColorBufferVk {
     bool updateFromBytes(const std::vector<uint8_t>& bytes);
     bool updateFromBytes(uint32_t x, uint32_t y, uint32_t w, uint32_t h, const void* bytes);
 
+    // See VkEmulation::readColorBufferToCallback() and updateColorBufferFromCallback().
+    bool readToCallback(uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                        const std::function<bool(const void* bytes, uint64_t size)>& consumeBytes);
+    bool updateFromCallback(uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                            const std::function<bool(void* bytes, uint64_t size)>& fillBytes);
+
     std::unique_ptr<BorrowedImageInfo> borrowForComposition(bool colorBufferIsTarget);
     std::unique_ptr<BorrowedImageInfo> borrowForDisplay();
 
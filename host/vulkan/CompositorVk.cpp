@@ -2,6 +2,7 @@
 
 #include <string.h>
 
+#include <algorithm>
 #include <cinttypes>
 #include <glm/gtc/matrix_transform.hpp>
 #include <optional>
@@ -31,6 +32,12 @@ constexpr const VkImageLayout kSourceImageFinalLayoutUsed =
 
 constexpr const VkImageLayout kTargetImageInitialLayoutUsed = VK_IMAGE_LAYOUT_UNDEFINED;
 constexpr const VkImageLayout kTargetImageFinalLayoutUsed = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+// When only the damaged area is redrawn, the rest of the target has to be kept.
+constexpr const VkImageLayout kTargetImageDamageInitialLayoutUsed =
+    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+// Used instead of the render pass when the composition is a copy of a single layer.
+constexpr const VkImageLayout kTargetImageCopyLayoutUsed = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+constexpr const VkImageLayout kSourceImageCopyLayoutUsed = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 
 const BorrowedImageInfoVk* getInfoOrAbort(const std::unique_ptr<BorrowedImageInfo>& info) {
     auto imageVk = static_cast<const BorrowedImageInfoVk*>(info.get());
@@ -42,6 +49,36 @@ const BorrowedImageInfoVk* getInfoOrAbort(const std::unique_ptr<BorrowedImageInf
         << "CompositorVk did not find BorrowedImageInfoVk";
 }
 
+// The composition draws the layer over opaque black with premultiplied blending. For a layer
+// without any scaling, transform or alpha, whose alpha the guest asks to ignore, that gives the
+// same colors as copying the source. The copy keeps the alpha channel of the source, which
+// recordDirectCopy() then overwrites with 1, as the composition always leaves an opaque target.
+bool canCopyInsteadOfCompose(const ComposeLayer& layer, const BorrowedImageInfoVk& source,
+                             const BorrowedImageInfoVk& target) {
+    const VkExtent3D& sourceExtent = source.imageCreateInfo.extent;
+    const VkExtent3D& targetExtent = target.imageCreateInfo.extent;
+    if (layer.composeMode != HWC2_COMPOSITION_DEVICE || layer.blendMode != HWC2_BLEND_MODE_NONE ||
+        layer.alpha != 1.0f || layer.transform != HWC_TRANSFORM_NONE) {
+        return false;
+    }
+    if (source.imageCreateInfo.format != target.imageCreateInfo.format ||
+        sourceExtent.width != targetExtent.width || sourceExtent.height != targetExtent.height ||
+        source.width != sourceExtent.width || source.height != sourceExtent.height) {
+        return false;
+    }
+    if (!(source.imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) ||
+        !(target.imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+        return false;
+    }
+    const hwc_rect_t& frame = layer.displayFrame;
+    const hwc_frect_t& crop = layer.crop;
+    return frame.left == 0 && frame.top == 0 &&
+           frame.right == static_cast<int>(targetExtent.width) &&
+           frame.bottom == static_cast<int>(targetExtent.height) && crop.left == 0.0f &&
+           crop.top == 0.0f && crop.right == static_cast<float>(sourceExtent.width) &&
+           crop.bottom == static_cast<float>(sourceExtent.height);
+}
+
 struct Vertex {
     alignas(8) glm::vec2 pos;
     alignas(8) glm::vec2 tex;
@@ -161,6 +198,10 @@ CompositorVk::CompositorVk(const VulkanDispatch& vk, VkDevice vkDevice,
       m_renderTargetCache(k_renderTargetCacheSize) {}
 
 CompositorVk::~CompositorVk() {
+    INFO("CompositorVk: %" PRIu64 " compositions, %" PRIu64 " skipped, %" PRIu64
+         " damage only, %" PRIu64 " direct copies, %" PRIu64 " pixels composed.",
+         m_stats.compositions, m_stats.skippedCompositions, m_stats.damageCompositions,
+         m_stats.directCopies, m_stats.composedPixels);
     {
         android::base::AutoLock lock(*m_vkQueueLock);
         VK_CHECK(vk_util::waitForVkQueueIdleWithRetry(m_vk, m_vkQueue));
@@ -187,6 +228,9 @@ CompositorVk::~CompositorVk() {
     for (auto& [_, formatResources] : m_formatResources) {
         m_vk.vkDestroyPipeline(m_vkDevice, formatResources.m_graphicsVkPipeline, nullptr);
         m_vk.vkDestroyRenderPass(m_vkDevice, formatResources.m_vkRenderPass, nullptr);
+        m_vk.vkDestroyRenderPass(m_vkDevice, formatResources.m_vkDamageRenderPass, nullptr);
+        m_vk.vkDestroyPipeline(m_vkDevice, formatResources.m_alphaFixupVkPipeline, nullptr);
+        m_vk.vkDestroyRenderPass(m_vkDevice, formatResources.m_vkAlphaFixupRenderPass, nullptr);
     }
     m_vk.vkDestroyPipelineLayout(m_vkDevice, m_vkPipelineLayout, nullptr);
     m_vk.vkDestroySampler(m_vkDevice, m_vkSampler, nullptr);
@@ -380,6 +424,71 @@ void CompositorVk::setUpGraphicsPipeline() {
         .pDependencies = &subpassDependency,
     };
 
+    // The clear only applies to the render area, which is set to the damaged area, and the
+    // initial layout keeps the contents outside of it. The previous composition into the
+    // target may still be read by the blit to the display.
+    VkAttachmentDescription damageColorAttachment = colorAttachment;
+    damageColorAttachment.initialLayout = kTargetImageDamageInitialLayoutUsed;
+
+    const VkSubpassDependency damageSubpassDependency = {
+        .srcSubpass = VK_SUBPASS_EXTERNAL,
+        .dstSubpass = 0,
+        .srcStageMask =
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask =
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+    };
+
+    const VkRenderPassCreateInfo damageRenderPassCi = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &damageColorAttachment,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = 1,
+        .pDependencies = &damageSubpassDependency,
+    };
+
+    // Draws over the result of recordDirectCopy(), so the contents are loaded instead of cleared.
+    VkAttachmentDescription alphaFixupColorAttachment = colorAttachment;
+    alphaFixupColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    alphaFixupColorAttachment.initialLayout = kTargetImageCopyLayoutUsed;
+
+    const VkSubpassDependency alphaFixupSubpassDependency = {
+        .srcSubpass = VK_SUBPASS_EXTERNAL,
+        .dstSubpass = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask =
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+    };
+
+    const VkRenderPassCreateInfo alphaFixupRenderPassCi = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &alphaFixupColorAttachment,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = 1,
+        .pDependencies = &alphaFixupSubpassDependency,
+    };
+
+    // Only writes the alpha channel, leaving the copied colors alone.
+    const VkPipelineColorBlendAttachmentState alphaFixupColorBlendAttachment = {
+        .blendEnable = VK_FALSE,
+        .colorWriteMask = VK_COLOR_COMPONENT_A_BIT,
+    };
+
+    const VkPipelineColorBlendStateCreateInfo alphaFixupColorBlendStateCi = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .logicOpEnable = VK_FALSE,
+        .attachmentCount = 1,
+        .pAttachments = &alphaFixupColorBlendAttachment,
+    };
+
     VkGraphicsPipelineCreateInfo graphicsPipelineCi = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
         .stageCount = static_cast<uint32_t>(std::size(shaderStageCis)),
@@ -405,19 +514,42 @@ void CompositorVk::setUpGraphicsPipeline() {
     };
     for (VkFormat renderTargetFormat : kRenderTargetFormats) {
         colorAttachment.format = renderTargetFormat;
+        damageColorAttachment.format = renderTargetFormat;
+        alphaFixupColorAttachment.format = renderTargetFormat;
 
         VkRenderPass renderPass = VK_NULL_HANDLE;
         VK_CHECK(m_vk.vkCreateRenderPass(m_vkDevice, &renderPassCi, nullptr, &renderPass));
 
+        // Compatible with `renderPass`, so the same pipeline and framebuffers work with both.
+        VkRenderPass damageRenderPass = VK_NULL_HANDLE;
+        VK_CHECK(
+            m_vk.vkCreateRenderPass(m_vkDevice, &damageRenderPassCi, nullptr, &damageRenderPass));
+
         graphicsPipelineCi.renderPass = renderPass;
 
         VkPipeline pipeline = VK_NULL_HANDLE;
         VK_CHECK(m_vk.vkCreateGraphicsPipelines(m_vkDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCi,
                                                 nullptr, &pipeline));
 
+        // Also compatible with `renderPass`.
+        VkRenderPass alphaFixupRenderPass = VK_NULL_HANDLE;
+        VK_CHECK(m_vk.vkCreateRenderPass(m_vkDevice, &alphaFixupRenderPassCi, nullptr,
+                                         &alphaFixupRenderPass));
+
+        VkGraphicsPipelineCreateInfo alphaFixupPipelineCi = graphicsPipelineCi;
+        alphaFixupPipelineCi.pColorBlendState = &alphaFixupColorBlendStateCi;
+
+        VkPipeline alphaFixupPipeline = VK_NULL_HANDLE;
+        VK_CHECK(m_vk.vkCreateGraphicsPipelines(m_vkDevice, VK_NULL_HANDLE, 1,
+                                                &alphaFixupPipelineCi, nullptr,
+                                                &alphaFixupPipeline));
+
         m_formatResources[renderTargetFormat] = PerFormatResources{
             .m_vkRenderPass = renderPass,
+            .m_vkDamageRenderPass = damageRenderPass,
+            .m_vkAlphaFixupRenderPass = alphaFixupRenderPass,
             .m_graphicsVkPipeline = pipeline,
+            .m_alphaFixupVkPipeline = alphaFixupPipeline,
         };
     }
 
@@ -957,8 +1089,11 @@ void CompositorVk::buildCompositionVk(const CompositionRequest& compositionReque
 
     compositionVk->targetImage = targetImage;
     compositionVk->targetRenderPass = formatResources.m_vkRenderPass;
+    compositionVk->targetDamageRenderPass = formatResources.m_vkDamageRenderPass;
     compositionVk->targetFramebuffer = targetImageRenderTarget->m_vkFramebuffer;
     compositionVk->pipeline = formatResources.m_graphicsVkPipeline;
+    compositionVk->targetAlphaFixupRenderPass = formatResources.m_vkAlphaFixupRenderPass;
+    compositionVk->alphaFixupPipeline = formatResources.m_alphaFixupVkPipeline;
 
     for (const CompositionRequestLayer& layer : compositionRequest.layers) {
         uint32_t sourceImageWidth = 0;
@@ -1058,6 +1193,7 @@ void CompositorVk::buildCompositionVk(const CompositionRequest& compositionReque
                 },
         };
 
+        uint64_t contentGeneration = 0;
         if (layer.props.composeMode == HWC2_COMPOSITION_SOLID_COLOR) {
             descriptorSetContents.binding0.sampledImageId = 0;
             descriptorSetContents.binding0.sampledImageView = m_defaultImage.m_vkImageView;
@@ -1075,9 +1211,18 @@ void CompositorVk::buildCompositionVk(const CompositionRequest& compositionReque
             descriptorSetContents.binding0.sampledImageId = sourceImage->id;
             descriptorSetContents.binding0.sampledImageView = sourceImage->imageView;
             compositionVk->layersSourceImages.emplace_back(sourceImage);
+            contentGeneration = sourceImage->contentGeneration;
         }
 
         compositionVk->layersDescriptorSets.descriptorSets.emplace_back(descriptorSetContents);
+        compositionVk->layersContentGenerations.push_back(contentGeneration);
+        compositionVk->layersDisplayFrames.push_back(layer.props.displayFrame);
+    }
+
+    if (compositionRequest.layers.size() == 1 && compositionVk->layersSourceImages.size() == 1 &&
+        canCopyInsteadOfCompose(compositionRequest.layers[0].props,
+                                *compositionVk->layersSourceImages[0], *targetImage)) {
+        compositionVk->directCopySource = compositionVk->layersSourceImages[0];
     }
 }
 
@@ -1094,6 +1239,50 @@ CompositorVk::CompositionFinishedWaitable CompositorVk::compose(
     CompositionVk compositionVk;
     buildCompositionVk(compositionRequest, &compositionVk);
 
+    const BorrowedImageInfoVk& targetImage = *compositionVk.targetImage;
+    const uint32_t targetWidth = targetImage.imageCreateInfo.extent.width;
+    const uint32_t targetHeight = targetImage.imageCreateInfo.extent.height;
+    // The composition itself bumps the generation of the target.
+    const uint64_t targetContentGeneration =
+        targetImage.contentGeneration == 0 ? 0 : targetImage.contentGeneration + 1;
+
+    std::optional<VkRect2D> damage;
+    auto lastCompositionIt = m_lastCompositions.find(targetImage.id);
+    if (lastCompositionIt != m_lastCompositions.end()) {
+        damage = getDamage(compositionVk, lastCompositionIt->second);
+    }
+
+    ++m_stats.compositions;
+    if (damage && (damage->extent.width == 0 || damage->extent.height == 0)) {
+        ++m_stats.skippedCompositions;
+        VERBOSE("CompositorVk composition:%d into ColorBuffer:%d skipped, nothing changed.",
+                thisCompositionNumber, targetImage.id);
+
+        TargetComposition& lastComposition = lastCompositionIt->second;
+        lastComposition.targetContentGeneration = targetContentGeneration;
+        return lastComposition.finished;
+    }
+
+    const VkRect2D renderArea = damage.value_or(VkRect2D{
+        .offset = {.x = 0, .y = 0},
+        .extent = {.width = targetWidth, .height = targetHeight},
+    });
+    const uint64_t composedPixels =
+        static_cast<uint64_t>(renderArea.extent.width) * renderArea.extent.height;
+    if (damage) {
+        ++m_stats.damageCompositions;
+    }
+    if (compositionVk.directCopySource != nullptr) {
+        ++m_stats.directCopies;
+    }
+    m_stats.composedPixels += composedPixels;
+    VERBOSE("CompositorVk composition:%d into ColorBuffer:%d redraws %" PRIu64 " of %" PRIu64
+            " pixels.",
+            thisCompositionNumber, targetImage.id, composedPixels,
+            static_cast<uint64_t>(targetWidth) * targetHeight);
+    GFXSTREAM_TRACE_EVENT_INSTANT(GFXSTREAM_TRACE_DEFAULT_CATEGORY, "CompositorVk damage",
+                                  "Composed pixels", composedPixels);
+
     // Grab and wait for the next available resources.
     if (m_availableFrameResources.empty()) {
         GFXSTREAM_ABORT(FatalError(ABORT_REASON_OTHER))
@@ -1103,21 +1292,35 @@ CompositorVk::CompositionFinishedWaitable CompositorVk::compose(
     m_availableFrameResources.pop_front();
     PerFrameResources* frameResources = frameResourceFuture.get();
 
-    updateDescriptorSetsIfChanged(compositionVk.layersDescriptorSets, frameResources);
+    const bool directCopy = compositionVk.directCopySource != nullptr;
+    if (directCopy) {
+        updateDescriptorSetsIfChanged(getAlphaFixupDescriptorSetsContents(), frameResources);
+    } else {
+        updateDescriptorSetsIfChanged(compositionVk.layersDescriptorSets, frameResources);
+    }
+
+    VkImageLayout targetInitialLayout = kTargetImageInitialLayoutUsed;
+    if (directCopy) {
+        targetInitialLayout = kTargetImageCopyLayoutUsed;
+    } else if (damage) {
+        targetInitialLayout = kTargetImageDamageInitialLayoutUsed;
+    }
 
     std::vector<VkImageMemoryBarrier> preCompositionQueueTransferBarriers;
     std::vector<VkImageMemoryBarrier> preCompositionLayoutTransitionBarriers;
     std::vector<VkImageMemoryBarrier> postCompositionLayoutTransitionBarriers;
     std::vector<VkImageMemoryBarrier> postCompositionQueueTransferBarriers;
     addNeededBarriersToUseBorrowedImage(
-        *compositionVk.targetImage, m_queueFamilyIndex, kTargetImageInitialLayoutUsed,
-        kTargetImageFinalLayoutUsed, VK_ACCESS_MEMORY_WRITE_BIT,
+        targetImage, m_queueFamilyIndex, targetInitialLayout, kTargetImageFinalLayoutUsed,
+        VK_ACCESS_MEMORY_WRITE_BIT,
         &preCompositionQueueTransferBarriers, &preCompositionLayoutTransitionBarriers,
         &postCompositionLayoutTransitionBarriers, &postCompositionQueueTransferBarriers);
     for (const BorrowedImageInfoVk* sourceImage : compositionVk.layersSourceImages) {
         addNeededBarriersToUseBorrowedImage(
-            *sourceImage, m_queueFamilyIndex, kSourceImageInitialLayoutUsed,
-            kSourceImageFinalLayoutUsed, VK_ACCESS_SHADER_READ_BIT,
+            *sourceImage, m_queueFamilyIndex,
+            directCopy ? kSourceImageCopyLayoutUsed : kSourceImageInitialLayoutUsed,
+            directCopy ? kSourceImageCopyLayoutUsed : kSourceImageFinalLayoutUsed,
+            directCopy ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_SHADER_READ_BIT,
             &preCompositionQueueTransferBarriers, &preCompositionLayoutTransitionBarriers,
             &postCompositionLayoutTransitionBarriers, &postCompositionQueueTransferBarriers);
     }
@@ -1162,6 +1365,103 @@ CompositorVk::CompositionFinishedWaitable CompositorVk::compose(
             preCompositionLayoutTransitionBarriers.data());
     }
 
+    if (compositionVk.directCopySource != nullptr) {
+        recordDirectCopy(commandBuffer, compositionVk, *frameResources, renderArea);
+    } else {
+        recordLayers(commandBuffer, compositionVk, *frameResources, damage.has_value(),
+                     renderArea);
+    }
+
+    if (!postCompositionLayoutTransitionBarriers.empty()) {
+        m_vk.vkCmdPipelineBarrier(
+            commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0, 0, nullptr, 0, nullptr,
+            static_cast<uint32_t>(postCompositionLayoutTransitionBarriers.size()),
+            postCompositionLayoutTransitionBarriers.data());
+    }
+    if (!postCompositionQueueTransferBarriers.empty()) {
+        m_vk.vkCmdPipelineBarrier(
+            commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0, 0, nullptr, 0, nullptr,
+            static_cast<uint32_t>(postCompositionQueueTransferBarriers.size()),
+            postCompositionQueueTransferBarriers.data());
+    }
+
+    m_debugUtilsHelper.cmdEndDebugLabel(commandBuffer);
+
+    VK_CHECK(m_vk.vkEndCommandBuffer(commandBuffer));
+
+    VkFence composeCompleteFence = frameResources->m_vkFence;
+    m_debugUtilsHelper.addDebugLabel(
+        composeCompleteFence, "CompositorVk composition:%d complete fence", thisCompositionNumber);
+
+    VK_CHECK(m_vk.vkResetFences(m_vkDevice, 1, &composeCompleteFence));
+
+    const VkPipelineStageFlags submitWaitStages[] = {
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+    };
+    const VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = 0,
+        .pWaitSemaphores = nullptr,
+        .pWaitDstStageMask = submitWaitStages,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBuffer,
+        .signalSemaphoreCount = 0,
+        .pSignalSemaphores = nullptr,
+    };
+
+    {
+        android::base::AutoLock lock(*m_vkQueueLock);
+        VK_CHECK(m_vk.vkQueueSubmit(m_vkQueue, 1, &submitInfo, composeCompleteFence));
+    }
+
+    // Create a future that will return the PerFrameResources to the next
+    // iteration of CompostiorVk::compose() once this current composition
+    // completes.
+    std::shared_future<PerFrameResources*> composeCompleteFutureForResources =
+        std::async(std::launch::deferred, [composeCompleteFence, frameResources, traceId,
+                                           this]() mutable {
+            (void)traceId;
+            GFXSTREAM_TRACE_EVENT(GFXSTREAM_TRACE_DEFAULT_CATEGORY, "Wait for compose fence",
+                                  GFXSTREAM_TRACE_FLOW(traceId));
+
+            VkResult res = m_vk.vkWaitForFences(m_vkDevice, 1, &composeCompleteFence, VK_TRUE,
+                                                kVkWaitForFencesTimeoutNsecs);
+            if (res == VK_SUCCESS) {
+                return frameResources;
+            }
+            if (res == VK_TIMEOUT) {
+                // Retry. If device lost, hopefully this returns immediately.
+                res = m_vk.vkWaitForFences(m_vkDevice, 1, &composeCompleteFence, VK_TRUE,
+                                           kVkWaitForFencesTimeoutNsecs);
+            }
+            VK_CHECK(res);
+            return frameResources;
+        }).share();
+    m_availableFrameResources.push_back(composeCompleteFutureForResources);
+
+    // Create a future that will return once this current composition
+    // completes that can be shared outside of CompositorVk.
+    std::shared_future<void> composeCompleteFuture =
+        std::async(std::launch::deferred, [composeCompleteFutureForResources]() {
+            composeCompleteFutureForResources.get();
+        }).share();
+
+    m_lastCompositions[targetImage.id] = TargetComposition{
+        .targetContentGeneration = targetContentGeneration,
+        .layersDescriptorSets = std::move(compositionVk.layersDescriptorSets),
+        .layersContentGenerations = std::move(compositionVk.layersContentGenerations),
+        .layersDisplayFrames = std::move(compositionVk.layersDisplayFrames),
+        .finished = composeCompleteFuture,
+    };
+
+    return composeCompleteFuture;
+}
+
+void CompositorVk::recordLayers(VkCommandBuffer commandBuffer, const CompositionVk& compositionVk,
+                                const PerFrameResources& frameResources, bool onlyDamage,
+                                const VkRect2D& renderArea) {
     const VkClearValue renderTargetClearColor = {
         .color =
             {
@@ -1170,21 +1470,10 @@ CompositorVk::CompositionFinishedWaitable CompositorVk::compose(
     };
     const VkRenderPassBeginInfo renderPassBeginInfo = {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .renderPass = compositionVk.targetRenderPass,
+        .renderPass = onlyDamage ? compositionVk.targetDamageRenderPass
+                                 : compositionVk.targetRenderPass,
         .framebuffer = compositionVk.targetFramebuffer,
-        .renderArea =
-            {
-                .offset =
-                    {
-                        .x = 0,
-                        .y = 0,
-                    },
-                .extent =
-                    {
-                        .width = compositionVk.targetImage->imageCreateInfo.extent.width,
-                        .height = compositionVk.targetImage->imageCreateInfo.extent.height,
-                    },
-            },
+        .renderArea = renderArea,
         .clearValueCount = 1,
         .pClearValues = &renderTargetClearColor,
     };
@@ -1192,19 +1481,8 @@ CompositorVk::CompositionFinishedWaitable CompositorVk::compose(
 
     m_vk.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, compositionVk.pipeline);
 
-    const VkRect2D scissor = {
-        .offset =
-            {
-                .x = 0,
-                .y = 0,
-            },
-        .extent =
-            {
-                .width = compositionVk.targetImage->imageCreateInfo.extent.width,
-                .height = compositionVk.targetImage->imageCreateInfo.extent.height,
-            },
-    };
-    m_vk.vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    // Layers are drawn in full, the scissor keeps them inside of the damaged area.
+    m_vk.vkCmdSetScissor(commandBuffer, 0, 1, &renderArea);
 
     const VkViewport viewport = {
         .x = 0.0f,
@@ -1226,7 +1504,7 @@ CompositorVk::CompositionFinishedWaitable CompositorVk::compose(
         m_debugUtilsHelper.cmdBeginDebugLabel(commandBuffer, "CompositorVk compose layer:%d",
                                               layerIndex);
 
-        VkDescriptorSet layerDescriptorSet = frameResources->m_layerDescriptorSets[layerIndex];
+        VkDescriptorSet layerDescriptorSet = frameResources.m_layerDescriptorSets[layerIndex];
 
         m_vk.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                                      m_vkPipelineLayout,
@@ -1269,87 +1547,191 @@ CompositorVk::CompositionFinishedWaitable CompositorVk::compose(
                               /*pMemoryBarriers=*/nullptr,
                               /*bufferMemoryBarrierCount=*/0,
                               /*pBufferMemoryBarriers=*/nullptr, 1, &renderTargetBarrier);
+}
 
-    if (!postCompositionLayoutTransitionBarriers.empty()) {
-        m_vk.vkCmdPipelineBarrier(
-            commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            0, 0, nullptr, 0, nullptr,
-            static_cast<uint32_t>(postCompositionLayoutTransitionBarriers.size()),
-            postCompositionLayoutTransitionBarriers.data());
-    }
-    if (!postCompositionQueueTransferBarriers.empty()) {
-        m_vk.vkCmdPipelineBarrier(
-            commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            0, 0, nullptr, 0, nullptr,
-            static_cast<uint32_t>(postCompositionQueueTransferBarriers.size()),
-            postCompositionQueueTransferBarriers.data());
-    }
-
-    m_debugUtilsHelper.cmdEndDebugLabel(commandBuffer);
+void CompositorVk::recordDirectCopy(VkCommandBuffer commandBuffer,
+                                    const CompositionVk& compositionVk,
+                                    const PerFrameResources& frameResources,
+                                    const VkRect2D& renderArea) {
+    const VkImageCopy region = {
+        .srcSubresource =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        .srcOffset = {.x = renderArea.offset.x, .y = renderArea.offset.y, .z = 0},
+        .dstSubresource =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        .dstOffset = {.x = renderArea.offset.x, .y = renderArea.offset.y, .z = 0},
+        .extent =
+            {
+                .width = renderArea.extent.width,
+                .height = renderArea.extent.height,
+                .depth = 1,
+            },
+    };
+    m_vk.vkCmdCopyImage(commandBuffer, compositionVk.directCopySource->image,
+                        kSourceImageCopyLayoutUsed, compositionVk.targetImage->image,
+                        kTargetImageCopyLayoutUsed, 1, &region);
 
-    VK_CHECK(m_vk.vkEndCommandBuffer(commandBuffer));
+    // The copy also took the alpha channel of the source, overwrite it with the opaque alpha the
+    // composition would have left. The render pass leaves the target in the same state as after
+    // the composition.
+    const VkRenderPassBeginInfo renderPassBeginInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = compositionVk.targetAlphaFixupRenderPass,
+        .framebuffer = compositionVk.targetFramebuffer,
+        .renderArea = renderArea,
+        .clearValueCount = 0,
+        .pClearValues = nullptr,
+    };
+    m_vk.vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-    VkFence composeCompleteFence = frameResources->m_vkFence;
-    m_debugUtilsHelper.addDebugLabel(
-        composeCompleteFence, "CompositorVk composition:%d complete fence", thisCompositionNumber);
+    m_vk.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                           compositionVk.alphaFixupPipeline);
 
-    VK_CHECK(m_vk.vkResetFences(m_vkDevice, 1, &composeCompleteFence));
+    m_vk.vkCmdSetScissor(commandBuffer, 0, 1, &renderArea);
 
-    const VkPipelineStageFlags submitWaitStages[] = {
-        VK_PIPELINE_STAGE_TRANSFER_BIT,
+    const VkViewport viewport = {
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = static_cast<float>(compositionVk.targetImage->imageCreateInfo.extent.width),
+        .height = static_cast<float>(compositionVk.targetImage->imageCreateInfo.extent.height),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
     };
-    const VkSubmitInfo submitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount = 0,
-        .pWaitSemaphores = nullptr,
-        .pWaitDstStageMask = submitWaitStages,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &commandBuffer,
-        .signalSemaphoreCount = 0,
-        .pSignalSemaphores = nullptr,
+    m_vk.vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    const VkDeviceSize offsets[] = {0};
+    m_vk.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_vertexVkBuffer, offsets);
+
+    m_vk.vkCmdBindIndexBuffer(commandBuffer, m_indexVkBuffer, 0, VK_INDEX_TYPE_UINT16);
+
+    m_vk.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 m_vkPipelineLayout,
+                                 /*firstSet=*/0,
+                                 /*descriptorSetCount=*/1,
+                                 &frameResources.m_layerDescriptorSets[0],
+                                 /*dynamicOffsetCount=*/0,
+                                 /*pDynamicOffsets=*/nullptr);
+
+    m_vk.vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(k_indices.size()), 1, 0, 0, 0);
+
+    m_vk.vkCmdEndRenderPass(commandBuffer);
+
+    // Insert a VkImageMemoryBarrier so that the vkCmdBlitImage in post will wait for the rendering
+    // to the render target to complete.
+    const VkImageMemoryBarrier renderTargetBarrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
+        .oldLayout = kTargetImageFinalLayoutUsed,
+        .newLayout = kTargetImageFinalLayoutUsed,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = compositionVk.targetImage->image,
+        .subresourceRange =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
     };
+    m_vk.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                              VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              /*dependencyFlags=*/0,
+                              /*memoryBarrierCount=*/0,
+                              /*pMemoryBarriers=*/nullptr,
+                              /*bufferMemoryBarrierCount=*/0,
+                              /*pBufferMemoryBarriers=*/nullptr, 1, &renderTargetBarrier);
+}
 
-    {
-        android::base::AutoLock lock(*m_vkQueueLock);
-        VK_CHECK(m_vk.vkQueueSubmit(m_vkQueue, 1, &submitInfo, composeCompleteFence));
+std::optional<VkRect2D> CompositorVk::getDamage(const CompositionVk& compositionVk,
+                                                const TargetComposition& lastComposition) {
+    const BorrowedImageInfoVk& targetImage = *compositionVk.targetImage;
+
+    // The target has to still hold the last composition, in a layout which keeps it.
+    if (targetImage.contentGeneration == 0 ||
+        targetImage.contentGeneration != lastComposition.targetContentGeneration ||
+        targetImage.preBorrowLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
+        return std::nullopt;
     }
 
-    // Create a future that will return the PerFrameResources to the next
-    // iteration of CompostiorVk::compose() once this current composition
-    // completes.
-    std::shared_future<PerFrameResources*> composeCompleteFutureForResources =
-        std::async(std::launch::deferred, [composeCompleteFence, frameResources, traceId,
-                                           this]() mutable {
-            (void)traceId;
-            GFXSTREAM_TRACE_EVENT(GFXSTREAM_TRACE_DEFAULT_CATEGORY, "Wait for compose fence",
-                                  GFXSTREAM_TRACE_FLOW(traceId));
+    const auto& descriptorSets = compositionVk.layersDescriptorSets.descriptorSets;
+    const auto& lastDescriptorSets = lastComposition.layersDescriptorSets.descriptorSets;
+    if (descriptorSets.size() != lastDescriptorSets.size()) {
+        return std::nullopt;
+    }
 
-            VkResult res = m_vk.vkWaitForFences(m_vkDevice, 1, &composeCompleteFence, VK_TRUE,
-                                                kVkWaitForFencesTimeoutNsecs);
-            if (res == VK_SUCCESS) {
-                return frameResources;
-            }
-            if (res == VK_TIMEOUT) {
-                // Retry. If device lost, hopefully this returns immediately.
-                res = m_vk.vkWaitForFences(m_vkDevice, 1, &composeCompleteFence, VK_TRUE,
-                                           kVkWaitForFencesTimeoutNsecs);
-            }
-            VK_CHECK(res);
-            return frameResources;
-        }).share();
-    m_availableFrameResources.push_back(composeCompleteFutureForResources);
+    const int32_t targetWidth = static_cast<int32_t>(targetImage.imageCreateInfo.extent.width);
+    const int32_t targetHeight = static_cast<int32_t>(targetImage.imageCreateInfo.extent.height);
+    int32_t left = targetWidth;
+    int32_t top = targetHeight;
+    int32_t right = 0;
+    int32_t bottom = 0;
+    auto addToDamage = [&](const hwc_rect_t& rect) {
+        left = std::min(left, std::max(rect.left, 0));
+        top = std::min(top, std::max(rect.top, 0));
+        right = std::max(right, std::min(rect.right, targetWidth));
+        bottom = std::max(bottom, std::min(rect.bottom, targetHeight));
+    };
 
-    // Create a future that will return once this current composition
-    // completes that can be shared outside of CompositorVk.
-    std::shared_future<void> composeCompleteFuture =
-        std::async(std::launch::deferred, [composeCompleteFutureForResources]() {
-            composeCompleteFutureForResources.get();
-        }).share();
+    // A changed layer has to be redrawn where it was and where it is now, together with
+    // everything else covering those areas.
+    for (size_t i = 0; i < descriptorSets.size(); ++i) {
+        bool changed = !(descriptorSets[i] == lastDescriptorSets[i]);
+        const bool isSolidColor = descriptorSets[i].binding1.mode.x ==
+                                  static_cast<uint32_t>(HWC2_COMPOSITION_SOLID_COLOR);
+        if (!isSolidColor) {
+            const uint64_t contentGeneration = compositionVk.layersContentGenerations[i];
+            changed |= contentGeneration == 0 ||
+                       contentGeneration != lastComposition.layersContentGenerations[i];
+        }
+        if (changed) {
+            addToDamage(lastComposition.layersDisplayFrames[i]);
+            addToDamage(compositionVk.layersDisplayFrames[i]);
+        }
+    }
 
-    return composeCompleteFuture;
+    if (left < right && top < bottom) {
+        return VkRect2D{
+            .offset = {.x = left, .y = top},
+            .extent =
+                {
+                    .width = static_cast<uint32_t>(right - left),
+                    .height = static_cast<uint32_t>(bottom - top),
+                },
+        };
+    }
+
+    // Nothing to redraw, but skipping the composition also skips its barriers, so the images
+    // have to already be where the barriers would leave them.
+    auto staysInPlace = [](const BorrowedImageInfoVk& image) {
+        return image.preBorrowLayout == image.postBorrowLayout &&
+               image.preBorrowQueueFamilyIndex == image.postBorrowQueueFamilyIndex;
+    };
+    if (!staysInPlace(targetImage) ||
+        !std::all_of(compositionVk.layersSourceImages.begin(),
+                     compositionVk.layersSourceImages.end(),
+                     [&](const BorrowedImageInfoVk* image) { return staysInPlace(*image); })) {
+        return std::nullopt;
+    }
+    return VkRect2D{};
 }
 
-void CompositorVk::onImageDestroyed(uint32_t imageId) { m_renderTargetCache.remove(imageId); }
+void CompositorVk::onImageDestroyed(uint32_t imageId) {
+    m_renderTargetCache.remove(imageId);
+    m_lastCompositions.erase(imageId);
+}
 
 bool operator==(const CompositorVkBase::DescriptorSetContents& lhs,
                 const CompositorVkBase::DescriptorSetContents& rhs) {
@@ -1375,6 +1757,32 @@ bool operator==(const CompositorVkBase::FrameDescriptorSetsContents& lhs,
     return lhs.descriptorSets == rhs.descriptorSets;
 }
 
+CompositorVk::FrameDescriptorSetsContents CompositorVk::getAlphaFixupDescriptorSetsContents()
+    const {
+    // An opaque black solid color over the whole target, only its alpha gets written.
+    return FrameDescriptorSetsContents{
+        .descriptorSets =
+            {
+                DescriptorSetContents{
+                    .binding0 =
+                        {
+                            .sampledImageId = 0,
+                            .sampledImageView = m_defaultImage.m_vkImageView,
+                        },
+                    .binding1 =
+                        {
+                            .positionTransform = glm::mat4(1.0f),
+                            .texCoordTransform = glm::mat4(1.0f),
+                            .mode = glm::uvec4(
+                                static_cast<uint32_t>(HWC2_COMPOSITION_SOLID_COLOR), 0, 0, 0),
+                            .alpha = glm::vec4(1.0f),
+                            .color = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+                        },
+                },
+            },
+    };
+}
+
 void CompositorVk::updateDescriptorSetsIfChanged(
     const FrameDescriptorSetsContents& descriptorSetsContents, PerFrameResources* frameResources) {
     if (frameResources->m_vkDescriptorSetsContents == descriptorSetsContents) {
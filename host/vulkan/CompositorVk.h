@@ -48,7 +48,12 @@ struct CompositorVkBase : public vk_util::MultiCrtp<CompositorVkBase,         //
     VkPipelineLayout m_vkPipelineLayout;
     struct PerFormatResources {
         VkRenderPass m_vkRenderPass = VK_NULL_HANDLE;
+        // Same as `m_vkRenderPass` but keeps the target contents outside of the render area.
+        VkRenderPass m_vkDamageRenderPass = VK_NULL_HANDLE;
+        // Loads the result of a direct copy and only writes the alpha channel.
+        VkRenderPass m_vkAlphaFixupRenderPass = VK_NULL_HANDLE;
         VkPipeline m_graphicsVkPipeline = VK_NULL_HANDLE;
+        VkPipeline m_alphaFixupVkPipeline = VK_NULL_HANDLE;
     };
     std::unordered_map<VkFormat, PerFormatResources> m_formatResources;
     VkBuffer m_vertexVkBuffer;
@@ -157,6 +162,20 @@ class CompositorVk : protected CompositorVkBase, public Compositor {
 
     void onImageDestroyed(uint32_t imageId) override;
 
+    // Logged when the compositor is destroyed.
+    struct Stats {
+        uint64_t compositions = 0;
+        // Compositions skipped because nothing changed since the last one into the target.
+        uint64_t skippedCompositions = 0;
+        // Compositions which only redrew the area covered by changed layers.
+        uint64_t damageCompositions = 0;
+        // Compositions of a single opaque layer covering the target, done with a copy.
+        uint64_t directCopies = 0;
+        uint64_t composedPixels = 0;
+    };
+    // Must be called from the thread calling compose().
+    Stats getStats() const { return m_stats; }
+
     static bool queueSupportsComposition(const VkQueueFamilyProperties& properties) {
         return properties.queueFlags & VK_QUEUE_GRAPHICS_BIT;
     }
@@ -207,16 +226,52 @@ class CompositorVk : protected CompositorVkBase, public Compositor {
     struct CompositionVk {
         const BorrowedImageInfoVk* targetImage = nullptr;
         VkRenderPass targetRenderPass = VK_NULL_HANDLE;
+        VkRenderPass targetDamageRenderPass = VK_NULL_HANDLE;
         VkFramebuffer targetFramebuffer = VK_NULL_HANDLE;
         VkPipeline pipeline = VK_NULL_HANDLE;
+        VkRenderPass targetAlphaFixupRenderPass = VK_NULL_HANDLE;
+        VkPipeline alphaFixupPipeline = VK_NULL_HANDLE;
         std::vector<const BorrowedImageInfoVk*> layersSourceImages;
         FrameDescriptorSetsContents layersDescriptorSets;
+        // Parallel to `layersDescriptorSets`. The generation is 0 for solid color layers.
+        std::vector<uint64_t> layersContentGenerations;
+        std::vector<hwc_rect_t> layersDisplayFrames;
+        // Set when the only layer is the same size and format as the target, is opaque and
+        // covers all of it, so it can be copied instead of drawn. The alpha channel of the
+        // target is made opaque afterwards.
+        const BorrowedImageInfoVk* directCopySource = nullptr;
     };
     void buildCompositionVk(const CompositionRequest& compositionRequest,
                             CompositionVk* compositionVk);
 
     void updateDescriptorSetsIfChanged(const FrameDescriptorSetsContents& contents,
                                        PerFrameResources* frameResources);
+    FrameDescriptorSetsContents getAlphaFixupDescriptorSetsContents() const;
+
+    // Record drawing the layers into `renderArea` of the target. `onlyDamage` keeps the target
+    // contents outside of it.
+    void recordLayers(VkCommandBuffer commandBuffer, const CompositionVk& compositionVk,
+                      const PerFrameResources& frameResources, bool onlyDamage,
+                      const VkRect2D& renderArea);
+    // Record copying the only layer into `renderArea` of the target, then making it opaque with
+    // the descriptor set from getAlphaFixupDescriptorSetsContents().
+    void recordDirectCopy(VkCommandBuffer commandBuffer, const CompositionVk& compositionVk,
+                          const PerFrameResources& frameResources, const VkRect2D& renderArea);
+
+    // What was last composed into a target, used to only redraw what changed since.
+    struct TargetComposition {
+        // The target's content generation right after the composition.
+        uint64_t targetContentGeneration = 0;
+        FrameDescriptorSetsContents layersDescriptorSets;
+        std::vector<uint64_t> layersContentGenerations;
+        std::vector<hwc_rect_t> layersDisplayFrames;
+        std::shared_future<void> finished;
+    };
+
+    // Returns the area of the target which has to be redrawn, or std::nullopt if all of it has.
+    // The returned area is empty if the target already has the contents of the composition.
+    std::optional<VkRect2D> getDamage(const CompositionVk& compositionVk,
+                                      const TargetComposition& lastComposition);
 
     class RenderTarget {
        public:
@@ -252,6 +307,11 @@ class CompositorVk : protected CompositorVkBase, public Compositor {
     static constexpr const uint32_t k_renderTargetCacheSize = 128;
     // Maps from borrowed image ids to render target info.
     android::base::LruCache<uint32_t, std::unique_ptr<RenderTarget>> m_renderTargetCache;
+
+    // Maps from borrowed image ids to the last composition into the image.
+    std::unordered_map<uint32_t, TargetComposition> m_lastCompositions;
+
+    Stats m_stats;
 };
 
 }  // namespace vk
@@ -0,0 +1,274 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "HostPipelineCache.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "aemu/base/system/System.h"
+#include "host-common/logging.h"
+#include "vulkan/vk_enum_string_helper.h"
+
+namespace gfxstream {
+namespace vk {
+namespace {
+
+std::string getCachePath(const std::string& directory, const VkPhysicalDeviceProperties& props) {
+    char name[128];
+    snprintf(name, sizeof(name), "/vk_pipeline_cache_%08x_%08x_", props.vendorID,
+             props.deviceID);
+    std::string path = directory + name;
+    for (uint8_t byte : props.pipelineCacheUUID) {
+        char hex[3];
+        snprintf(hex, sizeof(hex), "%02x", byte);
+        path += hex;
+    }
+    return path + ".bin";
+}
+
+std::vector<uint8_t> readFile(const std::string& path) {
+    std::vector<uint8_t> contents;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return contents;
+    }
+    if (fseek(file, 0, SEEK_END) == 0) {
+        const long size = ftell(file);
+        if (size > static_cast<long>(HostPipelineCache::kMaxFileSize)) {
+            WARN("Ignoring Vulkan pipeline cache %s of %ld bytes.", path.c_str(), size);
+        } else if (size > 0 && fseek(file, 0, SEEK_SET) == 0) {
+            contents.resize(size);
+            if (fread(contents.data(), contents.size(), 1, file) != 1) {
+                contents.clear();
+            }
+        }
+    }
+    fclose(file);
+    return contents;
+}
+
+// Drivers are supposed to ignore pipeline cache data from other devices or driver versions, but
+// some do not cope with it well, so it is checked here too.
+void writeFile(const std::string& path, const std::vector<uint8_t>& data) {
+    if (data.empty()) {
+        std::remove(path.c_str());
+        INFO("Removed Vulkan pipeline cache %s.", path.c_str());
+        return;
+    }
+
+    // Write a new file and move it into place, so that a crash while saving leaves the previous
+    // cache intact.
+    const std::string tmpPath = path + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        ERR("Failed to open Vulkan pipeline cache %s.", tmpPath.c_str());
+        return;
+    }
+    bool ok = fwrite(data.data(), data.size(), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+#ifdef _WIN32
+    // rename() does not replace existing files on Windows.
+    if (ok) {
+        std::remove(path.c_str());
+    }
+#endif
+    if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        ERR("Failed to write Vulkan pipeline cache %s.", path.c_str());
+        std::remove(tmpPath.c_str());
+        return;
+    }
+
+    INFO("Saved %zu bytes of Vulkan pipeline cache to %s.", data.size(), path.c_str());
+}
+
+bool isCompatibleCacheData(const std::vector<uint8_t>& data,
+                           const VkPhysicalDeviceProperties& props) {
+    VkPipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == props.vendorID && header.deviceID == props.deviceID &&
+           memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+}  // namespace
+
+// static
+std::unique_ptr<HostPipelineCacheWriter> HostPipelineCacheWriter::create() {
+    std::string directory = android::base::getEnvironmentVariable("ANDROID_EMUGL_SHADER_CACHE_DIR");
+    if (directory.empty()) {
+        return nullptr;
+    }
+    return std::make_unique<HostPipelineCacheWriter>(std::move(directory));
+}
+
+HostPipelineCacheWriter::HostPipelineCacheWriter(std::string directory)
+    : mDirectory(std::move(directory)), mWorker([](Cmd cmd) {
+          using android::base::WorkerProcessingResult;
+          struct {
+              WorkerProcessingResult operator()(const Write& write) {
+                  writeFile(write.path, write.data);
+                  return WorkerProcessingResult::Continue;
+              }
+              WorkerProcessingResult operator()(const Exit&) {
+                  return WorkerProcessingResult::Stop;
+              }
+          } visitor;
+          return std::visit(visitor, cmd);
+      }) {
+    mWorker.start();
+}
+
+HostPipelineCacheWriter::~HostPipelineCacheWriter() {
+    mWorker.enqueue(Exit{});
+    mWorker.join();
+}
+
+void HostPipelineCacheWriter::enqueue(std::string path, std::vector<uint8_t> data) {
+    mWorker.enqueue(Write{
+        .path = std::move(path),
+        .data = std::move(data),
+    });
+}
+
+void HostPipelineCacheWriter::waitForWrites() { mWorker.waitQueuedItems(); }
+
+// static
+std::unique_ptr<HostPipelineCache> HostPipelineCache::create(
+    HostPipelineCacheWriter* writer, VkDevice device, VulkanDispatch* deviceDispatch,
+    const VkPhysicalDeviceProperties& props) {
+    if (!writer) {
+        return nullptr;
+    }
+
+    const std::string path = getCachePath(writer->directory(), props);
+    std::vector<uint8_t> initialData = readFile(path);
+    if (!initialData.empty() && !isCompatibleCacheData(initialData, props)) {
+        WARN("Ignoring incompatible Vulkan pipeline cache %s.", path.c_str());
+        initialData.clear();
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .initialDataSize = initialData.size(),
+        .pInitialData = initialData.data(),
+    };
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    VkResult result = deviceDispatch->vkCreatePipelineCache(device, &createInfo, nullptr, &cache);
+    if (result != VK_SUCCESS && !initialData.empty()) {
+        WARN("Failed to load Vulkan pipeline cache %s: %s.", path.c_str(),
+             string_VkResult(result));
+        initialData.clear();
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        result = deviceDispatch->vkCreatePipelineCache(device, &createInfo, nullptr, &cache);
+    }
+    if (result != VK_SUCCESS) {
+        ERR("Failed to create host Vulkan pipeline cache: %s.", string_VkResult(result));
+        return nullptr;
+    }
+
+    INFO("Loaded %zu bytes of Vulkan pipeline cache from %s.", initialData.size(), path.c_str());
+    return std::unique_ptr<HostPipelineCache>(
+        new HostPipelineCache(writer, device, deviceDispatch, cache, path));
+}
+
+HostPipelineCache::HostPipelineCache(HostPipelineCacheWriter* writer, VkDevice device,
+                                     VulkanDispatch* deviceDispatch, VkPipelineCache cache,
+                                     std::string path)
+    : mWriter(writer),
+      mDevice(device),
+      mDeviceDispatch(deviceDispatch),
+      mCache(cache),
+      mPath(std::move(path)) {}
+
+HostPipelineCache::~HostPipelineCache() {
+    const uint64_t created = mPipelinesCreated.load();
+    if (created > 0) {
+        INFO("Vulkan pipeline cache stats: %" PRIu64 " pipelines created, %" PRIu64
+             " found in a pipeline cache, %.3f ms per pipeline, %.3f ms max per call.",
+             created, mPipelineCacheHits.load(), mTotalCreationUs.load() / 1000.0 / created,
+             mMaxCreationUs.load() / 1000.0);
+    }
+    mDeviceDispatch->vkDestroyPipelineCache(mDevice, mCache, nullptr);
+}
+
+HostPipelineCache::ScopedUse::ScopedUse(HostPipelineCache* cache) : mCache(cache) {
+    mCache->mMutex.lock_shared();
+}
+
+HostPipelineCache::ScopedUse::~ScopedUse() { mCache->mMutex.unlock_shared(); }
+
+VkPipelineCache HostPipelineCache::ScopedUse::handle() const { return mCache->mCache; }
+
+void HostPipelineCache::mergeFrom(VkPipelineCache guestCache) {
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    VkResult result = mDeviceDispatch->vkMergePipelineCaches(mDevice, mCache, 1, &guestCache);
+    if (result != VK_SUCCESS) {
+        WARN("Failed to merge guest pipeline cache: %s.", string_VkResult(result));
+    }
+}
+
+void HostPipelineCache::recordPipelineCreation(uint32_t count, uint64_t durationUs,
+                                               uint32_t cacheHits) {
+    mPipelinesCreated.fetch_add(count, std::memory_order_relaxed);
+    mPipelineCacheHits.fetch_add(cacheHits, std::memory_order_relaxed);
+    mTotalCreationUs.fetch_add(durationUs, std::memory_order_relaxed);
+    uint64_t max = mMaxCreationUs.load(std::memory_order_relaxed);
+    while (durationUs > max &&
+           !mMaxCreationUs.compare_exchange_weak(max, durationUs, std::memory_order_relaxed)) {
+    }
+}
+
+void HostPipelineCache::save() {
+    std::vector<uint8_t> data;
+    {
+        std::unique_lock<std::shared_mutex> lock(mMutex);
+
+        size_t dataSize = 0;
+        VkResult result =
+            mDeviceDispatch->vkGetPipelineCacheData(mDevice, mCache, &dataSize, nullptr);
+        if (result == VK_SUCCESS && dataSize > 0) {
+            data.resize(dataSize);
+            result =
+                mDeviceDispatch->vkGetPipelineCacheData(mDevice, mCache, &dataSize, data.data());
+            data.resize(dataSize);
+        }
+        if (result != VK_SUCCESS || data.empty()) {
+            WARN("Failed to get Vulkan pipeline cache data: %s.", string_VkResult(result));
+            return;
+        }
+    }
+
+    if (data.size() > kMaxFileSize) {
+        WARN("Vulkan pipeline cache %s grew to %zu bytes, starting over.", mPath.c_str(),
+             data.size());
+        data.clear();
+    }
+    mWriter->enqueue(mPath, std::move(data));
+}
+
+}  // namespace vk
+}  // namespace gfxstream
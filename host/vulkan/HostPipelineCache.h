@@ -0,0 +1,138 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "VulkanDispatch.h"
+#include "aemu/base/threads/WorkerThread.h"
+
+namespace gfxstream {
+namespace vk {
+
+// Writes host pipeline caches to disk on its own thread, so that saving a cache never blocks the
+// decoder on file I/O. Writes still queued when it is destroyed are completed first.
+class HostPipelineCacheWriter {
+   public:
+    // Returns nullptr unless ANDROID_EMUGL_SHADER_CACHE_DIR names a directory to keep pipeline
+    // caches in.
+    static std::unique_ptr<HostPipelineCacheWriter> create();
+
+    explicit HostPipelineCacheWriter(std::string directory);
+    ~HostPipelineCacheWriter();
+
+    HostPipelineCacheWriter(const HostPipelineCacheWriter&) = delete;
+    HostPipelineCacheWriter& operator=(const HostPipelineCacheWriter&) = delete;
+
+    const std::string& directory() const { return mDirectory; }
+
+    // Replaces the file at `path` with `data`, or removes it if `data` is empty.
+    void enqueue(std::string path, std::vector<uint8_t> data);
+
+    // Blocks until all writes enqueued so far are done.
+    void waitForWrites();
+
+   private:
+    struct Write {
+        std::string path;
+        std::vector<uint8_t> data;
+    };
+    struct Exit {};
+    using Cmd = std::variant<Write, Exit>;
+
+    const std::string mDirectory;
+    android::base::WorkerThread<Cmd> mWorker;
+};
+
+// A VkPipelineCache owned by the host for a single VkDevice, persisted to disk so that guest
+// pipelines compiled by earlier guest processes and boots are reused. The guest's own pipeline
+// cache data is rarely kept around, so without this every app process compiles every pipeline.
+//
+// The cache never leaves the host: all pipelines are created against it, even those the guest
+// creates with its own pipeline cache, and the initial data of guest pipeline caches is merged
+// into it. Guest pipeline caches are never seeded from it, so one guest process cannot read back
+// pipelines created by another.
+class HostPipelineCache {
+   public:
+    // Cache files larger than this are not loaded, and a cache that grows past it is removed from
+    // disk instead of saved so that it is rebuilt from the pipelines that are still in use.
+    static constexpr size_t kMaxFileSize = 64 * 1024 * 1024;
+
+    // Returns nullptr if `writer` is nullptr. The cache is loaded from the file for the device's
+    // driver in the writer's directory, if there is one.
+    static std::unique_ptr<HostPipelineCache> create(HostPipelineCacheWriter* writer,
+                                                     VkDevice device,
+                                                     VulkanDispatch* deviceDispatch,
+                                                     const VkPhysicalDeviceProperties& props);
+
+    ~HostPipelineCache();
+
+    HostPipelineCache(const HostPipelineCache&) = delete;
+    HostPipelineCache& operator=(const HostPipelineCache&) = delete;
+
+    // Keeps merges from running while the cache is used to create pipelines. Pipeline creation
+    // only needs shared access, merging into the cache requires exclusive access.
+    class ScopedUse {
+       public:
+        explicit ScopedUse(HostPipelineCache* cache);
+        ~ScopedUse();
+
+        VkPipelineCache handle() const;
+
+       private:
+        HostPipelineCache* mCache;
+    };
+
+    // Merges the contents of a guest pipeline cache into the host cache. This can take a while
+    // for large caches, callers should not hold locks that the decoder needs.
+    void mergeFrom(VkPipelineCache guestCache);
+
+    // Records how long creating `count` pipelines took and how many of them were found in a
+    // pipeline cache, as reported by VK_EXT_pipeline_creation_feedback.
+    void recordPipelineCreation(uint32_t count, uint64_t durationUs, uint32_t cacheHits);
+
+    // Copies the cache data and hands it to the writer. When several devices on the same driver
+    // are destroyed, the last one saved wins.
+    void save();
+
+   private:
+    HostPipelineCache(HostPipelineCacheWriter* writer, VkDevice device,
+                      VulkanDispatch* deviceDispatch, VkPipelineCache cache, std::string path);
+
+    HostPipelineCacheWriter* const mWriter;
+    const VkDevice mDevice;
+    VulkanDispatch* const mDeviceDispatch;
+    const VkPipelineCache mCache;
+    const std::string mPath;
+
+    // vkMergePipelineCaches() requires external synchronization of the destination cache.
+    std::shared_mutex mMutex;
+
+    std::atomic<uint64_t> mPipelinesCreated{0};
+    std::atomic<uint64_t> mPipelineCacheHits{0};
+    std::atomic<uint64_t> mTotalCreationUs{0};
+    std::atomic<uint64_t> mMaxCreationUs{0};
+};
+
+}  // namespace vk
+}  // namespace gfxstream
@@ -0,0 +1,293 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "HostPipelineCache.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace gfxstream {
+namespace vk {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+// The fake driver's pipeline cache data is the standard header followed by the ids of the cached
+// pipelines. Data whose payload is not a whole number of ids is rejected as corrupt.
+struct FakePipelineCache {
+    std::set<uint32_t> pipelines;
+};
+
+VkPhysicalDeviceProperties sProps;
+size_t sLastInitialDataSize = 0;
+
+std::vector<uint8_t> serialize(const VkPhysicalDeviceProperties& props,
+                               const std::set<uint32_t>& pipelines) {
+    VkPipelineCacheHeaderVersionOne header = {
+        .headerSize = sizeof(VkPipelineCacheHeaderVersionOne),
+        .headerVersion = VK_PIPELINE_CACHE_HEADER_VERSION_ONE,
+        .vendorID = props.vendorID,
+        .deviceID = props.deviceID,
+    };
+    memcpy(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+
+    std::vector<uint8_t> data(sizeof(header) + pipelines.size() * sizeof(uint32_t));
+    memcpy(data.data(), &header, sizeof(header));
+    uint8_t* out = data.data() + sizeof(header);
+    for (uint32_t pipeline : pipelines) {
+        memcpy(out, &pipeline, sizeof(pipeline));
+        out += sizeof(pipeline);
+    }
+    return data;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL fakeCreatePipelineCache(VkDevice,
+                                                       const VkPipelineCacheCreateInfo* pCreateInfo,
+                                                       const VkAllocationCallbacks*,
+                                                       VkPipelineCache* pPipelineCache) {
+    sLastInitialDataSize = pCreateInfo->initialDataSize;
+
+    auto cache = std::make_unique<FakePipelineCache>();
+    if (pCreateInfo->initialDataSize > 0) {
+        const size_t headerSize = sizeof(VkPipelineCacheHeaderVersionOne);
+        const size_t payloadSize = pCreateInfo->initialDataSize - headerSize;
+        if (payloadSize % sizeof(uint32_t) != 0) {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+        const uint8_t* in = static_cast<const uint8_t*>(pCreateInfo->pInitialData) + headerSize;
+        for (size_t i = 0; i < payloadSize / sizeof(uint32_t); i++) {
+            uint32_t pipeline;
+            memcpy(&pipeline, in + i * sizeof(uint32_t), sizeof(pipeline));
+            cache->pipelines.insert(pipeline);
+        }
+    }
+    *pPipelineCache = reinterpret_cast<VkPipelineCache>(cache.release());
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL fakeDestroyPipelineCache(VkDevice, VkPipelineCache pipelineCache,
+                                                    const VkAllocationCallbacks*) {
+    delete reinterpret_cast<FakePipelineCache*>(pipelineCache);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL fakeGetPipelineCacheData(VkDevice, VkPipelineCache pipelineCache,
+                                                        size_t* pDataSize, void* pData) {
+    const std::vector<uint8_t> data =
+        serialize(sProps, reinterpret_cast<FakePipelineCache*>(pipelineCache)->pipelines);
+    if (!pData) {
+        *pDataSize = data.size();
+        return VK_SUCCESS;
+    }
+    if (*pDataSize < data.size()) {
+        return VK_INCOMPLETE;
+    }
+    memcpy(pData, data.data(), data.size());
+    *pDataSize = data.size();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL fakeMergePipelineCaches(VkDevice, VkPipelineCache dstCache,
+                                                       uint32_t srcCacheCount,
+                                                       const VkPipelineCache* pSrcCaches) {
+    auto* dst = reinterpret_cast<FakePipelineCache*>(dstCache);
+    for (uint32_t i = 0; i < srcCacheCount; i++) {
+        const auto* src = reinterpret_cast<FakePipelineCache*>(pSrcCaches[i]);
+        dst->pipelines.insert(src->pipelines.begin(), src->pipelines.end());
+    }
+    return VK_SUCCESS;
+}
+
+class HostPipelineCacheTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        sProps = {};
+        sProps.vendorID = 0x1234;
+        sProps.deviceID = 0x5678;
+        for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+            sProps.pipelineCacheUUID[i] = static_cast<uint8_t>(i);
+        }
+        sLastInitialDataSize = 0;
+
+        mDispatch.vkCreatePipelineCache = fakeCreatePipelineCache;
+        mDispatch.vkDestroyPipelineCache = fakeDestroyPipelineCache;
+        mDispatch.vkGetPipelineCacheData = fakeGetPipelineCacheData;
+        mDispatch.vkMergePipelineCaches = fakeMergePipelineCaches;
+
+        mDirectory = std::filesystem::path(::testing::TempDir()) /
+                     ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        std::filesystem::remove_all(mDirectory);
+        std::filesystem::create_directories(mDirectory);
+        mWriter = std::make_unique<HostPipelineCacheWriter>(mDirectory.string());
+    }
+
+    void TearDown() override {
+        mWriter.reset();
+        std::filesystem::remove_all(mDirectory);
+    }
+
+    std::unique_ptr<HostPipelineCache> createCache() {
+        return HostPipelineCache::create(mWriter.get(), mDevice, &mDispatch, sProps);
+    }
+
+    // Returns the single cache file in the directory, or an empty path if there is none.
+    std::filesystem::path cacheFile() {
+        std::filesystem::path found;
+        for (const auto& entry : std::filesystem::directory_iterator(mDirectory)) {
+            EXPECT_TRUE(found.empty()) << "Unexpected file " << entry.path();
+            found = entry.path();
+        }
+        return found;
+    }
+
+    std::vector<uint8_t> readCacheFile() {
+        std::ifstream file(cacheFile(), std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {});
+    }
+
+    void writeCacheFile(const std::filesystem::path& path, const std::vector<uint8_t>& data) {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+    // Saves a cache holding `pipelines` so that there is a file to load.
+    std::filesystem::path saveCache(const std::set<uint32_t>& pipelines) {
+        auto cache = createCache();
+        FakePipelineCache guestCache{pipelines};
+        VkPipelineCache guestCacheHandle = reinterpret_cast<VkPipelineCache>(&guestCache);
+        cache->mergeFrom(guestCacheHandle);
+        cache->save();
+        mWriter->waitForWrites();
+        return cacheFile();
+    }
+
+    std::set<uint32_t> loadedPipelines(HostPipelineCache* cache) {
+        HostPipelineCache::ScopedUse use(cache);
+        return reinterpret_cast<FakePipelineCache*>(use.handle())->pipelines;
+    }
+
+    const VkDevice mDevice = reinterpret_cast<VkDevice>(0x1);
+    VulkanDispatch mDispatch = {};
+    std::filesystem::path mDirectory;
+    std::unique_ptr<HostPipelineCacheWriter> mWriter;
+};
+
+TEST_F(HostPipelineCacheTest, NotCreatedWithoutWriter) {
+    EXPECT_EQ(HostPipelineCache::create(nullptr, mDevice, &mDispatch, sProps), nullptr);
+}
+
+TEST_F(HostPipelineCacheTest, StartsEmptyWithoutFile) {
+    auto cache = createCache();
+    ASSERT_NE(cache, nullptr);
+    EXPECT_EQ(sLastInitialDataSize, 0u);
+    EXPECT_THAT(loadedPipelines(cache.get()), IsEmpty());
+}
+
+TEST_F(HostPipelineCacheTest, MergesGuestCachesAndRoundTrips) {
+    {
+        auto cache = createCache();
+        FakePipelineCache guestCache1{{1, 2}};
+        FakePipelineCache guestCache2{{2, 3}};
+        cache->mergeFrom(reinterpret_cast<VkPipelineCache>(&guestCache1));
+        cache->mergeFrom(reinterpret_cast<VkPipelineCache>(&guestCache2));
+        EXPECT_THAT(loadedPipelines(cache.get()), ElementsAre(1, 2, 3));
+        cache->save();
+    }
+    mWriter->waitForWrites();
+
+    EXPECT_EQ(readCacheFile(), serialize(sProps, {1, 2, 3}));
+
+    auto cache = createCache();
+    EXPECT_EQ(sLastInitialDataSize, serialize(sProps, {1, 2, 3}).size());
+    EXPECT_THAT(loadedPipelines(cache.get()), ElementsAre(1, 2, 3));
+}
+
+TEST_F(HostPipelineCacheTest, IgnoresFileWithDifferentUuid) {
+    const std::filesystem::path path = saveCache({1});
+    VkPhysicalDeviceProperties otherProps = sProps;
+    otherProps.pipelineCacheUUID[0] ^= 0xff;
+    writeCacheFile(path, serialize(otherProps, {1}));
+
+    auto cache = createCache();
+    ASSERT_NE(cache, nullptr);
+    EXPECT_EQ(sLastInitialDataSize, 0u);
+    EXPECT_THAT(loadedPipelines(cache.get()), IsEmpty());
+}
+
+TEST_F(HostPipelineCacheTest, IgnoresFileWithDifferentDevice) {
+    const std::filesystem::path path = saveCache({1});
+    VkPhysicalDeviceProperties otherProps = sProps;
+    otherProps.deviceID++;
+    writeCacheFile(path, serialize(otherProps, {1}));
+
+    auto cache = createCache();
+    ASSERT_NE(cache, nullptr);
+    EXPECT_EQ(sLastInitialDataSize, 0u);
+}
+
+TEST_F(HostPipelineCacheTest, IgnoresFileWithBadHeader) {
+    const std::filesystem::path path = saveCache({1});
+    std::vector<uint8_t> data = serialize(sProps, {1});
+    VkPipelineCacheHeaderVersionOne header;
+    memcpy(&header, data.data(), sizeof(header));
+    header.headerVersion = static_cast<VkPipelineCacheHeaderVersion>(2);
+    memcpy(data.data(), &header, sizeof(header));
+    writeCacheFile(path, data);
+
+    auto cache = createCache();
+    ASSERT_NE(cache, nullptr);
+    EXPECT_EQ(sLastInitialDataSize, 0u);
+}
+
+TEST_F(HostPipelineCacheTest, IgnoresTruncatedHeader) {
+    const std::filesystem::path path = saveCache({1});
+    std::vector<uint8_t> data = serialize(sProps, {1});
+    data.resize(sizeof(VkPipelineCacheHeaderVersionOne) / 2);
+    writeCacheFile(path, data);
+
+    auto cache = createCache();
+    ASSERT_NE(cache, nullptr);
+    EXPECT_EQ(sLastInitialDataSize, 0u);
+}
+
+TEST_F(HostPipelineCacheTest, FallsBackToEmptyCacheWhenDriverRejectsFile) {
+    const std::filesystem::path path = saveCache({1, 2});
+    std::vector<uint8_t> data = serialize(sProps, {1, 2});
+    data.pop_back();
+    writeCacheFile(path, data);
+
+    auto cache = createCache();
+    ASSERT_NE(cache, nullptr);
+    EXPECT_EQ(sLastInitialDataSize, 0u);
+    EXPECT_THAT(loadedPipelines(cache.get()), IsEmpty());
+
+    // Saving replaces the corrupt file.
+    FakePipelineCache guestCache{{3}};
+    cache->mergeFrom(reinterpret_cast<VkPipelineCache>(&guestCache));
+    cache->save();
+    mWriter->waitForWrites();
+    EXPECT_EQ(readCacheFile(), serialize(sProps, {3}));
+}
+
+}  // namespace
+}  // namespace vk
+}  // namespace gfxstream
@@ -0,0 +1,72 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace gfxstream {
+namespace vk {
+
+// How ReadbackWorkerVk picks slots in a display's ring of readback buffers, apart from the
+// Vulkan objects so that it can be tested without a GPU.
+struct ReadbackSlotState {
+    // Increases with every submission to any slot of the display, 0 if the slot has no frame.
+    uint64_t serial = 0;
+    // Whether the GPU is done with the last submission to the slot.
+    bool completed = false;
+};
+
+// The slot to record the next readback into: the oldest completed one, other than
+// `copyingSlot` which getPixels() is copying out. std::nullopt if all of them are busy, the
+// frame is then dropped rather than waiting for the GPU.
+inline std::optional<size_t> pickReadbackSlotToWrite(const std::vector<ReadbackSlotState>& slots,
+                                                     std::optional<size_t> copyingSlot) {
+    std::optional<size_t> oldest;
+    for (size_t i = 0; i < slots.size(); i++) {
+        if (copyingSlot == i || !slots[i].completed) {
+            continue;
+        }
+        if (!oldest || slots[i].serial < slots[*oldest].serial) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+// The slot for getPixels() to copy out: the newest completed frame, or the newest submitted
+// one if `readNewest` is set or none has completed yet. std::nullopt if there is no frame.
+inline std::optional<size_t> pickReadbackSlotToRead(const std::vector<ReadbackSlotState>& slots,
+                                                    bool readNewest) {
+    std::optional<size_t> newestSubmitted;
+    std::optional<size_t> newestCompleted;
+    for (size_t i = 0; i < slots.size(); i++) {
+        if (slots[i].serial == 0) {
+            continue;
+        }
+        if (!newestSubmitted || slots[i].serial > slots[*newestSubmitted].serial) {
+            newestSubmitted = i;
+        }
+        if (slots[i].completed &&
+            (!newestCompleted || slots[i].serial > slots[*newestCompleted].serial)) {
+            newestCompleted = i;
+        }
+    }
+    return (readNewest || !newestCompleted) ? newestSubmitted : newestCompleted;
+}
+
+}  // namespace vk
+}  // namespace gfxstream
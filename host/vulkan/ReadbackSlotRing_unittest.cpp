@@ -0,0 +1,154 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include "ReadbackSlotRing.h"
+
+namespace gfxstream {
+namespace vk {
+namespace {
+
+// Tracks a ring the way ReadbackWorkerVk does, with the GPU completing submissions when told.
+class Ring {
+   public:
+    explicit Ring(size_t size) : mSlots(size, ReadbackSlotState{.serial = 0, .completed = true}) {}
+
+    // Returns the slot that the frame was submitted to, std::nullopt if it was dropped.
+    std::optional<size_t> submit() {
+        const std::optional<size_t> index = pickReadbackSlotToWrite(mSlots, copyingSlot);
+        if (index) {
+            mSlots[*index] = ReadbackSlotState{.serial = mNextSerial++, .completed = false};
+        }
+        return index;
+    }
+
+    void complete(size_t index) { mSlots[index].completed = true; }
+
+    void completeAll() {
+        for (ReadbackSlotState& slot : mSlots) {
+            slot.completed = true;
+        }
+    }
+
+    std::optional<size_t> read(bool readNewest = false) const {
+        return pickReadbackSlotToRead(mSlots, readNewest);
+    }
+
+    std::optional<size_t> copyingSlot;
+
+   private:
+    std::vector<ReadbackSlotState> mSlots;
+    uint64_t mNextSerial = 1;
+};
+
+TEST(ReadbackSlotRingTest, NothingToReadBeforeTheFirstFrame) {
+    Ring ring(3);
+    EXPECT_EQ(std::nullopt, ring.read());
+    EXPECT_EQ(std::nullopt, ring.read(/*readNewest=*/true));
+}
+
+TEST(ReadbackSlotRingTest, ReusesSlotsOldestFirst) {
+    Ring ring(3);
+    for (size_t frame = 0; frame < 7; frame++) {
+        EXPECT_EQ(frame % 3, ring.submit()) << "frame " << frame;
+        ring.completeAll();
+    }
+}
+
+TEST(ReadbackSlotRingTest, KeepsSeveralFramesInFlight) {
+    Ring ring(3);
+    EXPECT_EQ(0u, ring.submit());
+    EXPECT_EQ(1u, ring.submit());
+    EXPECT_EQ(2u, ring.submit());
+}
+
+TEST(ReadbackSlotRingTest, DropsFramesWhileAllSlotsAreBusy) {
+    Ring ring(3);
+    ring.submit();
+    ring.submit();
+    ring.submit();
+    EXPECT_EQ(std::nullopt, ring.submit());
+    EXPECT_EQ(std::nullopt, ring.submit());
+
+    // Whichever slot completes first is reused, even if it is not the oldest.
+    ring.complete(1);
+    EXPECT_EQ(1u, ring.submit());
+    EXPECT_EQ(std::nullopt, ring.submit());
+}
+
+TEST(ReadbackSlotRingTest, DroppedFramesKeepThePreviousFrameReadable) {
+    Ring ring(3);
+    ring.submit();
+    ring.submit();
+    ring.submit();
+    ring.complete(0);
+    ring.complete(1);
+
+    ring.copyingSlot = 1;
+    ring.submit();  // Into slot 0.
+    EXPECT_EQ(std::nullopt, ring.submit());
+    EXPECT_EQ(1u, ring.read());
+}
+
+TEST(ReadbackSlotRingTest, DoesNotReuseTheSlotBeingCopied) {
+    Ring ring(3);
+    ring.submit();
+    ring.submit();
+    ring.submit();
+    ring.completeAll();
+
+    // Slot 0 holds the oldest frame but getPixels() is copying it out.
+    ring.copyingSlot = 0;
+    EXPECT_EQ(1u, ring.submit());
+    EXPECT_EQ(2u, ring.submit());
+    EXPECT_EQ(std::nullopt, ring.submit());
+
+    ring.copyingSlot.reset();
+    EXPECT_EQ(0u, ring.submit());
+}
+
+TEST(ReadbackSlotRingTest, ReadsTheNewestCompletedFrame) {
+    Ring ring(3);
+    ring.submit();
+    ring.submit();
+    ring.submit();
+    ring.complete(0);
+    ring.complete(1);
+
+    EXPECT_EQ(1u, ring.read());
+    // After a repaint or a flush, the newest frame is waited for.
+    EXPECT_EQ(2u, ring.read(/*readNewest=*/true));
+}
+
+TEST(ReadbackSlotRingTest, ReadsTheNewestSubmittedFrameWhenNoneCompleted) {
+    Ring ring(3);
+    ring.submit();
+    ring.submit();
+    EXPECT_EQ(1u, ring.read());
+}
+
+TEST(ReadbackSlotRingTest, ReadsFramesAcrossWrapAround) {
+    Ring ring(3);
+    for (int frame = 0; frame < 4; frame++) {
+        ring.submit();
+        ring.completeAll();
+    }
+    // The fourth frame went into slot 0, which now holds the newest frame.
+    EXPECT_EQ(0u, ring.read());
+}
+
+}  // namespace
+}  // namespace vk
+}  // namespace gfxstream
@@ -0,0 +1,683 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "ReadbackWorkerVk.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "ColorBuffer.h"
+#include "host-common/logging.h"
+#include "vulkan/BorrowedImageVk.h"
+#include "vulkan/vk_enum_string_helper.h"
+#include "vulkan/vk_util.h"
+
+namespace gfxstream {
+namespace vk {
+namespace {
+
+// Enough for the copy of the newest frame to be read by getPixels() while the GPU works on the
+// next two.
+constexpr const size_t kNumReadbackSlots = 3;
+
+// Readbacks are short copies, anything longer means the device is hung or lost.
+constexpr const uint64_t kReadbackFenceTimeoutNs = 2ULL * 1000ULL * 1000ULL * 1000ULL;
+
+constexpr const VkImageSubresourceRange kColorSubresourceRange = {
+    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+    .baseMipLevel = 0,
+    .levelCount = 1,
+    .baseArrayLayer = 0,
+    .layerCount = 1,
+};
+
+bool isRgba8(VkFormat format) {
+    return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+bool isBgra8(VkFormat format) {
+    return format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+}
+
+void swapRedBlue(uint8_t* pixels, size_t size) {
+    for (size_t i = 0; i + 3 < size; i += 4) {
+        std::swap(pixels[i], pixels[i + 2]);
+    }
+}
+
+}  // namespace
+
+std::unique_ptr<ReadbackWorkerVk> ReadbackWorkerVk::create(
+    const VulkanDispatch& vk, VkDevice vkDevice, VkPhysicalDevice vkPhysicalDevice,
+    VkQueue vkQueue, std::shared_ptr<android::base::Lock> queueLock, uint32_t queueFamilyIndex) {
+    return std::unique_ptr<ReadbackWorkerVk>(new ReadbackWorkerVk(
+        vk, vkDevice, vkPhysicalDevice, vkQueue, std::move(queueLock), queueFamilyIndex));
+}
+
+ReadbackWorkerVk::ReadbackWorkerVk(const VulkanDispatch& vk, VkDevice vkDevice,
+                                   VkPhysicalDevice vkPhysicalDevice, VkQueue vkQueue,
+                                   std::shared_ptr<android::base::Lock> queueLock,
+                                   uint32_t queueFamilyIndex)
+    : m_vk(vk),
+      m_vkDevice(vkDevice),
+      m_vkPhysicalDevice(vkPhysicalDevice),
+      m_vkQueue(vkQueue),
+      m_vkQueueLock(std::move(queueLock)),
+      m_queueFamilyIndex(queueFamilyIndex) {
+    m_vk.vkGetPhysicalDeviceMemoryProperties(m_vkPhysicalDevice, &m_vkMemoryProperties);
+
+    const VkCommandPoolCreateInfo commandPoolCi = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = m_queueFamilyIndex,
+    };
+    VK_CHECK(m_vk.vkCreateCommandPool(m_vkDevice, &commandPoolCi, nullptr, &m_vkCommandPool));
+}
+
+ReadbackWorkerVk::~ReadbackWorkerVk() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& [displayId, display] : m_trackedDisplays) {
+        destroyDisplayLocked(display.get());
+    }
+    m_trackedDisplays.clear();
+    m_vk.vkDestroyCommandPool(m_vkDevice, m_vkCommandPool, nullptr);
+}
+
+void ReadbackWorkerVk::init() {}
+
+void ReadbackWorkerVk::initReadbackForDisplay(uint32_t displayId, uint32_t w, uint32_t h) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_trackedDisplays.find(displayId) != m_trackedDisplays.end()) {
+        ERR("Double init of TrackedDisplay for display:%d", displayId);
+        return;
+    }
+
+    auto display = std::make_unique<TrackedDisplay>();
+    display->width = w;
+    display->height = h;
+    display->bufferSize = static_cast<VkDeviceSize>(4) * w * h /* RGBA8 (4 bpp) */;
+    if (display->bufferSize == 0) {
+        ERR("Invalid readback size %dx%d for display:%d", w, h, displayId);
+        return;
+    }
+
+    // Query the memory type bits with a throw away buffer of the right size and usage.
+    const VkBufferCreateInfo bufferCi = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = display->bufferSize,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer probeBuffer = VK_NULL_HANDLE;
+    VK_CHECK(m_vk.vkCreateBuffer(m_vkDevice, &bufferCi, nullptr, &probeBuffer));
+    VkMemoryRequirements memoryRequirements;
+    m_vk.vkGetBufferMemoryRequirements(m_vkDevice, probeBuffer, &memoryRequirements);
+    m_vk.vkDestroyBuffer(m_vkDevice, probeBuffer, nullptr);
+
+    // Prefer cached memory, reading back from uncached memory is several times slower.
+    const VkMemoryPropertyFlags kPreferredProperties[] = {
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+    };
+    std::optional<uint32_t> memoryTypeIndex;
+    for (VkMemoryPropertyFlags properties : kPreferredProperties) {
+        memoryTypeIndex = vk_util::findMemoryType(&m_vk, m_vkPhysicalDevice,
+                                                  memoryRequirements.memoryTypeBits, properties);
+        if (memoryTypeIndex) {
+            break;
+        }
+    }
+    if (!memoryTypeIndex) {
+        ERR("Failed to find host visible memory for readback of display:%d", displayId);
+        return;
+    }
+    display->hostCoherent = m_vkMemoryProperties.memoryTypes[*memoryTypeIndex].propertyFlags &
+                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    display->slots.resize(kNumReadbackSlots);
+    for (ReadbackSlot& slot : display->slots) {
+        if (!createSlotLocked(display.get(), *memoryTypeIndex, &slot)) {
+            ERR("Failed to create readback buffers for display:%d", displayId);
+            destroyDisplayLocked(display.get());
+            return;
+        }
+    }
+
+    m_trackedDisplays.emplace(displayId, std::move(display));
+}
+
+bool ReadbackWorkerVk::createSlotLocked(TrackedDisplay* display, uint32_t memoryTypeIndex,
+                                        ReadbackSlot* slot) {
+    const VkBufferCreateInfo bufferCi = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = display->bufferSize,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VK_CHECK(m_vk.vkCreateBuffer(m_vkDevice, &bufferCi, nullptr, &slot->buffer));
+
+    VkMemoryRequirements memoryRequirements;
+    m_vk.vkGetBufferMemoryRequirements(m_vkDevice, slot->buffer, &memoryRequirements);
+    const VkMemoryAllocateInfo allocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memoryRequirements.size,
+        .memoryTypeIndex = memoryTypeIndex,
+    };
+    const VkResult allocateResult =
+        m_vk.vkAllocateMemory(m_vkDevice, &allocateInfo, nullptr, &slot->memory);
+    if (allocateResult != VK_SUCCESS) {
+        ERR("Failed to allocate %" PRIu64 " bytes of readback memory: %s.",
+            static_cast<uint64_t>(allocateInfo.allocationSize), string_VkResult(allocateResult));
+        slot->memory = VK_NULL_HANDLE;
+        return false;
+    }
+    VK_CHECK(m_vk.vkBindBufferMemory(m_vkDevice, slot->buffer, slot->memory, 0));
+    VK_CHECK(m_vk.vkMapMemory(m_vkDevice, slot->memory, 0, VK_WHOLE_SIZE, 0, &slot->mapped));
+
+    const VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = m_vkCommandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VK_CHECK(m_vk.vkAllocateCommandBuffers(m_vkDevice, &commandBufferAllocateInfo,
+                                           &slot->commandBuffer));
+
+    const VkFenceCreateInfo fenceCi = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+    };
+    VK_CHECK(m_vk.vkCreateFence(m_vkDevice, &fenceCi, nullptr, &slot->fence));
+    return true;
+}
+
+void ReadbackWorkerVk::waitForSlotsLocked(TrackedDisplay* display) {
+    std::vector<VkFence> fences;
+    for (const ReadbackSlot& slot : display->slots) {
+        if (slot.fence != VK_NULL_HANDLE) {
+            fences.push_back(slot.fence);
+        }
+    }
+    if (!fences.empty()) {
+        const VkResult result =
+            m_vk.vkWaitForFences(m_vkDevice, static_cast<uint32_t>(fences.size()), fences.data(),
+                                 VK_TRUE, kReadbackFenceTimeoutNs);
+        if (result != VK_SUCCESS) {
+            ERR("Failed to wait for readbacks: %s.", string_VkResult(result));
+        }
+    }
+}
+
+void ReadbackWorkerVk::destroyDisplayLocked(TrackedDisplay* display) {
+    waitForSlotsLocked(display);
+    for (ReadbackSlot& slot : display->slots) {
+        if (slot.fence != VK_NULL_HANDLE) {
+            m_vk.vkDestroyFence(m_vkDevice, slot.fence, nullptr);
+        }
+        if (slot.commandBuffer != VK_NULL_HANDLE) {
+            m_vk.vkFreeCommandBuffers(m_vkDevice, m_vkCommandPool, 1, &slot.commandBuffer);
+        }
+        if (slot.buffer != VK_NULL_HANDLE) {
+            m_vk.vkDestroyBuffer(m_vkDevice, slot.buffer, nullptr);
+        }
+        if (slot.memory != VK_NULL_HANDLE) {
+            m_vk.vkFreeMemory(m_vkDevice, slot.memory, nullptr);
+        }
+    }
+    display->slots.clear();
+    destroyScaledImageLocked(display);
+}
+
+void ReadbackWorkerVk::destroyScaledImageLocked(TrackedDisplay* display) {
+    if (display->scaledImage != VK_NULL_HANDLE) {
+        m_vk.vkDestroyImage(m_vkDevice, display->scaledImage, nullptr);
+        display->scaledImage = VK_NULL_HANDLE;
+    }
+    if (display->scaledImageMemory != VK_NULL_HANDLE) {
+        m_vk.vkFreeMemory(m_vkDevice, display->scaledImageMemory, nullptr);
+        display->scaledImageMemory = VK_NULL_HANDLE;
+    }
+    display->scaledImageFormat = VK_FORMAT_UNDEFINED;
+}
+
+bool ReadbackWorkerVk::ensureScaledImageLocked(TrackedDisplay* display, VkFormat format) {
+    if (display->scaledImage != VK_NULL_HANDLE && display->scaledImageFormat == format) {
+        return true;
+    }
+
+    // Only happens when a consumer switches between RGBA and BGRA readback.
+    waitForSlotsLocked(display);
+    destroyScaledImageLocked(display);
+
+    const VkImageCreateInfo imageCi = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format,
+        .extent = {.width = display->width, .height = display->height, .depth = 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    VK_CHECK(m_vk.vkCreateImage(m_vkDevice, &imageCi, nullptr, &display->scaledImage));
+
+    VkMemoryRequirements memoryRequirements;
+    m_vk.vkGetImageMemoryRequirements(m_vkDevice, display->scaledImage, &memoryRequirements);
+    auto memoryTypeIndex =
+        vk_util::findMemoryType(&m_vk, m_vkPhysicalDevice, memoryRequirements.memoryTypeBits,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (!memoryTypeIndex) {
+        ERR("Failed to find memory type for the readback scaling image.");
+        destroyScaledImageLocked(display);
+        return false;
+    }
+    const VkMemoryAllocateInfo allocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memoryRequirements.size,
+        .memoryTypeIndex = *memoryTypeIndex,
+    };
+    const VkResult allocateResult =
+        m_vk.vkAllocateMemory(m_vkDevice, &allocateInfo, nullptr, &display->scaledImageMemory);
+    if (allocateResult != VK_SUCCESS) {
+        ERR("Failed to allocate the readback scaling image: %s.", string_VkResult(allocateResult));
+        display->scaledImageMemory = VK_NULL_HANDLE;
+        destroyScaledImageLocked(display);
+        return false;
+    }
+    VK_CHECK(
+        m_vk.vkBindImageMemory(m_vkDevice, display->scaledImage, display->scaledImageMemory, 0));
+    display->scaledImageFormat = format;
+    return true;
+}
+
+std::vector<ReadbackSlotState> ReadbackWorkerVk::getSlotStatesLocked(TrackedDisplay* display) {
+    std::vector<ReadbackSlotState> states;
+    states.reserve(display->slots.size());
+    for (const ReadbackSlot& slot : display->slots) {
+        states.push_back(ReadbackSlotState{
+            .serial = slot.serial,
+            .completed = m_vk.vkGetFenceStatus(m_vkDevice, slot.fence) == VK_SUCCESS,
+        });
+    }
+    return states;
+}
+
+ReadbackWorkerVk::ReadbackSlot* ReadbackWorkerVk::acquireSlotLocked(TrackedDisplay* display) {
+    // Reuse the oldest slot the GPU is done with, keeping the newer frames around for
+    // getPixels(). Never wait here, this is called on the post thread.
+    const std::optional<size_t> index =
+        pickReadbackSlotToWrite(getSlotStatesLocked(display), display->copyingSlot);
+    return index ? &display->slots[*index] : nullptr;
+}
+
+VkFormatFeatureFlags ReadbackWorkerVk::getFormatFeaturesLocked(VkFormat format,
+                                                               VkImageTiling tiling) {
+    auto it = m_formatProperties.find(format);
+    if (it == m_formatProperties.end()) {
+        VkFormatProperties formatProperties;
+        m_vk.vkGetPhysicalDeviceFormatProperties(m_vkPhysicalDevice, format, &formatProperties);
+        it = m_formatProperties.emplace(format, formatProperties).first;
+    }
+    return tiling == VK_IMAGE_TILING_LINEAR ? it->second.linearTilingFeatures
+                                            : it->second.optimalTilingFeatures;
+}
+
+ReadbackWorkerVk::DoNextReadbackResult ReadbackWorkerVk::doNextReadback(uint32_t displayId,
+                                                                        ColorBuffer* cb,
+                                                                        void* fbImage,
+                                                                        bool repaint,
+                                                                        bool readbackBgra) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_trackedDisplays.find(displayId);
+    if (it == m_trackedDisplays.end()) {
+        ERR("Failed to find TrackedDisplay for display:%d", displayId);
+        return DoNextReadbackResult::OK_NOT_READY_FOR_READ;
+    }
+    TrackedDisplay* display = it->second.get();
+
+    ReadbackSlot* slot = acquireSlotLocked(display);
+    if (!slot) {
+        // The GPU is more than a ring behind, drop this frame rather than stalling the guest.
+        VERBOSE("All readback buffers of display:%d busy, skipping frame.", displayId);
+        return DoNextReadbackResult::OK_NOT_READY_FOR_READ;
+    }
+
+    const std::unique_ptr<BorrowedImageInfo> borrowed =
+        cb->borrowForComposition(ColorBuffer::UsedApi::kVk, /*isTarget=*/false);
+    if (!borrowed) {
+        ERR("Failed to borrow ColorBuffer:%d for readback.", cb->getHndl());
+        return DoNextReadbackResult::OK_NOT_READY_FOR_READ;
+    }
+    const auto* image = static_cast<const BorrowedImageInfoVk*>(borrowed.get());
+    const VkFormat imageFormat = image->imageCreateInfo.format;
+    const VkExtent3D& imageExtent = image->imageCreateInfo.extent;
+    const bool sameSize =
+        imageExtent.width == display->width && imageExtent.height == display->height;
+
+    // Keep sRGB encoded ColorBuffers encoded, blitting to a UNORM image would linearize them.
+    const bool srgb =
+        imageFormat == VK_FORMAT_R8G8B8A8_SRGB || imageFormat == VK_FORMAT_B8G8R8A8_SRGB;
+    VkFormat wantedFormat = readbackBgra ? VK_FORMAT_B8G8R8A8_UNORM : VK_FORMAT_R8G8B8A8_UNORM;
+    if (srgb) {
+        wantedFormat = readbackBgra ? VK_FORMAT_B8G8R8A8_SRGB : VK_FORMAT_R8G8B8A8_SRGB;
+    }
+
+    // Copy the ColorBuffer as is when it already matches the display, blit it to scale and
+    // convert it on the GPU otherwise. If blitting is not supported, a same sized RGBA8 or
+    // BGRA8 ColorBuffer is copied and the channels are swapped by getPixels().
+    const VkFormatFeatureFlags imageFeatures =
+        getFormatFeaturesLocked(imageFormat, image->imageCreateInfo.tiling);
+    const VkFormatFeatureFlags scaledFeatures =
+        getFormatFeaturesLocked(wantedFormat, VK_IMAGE_TILING_OPTIMAL);
+    const bool canCopy = (isRgba8(imageFormat) || isBgra8(imageFormat)) && sameSize;
+    const bool needsBlit = !canCopy || isBgra8(imageFormat) != readbackBgra;
+    const bool canBlit = (imageFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT) &&
+                         (scaledFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+
+    const bool useBlit = needsBlit && canBlit && ensureScaledImageLocked(display, wantedFormat);
+    if (!useBlit && !canCopy && display->unsupportedFormat != imageFormat) {
+        // Logged once, the guest keeps posting the same ColorBuffers every frame.
+        ERR("Unable to read back ColorBuffer:%d with format %s and size %dx%d for display:%d "
+            "of size %dx%d.",
+            cb->getHndl(), string_VkFormat(imageFormat), imageExtent.width, imageExtent.height,
+            displayId, display->width, display->height);
+        display->unsupportedFormat = imageFormat;
+    }
+
+    std::vector<VkImageMemoryBarrier> acquireQueueTransferBarriers;
+    std::vector<VkImageMemoryBarrier> acquireLayoutTransitionBarriers;
+    std::vector<VkImageMemoryBarrier> releaseLayoutTransitionBarriers;
+    std::vector<VkImageMemoryBarrier> releaseQueueTransferBarriers;
+    addNeededBarriersToUseBorrowedImage(
+        *image, m_queueFamilyIndex,
+        /*usedInitialImageLayout=*/VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        /*usedFinalImageLayout=*/VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_ACCESS_TRANSFER_READ_BIT, &acquireQueueTransferBarriers,
+        &acquireLayoutTransitionBarriers, &releaseLayoutTransitionBarriers,
+        &releaseQueueTransferBarriers);
+
+    VK_CHECK(m_vk.vkResetCommandBuffer(slot->commandBuffer, 0));
+    const VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    VK_CHECK(m_vk.vkBeginCommandBuffer(slot->commandBuffer, &beginInfo));
+
+    if (!acquireQueueTransferBarriers.empty()) {
+        m_vk.vkCmdPipelineBarrier(slot->commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr,
+                                  static_cast<uint32_t>(acquireQueueTransferBarriers.size()),
+                                  acquireQueueTransferBarriers.data());
+    }
+    if (!acquireLayoutTransitionBarriers.empty()) {
+        m_vk.vkCmdPipelineBarrier(slot->commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                                  static_cast<uint32_t>(acquireLayoutTransitionBarriers.size()),
+                                  acquireLayoutTransitionBarriers.data());
+    }
+
+    VkImage copySource = image->image;
+    VkExtent3D copyExtent = {
+        .width = std::min(imageExtent.width, display->width),
+        .height = std::min(imageExtent.height, display->height),
+        .depth = 1,
+    };
+    if (useBlit) {
+        // The previous use of the scaled image, by an earlier submission, only read from it.
+        const VkImageMemoryBarrier toTransferDst = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = display->scaledImage,
+            .subresourceRange = kColorSubresourceRange,
+        };
+        m_vk.vkCmdPipelineBarrier(slot->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                                  &toTransferDst);
+
+        const VkImageBlit blit = {
+            .srcSubresource =
+                {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = 0,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+            .srcOffsets =
+                {
+                    {0, 0, 0},
+                    {static_cast<int32_t>(imageExtent.width),
+                     static_cast<int32_t>(imageExtent.height), 1},
+                },
+            .dstSubresource =
+                {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = 0,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+            .dstOffsets =
+                {
+                    {0, 0, 0},
+                    {static_cast<int32_t>(display->width), static_cast<int32_t>(display->height),
+                     1},
+                },
+        };
+        const VkFilter filter =
+            (!sameSize && (imageFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+                ? VK_FILTER_LINEAR
+                : VK_FILTER_NEAREST;
+        m_vk.vkCmdBlitImage(slot->commandBuffer, image->image,
+                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, display->scaledImage,
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, filter);
+
+        const VkImageMemoryBarrier toTransferSrc = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = display->scaledImage,
+            .subresourceRange = kColorSubresourceRange,
+        };
+        m_vk.vkCmdPipelineBarrier(slot->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                                  &toTransferSrc);
+
+        copySource = display->scaledImage;
+        copyExtent = {.width = display->width, .height = display->height, .depth = 1};
+        slot->swapRedBlue = false;
+    } else {
+        slot->swapRedBlue = isBgra8(imageFormat) != readbackBgra;
+    }
+
+    if (useBlit || canCopy) {
+        const VkBufferImageCopy region = {
+            .bufferOffset = 0,
+            .bufferRowLength = display->width,
+            .bufferImageHeight = display->height,
+            .imageSubresource =
+                {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = 0,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+            .imageOffset = {0, 0, 0},
+            .imageExtent = copyExtent,
+        };
+        m_vk.vkCmdCopyImageToBuffer(slot->commandBuffer, copySource,
+                                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1,
+                                    &region);
+
+        const VkBufferMemoryBarrier toHostRead = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = slot->buffer,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE,
+        };
+        m_vk.vkCmdPipelineBarrier(slot->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                  VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHostRead, 0,
+                                  nullptr);
+    }
+
+    // The borrow already moved the ColorBuffer's tracked layout and queue family, so the
+    // release barriers are recorded even if the frame could not be read back.
+    if (!releaseLayoutTransitionBarriers.empty()) {
+        m_vk.vkCmdPipelineBarrier(slot->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr,
+                                  static_cast<uint32_t>(releaseLayoutTransitionBarriers.size()),
+                                  releaseLayoutTransitionBarriers.data());
+    }
+    if (!releaseQueueTransferBarriers.empty()) {
+        m_vk.vkCmdPipelineBarrier(slot->commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr,
+                                  static_cast<uint32_t>(releaseQueueTransferBarriers.size()),
+                                  releaseQueueTransferBarriers.data());
+    }
+
+    VK_CHECK(m_vk.vkEndCommandBuffer(slot->commandBuffer));
+
+    VK_CHECK(m_vk.vkResetFences(m_vkDevice, 1, &slot->fence));
+    const VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &slot->commandBuffer,
+    };
+    {
+        android::base::AutoLock queueLock(*m_vkQueueLock);
+        VK_CHECK(m_vk.vkQueueSubmit(m_vkQueue, 1, &submitInfo, slot->fence));
+    }
+
+    if (!useBlit && !canCopy) {
+        // Nothing was written, keep handing out the previous frames.
+        slot->serial = 0;
+        return DoNextReadbackResult::OK_NOT_READY_FOR_READ;
+    }
+
+    slot->serial = display->nextSerial++;
+    if (repaint) {
+        display->readNewest = true;
+    }
+    return DoNextReadbackResult::OK_READY_FOR_READ;
+}
+
+ReadbackWorkerVk::FlushResult ReadbackWorkerVk::flushPipeline(uint32_t displayId) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_trackedDisplays.find(displayId);
+    if (it == m_trackedDisplays.end()) {
+        ERR("Failed to find TrackedDisplay for display:%d", displayId);
+        return FlushResult::FAIL;
+    }
+    TrackedDisplay* display = it->second.get();
+
+    if (display->copyingSlot) {
+        // No need to make the last frame available, we are currently being read.
+        return FlushResult::OK_NOT_READY_FOR_READ;
+    }
+
+    // Slots are reused oldest first, so the newest frame stays available until a newer one
+    // has been submitted.
+    display->readNewest = true;
+    return FlushResult::OK_READY_FOR_READ;
+}
+
+void ReadbackWorkerVk::getPixels(uint32_t displayId, void* out, uint32_t bytes) {
+    ReadbackSlot* slot = nullptr;
+    TrackedDisplay* display = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_trackedDisplays.find(displayId);
+        if (it == m_trackedDisplays.end()) {
+            ERR("Failed to find TrackedDisplay for display:%d", displayId);
+            return;
+        }
+        display = it->second.get();
+
+        const std::optional<size_t> index =
+            pickReadbackSlotToRead(getSlotStatesLocked(display), display->readNewest);
+        if (!index) {
+            ERR("No frame read back yet for display:%d", displayId);
+            return;
+        }
+        slot = &display->slots[*index];
+        display->readNewest = false;
+        display->copyingSlot = *index;
+    }
+
+    // Only this thread touches the slot until copyingSlot is cleared. Display removal also
+    // happens on this thread, so `display` stays valid.
+    const VkResult waitResult =
+        m_vk.vkWaitForFences(m_vkDevice, 1, &slot->fence, VK_TRUE, kReadbackFenceTimeoutNs);
+    if (waitResult != VK_SUCCESS) {
+        // Skip the frame rather than hanging the readback thread on a lost device.
+        ERR("Failed to wait for readback of display:%d: %s.", displayId,
+            string_VkResult(waitResult));
+        std::lock_guard<std::mutex> lock(m_mutex);
+        display->copyingSlot.reset();
+        return;
+    }
+    if (!display->hostCoherent) {
+        const VkMappedMemoryRange range = {
+            .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+            .memory = slot->memory,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE,
+        };
+        VK_CHECK(m_vk.vkInvalidateMappedMemoryRanges(m_vkDevice, 1, &range));
+    }
+
+    const size_t size = std::min<size_t>(bytes, display->bufferSize);
+    memcpy(out, slot->mapped, size);
+    if (slot->swapRedBlue) {
+        swapRedBlue(static_cast<uint8_t*>(out), size);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    display->copyingSlot.reset();
+}
+
+void ReadbackWorkerVk::deinitReadbackForDisplay(uint32_t displayId) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_trackedDisplays.find(displayId);
+    if (it == m_trackedDisplays.end()) {
+        ERR("Double deinit of TrackedDisplay for display:%d", displayId);
+        return;
+    }
+    destroyDisplayLocked(it->second.get());
+    m_trackedDisplays.erase(it);
+}
+
+}  // namespace vk
+}  // namespace gfxstream
@@ -0,0 +1,127 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "ReadbackSlotRing.h"
+#include "ReadbackWorker.h"
+#include "aemu/base/ThreadAnnotations.h"
+#include "aemu/base/synchronization/Lock.h"
+#include "goldfish_vk_dispatch.h"
+
+namespace gfxstream {
+namespace vk {
+
+// Reads back posted ColorBuffers for the m_onPost consumers (recording, WebRTC...) when there
+// is no GL emulation.
+//
+// Each tracked display has a ring of host visible buffers. doNextReadback() records a copy of
+// the ColorBuffer into the oldest buffer that the GPU is done with and submits it without
+// waiting, so several frames can be in flight. Scaling to the display size and the BGRA
+// conversion are done on the GPU with a blit when the ColorBuffer format supports it.
+// getPixels() hands out the newest buffer that the GPU has finished writing.
+//
+// doNextReadback() and flushPipeline() are called from the FrameBuffer post thread, the other
+// methods from the FrameBuffer readback thread.
+class ReadbackWorkerVk : public ReadbackWorker {
+   public:
+    static std::unique_ptr<ReadbackWorkerVk> create(const VulkanDispatch& vk, VkDevice vkDevice,
+                                                    VkPhysicalDevice vkPhysicalDevice,
+                                                    VkQueue vkQueue,
+                                                    std::shared_ptr<android::base::Lock> queueLock,
+                                                    uint32_t queueFamilyIndex);
+    ~ReadbackWorkerVk();
+
+    void init() override;
+    void initReadbackForDisplay(uint32_t displayId, uint32_t w, uint32_t h) override;
+    void deinitReadbackForDisplay(uint32_t displayId) override;
+    DoNextReadbackResult doNextReadback(uint32_t displayId, ColorBuffer* cb, void* fbImage,
+                                        bool repaint, bool readbackBgra) override;
+    void getPixels(uint32_t displayId, void* out, uint32_t bytes) override;
+    FlushResult flushPipeline(uint32_t displayId) override;
+
+   private:
+    ReadbackWorkerVk(const VulkanDispatch& vk, VkDevice vkDevice,
+                     VkPhysicalDevice vkPhysicalDevice, VkQueue vkQueue,
+                     std::shared_ptr<android::base::Lock> queueLock, uint32_t queueFamilyIndex);
+
+    struct ReadbackSlot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        // Increases with every submission to any slot of the display, 0 if never submitted.
+        uint64_t serial = 0;
+        // Set when the GPU could not do the BGRA conversion and getPixels() has to.
+        bool swapRedBlue = false;
+    };
+
+    struct TrackedDisplay {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        VkDeviceSize bufferSize = 0;
+        bool hostCoherent = false;
+        std::vector<ReadbackSlot> slots;
+
+        // Blit destination, allocated the first time the ColorBuffer does not match the
+        // display size or format.
+        VkImage scaledImage = VK_NULL_HANDLE;
+        VkDeviceMemory scaledImageMemory = VK_NULL_HANDLE;
+        VkFormat scaledImageFormat = VK_FORMAT_UNDEFINED;
+
+        uint64_t nextSerial = 1;
+        // The slot being copied out by getPixels(), which must not be reused meanwhile.
+        std::optional<size_t> copyingSlot;
+        // Set on repaint and flush so that getPixels() waits for the newest submission
+        // instead of handing out an older completed one.
+        bool readNewest = false;
+        // The last ColorBuffer format that could not be read back, to only log it once.
+        VkFormat unsupportedFormat = VK_FORMAT_UNDEFINED;
+    };
+
+    bool createSlotLocked(TrackedDisplay* display, uint32_t memoryTypeIndex, ReadbackSlot* slot)
+        REQUIRES(m_mutex);
+    void destroyDisplayLocked(TrackedDisplay* display) REQUIRES(m_mutex);
+    bool ensureScaledImageLocked(TrackedDisplay* display, VkFormat format) REQUIRES(m_mutex);
+    void destroyScaledImageLocked(TrackedDisplay* display) REQUIRES(m_mutex);
+    void waitForSlotsLocked(TrackedDisplay* display) REQUIRES(m_mutex);
+    std::vector<ReadbackSlotState> getSlotStatesLocked(TrackedDisplay* display) REQUIRES(m_mutex);
+    ReadbackSlot* acquireSlotLocked(TrackedDisplay* display) REQUIRES(m_mutex);
+    VkFormatFeatureFlags getFormatFeaturesLocked(VkFormat format, VkImageTiling tiling)
+        REQUIRES(m_mutex);
+
+    const VulkanDispatch& m_vk;
+    const VkDevice m_vkDevice;
+    const VkPhysicalDevice m_vkPhysicalDevice;
+    const VkQueue m_vkQueue;
+    const std::shared_ptr<android::base::Lock> m_vkQueueLock;
+    const uint32_t m_queueFamilyIndex;
+    VkPhysicalDeviceMemoryProperties m_vkMemoryProperties = {};
+
+    std::mutex m_mutex;
+    VkCommandPool m_vkCommandPool GUARDED_BY(m_mutex) = VK_NULL_HANDLE;
+    std::unordered_map<uint32_t, std::unique_ptr<TrackedDisplay>> m_trackedDisplays
+        GUARDED_BY(m_mutex);
+    std::unordered_map<VkFormat, VkFormatProperties> m_formatProperties GUARDED_BY(m_mutex);
+};
+
+}  // namespace vk
+}  // namespace gfxstream
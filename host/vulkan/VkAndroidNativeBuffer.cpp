@@ -863,6 +863,9 @@ VkResult AndroidNativeBufferInfo::on_vkQueueSignalReleaseImageANDROID(
     fb->unlock();
 
     if (mUseVulkanNativeImage) {
+        // The guest rendered straight into the ColorBuffer's image.
+        fb->markColorBufferContentChanged(mColorBufferHandle);
+
         VK_ANB_DEBUG_OBJ(this, "using native image, so use sync thread to wait");
         // Queue wait to sync thread with completion callback
         // Pass anbInfo by value to get a ref
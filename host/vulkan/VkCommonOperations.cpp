@@ -20,6 +20,7 @@
 #include <string.h>
 #include <vulkan/vk_enum_string_helper.h>
 
+#include <algorithm>
 #include <iomanip>
 #include <ostream>
 #include <sstream>
@@ -1556,16 +1557,17 @@ std::unique_ptr<VkEmulation> VkEmulation::create(VulkanDispatch* gvk,
                                              string_VkResult(poolCreateRes));
     }
 
+    std::vector<VkCommandBuffer> stagingCommandBuffers(kNumStagingSlots, VK_NULL_HANDLE);
     VkCommandBufferAllocateInfo cbAi = {
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         0,
         emulation->mCommandPool,
         VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        1,
+        kNumStagingSlots,
     };
 
     VkResult cbAllocRes =
-        dvk->vkAllocateCommandBuffers(emulation->mDevice, &cbAi, &emulation->mCommandBuffer);
+        dvk->vkAllocateCommandBuffers(emulation->mDevice, &cbAi, stagingCommandBuffers.data());
 
     if (cbAllocRes != VK_SUCCESS) {
         VK_EMU_INIT_RETURN_OR_ABORT_ON_ERROR(cbAllocRes,
@@ -1573,19 +1575,26 @@ std::unique_ptr<VkEmulation> VkEmulation::create(VulkanDispatch* gvk,
                                              string_VkResult(cbAllocRes));
     }
 
-    VkFenceCreateInfo fenceCi = {
-        VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-        0,
-        0,
-    };
+    emulation->mStagingSlots.resize(kNumStagingSlots);
+    for (uint32_t i = 0; i < kNumStagingSlots; i++) {
+        StagingSlot& slot = emulation->mStagingSlots[i];
+        slot.index = i;
+        slot.commandBuffer = stagingCommandBuffers[i];
 
-    VkResult fenceCreateRes =
-        dvk->vkCreateFence(emulation->mDevice, &fenceCi, nullptr, &emulation->mCommandBufferFence);
+        VkFenceCreateInfo fenceCi = {
+            VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            0,
+            0,
+        };
 
-    if (fenceCreateRes != VK_SUCCESS) {
-        VK_EMU_INIT_RETURN_OR_ABORT_ON_ERROR(
-            fenceCreateRes, "Failed to create fence for command buffer. Error: %s.",
-            string_VkResult(fenceCreateRes));
+        VkResult fenceCreateRes =
+            dvk->vkCreateFence(emulation->mDevice, &fenceCi, nullptr, &slot.fence);
+
+        if (fenceCreateRes != VK_SUCCESS) {
+            VK_EMU_INIT_RETURN_OR_ABORT_ON_ERROR(
+                fenceCreateRes, "Failed to create fence for command buffer. Error: %s.",
+                string_VkResult(fenceCreateRes));
+        }
     }
 
     // At this point, the global emulation state's logical device can alloc
@@ -1658,7 +1667,10 @@ std::unique_ptr<VkEmulation> VkEmulation::create(VulkanDispatch* gvk,
         emulation->mDebugUtilsHelper.addDebugLabel(emulation->mDevice, "AEMU_Device");
         emulation->mDebugUtilsHelper.addDebugLabel(emulation->mStaging.buffer,
                                                    "AEMU_StagingBuffer");
-        emulation->mDebugUtilsHelper.addDebugLabel(emulation->mCommandBuffer, "AEMU_CommandBuffer");
+        for (const StagingSlot& slot : emulation->mStagingSlots) {
+            emulation->mDebugUtilsHelper.addDebugLabel(slot.commandBuffer,
+                                                       "AEMU_CommandBuffer_%u", slot.index);
+        }
     }
 
     if (commandBufferCheckpointsSupportedAndRequested) {
@@ -1715,6 +1727,12 @@ void VkEmulation::initFeatures(Features features) {
                                                  mQueue, mQueueLock);
     }
 
+    if (mReadbackWorkerVk) {
+        ERR("Reset VkEmulation::readbackWorkerVk.");
+    }
+    mReadbackWorkerVk = ReadbackWorkerVk::create(*mIvk, mDevice, mPhysicalDevice, mQueue,
+                                                 mQueueLock, mQueueFamilyIndex);
+
     auto representativeInfo = findRepresentativeColorBufferMemoryTypeIndexLocked();
     if (!representativeInfo) {
         GFXSTREAM_ABORT(FatalError(ABORT_REASON_OTHER))
@@ -1733,12 +1751,23 @@ VkEmulation::~VkEmulation() {
 
     mCompositorVk.reset();
     mDisplayVk.reset();
+    mReadbackWorkerVk.reset();
+
+    {
+        android::base::AutoLock queueLock(*mQueueLock);
+        for (StagingSlot& slot : mStagingSlots) {
+            waitForStagingSlotLocked(&slot, __func__);
+        }
+    }
 
     freeExternalMemoryLocked(mDvk, &mStaging.memory);
 
     mDvk->vkDestroyBuffer(mDevice, mStaging.buffer, nullptr);
-    mDvk->vkDestroyFence(mDevice, mCommandBufferFence, nullptr);
-    mDvk->vkFreeCommandBuffers(mDevice, mCommandPool, 1, &mCommandBuffer);
+    for (StagingSlot& slot : mStagingSlots) {
+        mDvk->vkDestroyFence(mDevice, slot.fence, nullptr);
+        mDvk->vkFreeCommandBuffers(mDevice, mCommandPool, 1, &slot.commandBuffer);
+    }
+    mStagingSlots.clear();
     mDvk->vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
 
     mIvk->vkDestroyDevice(mDevice, nullptr);
@@ -1830,6 +1859,8 @@ Compositor* VkEmulation::getCompositor() { return mCompositorVk.get(); }
 
 DisplayVk* VkEmulation::getDisplay() { return mDisplayVk.get(); }
 
+ReadbackWorkerVk* VkEmulation::getReadbackWorker() { return mReadbackWorkerVk.get(); }
+
 VkInstance VkEmulation::getInstance() { return mInstance; }
 
 std::optional<std::array<uint8_t, VK_UUID_SIZE>> VkEmulation::getDeviceUuid() {
@@ -2883,6 +2914,8 @@ std::optional<VkEmulation::VkColorBufferMemoryExport> VkEmulation::exportColorBu
         return std::nullopt;
     }
 
+    waitForColorBufferUploadLocked(info);
+
     if ((info->vulkanMode != VkEmulation::VulkanMode::VulkanOnly) &&
         !mDeviceInfo.glInteropSupported) {
         return std::nullopt;
@@ -2955,6 +2988,9 @@ std::optional<VkEmulation::ColorBufferInfo> VkEmulation::getColorBufferInfo(
         return std::nullopt;
     }
 
+    // The image is about to be used outside of `mQueue`.
+    waitForColorBufferUploadLocked(infoPtr);
+
     return *infoPtr;
 }
 
@@ -2990,7 +3026,7 @@ bool VkEmulation::colorBufferNeedsUpdateBetweenGlAndVk(uint32_t colorBufferHandl
 }
 
 bool VkEmulation::readColorBufferToBytes(uint32_t colorBufferHandle, std::vector<uint8_t>* bytes) {
-    std::lock_guard<std::mutex> lock(mMutex);
+    std::unique_lock<std::mutex> lock(mMutex);
 
     auto colorBufferInfo = android::base::find(mColorBuffers, colorBufferHandle);
     if (!colorBufferInfo) {
@@ -3012,7 +3048,7 @@ bool VkEmulation::readColorBufferToBytes(uint32_t colorBufferHandle, std::vector
     bytes->resize(bytesNeeded);
 
     result = readColorBufferToBytesLocked(
-        colorBufferHandle, 0, 0, colorBufferInfo->imageCreateInfoShallow.extent.width,
+        lock, colorBufferHandle, 0, 0, colorBufferInfo->imageCreateInfoShallow.extent.width,
         colorBufferInfo->imageCreateInfoShallow.extent.height, bytes->data(), bytes->size());
     if (!result) {
         ERR("Failed to read from ColorBuffer:%d, failed to get read size.", colorBufferHandle);
@@ -3025,13 +3061,24 @@ bool VkEmulation::readColorBufferToBytes(uint32_t colorBufferHandle, std::vector
 bool VkEmulation::readColorBufferToBytes(uint32_t colorBufferHandle, uint32_t x, uint32_t y,
                                          uint32_t w, uint32_t h, void* outPixels,
                                          uint64_t outPixelsSize) {
-    std::lock_guard<std::mutex> lock(mMutex);
-    return readColorBufferToBytesLocked(colorBufferHandle, x, y, w, h, outPixels, outPixelsSize);
+    std::unique_lock<std::mutex> lock(mMutex);
+    return readColorBufferToBytesLocked(lock, colorBufferHandle, x, y, w, h, outPixels,
+                                        outPixelsSize);
 }
 
-bool VkEmulation::readColorBufferToBytesLocked(uint32_t colorBufferHandle, uint32_t x, uint32_t y,
+bool VkEmulation::readColorBufferToCallback(uint32_t colorBufferHandle, uint32_t x, uint32_t y,
+                                            uint32_t w, uint32_t h,
+                                            const ColorBufferReadCallback& consumePixels) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    return readColorBufferToBytesLocked(lock, colorBufferHandle, x, y, w, h, nullptr, 0,
+                                        consumePixels);
+}
+
+bool VkEmulation::readColorBufferToBytesLocked(std::unique_lock<std::mutex>& lock,
+                                               uint32_t colorBufferHandle, uint32_t x, uint32_t y,
                                                uint32_t w, uint32_t h, void* outPixels,
-                                               uint64_t outPixelsSize) {
+                                               uint64_t outPixelsSize,
+                                               const ColorBufferReadCallback& consumePixels) {
     auto vk = mDvk;
 
     auto colorBufferInfo = android::base::find(mColorBuffers, colorBufferHandle);
@@ -3045,22 +3092,37 @@ bool VkEmulation::readColorBufferToBytesLocked(uint32_t colorBufferHandle, uint3
         return false;
     }
 
-    if (x != 0 || y != 0 || w != colorBufferInfo->imageCreateInfoShallow.extent.width ||
-        h != colorBufferInfo->imageCreateInfoShallow.extent.height) {
-        ERR("Failed to read from ColorBuffer:%d, unhandled subrect.", colorBufferHandle);
+    const VkExtent3D& extent = colorBufferInfo->imageCreateInfoShallow.extent;
+    if (x > extent.width || w > extent.width - x || y > extent.height ||
+        h > extent.height - y) {
+        ERR("Failed to read from ColorBuffer:%d, subrect out of bounds.", colorBufferHandle);
         return false;
     }
+    const bool isSubrect = x != 0 || y != 0 || w != extent.width || h != extent.height;
 
     VkDeviceSize bufferCopySize = 0;
     std::vector<VkBufferImageCopy> bufferImageCopies;
-    if (!getFormatTransferInfo(colorBufferInfo->imageCreateInfoShallow.format,
-                               colorBufferInfo->imageCreateInfoShallow.extent.width,
-                               colorBufferInfo->imageCreateInfoShallow.extent.height,
-                               &bufferCopySize, &bufferImageCopies)) {
+    const bool gotTransferInfo =
+        isSubrect ? getFormatSubrectTransferInfo(colorBufferInfo->imageCreateInfoShallow.format,
+                                                 x, y, w, h, &bufferCopySize, &bufferImageCopies)
+                  : getFormatTransferInfo(colorBufferInfo->imageCreateInfoShallow.format, w, h,
+                                          &bufferCopySize, &bufferImageCopies);
+    if (!gotTransferInfo) {
         ERR("Failed to read ColorBuffer:%d, unable to get transfer info.", colorBufferHandle);
         return false;
     }
 
+    StagingSlot* slot = acquireStagingSlotLocked(bufferCopySize);
+    if (!slot) {
+        ERR("Failed to read ColorBuffer:%d, transfer size %" PRIu64
+            " too large for staging buffer size:%" PRIu64 ".",
+            colorBufferHandle, bufferCopySize, mStaging.size);
+        return false;
+    }
+    for (VkBufferImageCopy& bufferImageCopy : bufferImageCopies) {
+        bufferImageCopy.bufferOffset += slot->offset;
+    }
+
     // Avoid transitioning from VK_IMAGE_LAYOUT_UNDEFINED. Unfortunetly, Android does not
     // yet have a mechanism for sharing the expected VkImageLayout. However, the Vulkan
     // spec's image layout transition sections says "If the old layout is
@@ -3078,18 +3140,19 @@ bool VkEmulation::readColorBufferToBytesLocked(uint32_t colorBufferHandle, uint3
         .pNext = nullptr,
         .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
     };
-    VK_CHECK(vk->vkBeginCommandBuffer(mCommandBuffer, &beginInfo));
+    VK_CHECK(vk->vkBeginCommandBuffer(slot->commandBuffer, &beginInfo));
 
-    mDebugUtilsHelper.cmdBeginDebugLabel(mCommandBuffer, "readColorBufferToBytes(ColorBuffer:%d)",
-                                         colorBufferHandle);
+    mDebugUtilsHelper.cmdBeginDebugLabel(
+        slot->commandBuffer, "readColorBufferToBytes(ColorBuffer:%d)", colorBufferHandle);
 
     VkImageLayout currentLayout = colorBufferInfo->currentLayout;
     VkImageLayout transferSrcLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 
+    // Uploads to this ColorBuffer may still be executing on the queue.
     const VkImageMemoryBarrier toTransferSrcImageBarrier = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
         .pNext = nullptr,
-        .srcAccessMask = 0,
+        .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
         .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
         .oldLayout = currentLayout,
         .newLayout = transferSrcLayout,
@@ -3106,11 +3169,11 @@ bool VkEmulation::readColorBufferToBytesLocked(uint32_t colorBufferHandle, uint3
             },
     };
 
-    vk->vkCmdPipelineBarrier(mCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+    vk->vkCmdPipelineBarrier(slot->commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
                              VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1,
                              &toTransferSrcImageBarrier);
 
-    vk->vkCmdCopyImageToBuffer(mCommandBuffer, colorBufferInfo->image,
+    vk->vkCmdCopyImageToBuffer(slot->commandBuffer, colorBufferInfo->image,
                                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mStaging.buffer,
                                bufferImageCopies.size(), bufferImageCopies.data());
 
@@ -3136,61 +3199,47 @@ bool VkEmulation::readColorBufferToBytesLocked(uint32_t colorBufferHandle, uint3
                     .layerCount = 1,
                 },
         };
-        vk->vkCmdPipelineBarrier(mCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        vk->vkCmdPipelineBarrier(slot->commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
                                  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1,
                                  &toCurrentLayoutImageBarrier);
     } else {
         colorBufferInfo->currentLayout = transferSrcLayout;
     }
 
-    mDebugUtilsHelper.cmdEndDebugLabel(mCommandBuffer);
+    mDebugUtilsHelper.cmdEndDebugLabel(slot->commandBuffer);
 
-    VK_CHECK(vk->vkEndCommandBuffer(mCommandBuffer));
+    VK_CHECK(vk->vkEndCommandBuffer(slot->commandBuffer));
 
-    const VkSubmitInfo submitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext = nullptr,
-        .waitSemaphoreCount = 0,
-        .pWaitSemaphores = nullptr,
-        .pWaitDstStageMask = nullptr,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &mCommandBuffer,
-        .signalSemaphoreCount = 0,
-        .pSignalSemaphores = nullptr,
-    };
-
-    {
-        android::base::AutoLock queueLock(*mQueueLock);
-        VK_CHECK(vk->vkQueueSubmit(mQueue, 1, &submitInfo, mCommandBufferFence));
-    }
-
-    static constexpr uint64_t ANB_MAX_WAIT_NS = 5ULL * 1000ULL * 1000ULL * 1000ULL;
-    VkResult waitRes =
-        vk->vkWaitForFences(mDevice, 1, &mCommandBufferFence, VK_TRUE, ANB_MAX_WAIT_NS);
-    if (waitRes == VK_TIMEOUT) {
-        // Give a warning and try once more on a timeout error
-        ERR("readColorBufferToBytesLocked vkWaitForFences failed with timeout error "
-            "(cb:%d, x:%d, y:%d, w:%d, h:%d, bufferCopySize:%llu), retrying...",
-            colorBufferHandle, x, y, w, h, bufferCopySize);
-        waitRes =
-            vk->vkWaitForFences(mDevice, 1, &mCommandBufferFence, VK_TRUE, ANB_MAX_WAIT_NS * 2);
-    }
+    submitStagingSlotLocked(slot);
 
+    // Only this slot's submission needs to complete, earlier uploads to other ColorBuffers
+    // can still be in flight. Other threads can keep using the emulation in the meantime, the
+    // slot is left alone until the readback is done with it. `colorBufferInfo` is not used
+    // after this, as the ColorBuffer may be torn down while unlocked.
+    slot->readbackInProgress = true;
+    lock.unlock();
+    const VkResult waitRes = waitForStagingFence(*slot, __func__);
+    lock.lock();
     VK_CHECK(waitRes);
-
-    VK_CHECK(vk->vkResetFences(mDevice, 1, &mCommandBufferFence));
+    resetStagingSlotLocked(slot);
+    slot->readbackInProgress = false;
+    mStagingSlotCv.notify_all();
 
     const VkMappedMemoryRange toInvalidate = {
         .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
         .pNext = nullptr,
         .memory = mStaging.memory.memory,
-        .offset = 0,
-        .size = VK_WHOLE_SIZE,
+        .offset = slot->offset,
+        .size = slot->size,
     };
 
     VK_CHECK(vk->vkInvalidateMappedMemoryRanges(mDevice, 1, &toInvalidate));
 
-    const auto* stagingBufferPtr = mStaging.memory.mappedPtr;
+    const auto* stagingBufferPtr =
+        static_cast<const uint8_t*>(mStaging.memory.mappedPtr) + slot->offset;
+    if (!outPixels) {
+        return consumePixels(stagingBufferPtr, bufferCopySize);
+    }
     if (bufferCopySize > outPixelsSize) {
         ERR("Invalid buffer size for readColorBufferToBytes operation."
             "Required: %llu, Actual: %llu",
@@ -3223,6 +3272,13 @@ bool VkEmulation::updateColorBufferFromBytes(uint32_t colorBufferHandle, uint32_
     return updateColorBufferFromBytesLocked(colorBufferHandle, x, y, w, h, pixels, 0);
 }
 
+bool VkEmulation::updateColorBufferFromCallback(uint32_t colorBufferHandle, uint32_t x, uint32_t y,
+                                                uint32_t w, uint32_t h,
+                                                const ColorBufferWriteCallback& fillPixels) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return updateColorBufferFromBytesLocked(colorBufferHandle, x, y, w, h, nullptr, 0, fillPixels);
+}
+
 static void convertRgbToRgbaPixels(void* dst, const void* src, uint32_t w, uint32_t h) {
     const size_t pixelCount = w * h;
     const uint8_t* srcBytes = reinterpret_cast<const uint8_t*>(src);
@@ -3251,7 +3307,8 @@ static void convertRgba4ToBGRA4Pixels(void* dst, const void* src, uint32_t w, ui
 
 bool VkEmulation::updateColorBufferFromBytesLocked(uint32_t colorBufferHandle, uint32_t x,
                                                    uint32_t y, uint32_t w, uint32_t h,
-                                                   const void* pixels, size_t inputPixelsSize) {
+                                                   const void* pixels, size_t inputPixelsSize,
+                                                   const ColorBufferWriteCallback& fillPixels) {
     auto vk = mDvk;
 
     auto colorBufferInfo = android::base::find(mColorBuffers, colorBufferHandle);
@@ -3265,30 +3322,27 @@ bool VkEmulation::updateColorBufferFromBytesLocked(uint32_t colorBufferHandle, u
         return false;
     }
 
-    if (x != 0 || y != 0 || w != colorBufferInfo->imageCreateInfoShallow.extent.width ||
-        h != colorBufferInfo->imageCreateInfoShallow.extent.height) {
-        ERR("Failed to update ColorBuffer:%d, unhandled subrect.", colorBufferHandle);
+    const VkExtent3D& extent = colorBufferInfo->imageCreateInfoShallow.extent;
+    if (x > extent.width || w > extent.width - x || y > extent.height ||
+        h > extent.height - y) {
+        ERR("Failed to update ColorBuffer:%d, subrect out of bounds.", colorBufferHandle);
         return false;
     }
+    const bool isSubrect = x != 0 || y != 0 || w != extent.width || h != extent.height;
 
     const VkFormat creationFormat = colorBufferInfo->imageCreateInfoShallow.format;
     VkDeviceSize dstBufferSize = 0;
     std::vector<VkBufferImageCopy> bufferImageCopies;
-    if (!getFormatTransferInfo(creationFormat,
-                               colorBufferInfo->imageCreateInfoShallow.extent.width,
-                               colorBufferInfo->imageCreateInfoShallow.extent.height,
-                               &dstBufferSize, &bufferImageCopies)) {
+    const bool gotTransferInfo =
+        isSubrect ? getFormatSubrectTransferInfo(creationFormat, x, y, w, h, &dstBufferSize,
+                                                 &bufferImageCopies)
+                  : getFormatTransferInfo(creationFormat, w, h, &dstBufferSize,
+                                          &bufferImageCopies);
+    if (!gotTransferInfo) {
         ERR("Failed to update ColorBuffer:%d, unable to get transfer info.", colorBufferHandle);
         return false;
     }
 
-    const VkDeviceSize stagingBufferSize = mStaging.size;
-    if (dstBufferSize > stagingBufferSize) {
-        ERR("Failed to update ColorBuffer:%d, transfer size %" PRIu64
-            " too large for staging buffer size:%" PRIu64 ".",
-            colorBufferHandle, dstBufferSize, stagingBufferSize);
-        return false;
-    }
     const bool isRGBA4onBGRA4 = (colorBufferInfo->internalFormat == GL_RGBA4_OES) &&
                           (creationFormat == VK_FORMAT_B4G4R4A4_UNORM_PACK16);
     const bool isThreeByteRgb =
@@ -3302,7 +3356,36 @@ bool VkEmulation::updateColorBufferFromBytesLocked(uint32_t colorBufferHandle, u
         return false;
     }
 
-    auto* stagingBufferPtr = mStaging.memory.mappedPtr;
+    StagingSlot* slot = acquireStagingSlotLocked(dstBufferSize);
+    if (!slot) {
+        ERR("Failed to update ColorBuffer:%d, transfer size %" PRIu64
+            " too large for staging buffer size:%" PRIu64 ".",
+            colorBufferHandle, dstBufferSize, mStaging.size);
+        return false;
+    }
+    for (VkBufferImageCopy& bufferImageCopy : bufferImageCopies) {
+        bufferImageCopy.bufferOffset += slot->offset;
+    }
+
+    auto* stagingBufferPtr = static_cast<uint8_t*>(mStaging.memory.mappedPtr) + slot->offset;
+
+    // Formats that need conversion are filled into a temporary buffer first, everything else
+    // is written by the callback directly into the staging buffer.
+    std::vector<uint8_t> filledPixels;
+    if (!pixels) {
+        if (isThreeByteRgb || isRGBA4onBGRA4) {
+            filledPixels.resize(expectedInputSize);
+            if (!fillPixels(filledPixels.data(), filledPixels.size())) {
+                return false;
+            }
+            pixels = filledPixels.data();
+        } else {
+            if (!fillPixels(stagingBufferPtr, dstBufferSize)) {
+                return false;
+            }
+            pixels = stagingBufferPtr;
+        }
+    }
 
     if (isThreeByteRgb) {
         // Convert RGB to RGBA, since only for these types glFormat2VkFormat() makes
@@ -3311,7 +3394,7 @@ bool VkEmulation::updateColorBufferFromBytesLocked(uint32_t colorBufferHandle, u
         convertRgbToRgbaPixels(stagingBufferPtr, pixels, w, h);
     } else if(isRGBA4onBGRA4) {
         convertRgba4ToBGRA4Pixels(stagingBufferPtr, pixels, w, h);
-    } else {
+    } else if (pixels != stagingBufferPtr) {
         std::memcpy(stagingBufferPtr, pixels, dstBufferSize);
     }
 
@@ -3320,10 +3403,13 @@ bool VkEmulation::updateColorBufferFromBytesLocked(uint32_t colorBufferHandle, u
     // GL or Vulkan. Consequently, we typically avoid image transitions from
     // VK_IMAGE_LAYOUT_UNDEFINED as Vulkan spec allows the contents to be
     // discarded (and some drivers have been observed doing it). You can
-    // check go/ahb-vkimagelayout for more information. But since this
-    // function does not allow subrects (see above), it will write the
-    // provided contents onto the entirety of the target buffer, meaning this
-    // risk of discarding data should not impact anything.
+    // check go/ahb-vkimagelayout for more information. A full image update
+    // writes the entirety of the target buffer, so the risk of discarding data
+    // does not impact anything there. A subrect update must keep the rest of
+    // the contents, so it is handled like readColorBufferToBytesLocked().
+    if (isSubrect && colorBufferInfo->currentLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
+        colorBufferInfo->currentLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    }
 
     // Record our synchronization commands.
     const VkCommandBufferBeginInfo beginInfo = {
@@ -3331,21 +3417,23 @@ bool VkEmulation::updateColorBufferFromBytesLocked(uint32_t colorBufferHandle, u
         .pNext = nullptr,
         .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
     };
-    VK_CHECK(vk->vkBeginCommandBuffer(mCommandBuffer, &beginInfo));
+    VK_CHECK(vk->vkBeginCommandBuffer(slot->commandBuffer, &beginInfo));
 
     mDebugUtilsHelper.cmdBeginDebugLabel(
-        mCommandBuffer, "updateColorBufferFromBytes(ColorBuffer:%d)", colorBufferHandle);
+        slot->commandBuffer, "updateColorBufferFromBytes(ColorBuffer:%d)", colorBufferHandle);
 
     const bool isSnapshotLoad = VkDecoderGlobalState::get()->isSnapshotCurrentlyLoading();
     VkImageLayout currentLayout = colorBufferInfo->currentLayout;
     if (isSnapshotLoad) {
         currentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     }
+    // Uploads are not waited for, so order this one after any earlier use of the image
+    // on the queue.
     const VkImageMemoryBarrier toTransferDstImageBarrier = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
         .pNext = nullptr,
-        .srcAccessMask = 0,
-        .dstAccessMask = VK_ACCESS_HOST_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+        .srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
         .oldLayout = currentLayout,
         .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
@@ -3361,12 +3449,12 @@ bool VkEmulation::updateColorBufferFromBytesLocked(uint32_t colorBufferHandle, u
             },
     };
 
-    vk->vkCmdPipelineBarrier(mCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                             VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 0, nullptr, 1,
+    vk->vkCmdPipelineBarrier(slot->commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
                              &toTransferDstImageBarrier);
 
     // Copy from staging buffer to color buffer image
-    vk->vkCmdCopyBufferToImage(mCommandBuffer, mStaging.buffer, colorBufferInfo->image,
+    vk->vkCmdCopyBufferToImage(slot->commandBuffer, mStaging.buffer, colorBufferInfo->image,
                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, bufferImageCopies.size(),
                                bufferImageCopies.data());
 
@@ -3374,8 +3462,8 @@ bool VkEmulation::updateColorBufferFromBytesLocked(uint32_t colorBufferHandle, u
         const VkImageMemoryBarrier toCurrentLayoutImageBarrier = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
             .pNext = nullptr,
-            .srcAccessMask = VK_ACCESS_HOST_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
-            .dstAccessMask = VK_ACCESS_NONE_KHR,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
             .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             .newLayout = colorBufferInfo->currentLayout,
             .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
@@ -3390,47 +3478,20 @@ bool VkEmulation::updateColorBufferFromBytesLocked(uint32_t colorBufferHandle, u
                     .layerCount = 1,
                 },
         };
-        vk->vkCmdPipelineBarrier(mCommandBuffer, VK_PIPELINE_STAGE_HOST_BIT,
-                                 VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1,
+        vk->vkCmdPipelineBarrier(slot->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1,
                                  &toCurrentLayoutImageBarrier);
     } else {
         colorBufferInfo->currentLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
     }
 
-    mDebugUtilsHelper.cmdEndDebugLabel(mCommandBuffer);
+    mDebugUtilsHelper.cmdEndDebugLabel(slot->commandBuffer);
 
-    VK_CHECK(vk->vkEndCommandBuffer(mCommandBuffer));
+    VK_CHECK(vk->vkEndCommandBuffer(slot->commandBuffer));
 
-    const VkSubmitInfo submitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext = nullptr,
-        .waitSemaphoreCount = 0,
-        .pWaitSemaphores = nullptr,
-        .pWaitDstStageMask = nullptr,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &mCommandBuffer,
-        .signalSemaphoreCount = 0,
-        .pSignalSemaphores = nullptr,
-    };
-
-    {
-        android::base::AutoLock queueLock(*mQueueLock);
-        VK_CHECK(vk->vkQueueSubmit(mQueue, 1, &submitInfo, mCommandBufferFence));
-    }
-
-    static constexpr uint64_t ANB_MAX_WAIT_NS = 5ULL * 1000ULL * 1000ULL * 1000ULL;
-    VK_CHECK(vk->vkWaitForFences(mDevice, 1, &mCommandBufferFence, VK_TRUE, ANB_MAX_WAIT_NS));
-
-    VK_CHECK(vk->vkResetFences(mDevice, 1, &mCommandBufferFence));
-
-    const VkMappedMemoryRange toInvalidate = {
-        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
-        .pNext = nullptr,
-        .memory = mStaging.memory.memory,
-        .offset = 0,
-        .size = VK_WHOLE_SIZE,
-    };
-    VK_CHECK(vk->vkInvalidateMappedMemoryRanges(mDevice, 1, &toInvalidate));
+    // Do not wait for the upload here. Users of the image on other queues or APIs wait for
+    // `pendingUpload` first, see waitForColorBufferUploadLocked().
+    colorBufferInfo->pendingUpload = submitStagingSlotLocked(slot);
 
     return true;
 }
@@ -3775,8 +3836,8 @@ bool VkEmulation::readBufferToBytes(uint32_t bufferHandle, uint64_t offset, uint
         return false;
     }
 
-    const auto& stagingBufferInfo = mStaging;
-    if (size > stagingBufferInfo.size) {
+    StagingSlot* slot = acquireStagingSlotLocked(size);
+    if (!slot) {
         ERR("Failed to read from Buffer:%d, staging buffer too small.", bufferHandle);
         return false;
     }
@@ -3786,58 +3847,38 @@ bool VkEmulation::readBufferToBytes(uint32_t bufferHandle, uint64_t offset, uint
         .pNext = nullptr,
         .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
     };
-    VK_CHECK(vk->vkBeginCommandBuffer(mCommandBuffer, &beginInfo));
+    VK_CHECK(vk->vkBeginCommandBuffer(slot->commandBuffer, &beginInfo));
 
-    mDebugUtilsHelper.cmdBeginDebugLabel(mCommandBuffer, "readBufferToBytes(Buffer:%d)",
+    mDebugUtilsHelper.cmdBeginDebugLabel(slot->commandBuffer, "readBufferToBytes(Buffer:%d)",
                                          bufferHandle);
 
     const VkBufferCopy bufferCopy = {
         .srcOffset = offset,
-        .dstOffset = 0,
+        .dstOffset = slot->offset,
         .size = size,
     };
-    vk->vkCmdCopyBuffer(mCommandBuffer, bufferInfo->buffer, stagingBufferInfo.buffer, 1,
+    vk->vkCmdCopyBuffer(slot->commandBuffer, bufferInfo->buffer, mStaging.buffer, 1,
                         &bufferCopy);
 
-    mDebugUtilsHelper.cmdEndDebugLabel(mCommandBuffer);
+    mDebugUtilsHelper.cmdEndDebugLabel(slot->commandBuffer);
 
-    VK_CHECK(vk->vkEndCommandBuffer(mCommandBuffer));
+    VK_CHECK(vk->vkEndCommandBuffer(slot->commandBuffer));
 
-    const VkSubmitInfo submitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext = nullptr,
-        .waitSemaphoreCount = 0,
-        .pWaitSemaphores = nullptr,
-        .pWaitDstStageMask = nullptr,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &mCommandBuffer,
-        .signalSemaphoreCount = 0,
-        .pSignalSemaphores = nullptr,
-    };
-
-    {
-        android::base::AutoLock queueLock(*mQueueLock);
-        VK_CHECK(vk->vkQueueSubmit(mQueue, 1, &submitInfo, mCommandBufferFence));
-    }
-
-    static constexpr uint64_t ANB_MAX_WAIT_NS = 5ULL * 1000ULL * 1000ULL * 1000ULL;
-
-    VK_CHECK(vk->vkWaitForFences(mDevice, 1, &mCommandBufferFence, VK_TRUE, ANB_MAX_WAIT_NS));
-
-    VK_CHECK(vk->vkResetFences(mDevice, 1, &mCommandBufferFence));
+    submitStagingSlotLocked(slot);
+    waitForStagingSlotLocked(slot, __func__);
 
     const VkMappedMemoryRange toInvalidate = {
         .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
         .pNext = nullptr,
-        .memory = stagingBufferInfo.memory.memory,
-        .offset = 0,
-        .size = size,
+        .memory = mStaging.memory.memory,
+        .offset = slot->offset,
+        .size = slot->size,
     };
 
     VK_CHECK(vk->vkInvalidateMappedMemoryRanges(mDevice, 1, &toInvalidate));
 
     const void* srcPtr = reinterpret_cast<const void*>(
-        reinterpret_cast<const char*>(stagingBufferInfo.memory.mappedPtr));
+        reinterpret_cast<const char*>(mStaging.memory.mappedPtr) + slot->offset);
     void* dstPtr = outBytes;
     void* dstPtrOffset = reinterpret_cast<void*>(reinterpret_cast<char*>(dstPtr) + offset);
     std::memcpy(dstPtrOffset, srcPtr, size);
@@ -3857,8 +3898,8 @@ bool VkEmulation::updateBufferFromBytes(uint32_t bufferHandle, uint64_t offset,
         return false;
     }
 
-    const auto& stagingBufferInfo = mStaging;
-    if (size > stagingBufferInfo.size) {
+    StagingSlot* slot = acquireStagingSlotLocked(size);
+    if (!slot) {
         ERR("Failed to update Buffer:%d, staging buffer too small.", bufferHandle);
         return false;
     }
@@ -3866,15 +3907,15 @@ bool VkEmulation::updateBufferFromBytes(uint32_t bufferHandle, uint64_t offset,
     const void* srcPtr = bytes;
     const void* srcPtrOffset =
         reinterpret_cast<const void*>(reinterpret_cast<const char*>(srcPtr) + offset);
-    void* dstPtr = stagingBufferInfo.memory.mappedPtr;
+    void* dstPtr = reinterpret_cast<char*>(mStaging.memory.mappedPtr) + slot->offset;
     std::memcpy(dstPtr, srcPtrOffset, size);
 
     const VkMappedMemoryRange toFlush = {
         .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
         .pNext = nullptr,
-        .memory = stagingBufferInfo.memory.memory,
-        .offset = 0,
-        .size = size,
+        .memory = mStaging.memory.memory,
+        .offset = slot->offset,
+        .size = slot->size,
     };
     VK_CHECK(vk->vkFlushMappedMemoryRanges(mDevice, 1, &toFlush));
 
@@ -3883,44 +3924,25 @@ bool VkEmulation::updateBufferFromBytes(uint32_t bufferHandle, uint64_t offset,
         .pNext = nullptr,
         .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
     };
-    VK_CHECK(vk->vkBeginCommandBuffer(mCommandBuffer, &beginInfo));
+    VK_CHECK(vk->vkBeginCommandBuffer(slot->commandBuffer, &beginInfo));
 
-    mDebugUtilsHelper.cmdBeginDebugLabel(mCommandBuffer, "updateBufferFromBytes(Buffer:%d)",
+    mDebugUtilsHelper.cmdBeginDebugLabel(slot->commandBuffer, "updateBufferFromBytes(Buffer:%d)",
                                          bufferHandle);
 
     const VkBufferCopy bufferCopy = {
-        .srcOffset = 0,
+        .srcOffset = slot->offset,
         .dstOffset = offset,
         .size = size,
     };
-    vk->vkCmdCopyBuffer(mCommandBuffer, stagingBufferInfo.buffer, bufferInfo->buffer, 1,
+    vk->vkCmdCopyBuffer(slot->commandBuffer, mStaging.buffer, bufferInfo->buffer, 1,
                         &bufferCopy);
 
-    mDebugUtilsHelper.cmdEndDebugLabel(mCommandBuffer);
-
-    VK_CHECK(vk->vkEndCommandBuffer(mCommandBuffer));
-
-    const VkSubmitInfo submitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext = nullptr,
-        .waitSemaphoreCount = 0,
-        .pWaitSemaphores = nullptr,
-        .pWaitDstStageMask = nullptr,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &mCommandBuffer,
-        .signalSemaphoreCount = 0,
-        .pSignalSemaphores = nullptr,
-    };
-
-    {
-        android::base::AutoLock queueLock(*mQueueLock);
-        VK_CHECK(vk->vkQueueSubmit(mQueue, 1, &submitInfo, mCommandBufferFence));
-    }
+    mDebugUtilsHelper.cmdEndDebugLabel(slot->commandBuffer);
 
-    static constexpr uint64_t ANB_MAX_WAIT_NS = 5ULL * 1000ULL * 1000ULL * 1000ULL;
-    VK_CHECK(vk->vkWaitForFences(mDevice, 1, &mCommandBufferFence, VK_TRUE, ANB_MAX_WAIT_NS));
+    VK_CHECK(vk->vkEndCommandBuffer(slot->commandBuffer));
 
-    VK_CHECK(vk->vkResetFences(mDevice, 1, &mCommandBufferFence));
+    submitStagingSlotLocked(slot);
+    waitForStagingSlotLocked(slot, __func__);
 
     return true;
 }
@@ -4030,6 +4052,190 @@ VkImageLayout VkEmulation::getColorBufferCurrentLayout(uint32_t colorBufferHandl
     return infoPtr->currentLayout;
 }
 
+std::optional<CancelableFuture> VkEmulation::setColorBufferPendingFlush(
+    uint32_t colorBufferHandle, CancelableFuture pendingFlush) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto infoPtr = android::base::find(mColorBuffers, colorBufferHandle);
+    if (!infoPtr) {
+        VERBOSE("Invalid ColorBuffer handle %d.", static_cast<int>(colorBufferHandle));
+        return std::nullopt;
+    }
+    std::optional<CancelableFuture> previousFlush = std::move(infoPtr->pendingFlush);
+    infoPtr->pendingFlush = std::move(pendingFlush);
+    if (previousFlush &&
+        previousFlush->wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        return std::nullopt;
+    }
+    return previousFlush;
+}
+
+void VkEmulation::waitForColorBufferPendingFlush(uint32_t colorBufferHandle) {
+    std::optional<CancelableFuture> pendingFlush;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto infoPtr = android::base::find(mColorBuffers, colorBufferHandle);
+        if (!infoPtr) {
+            return;
+        }
+        waitForColorBufferUploadLocked(infoPtr);
+        if (!infoPtr->pendingFlush) {
+            return;
+        }
+        pendingFlush = infoPtr->pendingFlush;
+    }
+
+    pendingFlush->wait();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto infoPtr = android::base::find(mColorBuffers, colorBufferHandle);
+    if (infoPtr && infoPtr->pendingFlush &&
+        infoPtr->pendingFlush->wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        infoPtr->pendingFlush.reset();
+    }
+}
+
+void VkEmulation::waitForColorBufferUploads(
+    const std::unordered_set<uint32_t>& colorBufferHandles) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (uint32_t colorBufferHandle : colorBufferHandles) {
+        auto colorBufferInfo = android::base::find(mColorBuffers, colorBufferHandle);
+        if (colorBufferInfo) {
+            waitForColorBufferUploadLocked(colorBufferInfo);
+        }
+    }
+}
+
+VkEmulation::StagingSlot* VkEmulation::acquireStagingSlotLocked(VkDeviceSize size) {
+    if (size > mStaging.size) {
+        return nullptr;
+    }
+
+    const VkDeviceSize slotSize = mStaging.size / kNumStagingSlots;
+    StagingSlot* slot = nullptr;
+    VkDeviceSize offset = 0;
+    VkDeviceSize rangeSize = 0;
+    while (true) {
+        slot = &mStagingSlots[mNextStagingSlot];
+        offset = slot->index * slotSize;
+        rangeSize = slotSize;
+        if (size > slotSize) {
+            offset = 0;
+            rangeSize = mStaging.size;
+        }
+
+        // A readback waiting without `mMutex` still reads its range of the staging buffer.
+        // Waiting for it releases `mMutex`, so everything is checked again afterwards.
+        const bool overlapsReadback =
+            std::any_of(mStagingSlots.begin(), mStagingSlots.end(), [&](const StagingSlot& other) {
+                return other.readbackInProgress &&
+                       (&other == slot || (other.offset < offset + rangeSize &&
+                                           offset < other.offset + other.size));
+            });
+        if (!overlapsReadback) {
+            break;
+        }
+        mStagingSlotCv.wait(mMutex);
+    }
+    mNextStagingSlot = (mNextStagingSlot + 1) % kNumStagingSlots;
+
+    // The command buffer and fence are reused, so the slot's previous submission must be done.
+    waitForStagingSlotLocked(slot, __func__);
+
+    // Also wait for any other submission still using this range of the staging buffer. This
+    // only happens around transfers that needed the whole staging buffer.
+    for (StagingSlot& other : mStagingSlots) {
+        if (other.pendingSerial != 0 && other.offset < offset + rangeSize &&
+            offset < other.offset + other.size) {
+            waitForStagingSlotLocked(&other, __func__);
+        }
+    }
+
+    slot->offset = offset;
+    slot->size = rangeSize;
+    return slot;
+}
+
+VkEmulation::StagingSlotSubmission VkEmulation::submitStagingSlotLocked(StagingSlot* slot) {
+    auto vk = mDvk;
+
+    const VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .waitSemaphoreCount = 0,
+        .pWaitSemaphores = nullptr,
+        .pWaitDstStageMask = nullptr,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &slot->commandBuffer,
+        .signalSemaphoreCount = 0,
+        .pSignalSemaphores = nullptr,
+    };
+
+    {
+        android::base::AutoLock queueLock(*mQueueLock);
+        VK_CHECK(vk->vkQueueSubmit(mQueue, 1, &submitInfo, slot->fence));
+    }
+
+    slot->pendingSerial = mNextStagingSerial++;
+    return StagingSlotSubmission{
+        .slot = slot->index,
+        .serial = slot->pendingSerial,
+    };
+}
+
+void VkEmulation::waitForStagingSlotLocked(StagingSlot* slot, const char* caller) {
+    // The readback resets the slot itself once it is done.
+    mStagingSlotCv.wait(mMutex, [slot]() { return !slot->readbackInProgress; });
+
+    if (slot->pendingSerial == 0) {
+        return;
+    }
+
+    VK_CHECK(waitForStagingFence(*slot, caller));
+
+    resetStagingSlotLocked(slot);
+}
+
+VkResult VkEmulation::waitForStagingFence(const StagingSlot& slot, const char* caller) {
+    auto vk = mDvk;
+
+    static constexpr uint64_t ANB_MAX_WAIT_NS = 5ULL * 1000ULL * 1000ULL * 1000ULL;
+    VkResult waitRes = vk->vkWaitForFences(mDevice, 1, &slot.fence, VK_TRUE, ANB_MAX_WAIT_NS);
+    if (waitRes == VK_TIMEOUT) {
+        // Give a warning and try once more on a timeout error
+        ERR("%s: vkWaitForFences failed with timeout error (staging slot:%u, offset:%" PRIu64
+            ", size:%" PRIu64 "), retrying...",
+            caller, slot.index, slot.offset, slot.size);
+        waitRes = vk->vkWaitForFences(mDevice, 1, &slot.fence, VK_TRUE, ANB_MAX_WAIT_NS * 2);
+    }
+    return waitRes;
+}
+
+void VkEmulation::resetStagingSlotLocked(StagingSlot* slot) {
+    VK_CHECK(mDvk->vkResetFences(mDevice, 1, &slot->fence));
+
+    slot->pendingSerial = 0;
+}
+
+void VkEmulation::waitForStagingSubmissionLocked(const StagingSlotSubmission& submission,
+                                                 const char* caller) {
+    StagingSlot& slot = mStagingSlots[submission.slot];
+    // If the slot has moved on to a later submission, it was waited for in between.
+    if (slot.pendingSerial == submission.serial) {
+        waitForStagingSlotLocked(&slot, caller);
+    }
+}
+
+void VkEmulation::waitForColorBufferUploadLocked(ColorBufferInfo* colorBufferInfo) {
+    if (!colorBufferInfo->pendingUpload) {
+        return;
+    }
+    waitForStagingSubmissionLocked(*colorBufferInfo->pendingUpload, __func__);
+    colorBufferInfo->pendingUpload.reset();
+}
+
 // Allocate a ready to use VkCommandBuffer for queue transfer. The caller needs
 // to signal the returned VkFence when the VkCommandBuffer completes.
 std::tuple<VkCommandBuffer, VkFence> VkEmulation::allocateQueueTransferCommandBufferLocked() {
@@ -17,8 +17,11 @@
 #include <vulkan/vulkan.h>
 
 #include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -30,8 +33,10 @@
 #include "DisplayVk.h"
 #include "ExternalObjectManager.h"
 #include "FrameworkFormats.h"
+#include "ReadbackWorkerVk.h"
 #include "aemu/base/Optional.h"
 #include "aemu/base/ThreadAnnotations.h"
+#include "gfxstream/CancelableFuture.h"
 #include "gfxstream/host/BackendCallbacks.h"
 #include "gfxstream/host/Features.h"
 #include "goldfish_vk_private_defs.h"
@@ -154,6 +159,8 @@ class VkEmulation {
 
     DisplayVk* getDisplay();
 
+    ReadbackWorkerVk* getReadbackWorker();
+
     VkInstance getInstance();
 
     std::string getGpuVendor() const;
@@ -288,6 +295,12 @@ class VkEmulation {
         VulkanOnly = 1,
     };
 
+    // Identifies a submission that used one of the staging slots.
+    struct StagingSlotSubmission {
+        uint32_t slot = 0;
+        uint64_t serial = 0;
+    };
+
     struct ColorBufferInfo {
         ExternalMemoryInfo memory;
 
@@ -314,6 +327,15 @@ class VkEmulation {
         bool externalMemoryCompatible = false;
 
         VulkanMode vulkanMode = VulkanMode::Default;
+
+        // Set while the Vulkan contents of this ColorBuffer are being asynchronously
+        // flushed to its other backings after a guest queue submission released it.
+        std::optional<CancelableFuture> pendingFlush;
+
+        // Set while an upload from updateColorBufferFromBytes() may still be executing on
+        // `mQueue`. Users of the image outside of `mQueue` must wait for it first, see
+        // waitForColorBufferUploadLocked().
+        std::optional<StagingSlotSubmission> pendingUpload;
     };
     std::optional<VkEmulation::ColorBufferInfo> getColorBufferInfo(uint32_t colorBufferHandle);
 
@@ -359,6 +381,17 @@ class VkEmulation {
     bool updateColorBufferFromBytes(uint32_t colorBufferHandle, uint32_t x, uint32_t y, uint32_t w,
                                     uint32_t h, const void* pixels);
 
+    // Like readColorBufferToBytes()/updateColorBufferFromBytes(), but hands the mapped staging
+    // memory for the transfer to the callback so that callers can scatter/gather the pixels
+    // without an intermediate copy. The callback returns false to fail the transfer.
+    using ColorBufferReadCallback = std::function<bool(const void* pixels, uint64_t size)>;
+    using ColorBufferWriteCallback = std::function<bool(void* pixels, uint64_t size)>;
+    bool readColorBufferToCallback(uint32_t colorBufferHandle, uint32_t x, uint32_t y, uint32_t w,
+                                   uint32_t h, const ColorBufferReadCallback& consumePixels);
+    bool updateColorBufferFromCallback(uint32_t colorBufferHandle, uint32_t x, uint32_t y,
+                                       uint32_t w, uint32_t h,
+                                       const ColorBufferWriteCallback& fillPixels);
+
     // Data buffer operations
     bool getBufferAllocationInfo(uint32_t bufferHandle, VkDeviceSize* outSize,
                                  uint32_t* outMemoryTypeIndex, bool* outMemoryIsDedicatedAlloc);
@@ -395,6 +428,21 @@ class VkEmulation {
 
     VkImageLayout getColorBufferCurrentLayout(uint32_t colorBufferHandle);
 
+    // Marks that the Vulkan contents of the ColorBuffer are being flushed to its other
+    // backings and will be complete once `pendingFlush` is ready. Returns the flush it replaces
+    // if that one is still pending, the new flush must not complete before it.
+    std::optional<CancelableFuture> setColorBufferPendingFlush(uint32_t colorBufferHandle,
+                                                               CancelableFuture pendingFlush);
+
+    // Blocks until any pending flush of the ColorBuffer has completed. Must not be called
+    // while holding locks needed to perform the flush (e.g. the FrameBuffer lock).
+    void waitForColorBufferPendingFlush(uint32_t colorBufferHandle);
+
+    // Blocks until the uploads from updateColorBufferFromBytes() to the given ColorBuffers have
+    // completed. Guest queue submissions may use the imported ColorBuffer memory and are not
+    // ordered against `mQueue`, so they must call this first with the ColorBuffers they acquire.
+    void waitForColorBufferUploads(const std::unordered_set<uint32_t>& colorBufferHandles);
+
     void releaseColorBufferForGuestUse(uint32_t colorBufferHandle);
 
     std::unique_ptr<BorrowedImageInfoVk> borrowColorBufferForComposition(uint32_t colorBufferHandle,
@@ -501,19 +549,42 @@ class VkEmulation {
 
     bool colorBufferNeedsUpdateBetweenGlAndVk(const VkEmulation::ColorBufferInfo& colorBufferInfo);
 
-    bool readColorBufferToBytesLocked(uint32_t colorBufferHandle, uint32_t x, uint32_t y,
+    // Copies the pixels out to `outPixels`, or hands them to `consumePixels` if `outPixels`
+    // is null. `lock` holds `mMutex` and is released while waiting for the copy on the GPU.
+    bool readColorBufferToBytesLocked(std::unique_lock<std::mutex>& lock,
+                                      uint32_t colorBufferHandle, uint32_t x, uint32_t y,
                                       uint32_t w, uint32_t h, void* outPixels,
-                                      uint64_t outPixelsSize) REQUIRES(mMutex);
+                                      uint64_t outPixelsSize,
+                                      const ColorBufferReadCallback& consumePixels = nullptr)
+        REQUIRES(mMutex);
 
+    // Uploads from `pixels`, or lets `fillPixels` write the input if `pixels` is null.
     bool updateColorBufferFromBytesLocked(uint32_t colorBufferHandle, uint32_t x, uint32_t y,
                                           uint32_t w, uint32_t h, const void* pixels,
-                                          size_t inputPixelsSize) REQUIRES(mMutex);
+                                          size_t inputPixelsSize,
+                                          const ColorBufferWriteCallback& fillPixels = nullptr)
+        REQUIRES(mMutex);
 
     bool updateMemReqsForExtMem(std::optional<ExternalHandleInfo> extMemHandleInfo,
                                 VkMemoryRequirements* pMemReqs);
 
     std::tuple<VkCommandBuffer, VkFence> allocateQueueTransferCommandBufferLocked() REQUIRES(mMutex);
 
+    struct StagingSlot;
+
+    // Returns a staging slot with at least `size` bytes of staging memory that is no longer
+    // in use by the GPU, waiting for earlier submissions if needed. Returns nullptr if `size`
+    // does not fit in the staging buffer.
+    StagingSlot* acquireStagingSlotLocked(VkDeviceSize size) REQUIRES(mMutex);
+    StagingSlotSubmission submitStagingSlotLocked(StagingSlot* slot) REQUIRES(mMutex);
+    void waitForStagingSlotLocked(StagingSlot* slot, const char* caller) REQUIRES(mMutex);
+    // Waits for the fence of the slot's submission, without resetting it.
+    VkResult waitForStagingFence(const StagingSlot& slot, const char* caller);
+    void resetStagingSlotLocked(StagingSlot* slot) REQUIRES(mMutex);
+    void waitForStagingSubmissionLocked(const StagingSlotSubmission& submission,
+                                        const char* caller) REQUIRES(mMutex);
+    void waitForColorBufferUploadLocked(ColorBufferInfo* colorBufferInfo) REQUIRES(mMutex);
+
     void freeExternalMemoryLocked(VulkanDispatch* vk, ExternalMemoryInfo* info) REQUIRES(mMutex);
 
     std::mutex mMutex;
@@ -594,8 +665,6 @@ class VkEmulation {
     uint32_t mQueueFamilyIndex = 0;
 
     VkCommandPool mCommandPool = VK_NULL_HANDLE;
-    VkCommandBuffer mCommandBuffer = VK_NULL_HANDLE;
-    VkFence mCommandBufferFence = VK_NULL_HANDLE;
 
     std::vector<ImageSupportInfo> mImageSupportInfo;
 
@@ -620,6 +689,31 @@ class VkEmulation {
     // bind to imported versions of the memory.
     StagingBufferInfo mStaging GUARDED_BY(mMutex);
 
+    // The staging buffer is split into slots so that transfers do not have to wait for the
+    // previous one to complete. Uploads are submitted without waiting and readbacks only wait
+    // for their own slot. A transfer that does not fit in a single slot uses the whole
+    // staging buffer, after waiting for all of the slots.
+    static constexpr uint32_t kNumStagingSlots = 4;
+
+    struct StagingSlot {
+        uint32_t index = 0;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        // The range of the staging buffer used by the current submission.
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        // Non-zero while `fence` is pending for the submission with this serial.
+        uint64_t pendingSerial = 0;
+        // Set while a readback waits for `fence` without holding `mMutex`. Nothing else may
+        // wait for, reuse or overlap the slot until it is cleared.
+        bool readbackInProgress = false;
+    };
+    std::vector<StagingSlot> mStagingSlots GUARDED_BY(mMutex);
+    // Notified when a readback is done with its staging slot.
+    std::condition_variable_any mStagingSlotCv;
+    uint32_t mNextStagingSlot GUARDED_BY(mMutex) = 0;
+    uint64_t mNextStagingSerial GUARDED_BY(mMutex) = 1;
+
     // ColorBuffers are intended to back the guest's shareable images.
     // For example:
     // Android: gralloc
@@ -665,6 +759,9 @@ class VkEmulation {
     // The implementation for Vulkan native swapchain. Only initialized in initVkEmulationFeatures
     // if useVulkanNativeSwapchain is set.
     std::unique_ptr<DisplayVk> mDisplayVk;
+
+    // Reads back posted ColorBuffers when there is no GL emulation to do it.
+    std::unique_ptr<ReadbackWorkerVk> mReadbackWorkerVk;
 };
 
 }  // namespace vk
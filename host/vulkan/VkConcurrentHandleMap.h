@@ -0,0 +1,252 @@
+// Copyright (C) 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace gfxstream {
+namespace vk {
+
+// A map from 64 bit handles to non-zero 64 bit values, optimized for concurrent lookups.
+//
+// Lookups never take a lock: each shard is an open addressing table whose slots are
+// atomics. Updates take the lock of the shard the key hashes to, so render threads
+// creating and destroying unrelated objects rarely contend.
+//
+// Within a table, a slot's key is written at most once. Removing a key only clears the
+// slot's value, and reinserting the same key reuses its slot, so a reader that matched a
+// key can never observe a value that belongs to another key. Cleared slots are dropped
+// when the shard is rehashed. Tables grow (and get rehashed) as needed; a replaced table
+// is kept alive until no lookup can still be using it.
+class ConcurrentHandleMap {
+   public:
+    ConcurrentHandleMap() {
+        for (Shard& shard : mShards) {
+            shard.table.store(new Table(kMinCapacity), std::memory_order_seq_cst);
+        }
+    }
+
+    ~ConcurrentHandleMap() {
+        for (Shard& shard : mShards) {
+            delete shard.table.load(std::memory_order_seq_cst);
+        }
+    }
+
+    ConcurrentHandleMap(const ConcurrentHandleMap&) = delete;
+    ConcurrentHandleMap& operator=(const ConcurrentHandleMap&) = delete;
+
+    // Returns the value for `key`, or 0 if there is none.
+    uint64_t get(uint64_t key) const {
+        if (key == kEmptyKey) {
+            return mEmptyKeyValue.load(std::memory_order_acquire);
+        }
+
+        const uint64_t hash = hashKey(key);
+        const Shard& shard = shardFor(hash);
+
+        shard.activeReaders.fetch_add(1, std::memory_order_seq_cst);
+        const Table* table = shard.table.load(std::memory_order_seq_cst);
+        uint64_t value = 0;
+        for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+            const uint64_t slotKey = table->slots[i].key.load(std::memory_order_acquire);
+            if (slotKey == key) {
+                value = table->slots[i].value.load(std::memory_order_acquire);
+                break;
+            }
+            if (slotKey == kEmptyKey) {
+                break;
+            }
+        }
+        shard.activeReaders.fetch_sub(1, std::memory_order_seq_cst);
+        return value;
+    }
+
+    // Sets the value for `key`. `value` must not be 0.
+    void set(uint64_t key, uint64_t value) {
+        if (key == kEmptyKey) {
+            mEmptyKeyValue.store(value, std::memory_order_release);
+            return;
+        }
+
+        const uint64_t hash = hashKey(key);
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        Table* table = shard.table.load(std::memory_order_relaxed);
+        if ((table->usedSlots + 1) * kMaxLoadDenominator > table->capacity() * kMaxLoadNumerator) {
+            table = rehashLocked(shard);
+        }
+
+        Slot& slot = findSlotLocked(*table, key, hash);
+        if (slot.key.load(std::memory_order_relaxed) == kEmptyKey) {
+            slot.value.store(value, std::memory_order_relaxed);
+            slot.key.store(key, std::memory_order_release);
+            table->usedSlots++;
+            table->liveSlots++;
+            return;
+        }
+        if (slot.value.load(std::memory_order_relaxed) == 0) {
+            table->liveSlots++;
+        }
+        slot.value.store(value, std::memory_order_release);
+    }
+
+    void remove(uint64_t key) {
+        if (key == kEmptyKey) {
+            mEmptyKeyValue.store(0, std::memory_order_release);
+            return;
+        }
+
+        const uint64_t hash = hashKey(key);
+        Shard& shard = shardFor(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        Table* table = shard.table.load(std::memory_order_relaxed);
+        Slot& slot = findSlotLocked(*table, key, hash);
+        if (slot.key.load(std::memory_order_relaxed) == kEmptyKey ||
+            slot.value.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        slot.value.store(0, std::memory_order_release);
+        table->liveSlots--;
+    }
+
+    void clear() {
+        mEmptyKeyValue.store(0, std::memory_order_release);
+        for (Shard& shard : mShards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            Table* table = shard.table.load(std::memory_order_relaxed);
+            shard.retiredTables.emplace_back(table);
+            shard.table.store(new Table(kMinCapacity), std::memory_order_seq_cst);
+            reclaimRetiredTablesLocked(shard);
+        }
+    }
+
+    size_t size() const {
+        size_t count = mEmptyKeyValue.load(std::memory_order_relaxed) ? 1 : 0;
+        for (const Shard& shard : mShards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            count += shard.table.load(std::memory_order_relaxed)->liveSlots;
+        }
+        return count;
+    }
+
+   private:
+    static constexpr uint64_t kEmptyKey = 0;
+    static constexpr size_t kShardBits = 6;
+    static constexpr size_t kNumShards = 1 << kShardBits;
+    static constexpr size_t kMinCapacity = 64;
+    // Tables are rehashed when more than 3/4 of their slots have ever been used.
+    static constexpr size_t kMaxLoadNumerator = 3;
+    static constexpr size_t kMaxLoadDenominator = 4;
+
+    struct Slot {
+        std::atomic<uint64_t> key{kEmptyKey};
+        std::atomic<uint64_t> value{0};
+    };
+
+    struct Table {
+        explicit Table(size_t capacity) : mask(capacity - 1), slots(new Slot[capacity]) {}
+
+        size_t capacity() const { return mask + 1; }
+
+        const size_t mask;
+        std::unique_ptr<Slot[]> slots;
+        // Only accessed with the shard lock held.
+        size_t usedSlots = 0;
+        size_t liveSlots = 0;
+    };
+
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::atomic<Table*> table{nullptr};
+        mutable std::atomic<uint32_t> activeReaders{0};
+        // Tables replaced by a rehash that lookups may still be using. Guarded by `mutex`.
+        std::vector<std::unique_ptr<Table>> retiredTables;
+    };
+
+    static uint64_t hashKey(uint64_t key) {
+        // Handles are usually pointers or small ids, so mix the bits before using them.
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    // The top bits select the shard and the bottom bits the slot, so the two are independent.
+    Shard& shardFor(uint64_t hash) { return mShards[hash >> (64 - kShardBits)]; }
+    const Shard& shardFor(uint64_t hash) const { return mShards[hash >> (64 - kShardBits)]; }
+
+    // Returns the slot holding `key`, or the empty slot where it should be inserted.
+    static Slot& findSlotLocked(Table& table, uint64_t key, uint64_t hash) {
+        for (size_t i = hash & table.mask;; i = (i + 1) & table.mask) {
+            const uint64_t slotKey = table.slots[i].key.load(std::memory_order_relaxed);
+            if (slotKey == key || slotKey == kEmptyKey) {
+                return table.slots[i];
+            }
+        }
+    }
+
+    Table* rehashLocked(Shard& shard) {
+        Table* oldTable = shard.table.load(std::memory_order_relaxed);
+
+        size_t capacity = kMinCapacity;
+        while ((oldTable->liveSlots + 1) * 2 > capacity) {
+            capacity *= 2;
+        }
+
+        auto* newTable = new Table(capacity);
+        for (size_t i = 0; i < oldTable->capacity(); i++) {
+            const Slot& oldSlot = oldTable->slots[i];
+            const uint64_t key = oldSlot.key.load(std::memory_order_relaxed);
+            const uint64_t value = oldSlot.value.load(std::memory_order_relaxed);
+            if (key == kEmptyKey || value == 0) {
+                continue;
+            }
+            Slot& newSlot = findSlotLocked(*newTable, key, hashKey(key));
+            newSlot.key.store(key, std::memory_order_relaxed);
+            newSlot.value.store(value, std::memory_order_relaxed);
+            newTable->usedSlots++;
+            newTable->liveSlots++;
+        }
+
+        shard.retiredTables.emplace_back(oldTable);
+        shard.table.store(newTable, std::memory_order_seq_cst);
+        reclaimRetiredTablesLocked(shard);
+        return newTable;
+    }
+
+    // A lookup announces itself in `activeReaders` before loading the table pointer, so once
+    // no lookup is active after the new table was published, nothing can still be reading
+    // the retired ones. If lookups are active, the tables are freed by a later rehash.
+    static void reclaimRetiredTablesLocked(Shard& shard) {
+        if (shard.activeReaders.load(std::memory_order_seq_cst) == 0) {
+            shard.retiredTables.clear();
+        }
+    }
+
+    std::array<Shard, kNumShards> mShards;
+    std::atomic<uint64_t> mEmptyKeyValue{0};
+};
+
+}  // namespace vk
+}  // namespace gfxstream
@@ -0,0 +1,157 @@
+// Copyright (C) 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "VkConcurrentHandleMap.h"
+
+namespace gfxstream {
+namespace vk {
+namespace {
+
+TEST(ConcurrentHandleMapTest, SetGetRemove) {
+    ConcurrentHandleMap map;
+    EXPECT_EQ(map.get(0x1000), 0u);
+
+    map.set(0x1000, 1);
+    map.set(0x2000, 2);
+    EXPECT_EQ(map.get(0x1000), 1u);
+    EXPECT_EQ(map.get(0x2000), 2u);
+    EXPECT_EQ(map.size(), 2u);
+
+    map.set(0x1000, 3);
+    EXPECT_EQ(map.get(0x1000), 3u);
+    EXPECT_EQ(map.size(), 2u);
+
+    map.remove(0x1000);
+    EXPECT_EQ(map.get(0x1000), 0u);
+    EXPECT_EQ(map.get(0x2000), 2u);
+    EXPECT_EQ(map.size(), 1u);
+
+    map.set(0x1000, 4);
+    EXPECT_EQ(map.get(0x1000), 4u);
+    EXPECT_EQ(map.size(), 2u);
+}
+
+TEST(ConcurrentHandleMapTest, ZeroKey) {
+    ConcurrentHandleMap map;
+    map.set(0, 5);
+    EXPECT_EQ(map.get(0), 5u);
+    map.remove(0);
+    EXPECT_EQ(map.get(0), 0u);
+}
+
+TEST(ConcurrentHandleMapTest, GrowsBeyondInitialCapacity) {
+    constexpr uint64_t kCount = 100000;
+    ConcurrentHandleMap map;
+    for (uint64_t i = 1; i <= kCount; i++) {
+        map.set(i * 16, i);
+    }
+    EXPECT_EQ(map.size(), kCount);
+    for (uint64_t i = 1; i <= kCount; i++) {
+        ASSERT_EQ(map.get(i * 16), i);
+    }
+}
+
+TEST(ConcurrentHandleMapTest, ChurnDoesNotLoseEntries) {
+    ConcurrentHandleMap map;
+    map.set(0xdead0000, 1);
+    for (uint64_t i = 1; i <= 100000; i++) {
+        map.set(i, i);
+        map.remove(i);
+    }
+    EXPECT_EQ(map.size(), 1u);
+    EXPECT_EQ(map.get(0xdead0000), 1u);
+}
+
+TEST(ConcurrentHandleMapTest, Clear) {
+    ConcurrentHandleMap map;
+    for (uint64_t i = 1; i <= 1000; i++) {
+        map.set(i, i);
+    }
+    map.clear();
+    EXPECT_EQ(map.size(), 0u);
+    EXPECT_EQ(map.get(1), 0u);
+}
+
+TEST(ConcurrentHandleMapTest, ConcurrentReadersAndWriters) {
+    constexpr int kWriters = 4;
+    constexpr int kReaders = 4;
+    constexpr uint64_t kKeysPerWriter = 20000;
+
+    ConcurrentHandleMap map;
+    // Keys that stay in the map for the whole test.
+    for (uint64_t i = 1; i <= 1000; i++) {
+        map.set(i << 40, i);
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<bool> mismatch{false};
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < kWriters; w++) {
+        threads.emplace_back([&map, w]() {
+            const uint64_t base = (uint64_t)(w + 1) << 32;
+            for (uint64_t i = 1; i <= kKeysPerWriter; i++) {
+                map.set(base + i, base + i);
+            }
+            for (uint64_t i = 1; i <= kKeysPerWriter; i += 2) {
+                map.remove(base + i);
+            }
+        });
+    }
+    for (int r = 0; r < kReaders; r++) {
+        threads.emplace_back([&map, &done, &mismatch]() {
+            while (!done.load()) {
+                for (uint64_t i = 1; i <= 1000; i++) {
+                    if (map.get(i << 40) != i) {
+                        mismatch.store(true);
+                    }
+                }
+                // Entries being written concurrently are either absent or correct.
+                for (uint64_t key = (1ull << 32) + 1; key < (1ull << 32) + 100; key++) {
+                    const uint64_t value = map.get(key);
+                    if (value != 0 && value != key) {
+                        mismatch.store(true);
+                    }
+                }
+            }
+        });
+    }
+
+    for (int w = 0; w < kWriters; w++) {
+        threads[w].join();
+    }
+    done.store(true);
+    for (size_t i = kWriters; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    EXPECT_FALSE(mismatch.load());
+    EXPECT_EQ(map.size(), 1000 + kWriters * kKeysPerWriter / 2);
+    for (int w = 0; w < kWriters; w++) {
+        const uint64_t base = (uint64_t)(w + 1) << 32;
+        for (uint64_t i = 1; i <= kKeysPerWriter; i++) {
+            ASSERT_EQ(map.get(base + i), (i % 2) ? 0u : base + i);
+        }
+    }
+}
+
+}  // namespace
+}  // namespace vk
+}  // namespace gfxstream
@@ -37,6 +37,7 @@
 #include <optional>
 #include <unordered_map>
 
+#include "DecoderHangInfo.h"
 #include "FrameBuffer.h"
 #include "VkDecoderGlobalState.h"
 #include "VkDecoderSnapshot.h"
@@ -126,6 +127,8 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream,
     auto* healthMonitor = context.healthMonitor;
     auto& metricsLogger = *context.metricsLogger;
     if (len < 8) return 0;
+    DecoderHangInfo& hangInfo = DecoderHangInfo::forCurrentThread();
+    hangInfo.setProcessName(processName);
     unsigned char* ptr = (unsigned char*)buf;
     const unsigned char* const end = (const unsigned char*)buf + len;
     while (end - ptr >= 8) {
@@ -150,18 +153,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream,
         uint8_t** readStreamPtrPtr = &readStreamPtr;
         vkReadStream->setHandleMapping(&m_boxedHandleUnwrapMapping);
 
-        std::unique_ptr<EventHangMetadata::HangAnnotations> executionData =
-            std::make_unique<EventHangMetadata::HangAnnotations>();
-        if (healthMonitor) {
-            executionData->insert(
-                {{"packet_length", std::to_string(packetLen)}, {"opcode", std::to_string(opcode)}});
-            if (processName) {
-                executionData->insert({{"renderthread_guest_process", std::string(processName)}});
-            }
-            if (m_prevSeqno) {
-                executionData->insert({{"previous_seqno", std::to_string(m_prevSeqno.value())}});
-            }
-        }
+        hangInfo.setPacket(opcode, packetLen, m_prevSeqno);
 
         std::atomic<uint32_t>* seqnoPtr =
             processResources ? processResources->getSequenceNumberPtr() : nullptr;
@@ -172,7 +164,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream,
             uint32_t seqno;
             memcpy(&seqno, *readStreamPtrPtr, sizeof(uint32_t));
             *readStreamPtrPtr += sizeof(uint32_t);
-            if (healthMonitor) executionData->insert({{"seqno", std::to_string(seqno)}});
+            hangInfo.setSeqno(seqno);
             if (m_prevSeqno && seqno == m_prevSeqno.value()) {
                 WARN(
                     "Seqno %d is the same as previously processed on thread %d. It might be a "
@@ -181,31 +173,8 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream,
                 metricsLogger.logMetricEvent(MetricEventDuplicateSequenceNum{.opcode = opcode});
             }
             if (seqnoPtr && !m_forSnapshotLoad) {
-                {
-                    auto seqnoWatchdog =
-                        WATCHDOG_BUILDER(healthMonitor, "RenderThread seqno loop")
-                            .setHangType(EventHangMetadata::HangType::kRenderThread)
-                            .setAnnotations(std::make_unique<EventHangMetadata::HangAnnotations>(
-                                *executionData))
-                            /* Data gathered if this hangs*/
-                            .setOnHangCallback([=]() {
-                                auto annotations =
-                                    std::make_unique<EventHangMetadata::HangAnnotations>();
-                                annotations->insert(
-                                    {{"seqnoPtr",
-                                      std::to_string(seqnoPtr->load(std::memory_order_seq_cst))}});
-                                return annotations;
-                            })
-                            .build();
-                    while ((seqno - seqnoPtr->load(std::memory_order_seq_cst) != 1)) {
-#if (defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64)))
-                        _mm_pause();
-#elif (defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)))
-                        __asm__ __volatile__("pause;");
-#endif
-                    }
-                    m_prevSeqno = seqno;
-                }
+                processResources->waitForSequenceNumberTurn(seqno, healthMonitor);
+                m_prevSeqno = seqno;
             }
         }
 
@@ -217,10 +186,7 @@ size_t VkDecoder::Impl::decode(void* buf, size_t len, IOStream* ioStream,
         gfx_logger.recordCommandExecution();
 
         auto executionWatchdog =
-            WATCHDOG_BUILDER(healthMonitor, "RenderThread VkDecoder command execution")
-                .setHangType(EventHangMetadata::HangType::kRenderThread)
-                .setAnnotations(std::move(executionData))
-                .build();
+            hangInfo.buildPacketWatchdog(healthMonitor, "RenderThread VkDecoder command execution");
 
         switch (opcode) {
 #ifdef VK_VERSION_1_0
@@ -22,6 +22,9 @@
 #include "utils/GfxApiLogger.h"
 
 namespace gfxstream {
+
+class ProcessResources;
+
 namespace vk {
 
 struct VkDecoderContext {
@@ -29,6 +32,9 @@ struct VkDecoderContext {
     emugl::GfxApiLogger* gfxApiLogger = nullptr;
     emugl::HealthMonitor<>* healthMonitor = nullptr;
     emugl::MetricsLogger* metricsLogger = nullptr;
+    // Lets hooks that run after the decoder advanced the sequence number wake up the next
+    // render thread in line before doing their own work.
+    const ProcessResources* processResources = nullptr;
 };
 
 }  // namespace vk
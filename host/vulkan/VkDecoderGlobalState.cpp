@@ -15,14 +15,18 @@
 
 #include <algorithm>
 #include <functional>
+#include <future>
+#include <initializer_list>
 #include <list>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
 #include "FrameBuffer.h"
 #include "GraphicsDriverLock.h"
+#include "ProcessResources.h"
 #include "RenderThreadInfoVk.h"
 #include "TrivialStream.h"
 #include "VkAndroidNativeBuffer.h"
@@ -199,6 +203,8 @@ static constexpr uint32_t kMinVersion = VK_MAKE_VERSION(1, 0, 0);
 static constexpr uint64_t kPageSizeforBlob = 4096;
 static constexpr uint64_t kPageMaskForBlob = ~(0xfff);
 
+static constexpr uint64_t kColorBufferFlushTimeoutNs = 5000000000ULL;
+
 static std::atomic<uint64_t> sNextHostBlobId{1};
 
 class VkDecoderGlobalState::Impl {
@@ -223,7 +229,7 @@ class VkDecoderGlobalState::Impl {
         }
     }
 
-    ~Impl() = default;
+    ~Impl() { stopSnapshotContentPrefetch(); }
 
     // Resets all internal tracking info.
     // Assumes that the heavyweight cleanup operations have already happened.
@@ -238,7 +244,10 @@ class VkDecoderGlobalState::Impl {
         mCommandPoolInfo.clear();
         mDeviceToPhysicalDevice.clear();
         mPhysicalDeviceToInstance.clear();
-        mQueueInfo.clear();
+        {
+            std::lock_guard<std::mutex> queueInfoLock(mQueueInfoMutex);
+            mQueueInfo.clear();
+        }
         mBufferInfo.clear();
         mMemoryInfo.clear();
         mShaderModuleInfo.clear();
@@ -247,13 +256,18 @@ class VkDecoderGlobalState::Impl {
         mPipelineInfo.clear();
         mRenderPassInfo.clear();
         mFramebufferInfo.clear();
-        mSemaphoreInfo.clear();
-        mFenceInfo.clear();
+        {
+            std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
+            mSemaphoreInfo.clear();
+            mFenceInfo.clear();
 #ifdef _WIN32
-        mSemaphoreId = 1;
-        mExternalSemaphoresById.clear();
+            mSemaphoreId = 1;
+            mExternalSemaphoresById.clear();
 #endif
+        }
         mDescriptorUpdateTemplateInfo.clear();
+        mPendingSnapshotContents.clear();
+        mSnapshotContentsPending = false;
 
         sBoxedHandleManager.clear();
 
@@ -268,14 +282,37 @@ class VkDecoderGlobalState::Impl {
 
     const gfxstream::host::FeatureSet& getFeatures() const { return m_vkEmulation->getFeatures(); }
 
+    // Returns the queue used to save and load the contents of `device`'s images and buffers.
+    VkQueue getSnapshotQueue(VkDevice device, uint32_t* queueFamilyIndex) REQUIRES(mMutex) {
+        const auto& deviceInfo = android::base::find(mDeviceInfo, device);
+        const auto& physicalDeviceInfo =
+            android::base::find(mPhysdevInfo, deviceInfo->physicalDevice);
+        const auto& instanceInfo = android::base::find(mInstanceInfo, physicalDeviceInfo->instance);
+        VulkanDispatch* ivk = dispatch_VkInstance(instanceInfo->boxed);
+
+        uint32_t queueFamilyCount = 0;
+        ivk->vkGetPhysicalDeviceQueueFamilyProperties(deviceInfo->physicalDevice,
+                                                      &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilyProps(queueFamilyCount);
+        ivk->vkGetPhysicalDeviceQueueFamilyProperties(deviceInfo->physicalDevice,
+                                                      &queueFamilyCount, queueFamilyProps.data());
+        for (auto queue : deviceInfo->queues) {
+            int idx = queue.first;
+            if ((queueFamilyProps[idx].queueFlags & VK_QUEUE_GRAPHICS_BIT) == 0) {
+                continue;
+            }
+            *queueFamilyIndex = idx;
+            return queue.second[0];
+        }
+        *queueFamilyIndex = 0;
+        return VK_NULL_HANDLE;
+    }
+
     StateBlock createSnapshotStateBlock(VkDevice unboxed_device) REQUIRES(mMutex) {
         const auto& device = unboxed_device;
         const auto& deviceInfo = android::base::find(mDeviceInfo, device);
         const auto physicalDevice = deviceInfo->physicalDevice;
         const auto& physicalDeviceInfo = android::base::find(mPhysdevInfo, physicalDevice);
-        const auto& instanceInfo = android::base::find(mInstanceInfo, physicalDeviceInfo->instance);
-
-        VulkanDispatch* ivk = dispatch_VkInstance(instanceInfo->boxed);
         VulkanDispatch* dvk = dispatch_VkDevice(deviceInfo->boxed);
 
         StateBlock stateBlock{
@@ -287,21 +324,8 @@ class VkDecoderGlobalState::Impl {
             .commandPool = VK_NULL_HANDLE,
         };
 
-        uint32_t queueFamilyCount = 0;
-        ivk->vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
-        std::vector<VkQueueFamilyProperties> queueFamilyProps(queueFamilyCount);
-        ivk->vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
-                                                      queueFamilyProps.data());
         uint32_t queueFamilyIndex = 0;
-        for (auto queue : deviceInfo->queues) {
-            int idx = queue.first;
-            if ((queueFamilyProps[idx].queueFlags & VK_QUEUE_GRAPHICS_BIT) == 0) {
-                continue;
-            }
-            stateBlock.queue = queue.second[0];
-            queueFamilyIndex = idx;
-            break;
-        }
+        stateBlock.queue = getSnapshotQueue(device, &queueFamilyIndex);
 
         VkCommandPoolCreateInfo commandPoolCi = {
             VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
@@ -317,8 +341,108 @@ class VkDecoderGlobalState::Impl {
         stateBlock->deviceDispatch->vkDestroyCommandPool(stateBlock->device, stateBlock->commandPool, nullptr);
     }
 
+    // Contents which the host may read, or the guest may write through a mapping, before the
+    // next submission can't wait to be uploaded.
+    bool needsEagerSnapshotContentLoadLocked(VkDeviceMemory memory) REQUIRES(mMutex) {
+        const auto* memoryInfo = android::base::find(mMemoryInfo, memory);
+        return memoryInfo && (memoryInfo->ptr || memoryInfo->boundColorBuffer);
+    }
+
+    // Uploads the pending snapshot contents of `device` picked by `selection`, if any.
+    void loadPendingSnapshotContents(VkDevice device,
+                                     const SnapshotPendingContents::Selection& selection)
+        EXCLUDES(mMutex) {
+        if (!mSnapshotContentsPending) {
+            return;
+        }
+
+        // The snapshot queue is locked like a submission: before mMutex.
+        std::shared_ptr<std::mutex> queueMutex;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mPendingSnapshotContents.hasDevice(device)) {
+                return;
+            }
+            uint32_t queueFamilyIndex = 0;
+            VkQueue queue = getSnapshotQueue(device, &queueFamilyIndex);
+            std::lock_guard<std::mutex> queueInfoLock(mQueueInfoMutex);
+            auto* queueInfo = android::base::find(mQueueInfo, queue);
+            if (!queueInfo) {
+                ERR("Snapshot load cannot find queue info for %p, dropping pending contents.",
+                    queue);
+                mPendingSnapshotContents.forgetDevice(device);
+                mSnapshotContentsPending = !mPendingSnapshotContents.empty();
+                return;
+            }
+            queueMutex = queueInfo->queueMutex;
+        }
+
+        std::lock_guard<std::mutex> queueLock(*queueMutex);
+        std::lock_guard<std::mutex> lock(mMutex);
+        const SnapshotPendingContents::Batch batch =
+            mPendingSnapshotContents.take(device, selection);
+        if (batch.empty()) {
+            return;
+        }
+        StateBlock stateBlock = createSnapshotStateBlock(device);
+        SnapshotContentLoader contentLoader("deferred load");
+        contentLoader.load(&stateBlock, batch);
+        contentLoader.finish();
+        releaseSnapshotStateBlock(&stateBlock);
+        // Only now, so that submissions checking mSnapshotContentsPending without the lock wait
+        // for this upload instead of skipping it.
+        mPendingSnapshotContents.markUploaded(device);
+        mSnapshotContentsPending = !mPendingSnapshotContents.empty();
+    }
+
+    void loadAllPendingSnapshotContents() EXCLUDES(mMutex) {
+        while (mSnapshotContentsPending) {
+            VkDevice device = VK_NULL_HANDLE;
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                device = mPendingSnapshotContents.anyDevice();
+            }
+            if (device == VK_NULL_HANDLE) {
+                return;
+            }
+            loadPendingSnapshotContents(device, {});
+        }
+    }
+
+    // Uploads the pending snapshot contents in the background, a batch at a time so that
+    // decoding threads get the locks in between.
+    void startSnapshotContentPrefetch() EXCLUDES(mMutex) {
+        static constexpr VkDeviceSize kBatchBytes = 64 * 1024 * 1024;
+
+        mSnapshotContentPrefetchStop = false;
+        mSnapshotContentPrefetchThread = std::thread([this]() {
+            while (!mSnapshotContentPrefetchStop && mSnapshotContentsPending) {
+                VkDevice device = VK_NULL_HANDLE;
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    device = mPendingSnapshotContents.anyDevice();
+                }
+                if (device == VK_NULL_HANDLE) {
+                    return;
+                }
+                loadPendingSnapshotContents(device, {.maxBytes = kBatchBytes});
+            }
+        });
+    }
+
+    void stopSnapshotContentPrefetch() EXCLUDES(mMutex) {
+        if (mSnapshotContentPrefetchThread.joinable()) {
+            mSnapshotContentPrefetchStop = true;
+            mSnapshotContentPrefetchThread.join();
+        }
+    }
+
     void save(android::base::Stream* stream) {
         VERBOSE("VulkanSnapshots save (begin)");
+        // Contents still waiting from the previous load are read back like any other.
+        stopSnapshotContentPrefetch();
+        loadAllPendingSnapshotContents();
+
         std::lock_guard<std::mutex> lock(mMutex);
 
         mSnapshotState = SnapshotState::Saving;
@@ -369,7 +493,15 @@ class VkDecoderGlobalState::Impl {
         }
 
         // Set up VK structs to snapshot other Vulkan objects
-        // TODO(b/323064243): group all images from the same device and reuse queue / command pool
+        std::unordered_map<VkDevice, StateBlock> stateBlocks;
+        auto getStateBlock = [&](VkDevice device) {
+            auto it = stateBlocks.find(device);
+            if (it == stateBlocks.end()) {
+                it = stateBlocks.emplace(device, createSnapshotStateBlock(device)).first;
+            }
+            return &it->second;
+        };
+        SnapshotContentSaver contentSaver(stream);
 
         VERBOSE("snapshot save: image content");
         std::vector<VkImage> sortedBoxedImages;
@@ -390,12 +522,8 @@ class VkDecoderGlobalState::Impl {
                 continue;
             }
             // Vulkan command playback doesn't recover image layout. We need to do it here.
-            stream->putBe32(imageInfo.layout);
-
-            StateBlock stateBlock = createSnapshotStateBlock(imageInfo.device);
-            // TODO(b/294277842): make sure the queue is empty before using.
-            saveImageContent(stream, &stateBlock, unboxedImage, &imageInfo);
-            releaseSnapshotStateBlock(&stateBlock);
+            contentSaver.putBe32(imageInfo.layout);
+            contentSaver.saveImage(getStateBlock(imageInfo.device), unboxedImage, &imageInfo);
         }
 
         // snapshot buffers
@@ -417,10 +545,11 @@ class VkDecoderGlobalState::Impl {
                 continue;
             }
             // TODO: add a special case for host mapped memory
-            StateBlock stateBlock = createSnapshotStateBlock(bufferInfo.device);
+            contentSaver.saveBuffer(getStateBlock(bufferInfo.device), unboxedBuffer, &bufferInfo);
+        }
 
-            // TODO(b/294277842): make sure the queue is empty before using.
-            saveBufferContent(stream, &stateBlock, unboxedBuffer, &bufferInfo);
+        contentSaver.finish();
+        for (const auto& [device, stateBlock] : stateBlocks) {
             releaseSnapshotStateBlock(&stateBlock);
         }
 
@@ -564,6 +693,7 @@ class VkDecoderGlobalState::Impl {
         // Fences
         VERBOSE("snapshot save: fences");
         std::vector<VkFence> unsignaledFencesBoxed;
+        std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
         for (const auto& fence : mFenceInfo) {
             if (!fence.second.boxed) {
                 continue;
@@ -587,6 +717,8 @@ class VkDecoderGlobalState::Impl {
         // from FrameBuffer's onLoad method.
         VERBOSE("VulkanSnapshots load (begin)");
 
+        stopSnapshotContentPrefetch();
+
         // destroy all current internal data structures
         VERBOSE("snapshot load: setup internal structures");
         {
@@ -595,6 +727,9 @@ class VkDecoderGlobalState::Impl {
             clearLocked();
 
             mSnapshotState = SnapshotState::Loading;
+            // Contents are read after the replay below, but the command buffers it records
+            // already need to track the images and buffers they use.
+            mSnapshotContentsPending = true;
 
             // This needs to happen before the replay in the decoder so that virtio gpu context ids
             // are available for operations involving `ExternalObjectManager`.
@@ -656,8 +791,16 @@ class VkDecoderGlobalState::Impl {
                 stream->read(it->second.ptr, size);
             }
             // Set up VK structs to snapshot other Vulkan objects
-            // TODO(b/323064243): group all images from the same device and reuse queue / command
-            // pool
+            std::unordered_map<VkDevice, StateBlock> stateBlocks;
+            auto getStateBlock = [&](VkDevice device) {
+                auto it = stateBlocks.find(device);
+                if (it == stateBlocks.end()) {
+                    it = stateBlocks.emplace(device, createSnapshotStateBlock(device)).first;
+                }
+                return &it->second;
+            };
+            SnapshotContentLoader contentLoader;
+            std::vector<VkDevice> eagerlyLoadedDevices;
 
             VERBOSE("snapshot load: image content");
             std::vector<VkImage> sortedBoxedImages;
@@ -678,16 +821,19 @@ class VkDecoderGlobalState::Impl {
                 // command directly. Instead, we memorize the current layout and add our own
                 // vkCmdPipelineBarrier after load.
                 //
-                // We do the layout transform in loadImageContent. There are still use cases where
-                // it should recover the layout but does not.
+                // We do the layout transform in SnapshotContentLoader::loadImage(). There are
+                // still use cases where it should recover the layout but does not.
                 //
                 // TODO(b/323059453): fix corner cases when image contents cannot be properly
                 // loaded.
                 imageInfo.layout = static_cast<VkImageLayout>(stream->getBe32());
-                StateBlock stateBlock = createSnapshotStateBlock(imageInfo.device);
-                // TODO(b/294277842): make sure the queue is empty before using.
-                loadImageContent(stream, &stateBlock, unboxedImage, &imageInfo);
-                releaseSnapshotStateBlock(&stateBlock);
+                if (mPendingSnapshotContents.readImage(stream, unboxedImage, imageInfo) &&
+                    needsEagerSnapshotContentLoadLocked(imageInfo.memory)) {
+                    contentLoader.load(getStateBlock(imageInfo.device),
+                                       mPendingSnapshotContents.take(
+                                           imageInfo.device, {.images = {unboxedImage}}));
+                    eagerlyLoadedDevices.push_back(imageInfo.device);
+                }
             }
 
             // snapshot buffers
@@ -705,11 +851,26 @@ class VkDecoderGlobalState::Impl {
                     continue;
                 }
                 // TODO: add a special case for host mapped memory
-                StateBlock stateBlock = createSnapshotStateBlock(bufferInfo.device);
-                // TODO(b/294277842): make sure the queue is empty before using.
-                loadBufferContent(stream, &stateBlock, unboxedBuffer, &bufferInfo);
+                if (mPendingSnapshotContents.readBuffer(stream, unboxedBuffer, bufferInfo) &&
+                    needsEagerSnapshotContentLoadLocked(bufferInfo.memory)) {
+                    contentLoader.load(getStateBlock(bufferInfo.device),
+                                       mPendingSnapshotContents.take(
+                                           bufferInfo.device, {.buffers = {unboxedBuffer}}));
+                    eagerlyLoadedDevices.push_back(bufferInfo.device);
+                }
+            }
+
+            contentLoader.finish();
+            for (VkDevice device : eagerlyLoadedDevices) {
+                mPendingSnapshotContents.markUploaded(device);
+            }
+            for (const auto& [device, stateBlock] : stateBlocks) {
                 releaseSnapshotStateBlock(&stateBlock);
             }
+            // The rest is uploaded when first used, see loadPendingSnapshotContents().
+            mSnapshotContentsPending = !mPendingSnapshotContents.empty();
+            INFO("Vulkan snapshot load: %.2f MB of image and buffer contents deferred.",
+                 mPendingSnapshotContents.bytes() / 1048576.0);
 
             // snapshot descriptors
             VERBOSE("snapshot load: descriptors");
@@ -820,6 +981,7 @@ class VkDecoderGlobalState::Impl {
             uint64_t fenceCount = stream->getBe64();
             std::vector<VkFence> unsignaledFencesBoxed(fenceCount);
             stream->read(unsignaledFencesBoxed.data(), fenceCount * sizeof(VkFence));
+            std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
             for (VkFence boxedFence : unsignaledFencesBoxed) {
                 VkFence unboxedFence = unbox_VkFence(boxedFence);
                 auto it = mFenceInfo.find(unboxedFence);
@@ -840,6 +1002,9 @@ class VkDecoderGlobalState::Impl {
 
             mSnapshotState = SnapshotState::Normal;
         }
+        if (mSnapshotContentsPending) {
+            startSnapshotContentPrefetch();
+        }
         VERBOSE("VulkanSnapshots load (end)");
     }
 
@@ -2053,6 +2218,16 @@ class VkDecoderGlobalState::Impl {
 
         deviceInfo.deviceOpTracker = std::make_shared<DeviceOpTracker>(*pDevice, dispatch);
 
+        deviceInfo.hostPipelineCache = HostPipelineCache::create(
+            mPipelineCacheWriter.get(), *pDevice, dispatch, physicalDeviceInfo.props);
+        deviceInfo.supportsPipelineCreationFeedback =
+            (instanceInfo.apiVersion >= VK_API_VERSION_1_3 &&
+             physicalDeviceInfo.props.apiVersion >= VK_API_VERSION_1_3) ||
+            std::find(deviceInfo.enabledExtensionNames.begin(),
+                      deviceInfo.enabledExtensionNames.end(),
+                      VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME) !=
+                deviceInfo.enabledExtensionNames.end();
+
         if (mLogging) {
             INFO("%s: init vulkan dispatch from device (end)", __func__);
         }
@@ -2116,12 +2291,14 @@ class VkDecoderGlobalState::Impl {
                     new_boxed_VkQueue(physicalQueue, dispatch, false /* does not own dispatch */);
                 extraHandles.push_back((uint64_t)boxedQueue);
 
+                std::lock_guard<std::mutex> queueInfoLock(mQueueInfoMutex);
                 VALIDATE_NEW_HANDLE_INFO_ENTRY(mQueueInfo, physicalQueue);
                 QueueInfo& physicalQueueInfo = mQueueInfo[physicalQueue];
                 physicalQueueInfo.device = *pDevice;
                 physicalQueueInfo.queueFamilyIndex = index;
                 physicalQueueInfo.boxed = boxedQueue;
                 physicalQueueInfo.queueMutex = std::make_shared<std::mutex>();
+                physicalQueueInfo.deviceOpTracker = deviceInfo.deviceOpTracker;
                 queues.push_back(physicalQueue);
 
                 deviceWithQueues.queues.push_back(DeviceLostHelper::QueueWithMutex{
@@ -2157,6 +2334,7 @@ class VkDecoderGlobalState::Impl {
                         virtualQueueInfo.queueFamilyIndex = physicalQueueInfo.queueFamilyIndex;
                         virtualQueueInfo.boxed = boxedVirtualQueue;
                         virtualQueueInfo.queueMutex = physicalQueueInfo.queueMutex;  // Shares the same lock!
+                        virtualQueueInfo.deviceOpTracker = physicalQueueInfo.deviceOpTracker;
                         queues.push_back(virtualQueue);
                     }
                     i++;
@@ -2200,6 +2378,7 @@ class VkDecoderGlobalState::Impl {
 
         VkQueue unboxedQueue = (*queueList)[queueIndex];
 
+        std::lock_guard<std::mutex> queueInfoLock(mQueueInfoMutex);
         auto* queueInfo = android::base::find(mQueueInfo, unboxedQueue);
         if (!queueInfo) {
             ERR("vkGetDeviceQueue failed on queue: %p", unboxedQueue);
@@ -2258,6 +2437,13 @@ class VkDecoderGlobalState::Impl {
             }
         }
 
+        // The device is idle at this point, so these only wait for the flush threads to
+        // release their fences.
+        for (auto& pendingFlush : deviceInfo.pendingColorBufferFlushes) {
+            pendingFlush.wait();
+        }
+        deviceInfo.pendingColorBufferFlushes.clear();
+
         // Should happen before destroying fences
         deviceInfo.deviceOpTracker->OnDestroyDevice();
 
@@ -2269,6 +2455,11 @@ class VkDecoderGlobalState::Impl {
         }
         deviceInfo.externalFencePool.reset();
 
+        if (deviceInfo.hostPipelineCache) {
+            deviceInfo.hostPipelineCache->save();
+            deviceInfo.hostPipelineCache.reset();
+        }
+
         // Run the underlying API call.
         {
             AutoLock lock(*graphicsDriverLock());
@@ -2288,6 +2479,7 @@ class VkDecoderGlobalState::Impl {
         extractDeviceAndDependenciesLocked(device, deviceObjects);
         destroyDeviceObjects(deviceObjects);
 
+        mPendingSnapshotContents.forgetDevice(device);
         mDeviceInfo.erase(device);
         mDeviceToPhysicalDevice.erase(device);
     }
@@ -2371,6 +2563,7 @@ class VkDecoderGlobalState::Impl {
 
         destroyBufferWithExclusiveInfo(device, deviceDispatch, buffer, bufferInfo, pAllocator);
 
+        mPendingSnapshotContents.forgetBuffer(device, buffer);
         mBufferInfo.erase(buffer);
     }
 
@@ -2594,6 +2787,7 @@ class VkDecoderGlobalState::Impl {
 
         destroyImageWithExclusiveInfo(device, deviceDispatch, image, imageInfo, pAllocator);
 
+        mPendingSnapshotContents.forgetImage(device, image);
         mImageInfo.erase(image);
     }
 
@@ -2810,8 +3004,9 @@ class VkDecoderGlobalState::Impl {
         }
 
         std::lock_guard<std::mutex> lock(mMutex);
+        const VkImage image = pCreateInfo->image;
         auto* deviceInfo = android::base::find(mDeviceInfo, device);
-        auto* imageInfo = android::base::find(mImageInfo, pCreateInfo->image);
+        auto* imageInfo = android::base::find(mImageInfo, image);
         if (!deviceInfo || !imageInfo) return VK_ERROR_OUT_OF_HOST_MEMORY;
         VkImageViewCreateInfo createInfo;
         bool needEmulatedAlpha = false;
@@ -2847,6 +3042,7 @@ class VkDecoderGlobalState::Impl {
         VALIDATE_NEW_HANDLE_INFO_ENTRY(mImageViewInfo, *pView);
         auto& imageViewInfo = mImageViewInfo[*pView];
         imageViewInfo.device = device;
+        imageViewInfo.image = image;
         imageViewInfo.needEmulatedAlpha = needEmulatedAlpha;
         imageViewInfo.boundColorBuffer = imageInfo->boundColorBuffer;
         if (imageViewInfo.boundColorBuffer) {
@@ -3063,7 +3259,7 @@ class VkDecoderGlobalState::Impl {
 
         if (res != VK_SUCCESS) return res;
 
-        std::lock_guard<std::mutex> lock(mMutex);
+        std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
 
         VALIDATE_NEW_HANDLE_INFO_ENTRY(mSemaphoreInfo, *pSemaphore);
         auto& semaphoreInfo = mSemaphoreInfo[*pSemaphore];
@@ -3119,7 +3315,7 @@ class VkDecoderGlobalState::Impl {
         }
 
         {
-            std::lock_guard<std::mutex> lock(mMutex);
+            std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
 
             // Create FenceInfo for *pFence.
             if (!fenceReused) {
@@ -3148,7 +3344,7 @@ class VkDecoderGlobalState::Impl {
         auto device = unbox_VkDevice(boxed_device);
         auto vk = dispatch_VkDevice(boxed_device);
         {
-            std::lock_guard<std::mutex> lock(mMutex);
+            std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
             auto* fenceInfo = android::base::find(mFenceInfo, fence);
             if (!fenceInfo) {
                 ERR("%s: Invalid fence %p", fence);
@@ -3178,7 +3374,7 @@ class VkDecoderGlobalState::Impl {
         std::vector<VkFence> externalFences;
 
         {
-            std::lock_guard<std::mutex> lock(mMutex);
+            std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
             for (uint32_t i = 0; i < fenceCount; i++) {
                 if (pFences[i] == VK_NULL_HANDLE) continue;
 
@@ -3209,10 +3405,15 @@ class VkDecoderGlobalState::Impl {
             .flags = 0,
         };
 
+        if (externalFences.empty()) {
+            return VK_SUCCESS;
+        }
+
         std::lock_guard<std::mutex> lock(mMutex);
 
         auto* deviceInfo = android::base::find(mDeviceInfo, device);
         if (!deviceInfo) return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
         for (auto fence : externalFences) {
             VkFence replacement = deviceInfo->externalFencePool->pop(&createInfo);
             if (replacement == VK_NULL_HANDLE) {
@@ -3247,7 +3448,7 @@ class VkDecoderGlobalState::Impl {
 #ifdef _WIN32
         VK_EXT_SYNC_HANDLE handle = VK_EXT_SYNC_HANDLE_INVALID;
         {
-            std::lock_guard<std::mutex> lock(mMutex);
+            std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
 
             auto* infoPtr = android::base::find(
                 mSemaphoreInfo, mExternalSemaphoresById[pImportSemaphoreFdInfo->fd]);
@@ -3299,7 +3500,7 @@ class VkDecoderGlobalState::Impl {
             return result;
         }
 
-        std::lock_guard<std::mutex> lock(mMutex);
+        std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
         mSemaphoreInfo[pGetFdInfo->semaphore].externalHandle = handle;
 #ifdef _WIN32
         int nextId = genSemaphoreId();
@@ -3390,6 +3591,7 @@ class VkDecoderGlobalState::Impl {
         if (deviceInfoIt == mDeviceInfo.end()) return;
         auto& deviceInfo = deviceInfoIt->second;
 
+        std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
         auto semaphoreInfoIt = mSemaphoreInfo.find(semaphore);
         if (semaphoreInfoIt == mSemaphoreInfo.end()) return;
         auto& semaphoreInfo = semaphoreInfoIt->second;
@@ -3459,6 +3661,7 @@ class VkDecoderGlobalState::Impl {
     void destroyFenceLocked(VkDevice device, VulkanDispatch* deviceDispatch, VkFence fence,
                             const VkAllocationCallbacks* pAllocator,
                             bool allowExternalFenceRecycling) REQUIRES(mMutex) {
+        std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
         auto fenceInfoIt = mFenceInfo.find(fence);
         if (fenceInfoIt == mFenceInfo.end()) {
             ERR("Failed to find fence info for VkFence:%p. Leaking fence!", fence);
@@ -3709,6 +3912,7 @@ class VkDecoderGlobalState::Impl {
         setInfo.pool = pool;
         setInfo.unboxedLayout = setLayout;
         setInfo.bindings = setLayoutInfo->bindings;
+        setInfo.writesVersion = ++mDescriptorSetWritesVersion;
         for (size_t i = 0; i < setInfo.bindings.size(); i++) {
             VkDescriptorSetLayoutBinding dslBinding = setInfo.bindings[i];
             int bindingIdx = dslBinding.binding;
@@ -3809,9 +4013,209 @@ class VkDecoderGlobalState::Impl {
         auto device = unbox_VkDevice(boxed_device);
         auto vk = dispatch_VkDevice(boxed_device);
 
+        SnapshotPendingContents::Selection pendingSnapshotContents;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            on_vkUpdateDescriptorSetsImpl(pool, snapshotInfo, vk, device, descriptorWriteCount,
+                                          pDescriptorWrites, descriptorCopyCount,
+                                          pDescriptorCopies);
+            if (mSnapshotContentsPending) {
+                pendingSnapshotContents =
+                    getDescriptorWriteResourcesLocked(descriptorWriteCount, pDescriptorWrites);
+            }
+        }
+        if (!pendingSnapshotContents.images.empty() || !pendingSnapshotContents.buffers.empty()) {
+            loadPendingSnapshotContents(device, pendingSnapshotContents);
+        }
+    }
+
+    // Adds the images and buffers used by the commands of `cmdBufferInfo` to `selection`.
+    // Returns false if some of them are not known, e.g. the buffers of texel buffer views or
+    // those of commands outside of isSnapshotContentUseTracked().
+    bool getSnapshotContentUsesLocked(const CommandBufferInfo& cmdBufferInfo,
+                                      SnapshotPendingContents::Selection* selection)
+        REQUIRES(mMutex) {
+        bool allUsesTracked = !cmdBufferInfo.snapshotContentUsesUntracked;
+        selection->images.insert(selection->images.end(),
+                                 cmdBufferInfo.snapshotContentImages.begin(),
+                                 cmdBufferInfo.snapshotContentImages.end());
+        selection->buffers.insert(selection->buffers.end(),
+                                  cmdBufferInfo.snapshotContentBuffers.begin(),
+                                  cmdBufferInfo.snapshotContentBuffers.end());
+        for (const auto& [image, layout] : cmdBufferInfo.imageLayouts) {
+            selection->images.push_back(image);
+        }
+        for (VkDescriptorSet descriptorSet : cmdBufferInfo.allDescriptorSets) {
+            const auto* descriptorSetInfo = android::base::find(mDescriptorSetInfo, descriptorSet);
+            if (!descriptorSetInfo) {
+                continue;
+            }
+            for (const auto& bindingWrites : descriptorSetInfo->allWrites) {
+                for (const auto& write : bindingWrites) {
+                    switch (write.writeType) {
+                        case DescriptorSetInfo::DescriptorWriteType::ImageInfo: {
+                            if (!descriptorTypeContainsImage(write.descriptorType)) {
+                                break;
+                            }
+                            const auto* imageViewInfo =
+                                android::base::find(mImageViewInfo, write.imageInfo.imageView);
+                            if (imageViewInfo && imageViewInfo->image != VK_NULL_HANDLE) {
+                                selection->images.push_back(imageViewInfo->image);
+                            }
+                        } break;
+                        case DescriptorSetInfo::DescriptorWriteType::BufferInfo:
+                            selection->buffers.push_back(write.bufferInfo.buffer);
+                            break;
+                        case DescriptorSetInfo::DescriptorWriteType::BufferView:
+                            allUsesTracked = false;
+                            break;
+                        default:
+                            break;
+                    }
+                }
+            }
+        }
+        for (VkCommandBuffer subCmd : cmdBufferInfo.subCmds) {
+            const auto* subCmdInfo = android::base::find(mCommandBufferInfo, subCmd);
+            if (subCmdInfo) {
+                allUsesTracked &= getSnapshotContentUsesLocked(*subCmdInfo, selection);
+            }
+        }
+        return allUsesTracked;
+    }
+
+    // Whether all the images and buffers used by the command `opcode` end up in
+    // getSnapshotContentUsesLocked(), because its on_vkCmd* hook records them or because it
+    // does not access image or buffer memory by itself. Any other command makes submissions
+    // of its command buffer upload every pending content, so only add commands here once
+    // their uses are tracked.
+    static bool isSnapshotContentUseTracked(uint32_t opcode) {
+        switch (opcode) {
+            case OP_vkBeginCommandBuffer:
+            case OP_vkEndCommandBuffer:
+            case OP_vkResetCommandBuffer:
+            case OP_vkBeginCommandBufferAsyncGOOGLE:
+            case OP_vkEndCommandBufferAsyncGOOGLE:
+            case OP_vkResetCommandBufferAsyncGOOGLE:
+            case OP_vkCommandBufferHostSyncGOOGLE:
+            // Recorded by their hooks.
+            case OP_vkCmdBindDescriptorSets:
+            case OP_vkCmdPipelineBarrier:
+            case OP_vkCmdPipelineBarrier2:
+            case OP_vkCmdBeginRenderPass:
+            case OP_vkCmdBeginRenderPass2:
+            case OP_vkCmdBeginRenderPass2KHR:
+            case OP_vkCmdCopyImage:
+            case OP_vkCmdCopyImage2:
+            case OP_vkCmdCopyImage2KHR:
+            case OP_vkCmdCopyBufferToImage:
+            case OP_vkCmdCopyBufferToImage2:
+            case OP_vkCmdCopyBufferToImage2KHR:
+            case OP_vkCmdCopyImageToBuffer:
+            case OP_vkCmdCopyImageToBuffer2:
+            case OP_vkCmdCopyImageToBuffer2KHR:
+            case OP_vkCmdCopyQueryPoolResults:
+            case OP_vkCmdExecuteCommands:
+            // Only use state and the resources bound by the commands above.
+            case OP_vkCmdBindPipeline:
+            case OP_vkCmdSetViewport:
+            case OP_vkCmdSetScissor:
+            case OP_vkCmdSetLineWidth:
+            case OP_vkCmdSetDepthBias:
+            case OP_vkCmdSetBlendConstants:
+            case OP_vkCmdSetDepthBounds:
+            case OP_vkCmdSetStencilCompareMask:
+            case OP_vkCmdSetStencilWriteMask:
+            case OP_vkCmdSetStencilReference:
+            case OP_vkCmdSetDeviceMask:
+            case OP_vkCmdPushConstants:
+            case OP_vkCmdDraw:
+            case OP_vkCmdDrawIndexed:
+            case OP_vkCmdDispatch:
+            case OP_vkCmdDispatchBase:
+            case OP_vkCmdClearAttachments:
+            case OP_vkCmdNextSubpass:
+            case OP_vkCmdNextSubpass2:
+            case OP_vkCmdNextSubpass2KHR:
+            case OP_vkCmdEndRenderPass:
+            case OP_vkCmdEndRenderPass2:
+            case OP_vkCmdEndRenderPass2KHR:
+            case OP_vkCmdSetEvent:
+            case OP_vkCmdResetEvent:
+            case OP_vkCmdBeginQuery:
+            case OP_vkCmdEndQuery:
+            case OP_vkCmdResetQueryPool:
+            case OP_vkCmdWriteTimestamp:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Marks `commandBuffer` as having untracked snapshot content uses if the commands in
+    // `pData`, as passed to vkQueueFlushCommandsGOOGLE, are not all isSnapshotContentUseTracked().
+    void checkSnapshotContentUsesTracked(VkCommandBuffer commandBuffer, VkDeviceSize dataSize,
+                                         const void* pData) EXCLUDES(mMutex) {
+        const uint8_t* ptr = static_cast<const uint8_t*>(pData);
+        const uint8_t* const end = ptr + dataSize;
+        bool restarted = false;
+        bool untracked = false;
+        while (end - ptr >= 8) {
+            uint32_t opcode;
+            uint32_t packetLen;
+            memcpy(&opcode, ptr, sizeof(uint32_t));
+            memcpy(&packetLen, ptr + 4, sizeof(uint32_t));
+            if (packetLen < 8 || end - ptr < packetLen) {
+                untracked = true;
+                break;
+            }
+            if (opcode == OP_vkBeginCommandBuffer || opcode == OP_vkResetCommandBuffer ||
+                opcode == OP_vkBeginCommandBufferAsyncGOOGLE ||
+                opcode == OP_vkResetCommandBufferAsyncGOOGLE) {
+                // Only the commands recorded since matter.
+                restarted = true;
+                untracked = false;
+            } else if (!isSnapshotContentUseTracked(opcode)) {
+                untracked = true;
+            }
+            ptr += packetLen;
+        }
+
         std::lock_guard<std::mutex> lock(mMutex);
-        on_vkUpdateDescriptorSetsImpl(pool, snapshotInfo, vk, device, descriptorWriteCount, pDescriptorWrites,
-                                      descriptorCopyCount, pDescriptorCopies);
+        auto* cmdBufferInfo = android::base::find(mCommandBufferInfo, commandBuffer);
+        if (!cmdBufferInfo) {
+            return;
+        }
+        if (restarted) {
+            cmdBufferInfo->snapshotContentUsesUntracked = untracked;
+        } else {
+            cmdBufferInfo->snapshotContentUsesUntracked |= untracked;
+        }
+    }
+
+    // Returns the images and buffers referenced by `pDescriptorWrites`.
+    SnapshotPendingContents::Selection getDescriptorWriteResourcesLocked(
+        uint32_t descriptorWriteCount, const VkWriteDescriptorSet* pDescriptorWrites)
+        REQUIRES(mMutex) {
+        SnapshotPendingContents::Selection selection;
+        for (uint32_t writeIdx = 0; writeIdx < descriptorWriteCount; writeIdx++) {
+            const VkWriteDescriptorSet& descriptorWrite = pDescriptorWrites[writeIdx];
+            const VkDescriptorType descType = descriptorWrite.descriptorType;
+            if (isDescriptorTypeImageInfo(descType) && descriptorTypeContainsImage(descType)) {
+                for (uint32_t i = 0; i < descriptorWrite.descriptorCount; i++) {
+                    auto* imageViewInfo = android::base::find(
+                        mImageViewInfo, descriptorWrite.pImageInfo[i].imageView);
+                    if (imageViewInfo && imageViewInfo->image != VK_NULL_HANDLE) {
+                        selection.images.push_back(imageViewInfo->image);
+                    }
+                }
+            } else if (isDescriptorTypeBufferInfo(descType)) {
+                for (uint32_t i = 0; i < descriptorWrite.descriptorCount; i++) {
+                    selection.buffers.push_back(descriptorWrite.pBufferInfo[i].buffer);
+                }
+            }
+        }
+        return selection;
     }
 
     void on_vkUpdateDescriptorSetsImpl(android::base::BumpPool* pool, VkSnapshotApiCallInfo*,
@@ -3827,6 +4231,7 @@ class VkDecoderGlobalState::Impl {
                 continue;
             }
             DescriptorSetInfo& descriptorSetInfo = ite->second;
+            descriptorSetInfo.writesVersion = ++mDescriptorSetWritesVersion;
             auto& table = descriptorSetInfo.allWrites;
             VkDescriptorType descType = descriptorWrite.descriptorType;
             uint32_t dstBinding = descriptorWrite.dstBinding;
@@ -4113,11 +4518,25 @@ class VkDecoderGlobalState::Impl {
             return result;
         }
 
-        std::lock_guard<std::mutex> lock(mMutex);
+        HostPipelineCache* hostPipelineCache = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
 
-        VALIDATE_NEW_HANDLE_INFO_ENTRY(mPipelineCacheInfo, *pPipelineCache);
-        auto& pipelineCacheInfo = mPipelineCacheInfo[*pPipelineCache];
-        pipelineCacheInfo.device = device;
+            VALIDATE_NEW_HANDLE_INFO_ENTRY(mPipelineCacheInfo, *pPipelineCache);
+            auto& pipelineCacheInfo = mPipelineCacheInfo[*pPipelineCache];
+            pipelineCacheInfo.device = device;
+
+            if (auto* deviceInfo = android::base::find(mDeviceInfo, device)) {
+                hostPipelineCache = deviceInfo->hostPipelineCache.get();
+            }
+        }
+
+        // Pipelines are only ever created against the host cache, see
+        // createPipelinesWithHostCache(), so the guest's data is only useful there. Merging can
+        // take a while for large caches, so it is done without holding mMutex.
+        if (hostPipelineCache && pCreateInfo->initialDataSize > 0) {
+            hostPipelineCache->mergeFrom(*pPipelineCache);
+        }
 
         *pPipelineCache = new_boxed_non_dispatchable_VkPipelineCache(*pPipelineCache);
 
@@ -4211,6 +4630,66 @@ class VkDecoderGlobalState::Impl {
         destroyPipelineLayoutLocked(device, deviceDispatch, pipelineLayout, pAllocator);
     }
 
+    // Pipelines are created against the device's host pipeline cache, if there is one, even when
+    // the guest passes its own cache. Guest pipeline caches stay host-side only, their initial
+    // data is merged into the host cache when they are created. Also records how long creation
+    // took and, where the driver reports it, how many pipelines were found in a pipeline cache.
+    template <typename CreateInfo, typename CreatePipelinesFunc>
+    VkResult createPipelinesWithHostCache(VkDevice device, VkPipelineCache pipelineCache,
+                                          uint32_t createInfoCount, const CreateInfo* pCreateInfos,
+                                          CreatePipelinesFunc createPipelines) {
+        HostPipelineCache* hostPipelineCache = nullptr;
+        bool supportsFeedback = false;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (auto* deviceInfo = android::base::find(mDeviceInfo, device)) {
+                hostPipelineCache = deviceInfo->hostPipelineCache.get();
+                supportsFeedback = deviceInfo->supportsPipelineCreationFeedback;
+            }
+        }
+        if (!hostPipelineCache) {
+            return createPipelines(pipelineCache, pCreateInfos);
+        }
+
+        std::vector<CreateInfo> createInfos(pCreateInfos, pCreateInfos + createInfoCount);
+        std::vector<VkPipelineCreationFeedback> feedbacks(createInfoCount);
+        std::vector<VkPipelineCreationFeedbackCreateInfo> feedbackInfos(createInfoCount);
+        std::vector<const VkPipelineCreationFeedback*> pipelineFeedbacks(createInfoCount, nullptr);
+        for (uint32_t i = 0; i < createInfoCount; i++) {
+            if (const auto* guestFeedbackInfo =
+                    vk_find_struct<VkPipelineCreationFeedbackCreateInfo>(&createInfos[i])) {
+                pipelineFeedbacks[i] = guestFeedbackInfo->pPipelineCreationFeedback;
+            } else if (supportsFeedback) {
+                feedbackInfos[i] = {
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO,
+                    .pNext = createInfos[i].pNext,
+                    .pPipelineCreationFeedback = &feedbacks[i],
+                    .pipelineStageCreationFeedbackCount = 0,
+                    .pPipelineStageCreationFeedbacks = nullptr,
+                };
+                createInfos[i].pNext = &feedbackInfos[i];
+                pipelineFeedbacks[i] = &feedbacks[i];
+            }
+        }
+
+        HostPipelineCache::ScopedUse hostPipelineCacheUse(hostPipelineCache);
+        const uint64_t startUs = android::base::getHighResTimeUs();
+        VkResult result = createPipelines(hostPipelineCacheUse.handle(), createInfos.data());
+        const uint64_t durationUs = android::base::getHighResTimeUs() - startUs;
+
+        uint32_t cacheHits = 0;
+        for (const VkPipelineCreationFeedback* feedback : pipelineFeedbacks) {
+            if (feedback && (feedback->flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT) &&
+                (feedback->flags &
+                 VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT)) {
+                cacheHits++;
+            }
+        }
+        hostPipelineCache->recordPipelineCreation(createInfoCount, durationUs, cacheHits);
+
+        return result;
+    }
+
     VkResult on_vkCreateGraphicsPipelines(android::base::BumpPool* pool, VkSnapshotApiCallInfo*,
                                           VkDevice boxed_device, VkPipelineCache pipelineCache,
                                           uint32_t createInfoCount,
@@ -4220,8 +4699,12 @@ class VkDecoderGlobalState::Impl {
         auto device = unbox_VkDevice(boxed_device);
         auto deviceDispatch = dispatch_VkDevice(boxed_device);
 
-        VkResult result = deviceDispatch->vkCreateGraphicsPipelines(
-            device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines);
+        VkResult result = createPipelinesWithHostCache(
+            device, pipelineCache, createInfoCount, pCreateInfos,
+            [&](VkPipelineCache cache, const VkGraphicsPipelineCreateInfo* createInfos) {
+                return deviceDispatch->vkCreateGraphicsPipelines(
+                    device, cache, createInfoCount, createInfos, pAllocator, pPipelines);
+            });
         if (result != VK_SUCCESS && result != VK_PIPELINE_COMPILE_REQUIRED) {
             return result;
         }
@@ -4251,8 +4734,12 @@ class VkDecoderGlobalState::Impl {
         auto device = unbox_VkDevice(boxed_device);
         auto deviceDispatch = dispatch_VkDevice(boxed_device);
 
-        VkResult result = deviceDispatch->vkCreateComputePipelines(
-            device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines);
+        VkResult result = createPipelinesWithHostCache(
+            device, pipelineCache, createInfoCount, pCreateInfos,
+            [&](VkPipelineCache cache, const VkComputePipelineCreateInfo* createInfos) {
+                return deviceDispatch->vkCreateComputePipelines(
+                    device, cache, createInfoCount, createInfos, pAllocator, pPipelines);
+            });
         if (result != VK_SUCCESS && result != VK_PIPELINE_COMPILE_REQUIRED) {
             return result;
         }
@@ -4301,6 +4788,23 @@ class VkDecoderGlobalState::Impl {
         destroyPipelineLocked(device, deviceDispatch, pipeline, pAllocator);
     }
 
+    // Records that the commands of `commandBuffer` use these images and buffers, see
+    // CommandBufferInfo::snapshotContentImages.
+    void recordSnapshotContentUsesLocked(VkCommandBuffer commandBuffer,
+                                         std::initializer_list<VkImage> images,
+                                         std::initializer_list<VkBuffer> buffers)
+        REQUIRES(mMutex) {
+        if (!mSnapshotContentsPending) {
+            return;
+        }
+        auto* cmdBufferInfo = android::base::find(mCommandBufferInfo, commandBuffer);
+        if (!cmdBufferInfo) {
+            return;
+        }
+        cmdBufferInfo->snapshotContentImages.insert(images);
+        cmdBufferInfo->snapshotContentBuffers.insert(buffers);
+    }
+
     void on_vkCmdCopyImage(android::base::BumpPool* pool, VkSnapshotApiCallInfo*,
                            VkCommandBuffer boxed_commandBuffer, VkImage srcImage,
                            VkImageLayout srcImageLayout, VkImage dstImage,
@@ -4310,6 +4814,7 @@ class VkDecoderGlobalState::Impl {
         auto vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
 
         std::lock_guard<std::mutex> lock(mMutex);
+        recordSnapshotContentUsesLocked(commandBuffer, {srcImage, dstImage}, {});
         auto* srcImg = android::base::find(mImageInfo, srcImage);
         auto* dstImg = android::base::find(mImageInfo, dstImage);
         if (!srcImg || !dstImg) return;
@@ -4349,6 +4854,7 @@ class VkDecoderGlobalState::Impl {
         auto vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
 
         std::lock_guard<std::mutex> lock(mMutex);
+        recordSnapshotContentUsesLocked(commandBuffer, {srcImage}, {dstBuffer});
         auto* imageInfo = android::base::find(mImageInfo, srcImage);
         auto* bufferInfo = android::base::find(mBufferInfo, dstBuffer);
         if (!imageInfo || !bufferInfo) return;
@@ -4375,6 +4881,8 @@ class VkDecoderGlobalState::Impl {
         auto vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
 
         std::lock_guard<std::mutex> lock(mMutex);
+        recordSnapshotContentUsesLocked(commandBuffer,
+                                        {pCopyImageInfo->srcImage, pCopyImageInfo->dstImage}, {});
         auto* srcImg = android::base::find(mImageInfo, pCopyImageInfo->srcImage);
         auto* dstImg = android::base::find(mImageInfo, pCopyImageInfo->dstImage);
         if (!srcImg || !dstImg) return;
@@ -4419,6 +4927,8 @@ class VkDecoderGlobalState::Impl {
         auto vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
 
         std::lock_guard<std::mutex> lock(mMutex);
+        recordSnapshotContentUsesLocked(commandBuffer, {pCopyImageToBufferInfo->srcImage},
+                                        {pCopyImageToBufferInfo->dstBuffer});
         auto* imageInfo = android::base::find(mImageInfo, pCopyImageToBufferInfo->srcImage);
         auto* bufferInfo = android::base::find(mBufferInfo, pCopyImageToBufferInfo->dstBuffer);
         if (!imageInfo || !bufferInfo) return;
@@ -4448,6 +4958,8 @@ class VkDecoderGlobalState::Impl {
         auto vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
 
         std::lock_guard<std::mutex> lock(mMutex);
+        recordSnapshotContentUsesLocked(commandBuffer,
+                                        {pCopyImageInfo->srcImage, pCopyImageInfo->dstImage}, {});
         auto* srcImg = android::base::find(mImageInfo, pCopyImageInfo->srcImage);
         auto* dstImg = android::base::find(mImageInfo, pCopyImageInfo->dstImage);
         if (!srcImg || !dstImg) return;
@@ -4492,6 +5004,8 @@ class VkDecoderGlobalState::Impl {
         auto vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
 
         std::lock_guard<std::mutex> lock(mMutex);
+        recordSnapshotContentUsesLocked(commandBuffer, {pCopyImageToBufferInfo->srcImage},
+                                        {pCopyImageToBufferInfo->dstBuffer});
         auto* imageInfo = android::base::find(mImageInfo, pCopyImageToBufferInfo->srcImage);
         auto* bufferInfo = android::base::find(mBufferInfo, pCopyImageToBufferInfo->dstBuffer);
         if (!imageInfo || !bufferInfo) return;
@@ -4657,6 +5171,7 @@ class VkDecoderGlobalState::Impl {
         auto vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
 
         std::lock_guard<std::mutex> lock(mMutex);
+        recordSnapshotContentUsesLocked(commandBuffer, {dstImage}, {srcBuffer});
         auto* imageInfo = android::base::find(mImageInfo, dstImage);
         if (!imageInfo) return;
         auto* bufferInfo = android::base::find(mBufferInfo, srcBuffer);
@@ -4711,6 +5226,8 @@ class VkDecoderGlobalState::Impl {
         auto vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
 
         std::lock_guard<std::mutex> lock(mMutex);
+        recordSnapshotContentUsesLocked(commandBuffer, {pCopyBufferToImageInfo->dstImage},
+                                        {pCopyBufferToImageInfo->srcBuffer});
         auto* imageInfo = android::base::find(mImageInfo, pCopyBufferToImageInfo->dstImage);
         if (!imageInfo) return;
         auto* bufferInfo = android::base::find(mBufferInfo, pCopyBufferToImageInfo->srcBuffer);
@@ -4768,6 +5285,8 @@ class VkDecoderGlobalState::Impl {
         auto vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
 
         std::lock_guard<std::mutex> lock(mMutex);
+        recordSnapshotContentUsesLocked(commandBuffer, {pCopyBufferToImageInfo->dstImage},
+                                        {pCopyBufferToImageInfo->srcBuffer});
         auto* imageInfo = android::base::find(mImageInfo, pCopyBufferToImageInfo->dstImage);
         if (!imageInfo) return;
         auto* bufferInfo = android::base::find(mBufferInfo, pCopyBufferToImageInfo->srcBuffer);
@@ -5697,9 +6216,12 @@ class VkDecoderGlobalState::Impl {
         freeMemoryLocked(device, deviceDispatch, memory, pAllocator);
     }
 
-    VkResult on_vkMapMemory(android::base::BumpPool* pool, VkSnapshotApiCallInfo*, VkDevice,
-                            VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size,
-                            VkMemoryMapFlags flags, void** ppData) {
+    VkResult on_vkMapMemory(android::base::BumpPool* pool, VkSnapshotApiCallInfo*,
+                            VkDevice boxed_device, VkDeviceMemory memory, VkDeviceSize offset,
+                            VkDeviceSize size, VkMemoryMapFlags flags, void** ppData) {
+        // Mapped memory is restored while loading, this only catches what the guest maps later.
+        loadPendingSnapshotContents(unbox_VkDevice(boxed_device), {.memory = memory});
+
         std::lock_guard<std::mutex> lock(mMutex);
         return on_vkMapMemoryLocked(0, memory, offset, size, flags, ppData);
     }
@@ -5869,6 +6391,7 @@ class VkDecoderGlobalState::Impl {
 
         DeviceOpWaitable aniCompletedWaitable = builder.OnQueueSubmittedWithFence(usedFence);
 
+        std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
         if (semaphore != VK_NULL_HANDLE) {
             auto semaphoreInfo = android::base::find(mSemaphoreInfo, semaphore);
             if (semaphoreInfo != nullptr) {
@@ -5897,7 +6420,11 @@ class VkDecoderGlobalState::Impl {
 
         std::lock_guard<std::mutex> lock(mMutex);
 
-        auto* queueInfo = android::base::find(mQueueInfo, queue);
+        QueueInfo* queueInfo = nullptr;
+        {
+            std::lock_guard<std::mutex> queueInfoLock(mQueueInfoMutex);
+            queueInfo = android::base::find(mQueueInfo, queue);
+        }
         if (!queueInfo) return VK_ERROR_INITIALIZATION_FAILED;
 
         if (mRenderDocWithMultipleVkInstances) {
@@ -6288,22 +6815,16 @@ class VkDecoderGlobalState::Impl {
                         if (!cmdBufferInfo) {
                             continue;
                         }
-                        for (auto descriptorSet : cmdBufferInfo->allDescriptorSets) {
-                            auto descriptorSetInfo =
-                                android::base::find(mDescriptorSetInfo, descriptorSet);
-                            if (!descriptorSetInfo) {
-                                continue;
+                        if (!descriptorColorBuffersUpToDateLocked(*cmdBufferInfo)) {
+                            computeDescriptorColorBuffersLocked(*cmdBufferInfo);
+                        }
+                        for (const auto& use : cmdBufferInfo->descriptorColorBuffers) {
+                            bool isValid = true;
+                            for (const auto& alive : use.alives) {
+                                isValid &= !alive.expired();
                             }
-                            for (auto& writes : descriptorSetInfo->allWrites) {
-                                for (const auto& write : writes) {
-                                    bool isValid = true;
-                                    for (const auto& alive : write.alives) {
-                                        isValid &= !alive.expired();
-                                    }
-                                    if (isValid && write.boundColorBuffer.has_value()) {
-                                        acquiredColorBuffers.insert(write.boundColorBuffer.value());
-                                    }
-                                }
+                            if (isValid) {
+                                acquiredColorBuffers.insert(use.colorBuffer);
                             }
                         }
 
@@ -6319,13 +6840,18 @@ class VkDecoderGlobalState::Impl {
             for (HandleType cb : acquiredColorBuffers) {
                 m_vkEmulation->getCallbacks().invalidateColorBuffer(cb);
             }
+
+            // Uploads to ColorBuffers are submitted to the emulation queue without waiting,
+            // so make sure the ones to the acquired ColorBuffers are complete before the guest
+            // can use the images.
+            m_vkEmulation->waitForColorBufferUploads(acquiredColorBuffers);
         }
 
         VkDevice device = VK_NULL_HANDLE;
         std::mutex* queueMutex = nullptr;
-
+        DeviceOpTrackerPtr deviceOpTracker;
         {
-            std::lock_guard<std::mutex> lock(mMutex);
+            std::lock_guard<std::mutex> queueInfoLock(mQueueInfoMutex);
             auto* queueInfo = android::base::find(mQueueInfo, queue);
             if (!queueInfo) {
                 ERR("vkQueueSubmit cannot find queue info for %p", queue);
@@ -6333,6 +6859,32 @@ class VkDecoderGlobalState::Impl {
             }
             device = queueInfo->device;
             queueMutex = queueInfo->queueMutex.get();
+            deviceOpTracker = queueInfo->deviceOpTracker;
+        }
+        if (!deviceOpTracker) return VK_ERROR_INITIALIZATION_FAILED;
+
+        if (mSnapshotContentsPending) {
+            SnapshotPendingContents::Selection pendingSnapshotContents;
+            bool allUsesTracked = true;
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                for (uint32_t i = 0; i < submitCount; i++) {
+                    for (int j = 0; j < getCommandBufferCount(pSubmits[i]); j++) {
+                        const CommandBufferInfo* cmdBufferInfo = android::base::find(
+                            mCommandBufferInfo, getCommandBuffer(pSubmits[i], j));
+                        if (cmdBufferInfo) {
+                            allUsesTracked &= getSnapshotContentUsesLocked(
+                                *cmdBufferInfo, &pendingSnapshotContents);
+                        }
+                    }
+                }
+            }
+            if (!allUsesTracked) {
+                loadPendingSnapshotContents(device, {});
+            } else if (!pendingSnapshotContents.images.empty() ||
+                       !pendingSnapshotContents.buffers.empty()) {
+                loadPendingSnapshotContents(device, pendingSnapshotContents);
+            }
         }
 
         // Unsafe to release when snapshot enabled.
@@ -6344,11 +6896,7 @@ class VkDecoderGlobalState::Impl {
         VkFence usedFence = fence;
         DeviceOpWaitable queueCompletedWaitable;
         {
-            std::lock_guard<std::mutex> lock(mMutex);
-
-            auto* deviceInfo = android::base::find(mDeviceInfo, device);
-            if (!deviceInfo) return VK_ERROR_INITIALIZATION_FAILED;
-            DeviceOpBuilder builder(*deviceInfo->deviceOpTracker);
+            DeviceOpBuilder builder(*deviceOpTracker);
 
             if (VK_NULL_HANDLE == usedFence) {
                 // Note: This fence will be managed by the DeviceOpTracker after the
@@ -6358,7 +6906,7 @@ class VkDecoderGlobalState::Impl {
             }
             queueCompletedWaitable = builder.OnQueueSubmittedWithFence(usedFence);
 
-            deviceInfo->deviceOpTracker->PollAndProcessGarbage();
+            deviceOpTracker->PollAndProcessGarbage();
         }
 
         std::lock_guard<std::mutex> queueLock(*queueMutex);
@@ -6368,6 +6916,13 @@ class VkDecoderGlobalState::Impl {
             WARN("dispatchVkQueueSubmit failed: %s [%d]", string_VkResult(result), result);
             return result;
         }
+
+        // The guest may reset or destroy its own fence at any point after it signals, so
+        // released ColorBuffers are flushed after a separate host owned fence instead.
+        VkFence colorBufferFlushFence = VK_NULL_HANDLE;
+        if (!releasedColorBuffers.empty()) {
+            colorBufferFlushFence = submitColorBufferFlushFence(vk, device, queue);
+        }
         {
             std::lock_guard<std::mutex> lock(mMutex);
             // Update image layouts
@@ -6388,6 +6943,9 @@ class VkDecoderGlobalState::Impl {
                     }
                 }
             }
+        }
+        {
+            std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
             // Update latestUse for all wait/signal semaphores, to ensure that they
             // are never asynchronously destroyed before the queue submissions referencing
             // them have completed
@@ -6424,7 +6982,10 @@ class VkDecoderGlobalState::Impl {
                 fenceInfo->latestUse = queueCompletedWaitable;
             }
         }
-        if (!releasedColorBuffers.empty()) {
+        if (colorBufferFlushFence != VK_NULL_HANDLE) {
+            scheduleColorBufferFlushes(vk, device, colorBufferFlushFence,
+                                       std::move(releasedColorBuffers));
+        } else if (!releasedColorBuffers.empty()) {
             result = vk->vkWaitForFences(device, 1, &usedFence, VK_TRUE, /* 1 sec */ 1000000000L);
             if (result != VK_SUCCESS) {
                 ERR("vkWaitForFences failed: %s [%d]", string_VkResult(result), result);
@@ -6439,6 +7000,144 @@ class VkDecoderGlobalState::Impl {
         return result;
     }
 
+    void computeDescriptorColorBuffersLocked(CommandBufferInfo& cmdBufferInfo) REQUIRES(mMutex) {
+        cmdBufferInfo.descriptorColorBuffers.clear();
+        cmdBufferInfo.descriptorSetVersions.clear();
+        for (auto descriptorSet : cmdBufferInfo.allDescriptorSets) {
+            auto* descriptorSetInfo = android::base::find(mDescriptorSetInfo, descriptorSet);
+            // A set that no longer exists is recorded with version 0, which no live set has.
+            cmdBufferInfo.descriptorSetVersions.emplace_back(
+                descriptorSet, descriptorSetInfo ? descriptorSetInfo->writesVersion : 0);
+            if (!descriptorSetInfo) {
+                continue;
+            }
+            for (const auto& writes : descriptorSetInfo->allWrites) {
+                for (const auto& write : writes) {
+                    if (!write.boundColorBuffer.has_value()) {
+                        continue;
+                    }
+                    cmdBufferInfo.descriptorColorBuffers.push_back(
+                        CommandBufferInfo::DescriptorColorBuffer{
+                            .colorBuffer = write.boundColorBuffer.value(),
+                            .alives = write.alives,
+                        });
+                }
+            }
+        }
+        cmdBufferInfo.descriptorColorBuffersComputed = true;
+    }
+
+    bool descriptorColorBuffersUpToDateLocked(const CommandBufferInfo& cmdBufferInfo)
+        REQUIRES(mMutex) {
+        if (!cmdBufferInfo.descriptorColorBuffersComputed ||
+            cmdBufferInfo.descriptorSetVersions.size() != cmdBufferInfo.allDescriptorSets.size()) {
+            return false;
+        }
+        for (const auto& [descriptorSet, version] : cmdBufferInfo.descriptorSetVersions) {
+            auto* descriptorSetInfo = android::base::find(mDescriptorSetInfo, descriptorSet);
+            const uint64_t currentVersion = descriptorSetInfo ? descriptorSetInfo->writesVersion : 0;
+            if (currentVersion != version) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Submits an empty batch to `queue` signaling a newly created fence once all previously
+    // submitted work has completed. Returns VK_NULL_HANDLE on failure. Requires the queue lock.
+    VkFence submitColorBufferFlushFence(VulkanDispatch* vk, VkDevice device, VkQueue queue) {
+        const VkFenceCreateInfo fenceCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+        };
+        VkFence fence = VK_NULL_HANDLE;
+        VkResult result = vk->vkCreateFence(device, &fenceCreateInfo, nullptr, &fence);
+        if (result != VK_SUCCESS) {
+            WARN("Failed to create ColorBuffer flush fence: %s [%d]", string_VkResult(result),
+                 result);
+            return VK_NULL_HANDLE;
+        }
+
+        result = vk->vkQueueSubmit(queue, 0, nullptr, fence);
+        if (result != VK_SUCCESS) {
+            WARN("Failed to submit ColorBuffer flush fence: %s [%d]", string_VkResult(result),
+                 result);
+            vk->vkDestroyFence(device, fence, nullptr);
+            return VK_NULL_HANDLE;
+        }
+        return fence;
+    }
+
+    // Flushes the released ColorBuffers to their other backings on a background thread once
+    // `fence` signals, instead of stalling the render thread on GPU completion. Consumers of
+    // these ColorBuffers wait on the pending flush through VkEmulation. Takes ownership of
+    // `fence`.
+    void scheduleColorBufferFlushes(VulkanDispatch* vk, VkDevice device, VkFence fence,
+                                    std::unordered_set<HandleType> colorBuffers) {
+        auto fenceReleased = std::make_shared<std::promise<void>>();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto* deviceInfo = android::base::find(mDeviceInfo, device);
+            if (deviceInfo) {
+                auto& pendingFlushes = deviceInfo->pendingColorBufferFlushes;
+                pendingFlushes.erase(
+                    std::remove_if(pendingFlushes.begin(), pendingFlushes.end(),
+                                   [](const DeviceOpWaitable& waitable) { return IsDone(waitable); }),
+                    pendingFlushes.end());
+                pendingFlushes.push_back(fenceReleased->get_future().share());
+            }
+        }
+
+        // Published before scheduling so that no consumer can observe the ColorBuffers
+        // without also observing the pending flush. A flush of an earlier submission that is
+        // still pending has to finish first, or it could overwrite the newer contents.
+        auto flushCompleted = std::make_shared<AutoCancelingPromise>();
+        CancelableFuture pendingFlush = flushCompleted->GetFuture();
+        std::vector<CancelableFuture> previousFlushes;
+        for (HandleType cb : colorBuffers) {
+            if (auto previousFlush = m_vkEmulation->setColorBufferPendingFlush(cb, pendingFlush)) {
+                previousFlushes.push_back(std::move(*previousFlush));
+            }
+        }
+
+        m_vkEmulation->getCallbacks().scheduleAsyncWork(
+            [this, vk, device, fence, colorBuffers = std::move(colorBuffers),
+             previousFlushes = std::move(previousFlushes),
+             fenceReleased = std::move(fenceReleased),
+             flushCompleted = std::move(flushCompleted)]() {
+                GFXSTREAM_TRACE_EVENT(GFXSTREAM_TRACE_DEFAULT_CATEGORY,
+                                      "Flush ColorBuffers after vkQueueSubmit");
+                // The fence can only be destroyed once it is no longer pending, so keep waiting
+                // on a timeout instead of giving up on it.
+                VkResult result;
+                while ((result = vk->vkWaitForFences(device, 1, &fence, VK_TRUE,
+                                                     kColorBufferFlushTimeoutNs)) == VK_TIMEOUT) {
+                    WARN("vkWaitForFences for ColorBuffer flush timed out, waiting again.");
+                }
+                vk->vkDestroyFence(device, fence, nullptr);
+                fenceReleased->set_value();
+
+                if (result != VK_SUCCESS) {
+                    // The Vulkan contents are not known to be complete, so they are not flushed.
+                    // Destroying `flushCompleted` without completing it cancels the pending
+                    // flush.
+                    ERR("vkWaitForFences for ColorBuffer flush failed: %s [%d]",
+                        string_VkResult(result), result);
+                    return;
+                }
+
+                for (const CancelableFuture& previousFlush : previousFlushes) {
+                    previousFlush.wait();
+                }
+                for (HandleType cb : colorBuffers) {
+                    m_vkEmulation->getCallbacks().flushColorBuffer(cb);
+                }
+                flushCompleted->MarkComplete();
+            },
+            "Flush ColorBuffers released by vkQueueSubmit");
+    }
+
     VkResult on_vkQueueWaitIdle(android::base::BumpPool* pool, VkSnapshotApiCallInfo*,
                                 VkQueue boxed_queue) {
         auto queue = unbox_VkQueue(boxed_queue);
@@ -6448,7 +7147,7 @@ class VkDecoderGlobalState::Impl {
 
         std::mutex* queueMutex;
         {
-            std::lock_guard<std::mutex> lock(mMutex);
+            std::lock_guard<std::mutex> queueInfoLock(mQueueInfoMutex);
             auto* queueInfo = android::base::find(mQueueInfo, queue);
             if (!queueInfo) return VK_SUCCESS;
             queueMutex = queueInfo->queueMutex.get();
@@ -6835,6 +7534,9 @@ class VkDecoderGlobalState::Impl {
         auto* commandBufferInfo = android::base::find(mCommandBufferInfo, commandBuffer);
         if (!commandBufferInfo) return VK_ERROR_UNKNOWN;
         commandBufferInfo->reset();
+        // Only commands recorded through vkQueueFlushCommandsGOOGLE are checked against
+        // isSnapshotContentUseTracked(), see on_vkQueueFlushCommandsGOOGLE().
+        commandBufferInfo->snapshotContentUsesUntracked = mSnapshotContentsPending;
 
         if (context.processName) {
             commandBufferInfo->debugUtilsHelper.cmdBeginDebugLabel(commandBuffer, "Process %s",
@@ -6870,6 +7572,10 @@ class VkDecoderGlobalState::Impl {
             commandBufferInfo->debugUtilsHelper.cmdEndDebugLabel(commandBuffer);
         }
 
+        if (!m_vkEmulation->getFeatures().GuestVulkanOnly.enabled) {
+            computeDescriptorColorBuffersLocked(*commandBufferInfo);
+        }
+
         return vk->vkEndCommandBuffer(commandBuffer);
     }
 
@@ -7051,6 +7757,10 @@ class VkDecoderGlobalState::Impl {
 
         cmdBufferInfo->releasedColorBuffers.insert(fbInfo->attachedColorBuffers.begin(),
                                                    fbInfo->attachedColorBuffers.end());
+        if (mSnapshotContentsPending) {
+            cmdBufferInfo->snapshotContentImages.insert(fbInfo->attachedImages.begin(),
+                                                        fbInfo->attachedImages.end());
+        }
         return true;
     }
 
@@ -7096,6 +7806,8 @@ class VkDecoderGlobalState::Impl {
         {
             std::lock_guard<std::mutex> lock(mMutex);
 
+            recordSnapshotContentUsesLocked(commandBuffer, {}, {dstBuffer});
+
             if (queryCount == 1 && stride == 0) {
                 // Some drivers don't seem to handle stride==0 very well.
                 // In fact, the spec does not say what should happen with stride==0.
@@ -7139,6 +7851,7 @@ class VkDecoderGlobalState::Impl {
                     framebufferInfo.attachedColorBuffers.push_back(
                         imageViewInfo->boundColorBuffer.value());
                 }
+                framebufferInfo.attachedImages.push_back(imageViewInfo->image);
             }
         }
 
@@ -7440,10 +8153,19 @@ class VkDecoderGlobalState::Impl {
                                        const VkDecoderContext& context) {
         (void)queue;
 
+        // The decoder already advanced the sequence number, let the next command run while
+        // this one is decoded.
+        if (context.processResources) {
+            context.processResources->wakeNextSequenceNumberWaiter();
+        }
+
         VkCommandBuffer commandBuffer = unbox_VkCommandBuffer(boxed_commandBuffer);
         VulkanDispatch* vk = dispatch_VkCommandBuffer(boxed_commandBuffer);
         VulkanMemReadingStream* readStream = readstream_VkCommandBuffer(boxed_commandBuffer);
         subDecode(readStream, vk, boxed_commandBuffer, commandBuffer, dataSize, pData, context);
+        if (mSnapshotContentsPending) {
+            checkSnapshotContentUsesTracked(commandBuffer, dataSize, pData);
+        }
     }
 
     void on_vkQueueFlushCommandsFromAuxMemoryGOOGLE(android::base::BumpPool* pool,
@@ -7517,6 +8239,7 @@ class VkDecoderGlobalState::Impl {
         auto queue = unbox_VkQueue(boxed_queue);
         auto vk = dispatch_VkQueue(boxed_queue);
 
+        std::unique_lock<std::mutex> queueInfoLock(mQueueInfoMutex);
         auto* queueInfo = android::base::find(mQueueInfo, queue);
         if (queueInfo) {
             device = queueInfo->device;
@@ -7524,6 +8247,7 @@ class VkDecoderGlobalState::Impl {
             GFXSTREAM_ABORT(FatalError(ABORT_REASON_OTHER))
                 << "queue " << queue << "(boxed: " << boxed_queue << ") with no device registered";
         }
+        queueInfoLock.unlock();
         on_vkQueueCommitDescriptorSetUpdatesGOOGLELocked(
             pool, snapshotInfo, vk, device, descriptorPoolCount, pDescriptorPools,
             descriptorSetCount, pDescriptorSetLayouts, pDescriptorSetPoolIds,
@@ -7706,7 +8430,7 @@ class VkDecoderGlobalState::Impl {
                 std::mutex* fenceMutex = nullptr;
                 std::condition_variable* cv = nullptr;
                 {
-                    std::lock_guard<std::mutex> lock(mMutex);
+                    std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
                     auto* fenceInfo = android::base::find(mFenceInfo, fence);
                     if (!fenceInfo) {
                         ERR("%s: Invalid fence information! (%p)", __func__, fence);
@@ -7738,7 +8462,7 @@ class VkDecoderGlobalState::Impl {
                 if (checkWaitState) {
                     std::unique_lock<std::mutex> lock(*fenceMutex);
                     cv->wait(lock, [this, fence] {
-                        std::lock_guard<std::mutex> lock(mMutex);
+                        std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
                         auto* fenceInfo = android::base::find(mFenceInfo, fence);
                         if (!fenceInfo) {
                             GFXSTREAM_ABORT(FatalError(ABORT_REASON_OTHER))
@@ -7768,7 +8492,7 @@ class VkDecoderGlobalState::Impl {
         VkDevice device;
         VulkanDispatch* vk;
         {
-            std::lock_guard<std::mutex> lock(mMutex);
+            std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
             auto* fenceInfo = android::base::find(mFenceInfo, fence);
             if (!fenceInfo) {
                 // No fence, could be a semaphore.
@@ -8198,6 +8922,7 @@ class VkDecoderGlobalState::Impl {
         auto* deviceInfo = android::base::find(mDeviceInfo, device);
         if (!deviceInfo) return false;
 
+        std::lock_guard<std::mutex> queueInfoLock(mQueueInfoMutex);
         auto zeroIt = deviceInfo->queues.find(0);
         if (zeroIt == deviceInfo->queues.end() || zeroIt->second.empty()) {
             // Get the first queue / queueFamilyIndex
@@ -8488,18 +9213,24 @@ class VkDecoderGlobalState::Impl {
         extractInfosWithDeviceInto(device, mDescriptorSetLayoutInfo,
                                    deviceObjects.descriptorSetLayouts);
         extractInfosWithDeviceInto(device, mMemoryInfo, deviceObjects.memories);
-        extractInfosWithDeviceInto(device, mFenceInfo, deviceObjects.fences);
         extractInfosWithDeviceInto(device, mFramebufferInfo, deviceObjects.framebuffers);
         extractInfosWithDeviceInto(device, mImageInfo, deviceObjects.images);
         extractInfosWithDeviceInto(device, mImageViewInfo, deviceObjects.imageViews);
         extractInfosWithDeviceInto(device, mPipelineCacheInfo, deviceObjects.pipelineCaches);
         extractInfosWithDeviceInto(device, mPipelineLayoutInfo, deviceObjects.pipelineLayouts);
         extractInfosWithDeviceInto(device, mPipelineInfo, deviceObjects.pipelines);
-        extractInfosWithDeviceInto(device, mQueueInfo, deviceObjects.queues);
         extractInfosWithDeviceInto(device, mRenderPassInfo, deviceObjects.renderPasses);
         extractInfosWithDeviceInto(device, mSamplerInfo, deviceObjects.samplers);
-        extractInfosWithDeviceInto(device, mSemaphoreInfo, deviceObjects.semaphores);
         extractInfosWithDeviceInto(device, mShaderModuleInfo, deviceObjects.shaderModules);
+        {
+            std::lock_guard<std::mutex> queueInfoLock(mQueueInfoMutex);
+            extractInfosWithDeviceInto(device, mQueueInfo, deviceObjects.queues);
+        }
+        {
+            std::lock_guard<std::mutex> syncObjectLock(mSyncObjectMutex);
+            extractInfosWithDeviceInto(device, mFenceInfo, deviceObjects.fences);
+            extractInfosWithDeviceInto(device, mSemaphoreInfo, deviceObjects.semaphores);
+        }
     }
 
     void extractInstanceAndDependenciesLocked(VkInstance instance, InstanceObjects& objects) REQUIRES(mMutex) {
@@ -8862,7 +9593,21 @@ class VkDecoderGlobalState::Impl {
     bool mVerbosePrints = false;
     bool mUseOldMemoryCleanupPath = false;
 
+    // Guards most of the object tracking info below. Queues and synchronization objects,
+    // which are looked up on every submission and wait, are tracked under their own locks so
+    // that those paths don't contend with unrelated object creation and destruction.
+    //
+    // Command buffers, descriptor sets and images stay under mMutex. The paths using them also
+    // use the state they refer to in the same critical section: a submission walks the command
+    // buffers' descriptor sets and updates image layouts, descriptor set allocation updates the
+    // pool, and image binding updates the memory info. Separate locks would take those paths
+    // through more locks, not fewer. Per-device maps don't help either, most entry points only
+    // get the handle and would need a global lookup to find its device.
+    //
+    // Lock order: mMutex, then mQueueInfoMutex, then mSyncObjectMutex.
     std::mutex mMutex;
+    std::mutex mQueueInfoMutex;
+    std::mutex mSyncObjectMutex;
 
     bool isBindingFeasibleForAlloc(const DescriptorPoolInfo::PoolState& poolState,
                                    const VkDescriptorSetLayoutBinding& binding) {
@@ -8975,27 +9720,29 @@ class VkDecoderGlobalState::Impl {
     std::unordered_map<VkCommandPool, CommandPoolInfo> mCommandPoolInfo GUARDED_BY(mMutex);
     std::unordered_map<VkDescriptorPool, DescriptorPoolInfo> mDescriptorPoolInfo GUARDED_BY(mMutex);
     std::unordered_map<VkDescriptorSet, DescriptorSetInfo> mDescriptorSetInfo GUARDED_BY(mMutex);
+    // Source of DescriptorSetInfo::writesVersion.
+    uint64_t mDescriptorSetWritesVersion GUARDED_BY(mMutex) = 0;
     std::unordered_map<VkDescriptorSetLayout, DescriptorSetLayoutInfo> mDescriptorSetLayoutInfo
         GUARDED_BY(mMutex);
     std::unordered_map<VkDescriptorUpdateTemplate, DescriptorUpdateTemplateInfo>
         mDescriptorUpdateTemplateInfo GUARDED_BY(mMutex);
     std::unordered_map<VkDeviceMemory, MemoryInfo> mMemoryInfo GUARDED_BY(mMutex);
-    std::unordered_map<VkFence, FenceInfo> mFenceInfo GUARDED_BY(mMutex);
+    std::unordered_map<VkFence, FenceInfo> mFenceInfo GUARDED_BY(mSyncObjectMutex);
     std::unordered_map<VkFramebuffer, FramebufferInfo> mFramebufferInfo GUARDED_BY(mMutex);
     std::unordered_map<VkImage, ImageInfo> mImageInfo GUARDED_BY(mMutex);
     std::unordered_map<VkImageView, ImageViewInfo> mImageViewInfo GUARDED_BY(mMutex);
     std::unordered_map<VkPipeline, PipelineInfo> mPipelineInfo GUARDED_BY(mMutex);
     std::unordered_map<VkPipelineCache, PipelineCacheInfo> mPipelineCacheInfo GUARDED_BY(mMutex);
     std::unordered_map<VkPipelineLayout, PipelineLayoutInfo> mPipelineLayoutInfo GUARDED_BY(mMutex);
-    std::unordered_map<VkQueue, QueueInfo> mQueueInfo GUARDED_BY(mMutex);
+    std::unordered_map<VkQueue, QueueInfo> mQueueInfo GUARDED_BY(mQueueInfoMutex);
     std::unordered_map<VkRenderPass, RenderPassInfo> mRenderPassInfo GUARDED_BY(mMutex);
     std::unordered_map<VkSampler, SamplerInfo> mSamplerInfo GUARDED_BY(mMutex);
-    std::unordered_map<VkSemaphore, SemaphoreInfo> mSemaphoreInfo GUARDED_BY(mMutex);
+    std::unordered_map<VkSemaphore, SemaphoreInfo> mSemaphoreInfo GUARDED_BY(mSyncObjectMutex);
     std::unordered_map<VkShaderModule, ShaderModuleInfo> mShaderModuleInfo GUARDED_BY(mMutex);
 
 #ifdef _WIN32
-    int mSemaphoreId = 1;
-    int genSemaphoreId() {
+    int mSemaphoreId GUARDED_BY(mSyncObjectMutex) = 1;
+    int genSemaphoreId() REQUIRES(mSyncObjectMutex) {
         if (mSemaphoreId == -1) {
             mSemaphoreId = 1;
         }
@@ -9003,7 +9750,7 @@ class VkDecoderGlobalState::Impl {
         ++mSemaphoreId;
         return res;
     }
-    std::unordered_map<int, VkSemaphore> mExternalSemaphoresById GUARDED_BY(mMutex);
+    std::unordered_map<int, VkSemaphore> mExternalSemaphoresById GUARDED_BY(mSyncObjectMutex);
 #endif
 
     VkDecoderSnapshot mSnapshot;
@@ -9021,6 +9768,17 @@ class VkDecoderGlobalState::Impl {
     std::optional<std::unordered_map<VkDevice, uint32_t>> mSnapshotLoadVkDeviceToVirtioCpuContextId
         GUARDED_BY(mMutex);
 
+    // Image and buffer contents of the last snapshot load which were not uploaded yet.
+    SnapshotPendingContents mPendingSnapshotContents GUARDED_BY(mMutex);
+    // Whether `mPendingSnapshotContents` is not empty, checked without the lock on every submit.
+    std::atomic<bool> mSnapshotContentsPending{false};
+    std::thread mSnapshotContentPrefetchThread;
+    std::atomic<bool> mSnapshotContentPrefetchStop{false};
+
+    // Persists the devices' host pipeline caches, nullptr if they are not kept on disk.
+    std::unique_ptr<HostPipelineCacheWriter> mPipelineCacheWriter =
+        HostPipelineCacheWriter::create();
+
     struct LinearImageCreateInfo {
         VkExtent3D extent;
         VkFormat format;
@@ -0,0 +1,133 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+#include "VkDecoderGlobalState.h"
+#include "aemu/base/BumpPool.h"
+#include "vk_util.h"
+#include "vulkan/testing/VulkanTestHelper.h"
+
+namespace gfxstream {
+namespace vk {
+namespace {
+
+using ::android::base::BumpPool;
+using testing::VulkanTestHelper;
+
+// What one render thread submits. Command pools are externally synchronized, so each thread
+// records into its own.
+struct ThreadResources {
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+};
+
+std::unique_ptr<VulkanTestHelper> sHelper;
+std::vector<ThreadResources> sThreadResources;
+
+void setUpThreads(const benchmark::State& state) {
+    sHelper = std::make_unique<VulkanTestHelper>();
+    sHelper->initialize();
+    auto& vk = sHelper->vk();
+    const VkDevice device = sHelper->device();
+    VkDecoderGlobalState* globalState = VkDecoderGlobalState::get();
+    BumpPool pool;
+
+    sThreadResources.resize(state.threads());
+    for (ThreadResources& resources : sThreadResources) {
+        const VkCommandPoolCreateInfo poolInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .queueFamilyIndex = sHelper->getQueueFamilyIndex(VK_QUEUE_GRAPHICS_BIT),
+        };
+        VK_CHECK(vk.vkCreateCommandPool(device, &poolInfo, nullptr, &resources.commandPool));
+
+        const VkCommandBufferAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = unbox_VkCommandPool(resources.commandPool),
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        VK_CHECK(vk.vkAllocateCommandBuffers(device, &allocInfo, &resources.commandBuffer));
+        const VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        };
+        VK_CHECK(vk.vkBeginCommandBuffer(resources.commandBuffer, &beginInfo));
+        VK_CHECK(vk.vkEndCommandBuffer(resources.commandBuffer));
+
+        const VkFenceCreateInfo fenceInfo = {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        };
+        VK_CHECK(globalState->on_vkCreateFence(&pool, nullptr, device, &fenceInfo, nullptr,
+                                               &resources.fence));
+        resources.fence = unbox_VkFence(resources.fence);
+    }
+}
+
+void tearDownThreads(const benchmark::State&) {
+    auto& vk = sHelper->vk();
+    const VkDevice device = sHelper->device();
+    BumpPool pool;
+    vk.vkDeviceWaitIdle(device);
+    for (const ThreadResources& resources : sThreadResources) {
+        VkDecoderGlobalState::get()->on_vkDestroyFence(&pool, nullptr, device, resources.fence,
+                                                       nullptr);
+        vk.vkDestroyCommandPool(device, resources.commandPool, nullptr);
+    }
+    sThreadResources.clear();
+    sHelper.reset();
+}
+
+// Each of the state.threads() render threads submits an empty command buffer to the same queue
+// and waits for its fence, which is the submission and wait path of VkDecoderGlobalState with as
+// little driver work as possible.
+void BM_QueueSubmit(benchmark::State& state) {
+    const ThreadResources& resources = sThreadResources[state.thread_index()];
+    const VkDevice device = sHelper->device();
+    const VkQueue queue = sHelper->graphicsQueue();
+    VkDecoderGlobalState* globalState = VkDecoderGlobalState::get();
+    BumpPool pool;
+
+    const VkCommandBuffer commandBuffer = unbox_VkCommandBuffer(resources.commandBuffer);
+    const VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBuffer,
+    };
+
+    for (auto _ : state) {
+        globalState->on_vkQueueSubmit(&pool, nullptr, queue, 1, &submitInfo, resources.fence);
+        globalState->on_vkWaitForFences(&pool, nullptr, device, 1, &resources.fence, VK_TRUE,
+                                        UINT64_MAX);
+        globalState->on_vkResetFences(&pool, nullptr, device, 1, &resources.fence);
+        pool.freeAll();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_QueueSubmit)
+    ->Setup(setUpThreads)
+    ->Teardown(tearDownThreads)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace vk
+}  // namespace gfxstream
+
+BENCHMARK_MAIN();
@@ -32,6 +32,7 @@
 #include "DebugUtilsHelper.h"
 #include "DeviceOpTracker.h"
 #include "Handle.h"
+#include "HostPipelineCache.h"
 #include "VkEmulatedPhysicalDeviceMemory.h"
 #include "VkEmulatedPhysicalDeviceQueue.h"
 #include "aemu/base/files/Stream.h"
@@ -214,6 +215,13 @@ struct DeviceInfo {
     std::unique_ptr<GpuDecompressionPipelineManager> decompPipelines = nullptr;
     DeviceOpTrackerPtr deviceOpTracker = nullptr;
     std::optional<uint32_t> virtioGpuContextId;
+    // Set if pipeline caches are persisted on the host.
+    std::unique_ptr<HostPipelineCache> hostPipelineCache;
+    bool supportsPipelineCreationFeedback = false;
+
+    // Ready once the asynchronous ColorBuffer flushes scheduled by vkQueueSubmit() no longer
+    // reference any objects owned by this device.
+    std::vector<DeviceOpWaitable> pendingColorBufferFlushes;
 
     // True if this is a compressed image that needs to be decompressed on the GPU (with our
     // compute shader)
@@ -236,6 +244,8 @@ struct QueueInfo {
     VkDevice device;
     uint32_t queueFamilyIndex;
     VkQueue boxed = nullptr;
+    // The owning device's tracker, so submissions don't need to look up the DeviceInfo.
+    DeviceOpTrackerPtr deviceOpTracker;
 
     // In order to create a virtual queue handle, we use an offset to the physical
     // queue handle value. This assumes the new generated virtual handle value will
@@ -270,6 +280,7 @@ struct ImageInfo {
 
 struct ImageViewInfo {
     VkDevice device;
+    VkImage image = VK_NULL_HANDLE;
     bool needEmulatedAlpha = false;
 
     // Color buffer, provided via vkAllocateMemory().
@@ -389,6 +400,9 @@ struct DescriptorSetInfo {
     VkDescriptorSetLayout unboxedLayout = 0;
     std::vector<std::vector<DescriptorWrite>> allWrites;
     std::vector<VkDescriptorSetLayoutBinding> bindings;
+    // Changes whenever `allWrites` changes. Versions are unique across all descriptor sets, so
+    // a set that was freed and reallocated with the same handle gets a new version too.
+    uint64_t writesVersion = 0;
 };
 
 struct ShaderModuleInfo {
@@ -414,6 +428,7 @@ struct RenderPassInfo {
 struct FramebufferInfo {
     VkDevice device;
     std::vector<HandleType> attachedColorBuffers;
+    std::vector<VkImage> attachedImages;
 };
 
 typedef std::function<void()> PreprocessFunc;
@@ -438,6 +453,27 @@ struct CommandBufferInfo {
     std::unordered_map<HandleType, VkImageLayout> cbLayouts;
     std::unordered_map<VkImage, VkImageLayout> imageLayouts;
 
+    // The ColorBuffers written into the descriptor sets in `allDescriptorSets`, computed at
+    // vkEndCommandBuffer so that submitting a pre-recorded command buffer doesn't have to walk
+    // every descriptor again. Still valid as long as the `writesVersion` of every bound set
+    // matches `descriptorSetVersions`.
+    struct DescriptorColorBuffer {
+        HandleType colorBuffer;
+        std::vector<std::weak_ptr<bool>> alives;
+    };
+    std::vector<DescriptorColorBuffer> descriptorColorBuffers;
+    std::vector<std::pair<VkDescriptorSet, uint64_t>> descriptorSetVersions;
+    bool descriptorColorBuffersComputed = false;
+
+    // Images and buffers used by the recorded commands other than through descriptor sets or
+    // image barriers. Only tracked while a snapshot load has contents that were not uploaded
+    // yet, so that submitting the command buffer uploads only what it uses.
+    std::unordered_set<VkImage> snapshotContentImages;
+    std::unordered_set<VkBuffer> snapshotContentBuffers;
+    // Set if some recorded command may use images or buffers that are not tracked at all, in
+    // which case submitting the command buffer uploads every pending content of the device.
+    bool snapshotContentUsesUntracked = false;
+
     void reset() {
         subCmds.clear();
         computePipeline = VK_NULL_HANDLE;
@@ -450,6 +486,12 @@ struct CommandBufferInfo {
         releasedColorBuffers.clear();
         cbLayouts.clear();
         imageLayouts.clear();
+        descriptorColorBuffers.clear();
+        descriptorSetVersions.clear();
+        descriptorColorBuffersComputed = false;
+        snapshotContentImages.clear();
+        snapshotContentBuffers.clear();
+        snapshotContentUsesUntracked = false;
     }
 };
 
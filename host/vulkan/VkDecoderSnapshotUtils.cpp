@@ -14,7 +14,12 @@
 
 #include "vulkan/VkDecoderSnapshotUtils.h"
 
+#include <string.h>
+
+#include <numeric>
+
 #include "VkCommonOperations.h"
+#include "host-common/logging.h"
 
 namespace gfxstream {
 namespace vk {
@@ -135,6 +140,69 @@ VkExtent3D getMipmapExtent(VkExtent3D baseExtent, uint32_t mipLevel) {
     };
 }
 
+// Size of each staging slot. Bigger images and buffers get a slot of their own size.
+constexpr VkDeviceSize kStagingSlotSize = 32 * 1024 * 1024;
+
+constexpr uint64_t kFenceTimeoutNs = 3000000000L;
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Buffer offsets of image copies must be a multiple of both the texel size and 4.
+VkDeviceSize getImageCopyAlignment(VkFormat format) {
+    return std::lcm<VkDeviceSize>(bytes_per_pixel(format), 4);
+}
+
+VkDeviceSize getSubresourceSize(const VkImageCreateInfo& imageCreateInfo, uint32_t mipLevel) {
+    const VkExtent3D mipmapExtent = getMipmapExtent(imageCreateInfo.extent, mipLevel);
+    return static_cast<VkDeviceSize>(mipmapExtent.width) * mipmapExtent.height *
+           mipmapExtent.depth * bytes_per_pixel(imageCreateInfo.format);
+}
+
+// Returns the staging memory needed for all the mip levels and array layers of an image.
+VkDeviceSize getImageStagingSize(const VkImageCreateInfo& imageCreateInfo) {
+    const VkDeviceSize alignment = getImageCopyAlignment(imageCreateInfo.format);
+    VkDeviceSize size = 0;
+    for (uint32_t mipLevel = 0; mipLevel < imageCreateInfo.mipLevels; mipLevel++) {
+        for (uint32_t arrayLayer = 0; arrayLayer < imageCreateInfo.arrayLayers; arrayLayer++) {
+            size = alignUp(size, alignment) + getSubresourceSize(imageCreateInfo, mipLevel);
+        }
+    }
+    return size;
+}
+
+// TODO(b/323059453): separate stencil and depth images properly
+VkImageAspectFlags getSnapshotAspects(const VkImageCreateInfo& imageCreateInfo) {
+    return imageCreateInfo.usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+               ? VK_IMAGE_ASPECT_STENCIL_BIT | VK_IMAGE_ASPECT_DEPTH_BIT
+               : VK_IMAGE_ASPECT_COLOR_BIT;
+}
+
+void recordImageLayoutTransition(VulkanDispatch* dispatch, VkCommandBuffer commandBuffer,
+                                 VkImage image, VkImageAspectFlags aspects,
+                                 VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+                                 VkImageLayout oldLayout, VkImageLayout newLayout) {
+    VkImageMemoryBarrier imgMemoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = srcAccessMask,
+        .dstAccessMask = dstAccessMask,
+        .oldLayout = oldLayout,
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = VkImageSubresourceRange{.aspectMask = aspects,
+                                                    .baseMipLevel = 0,
+                                                    .levelCount = VK_REMAINING_MIP_LEVELS,
+                                                    .baseArrayLayer = 0,
+                                                    .layerCount = VK_REMAINING_ARRAY_LAYERS}};
+    dispatch->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                   VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr,
+                                   1, &imgMemoryBarrier);
+}
+
 }  // namespace
 
 #define _RUN_AND_CHECK(command)                                                             \
@@ -145,565 +213,598 @@ VkExtent3D getMipmapExtent(VkExtent3D baseExtent, uint32_t mipLevel) {
                 << __LINE__ << ")";                                                         \
     }
 
-void saveImageContent(android::base::Stream* stream, StateBlock* stateBlock, VkImage image,
-                      const ImageInfo* imageInfo) {
-    if (imageInfo->layout == VK_IMAGE_LAYOUT_UNDEFINED) {
-        return;
-    }
-    // TODO(b/333936705): snapshot multi-sample images
-    if (imageInfo->imageCreateInfoShallow.samples != VK_SAMPLE_COUNT_1_BIT) {
-        return;
-    }
-    VulkanDispatch* dispatch = stateBlock->deviceDispatch;
-    const VkImageCreateInfo& imageCreateInfo = imageInfo->imageCreateInfoShallow;
-    VkCommandBufferAllocateInfo allocInfo{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = stateBlock->commandPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1,
-    };
-    VkCommandBuffer commandBuffer;
-    _RUN_AND_CHECK(dispatch->vkAllocateCommandBuffers(stateBlock->device, &allocInfo,
-                                                      &commandBuffer) != VK_SUCCESS);
-    VkFenceCreateInfo fenceCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-    };
-    VkFence fence;
-    _RUN_AND_CHECK(dispatch->vkCreateFence(stateBlock->device, &fenceCreateInfo, nullptr, &fence));
-    VkBufferCreateInfo bufferCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size = static_cast<VkDeviceSize>(
-            imageCreateInfo.extent.width * imageCreateInfo.extent.height *
-            imageCreateInfo.extent.depth * bytes_per_pixel(imageCreateInfo.format)),
-        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-    };
-    VkBuffer readbackBuffer;
-    _RUN_AND_CHECK(
-        dispatch->vkCreateBuffer(stateBlock->device, &bufferCreateInfo, nullptr, &readbackBuffer));
+SnapshotContentTransfer::SnapshotContentTransfer(const char* operation,
+                                                 VkBufferUsageFlags stagingUsage)
+    : mOperation(operation), mStagingUsage(stagingUsage) {}
 
-    VkMemoryRequirements readbackBufferMemoryRequirements{};
-    dispatch->vkGetBufferMemoryRequirements(stateBlock->device, readbackBuffer,
-                                            &readbackBufferMemoryRequirements);
+void SnapshotContentTransfer::finish() {
+    flush();
+    destroySlots();
+    mStateBlock = nullptr;
 
-    const auto readbackBufferMemoryType =
-        GetMemoryType(*stateBlock->physicalDeviceInfo, readbackBufferMemoryRequirements,
-                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    // Staging memory
-    // TODO(b/323064243): reuse staging memory
-    VkMemoryAllocateInfo readbackBufferMemoryAllocateInfo = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = readbackBufferMemoryRequirements.size,
-        .memoryTypeIndex = readbackBufferMemoryType,
-    };
-    VkDeviceMemory readbackMemory;
-    _RUN_AND_CHECK(dispatch->vkAllocateMemory(stateBlock->device, &readbackBufferMemoryAllocateInfo,
-                                              nullptr, &readbackMemory));
-    _RUN_AND_CHECK(
-        dispatch->vkBindBufferMemory(stateBlock->device, readbackBuffer, readbackMemory, 0));
+    const auto elapsed = std::chrono::steady_clock::now() - mStartTime;
+    INFO("Vulkan snapshot %s: %.2f MB of image and buffer contents in %u submissions, %lld ms.",
+         mOperation, mTransferredBytes / 1048576.0, mSubmitCount,
+         static_cast<long long>(
+             std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()));
+}
 
-    void* mapped = nullptr;
-    _RUN_AND_CHECK(dispatch->vkMapMemory(stateBlock->device, readbackMemory, 0, VK_WHOLE_SIZE,
-                                         VkMemoryMapFlags{}, &mapped));
+VkDeviceSize SnapshotContentTransfer::reserve(StateBlock* stateBlock, VkDeviceSize size,
+                                              VkDeviceSize alignment) {
+    if (stateBlock->device != (mStateBlock ? mStateBlock->device : VK_NULL_HANDLE)) {
+        // The staging resources belong to the previous device.
+        flush();
+        destroySlots();
+    }
+    mStateBlock = stateBlock;
 
-    for (uint32_t mipLevel = 0; mipLevel < imageInfo->imageCreateInfoShallow.mipLevels;
-         mipLevel++) {
-        for (uint32_t arrayLayer = 0; arrayLayer < imageInfo->imageCreateInfoShallow.arrayLayers;
-             arrayLayer++) {
-            // TODO(b/323064243): reuse command buffers
-            VkCommandBufferBeginInfo beginInfo{
-                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            };
-            if (dispatch->vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-                GFXSTREAM_ABORT(emugl::FatalError(emugl::ABORT_REASON_OTHER))
-                    << "Failed to start command buffer on snapshot save";
-            }
+    VkDeviceSize offset = alignUp(currentSlot().used, alignment);
+    if (currentSlot().used > 0 && offset + size > currentSlot().capacity) {
+        switchSlot();
+        offset = 0;
+    }
 
-            // TODO(b/323059453): separate stencil and depth images properly
-            VkExtent3D mipmapExtent = getMipmapExtent(imageCreateInfo.extent, mipLevel);
-            VkImageAspectFlags aspects =
-                imageCreateInfo.usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
-                    ? VK_IMAGE_ASPECT_STENCIL_BIT | VK_IMAGE_ASPECT_DEPTH_BIT
-                    : VK_IMAGE_ASPECT_COLOR_BIT;
-            VkImageLayout layoutBeforeSave = imageInfo->layout;
-            VkImageMemoryBarrier imgMemoryBarrier = {
-                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-                .pNext = nullptr,
-                .srcAccessMask = static_cast<VkAccessFlags>(~VK_ACCESS_NONE_KHR),
-                .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-                .oldLayout = layoutBeforeSave,
-                .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                .image = image,
-                .subresourceRange = VkImageSubresourceRange{.aspectMask = aspects,
-                                                            .baseMipLevel = mipLevel,
-                                                            .levelCount = 1,
-                                                            .baseArrayLayer = arrayLayer,
-                                                            .layerCount = 1}};
-
-            dispatch->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                                           VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0,
-                                           nullptr, 1, &imgMemoryBarrier);
-            VkBufferImageCopy region{
-                .bufferOffset = 0,
-                .bufferRowLength = 0,
-                .bufferImageHeight = 0,
-                .imageSubresource = VkImageSubresourceLayers{.aspectMask = aspects,
-                                                             .mipLevel = mipLevel,
-                                                             .baseArrayLayer = arrayLayer,
-                                                             .layerCount = 1},
-                .imageOffset =
-                    VkOffset3D{
-                        .x = 0,
-                        .y = 0,
-                        .z = 0,
-                    },
-                .imageExtent = mipmapExtent,
-            };
-            dispatch->vkCmdCopyImageToBuffer(commandBuffer, image,
-                                             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer,
-                                             1, &region);
-
-            // Cannot really translate it back to VK_IMAGE_LAYOUT_PREINITIALIZED
-            if (layoutBeforeSave != VK_IMAGE_LAYOUT_PREINITIALIZED) {
-                imgMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-                imgMemoryBarrier.newLayout = layoutBeforeSave;
-                imgMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-                imgMemoryBarrier.dstAccessMask = ~VK_ACCESS_NONE_KHR;
-                dispatch->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                                               VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0,
-                                               nullptr, 1, &imgMemoryBarrier);
-            }
-            _RUN_AND_CHECK(dispatch->vkEndCommandBuffer(commandBuffer));
-
-            // Execute the command to copy image
-            VkSubmitInfo submitInfo = {
-                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-                .commandBufferCount = 1,
-                .pCommandBuffers = &commandBuffer,
-            };
-            _RUN_AND_CHECK(dispatch->vkQueueSubmit(stateBlock->queue, 1, &submitInfo, fence));
-            _RUN_AND_CHECK(
-                dispatch->vkWaitForFences(stateBlock->device, 1, &fence, VK_TRUE, 3000000000L));
-            _RUN_AND_CHECK(dispatch->vkResetFences(stateBlock->device, 1, &fence));
-            size_t bytes = mipmapExtent.width * mipmapExtent.height * mipmapExtent.depth *
-                           bytes_per_pixel(imageCreateInfo.format);
-            stream->putBe64(bytes);
-            stream->write(mapped, bytes);
+    Slot& slot = currentSlot();
+    if (slot.buffer == VK_NULL_HANDLE || slot.capacity < size) {
+        allocateStaging(slot, std::max(size, kStagingSlotSize));
+    }
+    if (!slot.recording) {
+        VkCommandBufferBeginInfo beginInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        };
+        if (mStateBlock->deviceDispatch->vkBeginCommandBuffer(slot.commandBuffer, &beginInfo) !=
+            VK_SUCCESS) {
+            GFXSTREAM_ABORT(emugl::FatalError(emugl::ABORT_REASON_OTHER))
+                << "Failed to start command buffer on snapshot " << mOperation;
         }
+        slot.recording = true;
     }
-    dispatch->vkDestroyFence(stateBlock->device, fence, nullptr);
-    dispatch->vkUnmapMemory(stateBlock->device, readbackMemory);
-    dispatch->vkDestroyBuffer(stateBlock->device, readbackBuffer, nullptr);
-    dispatch->vkFreeMemory(stateBlock->device, readbackMemory, nullptr);
-    dispatch->vkFreeCommandBuffers(stateBlock->device, stateBlock->commandPool, 1, &commandBuffer);
+    slot.used = offset + size;
+    mTransferredBytes += size;
+    return offset;
 }
 
-void loadImageContent(android::base::Stream* stream, StateBlock* stateBlock, VkImage image,
-                      const ImageInfo* imageInfo) {
-    if (imageInfo->layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+void SnapshotContentTransfer::flush() {
+    submit(currentSlot());
+    // The other slot was submitted first.
+    for (uint32_t index : {1 - mCurrent, mCurrent}) {
+        wait(mSlots[index]);
+        onSlotDone(index, mSlots[index]);
+    }
+}
+
+void SnapshotContentTransfer::switchSlot() {
+    submit(currentSlot());
+    mCurrent = 1 - mCurrent;
+    wait(currentSlot());
+    onSlotDone(mCurrent, currentSlot());
+}
+
+void SnapshotContentTransfer::submit(Slot& slot) {
+    if (!slot.recording) {
         return;
     }
-    VulkanDispatch* dispatch = stateBlock->deviceDispatch;
-    const VkImageCreateInfo& imageCreateInfo = imageInfo->imageCreateInfoShallow;
-    VkCommandBufferAllocateInfo allocInfo{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = stateBlock->commandPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+    VulkanDispatch* dispatch = mStateBlock->deviceDispatch;
+    onSlotSubmit(slot);
+    _RUN_AND_CHECK(dispatch->vkEndCommandBuffer(slot.commandBuffer));
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
         .commandBufferCount = 1,
+        .pCommandBuffers = &slot.commandBuffer,
     };
-    VkCommandBuffer commandBuffer;
-    _RUN_AND_CHECK(dispatch->vkAllocateCommandBuffers(stateBlock->device, &allocInfo,
-                                                      &commandBuffer) != VK_SUCCESS);
-    VkFenceCreateInfo fenceCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-    };
-    VkFence fence;
-    _RUN_AND_CHECK(dispatch->vkCreateFence(stateBlock->device, &fenceCreateInfo, nullptr, &fence));
-    if (imageInfo->imageCreateInfoShallow.samples != VK_SAMPLE_COUNT_1_BIT) {
-        // Set the layout and quit
-        // TODO: resolve and save image content
-        VkImageAspectFlags aspects =
-            imageCreateInfo.usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
-                ? VK_IMAGE_ASPECT_STENCIL_BIT | VK_IMAGE_ASPECT_DEPTH_BIT
-                : VK_IMAGE_ASPECT_COLOR_BIT;
-        VkImageMemoryBarrier imgMemoryBarrier = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            .pNext = nullptr,
-            .srcAccessMask = static_cast<VkAccessFlags>(~VK_ACCESS_NONE_KHR),
-            .dstAccessMask = static_cast<VkAccessFlags>(~VK_ACCESS_NONE_KHR),
-            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .newLayout = imageInfo->layout,
-            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-            .image = image,
-            .subresourceRange = VkImageSubresourceRange{.aspectMask = aspects,
-                                                        .baseMipLevel = 0,
-                                                        .levelCount = VK_REMAINING_MIP_LEVELS,
-                                                        .baseArrayLayer = 0,
-                                                        .layerCount = VK_REMAINING_ARRAY_LAYERS}};
-        VkCommandBufferBeginInfo beginInfo{
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        };
-        _RUN_AND_CHECK(dispatch->vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS);
+    // TODO(b/294277842): make sure the queue is empty before using.
+    _RUN_AND_CHECK(dispatch->vkQueueSubmit(mStateBlock->queue, 1, &submitInfo, slot.fence));
+    slot.recording = false;
+    slot.submitted = true;
+    mSubmitCount++;
+}
 
-        dispatch->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                                       VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0,
-                                       nullptr, 1, &imgMemoryBarrier);
+void SnapshotContentTransfer::wait(Slot& slot) {
+    if (slot.submitted) {
+        VulkanDispatch* dispatch = mStateBlock->deviceDispatch;
+        _RUN_AND_CHECK(dispatch->vkWaitForFences(mStateBlock->device, 1, &slot.fence, VK_TRUE,
+                                                 kFenceTimeoutNs));
+        _RUN_AND_CHECK(dispatch->vkResetFences(mStateBlock->device, 1, &slot.fence));
+        slot.submitted = false;
+    }
+    slot.used = 0;
+}
 
-        _RUN_AND_CHECK(dispatch->vkEndCommandBuffer(commandBuffer));
+void SnapshotContentTransfer::allocateStaging(Slot& slot, VkDeviceSize size) {
+    VulkanDispatch* dispatch = mStateBlock->deviceDispatch;
+    const VkDevice device = mStateBlock->device;
 
-        // Execute the command to copy image
-        VkSubmitInfo submitInfo = {
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+    if (slot.commandBuffer == VK_NULL_HANDLE) {
+        VkCommandBufferAllocateInfo allocInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = mStateBlock->commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
             .commandBufferCount = 1,
-            .pCommandBuffers = &commandBuffer,
         };
-        _RUN_AND_CHECK(dispatch->vkQueueSubmit(stateBlock->queue, 1, &submitInfo, fence));
-        _RUN_AND_CHECK(
-            dispatch->vkWaitForFences(stateBlock->device, 1, &fence, VK_TRUE, 3000000000L));
-        dispatch->vkDestroyFence(stateBlock->device, fence, nullptr);
-        dispatch->vkFreeCommandBuffers(stateBlock->device, stateBlock->commandPool, 1,
-                                       &commandBuffer);
-        return;
+        _RUN_AND_CHECK(dispatch->vkAllocateCommandBuffers(device, &allocInfo,
+                                                          &slot.commandBuffer) != VK_SUCCESS);
+        VkFenceCreateInfo fenceCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        };
+        _RUN_AND_CHECK(dispatch->vkCreateFence(device, &fenceCreateInfo, nullptr, &slot.fence));
+    }
+
+    if (slot.buffer != VK_NULL_HANDLE) {
+        dispatch->vkUnmapMemory(device, slot.memory);
+        dispatch->vkDestroyBuffer(device, slot.buffer, nullptr);
+        dispatch->vkFreeMemory(device, slot.memory, nullptr);
     }
+
     VkBufferCreateInfo bufferCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size = static_cast<VkDeviceSize>(
-            imageCreateInfo.extent.width * imageCreateInfo.extent.height *
-            imageCreateInfo.extent.depth * bytes_per_pixel(imageCreateInfo.format)),
-        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .size = size,
+        .usage = mStagingUsage,
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
     };
-    VkBuffer stagingBuffer;
-    _RUN_AND_CHECK(
-        dispatch->vkCreateBuffer(stateBlock->device, &bufferCreateInfo, nullptr, &stagingBuffer));
+    _RUN_AND_CHECK(dispatch->vkCreateBuffer(device, &bufferCreateInfo, nullptr, &slot.buffer));
 
-    VkMemoryRequirements stagingBufferMemoryRequirements{};
-    dispatch->vkGetBufferMemoryRequirements(stateBlock->device, stagingBuffer,
-                                            &stagingBufferMemoryRequirements);
-
-    const auto stagingBufferMemoryType =
-        GetMemoryType(*stateBlock->physicalDeviceInfo, stagingBufferMemoryRequirements,
+    VkMemoryRequirements memoryRequirements{};
+    dispatch->vkGetBufferMemoryRequirements(device, slot.buffer, &memoryRequirements);
+    const auto memoryType =
+        GetMemoryType(*mStateBlock->physicalDeviceInfo, memoryRequirements,
                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    // Staging memory
-    // TODO(b/323064243): reuse staging memory
-    VkMemoryAllocateInfo stagingBufferMemoryAllocateInfo = {
+    VkMemoryAllocateInfo memoryAllocateInfo = {
         .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = stagingBufferMemoryRequirements.size,
-        .memoryTypeIndex = stagingBufferMemoryType,
+        .allocationSize = memoryRequirements.size,
+        .memoryTypeIndex = memoryType,
     };
-    VkDeviceMemory stagingMemory;
-    _RUN_AND_CHECK(dispatch->vkAllocateMemory(stateBlock->device, &stagingBufferMemoryAllocateInfo,
-                                              nullptr, &stagingMemory));
     _RUN_AND_CHECK(
-        dispatch->vkBindBufferMemory(stateBlock->device, stagingBuffer, stagingMemory, 0));
+        dispatch->vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &slot.memory));
+    _RUN_AND_CHECK(dispatch->vkBindBufferMemory(device, slot.buffer, slot.memory, 0));
 
     void* mapped = nullptr;
-    _RUN_AND_CHECK(dispatch->vkMapMemory(stateBlock->device, stagingMemory, 0, VK_WHOLE_SIZE,
+    _RUN_AND_CHECK(dispatch->vkMapMemory(device, slot.memory, 0, VK_WHOLE_SIZE,
                                          VkMemoryMapFlags{}, &mapped));
+    slot.mapped = static_cast<uint8_t*>(mapped);
+    slot.capacity = size;
+}
 
-    for (uint32_t mipLevel = 0; mipLevel < imageInfo->imageCreateInfoShallow.mipLevels;
-         mipLevel++) {
-        for (uint32_t arrayLayer = 0; arrayLayer < imageInfo->imageCreateInfoShallow.arrayLayers;
-             arrayLayer++) {
-            // TODO(b/323064243): reuse command buffers
-            VkCommandBufferBeginInfo beginInfo{
-                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            };
-            if (dispatch->vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-                GFXSTREAM_ABORT(emugl::FatalError(emugl::ABORT_REASON_OTHER))
-                    << "Failed to start command buffer on snapshot save";
-            }
+void SnapshotContentTransfer::destroySlots() {
+    if (!mStateBlock) {
+        return;
+    }
+    VulkanDispatch* dispatch = mStateBlock->deviceDispatch;
+    const VkDevice device = mStateBlock->device;
+    for (Slot& slot : mSlots) {
+        if (slot.buffer != VK_NULL_HANDLE) {
+            dispatch->vkUnmapMemory(device, slot.memory);
+            dispatch->vkDestroyBuffer(device, slot.buffer, nullptr);
+            dispatch->vkFreeMemory(device, slot.memory, nullptr);
+        }
+        if (slot.commandBuffer != VK_NULL_HANDLE) {
+            dispatch->vkDestroyFence(device, slot.fence, nullptr);
+            dispatch->vkFreeCommandBuffers(device, mStateBlock->commandPool, 1,
+                                           &slot.commandBuffer);
+        }
+        slot = Slot{};
+    }
+    mCurrent = 0;
+}
+
+SnapshotContentSaver::SnapshotContentSaver(android::base::Stream* stream)
+    : SnapshotContentTransfer("save", VK_BUFFER_USAGE_TRANSFER_DST_BIT), mStream(stream) {}
+
+void SnapshotContentSaver::putBe32(uint32_t value) {
+    mPendingWrites[currentSlotIndex()].push_back(PendingWrite{
+        .isBe32 = true,
+        .value = value,
+    });
+}
 
-            VkExtent3D mipmapExtent = getMipmapExtent(imageCreateInfo.extent, mipLevel);
-            size_t bytes = stream->getBe64();
-            stream->read(mapped, bytes);
-
-            VkImageAspectFlags aspects =
-                imageCreateInfo.usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
-                    ? VK_IMAGE_ASPECT_STENCIL_BIT | VK_IMAGE_ASPECT_DEPTH_BIT
-                    : VK_IMAGE_ASPECT_COLOR_BIT;
-            VkImageMemoryBarrier imgMemoryBarrier = {
-                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-                .pNext = nullptr,
-                .srcAccessMask = static_cast<VkAccessFlags>(~VK_ACCESS_NONE_KHR),
-                .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                .image = image,
-                .subresourceRange = VkImageSubresourceRange{.aspectMask = aspects,
-                                                            .baseMipLevel = mipLevel,
-                                                            .levelCount = 1,
-                                                            .baseArrayLayer = arrayLayer,
-                                                            .layerCount = 1}};
-
-            dispatch->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                                           VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0,
-                                           nullptr, 1, &imgMemoryBarrier);
-
-            VkBufferImageCopy region{
-                .bufferOffset = 0,
+void SnapshotContentSaver::saveImage(StateBlock* stateBlock, VkImage image,
+                                     const ImageInfo* imageInfo) {
+    if (imageInfo->layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+        return;
+    }
+    // TODO(b/333936705): snapshot multi-sample images
+    if (imageInfo->imageCreateInfoShallow.samples != VK_SAMPLE_COUNT_1_BIT) {
+        return;
+    }
+    const VkImageCreateInfo& imageCreateInfo = imageInfo->imageCreateInfoShallow;
+    const VkDeviceSize alignment = getImageCopyAlignment(imageCreateInfo.format);
+    VkDeviceSize offset =
+        reserve(stateBlock, getImageStagingSize(imageCreateInfo), alignment);
+    VulkanDispatch* dispatch = stateBlock->deviceDispatch;
+    Slot& slot = currentSlot();
+    std::vector<PendingWrite>& pendingWrites = mPendingWrites[currentSlotIndex()];
+
+    const VkImageAspectFlags aspects = getSnapshotAspects(imageCreateInfo);
+    const VkImageLayout layoutBeforeSave = imageInfo->layout;
+    recordImageLayoutTransition(dispatch, slot.commandBuffer, image, aspects,
+                                static_cast<VkAccessFlags>(~VK_ACCESS_NONE_KHR),
+                                VK_ACCESS_TRANSFER_READ_BIT, layoutBeforeSave,
+                                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    std::vector<VkBufferImageCopy> regions;
+    for (uint32_t mipLevel = 0; mipLevel < imageCreateInfo.mipLevels; mipLevel++) {
+        for (uint32_t arrayLayer = 0; arrayLayer < imageCreateInfo.arrayLayers; arrayLayer++) {
+            offset = alignUp(offset, alignment);
+            const VkDeviceSize size = getSubresourceSize(imageCreateInfo, mipLevel);
+            regions.push_back(VkBufferImageCopy{
+                .bufferOffset = offset,
                 .bufferRowLength = 0,
                 .bufferImageHeight = 0,
                 .imageSubresource = VkImageSubresourceLayers{.aspectMask = aspects,
                                                              .mipLevel = mipLevel,
                                                              .baseArrayLayer = arrayLayer,
                                                              .layerCount = 1},
-                .imageOffset =
-                    VkOffset3D{
-                        .x = 0,
-                        .y = 0,
-                        .z = 0,
-                    },
-                .imageExtent = mipmapExtent,
-            };
-            dispatch->vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image,
-                                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-            // Cannot really translate it back to VK_IMAGE_LAYOUT_PREINITIALIZED
-            if (imageInfo->layout != VK_IMAGE_LAYOUT_PREINITIALIZED) {
-                imgMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                imgMemoryBarrier.newLayout = imageInfo->layout;
-                imgMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                imgMemoryBarrier.dstAccessMask = ~VK_ACCESS_NONE_KHR;
-                dispatch->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                                               VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0,
-                                               nullptr, 1, &imgMemoryBarrier);
-            }
-            _RUN_AND_CHECK(dispatch->vkEndCommandBuffer(commandBuffer));
-
-            // Execute the command to copy image
-            VkSubmitInfo submitInfo = {
-                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-                .commandBufferCount = 1,
-                .pCommandBuffers = &commandBuffer,
-            };
-            _RUN_AND_CHECK(dispatch->vkQueueSubmit(stateBlock->queue, 1, &submitInfo, fence));
-            _RUN_AND_CHECK(
-                dispatch->vkWaitForFences(stateBlock->device, 1, &fence, VK_TRUE, 3000000000L));
-            _RUN_AND_CHECK(dispatch->vkResetFences(stateBlock->device, 1, &fence));
+                .imageOffset = VkOffset3D{.x = 0, .y = 0, .z = 0},
+                .imageExtent = getMipmapExtent(imageCreateInfo.extent, mipLevel),
+            });
+            pendingWrites.push_back(PendingWrite{
+                .isBe32 = false,
+                .offset = offset,
+                .size = size,
+            });
+            offset += size;
         }
     }
-    dispatch->vkDestroyFence(stateBlock->device, fence, nullptr);
-    dispatch->vkUnmapMemory(stateBlock->device, stagingMemory);
-    dispatch->vkDestroyBuffer(stateBlock->device, stagingBuffer, nullptr);
-    dispatch->vkFreeMemory(stateBlock->device, stagingMemory, nullptr);
-    dispatch->vkFreeCommandBuffers(stateBlock->device, stateBlock->commandPool, 1, &commandBuffer);
+    dispatch->vkCmdCopyImageToBuffer(slot.commandBuffer, image,
+                                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer,
+                                     static_cast<uint32_t>(regions.size()), regions.data());
+
+    // Cannot really translate it back to VK_IMAGE_LAYOUT_PREINITIALIZED
+    if (layoutBeforeSave != VK_IMAGE_LAYOUT_PREINITIALIZED) {
+        recordImageLayoutTransition(dispatch, slot.commandBuffer, image, aspects,
+                                    VK_ACCESS_TRANSFER_READ_BIT,
+                                    static_cast<VkAccessFlags>(~VK_ACCESS_NONE_KHR),
+                                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layoutBeforeSave);
+    }
 }
 
-void saveBufferContent(android::base::Stream* stream, StateBlock* stateBlock, VkBuffer buffer,
-                       const BufferInfo* bufferInfo) {
+void SnapshotContentSaver::saveBuffer(StateBlock* stateBlock, VkBuffer buffer,
+                                      const BufferInfo* bufferInfo) {
     VkBufferUsageFlags requiredUsages =
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
     if ((bufferInfo->usage & requiredUsages) != requiredUsages) {
         return;
     }
-    VulkanDispatch* dispatch = stateBlock->deviceDispatch;
-    VkCommandBufferAllocateInfo allocInfo{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = stateBlock->commandPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1,
-    };
-    VkCommandBuffer commandBuffer;
-    _RUN_AND_CHECK(dispatch->vkAllocateCommandBuffers(stateBlock->device, &allocInfo,
-                                                      &commandBuffer) != VK_SUCCESS);
-    VkFenceCreateInfo fenceCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-    };
-    VkFence fence;
-    _RUN_AND_CHECK(dispatch->vkCreateFence(stateBlock->device, &fenceCreateInfo, nullptr, &fence));
-    VkBufferCreateInfo bufferCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size = static_cast<VkDeviceSize>(bufferInfo->size),
-        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-    };
-    VkBuffer readbackBuffer;
-    _RUN_AND_CHECK(
-        dispatch->vkCreateBuffer(stateBlock->device, &bufferCreateInfo, nullptr, &readbackBuffer));
-
-    VkMemoryRequirements readbackBufferMemoryRequirements{};
-    dispatch->vkGetBufferMemoryRequirements(stateBlock->device, readbackBuffer,
-                                            &readbackBufferMemoryRequirements);
-
-    const auto readbackBufferMemoryType =
-        GetMemoryType(*stateBlock->physicalDeviceInfo, readbackBufferMemoryRequirements,
-                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    // Staging memory
-    // TODO(b/323064243): reuse staging memory
-    VkMemoryAllocateInfo readbackBufferMemoryAllocateInfo = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = readbackBufferMemoryRequirements.size,
-        .memoryTypeIndex = readbackBufferMemoryType,
-    };
-    VkDeviceMemory readbackMemory;
-    _RUN_AND_CHECK(dispatch->vkAllocateMemory(stateBlock->device, &readbackBufferMemoryAllocateInfo,
-                                              nullptr, &readbackMemory));
-    _RUN_AND_CHECK(
-        dispatch->vkBindBufferMemory(stateBlock->device, readbackBuffer, readbackMemory, 0));
-
-    void* mapped = nullptr;
-    _RUN_AND_CHECK(dispatch->vkMapMemory(stateBlock->device, readbackMemory, 0, VK_WHOLE_SIZE,
-                                         VkMemoryMapFlags{}, &mapped));
+    const VkDeviceSize offset = reserve(stateBlock, bufferInfo->size, 1);
+    Slot& slot = currentSlot();
 
     VkBufferCopy bufferCopy = {
         .srcOffset = 0,
-        .dstOffset = 0,
+        .dstOffset = offset,
         .size = bufferInfo->size,
     };
+    stateBlock->deviceDispatch->vkCmdCopyBuffer(slot.commandBuffer, buffer, slot.buffer, 1,
+                                                &bufferCopy);
+    mPendingWrites[currentSlotIndex()].push_back(PendingWrite{
+        .isBe32 = false,
+        .offset = offset,
+        .size = bufferInfo->size,
+    });
+}
 
-    VkCommandBufferBeginInfo beginInfo{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-    };
-    if (dispatch->vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-        GFXSTREAM_ABORT(emugl::FatalError(emugl::ABORT_REASON_OTHER))
-            << "Failed to start command buffer on snapshot save";
-    }
-    dispatch->vkCmdCopyBuffer(commandBuffer, buffer, readbackBuffer, 1, &bufferCopy);
+void SnapshotContentSaver::onSlotSubmit(Slot& slot) {
     VkBufferMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
                                   .pNext = nullptr,
                                   .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
                                   .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
-                                  .srcQueueFamilyIndex = 0xFFFFFFFF,
-                                  .dstQueueFamilyIndex = 0xFFFFFFFF,
-                                  .buffer = readbackBuffer,
+                                  .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                  .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                  .buffer = slot.buffer,
                                   .offset = 0,
-                                  .size = bufferInfo->size};
-    dispatch->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                   VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0,
-                                   nullptr);
+                                  .size = VK_WHOLE_SIZE};
+    stateBlock()->deviceDispatch->vkCmdPipelineBarrier(
+        slot.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0,
+        nullptr, 1, &barrier, 0, nullptr);
+}
 
-    // Execute the command to copy buffer
-    VkSubmitInfo submitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &commandBuffer,
+void SnapshotContentSaver::onSlotDone(uint32_t slotIndex, Slot& slot) {
+    for (const PendingWrite& write : mPendingWrites[slotIndex]) {
+        if (write.isBe32) {
+            mStream->putBe32(write.value);
+        } else {
+            mStream->putBe64(write.size);
+            mStream->write(slot.mapped + write.offset, write.size);
+        }
+    }
+    mPendingWrites[slotIndex].clear();
+}
+
+bool SnapshotPendingContents::readImage(android::base::Stream* stream, VkImage image,
+                                        const ImageInfo& imageInfo) {
+    if (imageInfo.layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+        return false;
+    }
+    Image content{
+        .device = imageInfo.device,
+        .memory = imageInfo.memory,
+        .createInfo = imageInfo.imageCreateInfoShallow,
+        .layout = imageInfo.layout,
     };
-    _RUN_AND_CHECK(dispatch->vkEndCommandBuffer(commandBuffer));
-    _RUN_AND_CHECK(dispatch->vkQueueSubmit(stateBlock->queue, 1, &submitInfo, fence));
-    _RUN_AND_CHECK(dispatch->vkWaitForFences(stateBlock->device, 1, &fence, VK_TRUE, 3000000000L));
-    _RUN_AND_CHECK(dispatch->vkResetFences(stateBlock->device, 1, &fence));
-    stream->putBe64(bufferInfo->size);
-    stream->write(mapped, bufferInfo->size);
-
-    dispatch->vkDestroyFence(stateBlock->device, fence, nullptr);
-    dispatch->vkUnmapMemory(stateBlock->device, readbackMemory);
-    dispatch->vkDestroyBuffer(stateBlock->device, readbackBuffer, nullptr);
-    dispatch->vkFreeMemory(stateBlock->device, readbackMemory, nullptr);
-    dispatch->vkFreeCommandBuffers(stateBlock->device, stateBlock->commandPool, 1, &commandBuffer);
-}
-
-void loadBufferContent(android::base::Stream* stream, StateBlock* stateBlock, VkBuffer buffer,
-                       const BufferInfo* bufferInfo) {
+    content.createInfo.pNext = nullptr;
+    content.createInfo.pQueueFamilyIndices = nullptr;
+
+    if (content.createInfo.samples == VK_SAMPLE_COUNT_1_BIT) {
+        // TODO: resolve and save multisampled image content
+        const VkImageCreateInfo& createInfo = content.createInfo;
+        for (uint32_t mipLevel = 0; mipLevel < createInfo.mipLevels; mipLevel++) {
+            for (uint32_t arrayLayer = 0; arrayLayer < createInfo.arrayLayers; arrayLayer++) {
+                const VkDeviceSize size = stream->getBe64();
+                if (size != getSubresourceSize(createInfo, mipLevel)) {
+                    GFXSTREAM_ABORT(emugl::FatalError(emugl::ABORT_REASON_OTHER))
+                        << "Failed to read image on snapshot load";
+                }
+                const size_t offset = content.data.size();
+                content.data.resize(offset + size);
+                stream->read(content.data.data() + offset, size);
+            }
+        }
+    }
+
+    forgetImage(content.device, image);
+    mBytes += content.data.size();
+    mDevices[content.device].images.emplace(image, std::move(content));
+    return true;
+}
+
+bool SnapshotPendingContents::readBuffer(android::base::Stream* stream, VkBuffer buffer,
+                                         const BufferInfo& bufferInfo) {
     VkBufferUsageFlags requiredUsages =
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    if ((bufferInfo->usage & requiredUsages) != requiredUsages) {
-        return;
+    if ((bufferInfo.usage & requiredUsages) != requiredUsages) {
+        return false;
     }
-    VulkanDispatch* dispatch = stateBlock->deviceDispatch;
-    VkCommandBufferAllocateInfo allocInfo{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = stateBlock->commandPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1,
-    };
-    VkCommandBuffer commandBuffer;
-    _RUN_AND_CHECK(dispatch->vkAllocateCommandBuffers(stateBlock->device, &allocInfo,
-                                                      &commandBuffer) != VK_SUCCESS);
-    VkFenceCreateInfo fenceCreateInfo{
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-    };
-    VkFence fence;
-    _RUN_AND_CHECK(dispatch->vkCreateFence(stateBlock->device, &fenceCreateInfo, nullptr, &fence));
-    VkBufferCreateInfo bufferCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size = static_cast<VkDeviceSize>(bufferInfo->size),
-        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    const VkDeviceSize size = stream->getBe64();
+    if (size != bufferInfo.size) {
+        GFXSTREAM_ABORT(emugl::FatalError(emugl::ABORT_REASON_OTHER))
+            << "Failed to read buffer on snapshot load";
+    }
+    Buffer content{
+        .device = bufferInfo.device,
+        .memory = bufferInfo.memory,
+        .data = std::vector<uint8_t>(size),
     };
-    VkBuffer stagingBuffer;
-    _RUN_AND_CHECK(
-        dispatch->vkCreateBuffer(stateBlock->device, &bufferCreateInfo, nullptr, &stagingBuffer));
+    stream->read(content.data.data(), size);
 
-    VkMemoryRequirements stagingBufferMemoryRequirements{};
-    dispatch->vkGetBufferMemoryRequirements(stateBlock->device, stagingBuffer,
-                                            &stagingBufferMemoryRequirements);
+    forgetBuffer(content.device, buffer);
+    mBytes += content.data.size();
+    mDevices[content.device].buffers.emplace(buffer, std::move(content));
+    return true;
+}
 
-    const auto stagingBufferMemoryType =
-        GetMemoryType(*stateBlock->physicalDeviceInfo, stagingBufferMemoryRequirements,
-                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    // Staging memory
-    // TODO(b/323064243): reuse staging memory
-    VkMemoryAllocateInfo stagingBufferMemoryAllocateInfo = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = stagingBufferMemoryRequirements.size,
-        .memoryTypeIndex = stagingBufferMemoryType,
-    };
-    VkDeviceMemory stagingMemory;
-    _RUN_AND_CHECK(dispatch->vkAllocateMemory(stateBlock->device, &stagingBufferMemoryAllocateInfo,
-                                              nullptr, &stagingMemory));
-    _RUN_AND_CHECK(
-        dispatch->vkBindBufferMemory(stateBlock->device, stagingBuffer, stagingMemory, 0));
+VkDevice SnapshotPendingContents::anyDevice() const {
+    for (const auto& [device, contents] : mDevices) {
+        if (!contents.images.empty() || !contents.buffers.empty()) {
+            return device;
+        }
+    }
+    return VK_NULL_HANDLE;
+}
 
-    void* mapped = nullptr;
-    _RUN_AND_CHECK(dispatch->vkMapMemory(stateBlock->device, stagingMemory, 0, VK_WHOLE_SIZE,
-                                         VkMemoryMapFlags{}, &mapped));
-    size_t bufferSize = stream->getBe64();
-    if (bufferSize != bufferInfo->size) {
-        GFXSTREAM_ABORT(emugl::FatalError(emugl::ABORT_REASON_OTHER))
-            << "Failed to read buffer on snapshot load";
+SnapshotPendingContents::Batch SnapshotPendingContents::take(VkDevice device,
+                                                              const Selection& selection) {
+    Batch batch;
+    auto deviceIt = mDevices.find(device);
+    if (deviceIt == mDevices.end()) {
+        return batch;
+    }
+    auto& images = deviceIt->second.images;
+    auto& buffers = deviceIt->second.buffers;
+    VkDeviceSize takenBytes = 0;
+
+    if (!selection.images.empty() || !selection.buffers.empty()) {
+        for (VkImage image : selection.images) {
+            auto it = images.find(image);
+            if (it != images.end()) {
+                takenBytes += it->second.data.size();
+                batch.images.emplace_back(image, std::move(it->second));
+                images.erase(it);
+            }
+        }
+        for (VkBuffer buffer : selection.buffers) {
+            auto it = buffers.find(buffer);
+            if (it != buffers.end()) {
+                takenBytes += it->second.data.size();
+                batch.buffers.emplace_back(buffer, std::move(it->second));
+                buffers.erase(it);
+            }
+        }
+    } else {
+        auto selected = [&](VkDeviceMemory contentMemory) {
+            return takenBytes < selection.maxBytes &&
+                   (selection.memory == VK_NULL_HANDLE || selection.memory == contentMemory);
+        };
+        for (auto it = images.begin(); it != images.end();) {
+            if (!selected(it->second.memory)) {
+                ++it;
+                continue;
+            }
+            takenBytes += it->second.data.size();
+            batch.images.emplace_back(it->first, std::move(it->second));
+            it = images.erase(it);
+        }
+        for (auto it = buffers.begin(); it != buffers.end();) {
+            if (!selected(it->second.memory)) {
+                ++it;
+                continue;
+            }
+            takenBytes += it->second.data.size();
+            batch.buffers.emplace_back(it->first, std::move(it->second));
+            it = buffers.erase(it);
+        }
+    }
+    mBytes -= takenBytes;
+    if (!batch.empty()) {
+        deviceIt->second.batchesInFlight++;
     }
-    stream->read(mapped, bufferInfo->size);
+    return batch;
+}
+
+void SnapshotPendingContents::markUploaded(VkDevice device) {
+    auto it = mDevices.find(device);
+    if (it == mDevices.end()) {
+        return;
+    }
+    if (it->second.batchesInFlight > 0) {
+        it->second.batchesInFlight--;
+    }
+    eraseIfDone(it);
+}
+
+void SnapshotPendingContents::forgetImage(VkDevice device, VkImage image) {
+    auto deviceIt = mDevices.find(device);
+    if (deviceIt == mDevices.end()) {
+        return;
+    }
+    auto& images = deviceIt->second.images;
+    auto it = images.find(image);
+    if (it != images.end()) {
+        mBytes -= it->second.data.size();
+        images.erase(it);
+        eraseIfDone(deviceIt);
+    }
+}
+
+void SnapshotPendingContents::forgetBuffer(VkDevice device, VkBuffer buffer) {
+    auto deviceIt = mDevices.find(device);
+    if (deviceIt == mDevices.end()) {
+        return;
+    }
+    auto& buffers = deviceIt->second.buffers;
+    auto it = buffers.find(buffer);
+    if (it != buffers.end()) {
+        mBytes -= it->second.data.size();
+        buffers.erase(it);
+        eraseIfDone(deviceIt);
+    }
+}
+
+void SnapshotPendingContents::forgetDevice(VkDevice device) {
+    auto it = mDevices.find(device);
+    if (it == mDevices.end()) {
+        return;
+    }
+    for (const auto& [image, content] : it->second.images) {
+        mBytes -= content.data.size();
+    }
+    for (const auto& [buffer, content] : it->second.buffers) {
+        mBytes -= content.data.size();
+    }
+    mDevices.erase(it);
+}
+
+void SnapshotPendingContents::clear() {
+    mDevices.clear();
+    mBytes = 0;
+}
+
+void SnapshotPendingContents::eraseIfDone(
+    std::unordered_map<VkDevice, DeviceContents>::iterator it) {
+    if (it->second.images.empty() && it->second.buffers.empty() &&
+        it->second.batchesInFlight == 0) {
+        mDevices.erase(it);
+    }
+}
+
+SnapshotContentLoader::SnapshotContentLoader(const char* operation)
+    : SnapshotContentTransfer(operation, VK_BUFFER_USAGE_TRANSFER_SRC_BIT) {}
+
+void SnapshotContentLoader::loadImage(StateBlock* stateBlock, VkImage image,
+                                      const SnapshotPendingContents::Image& content) {
+    const VkImageCreateInfo& imageCreateInfo = content.createInfo;
+    const VkImageAspectFlags aspects = getSnapshotAspects(imageCreateInfo);
+    VulkanDispatch* dispatch = stateBlock->deviceDispatch;
+
+    if (imageCreateInfo.samples != VK_SAMPLE_COUNT_1_BIT) {
+        // Set the layout and quit
+        reserve(stateBlock, 0, 1);
+        recordImageLayoutTransition(dispatch, currentSlot().commandBuffer, image, aspects,
+                                    static_cast<VkAccessFlags>(~VK_ACCESS_NONE_KHR),
+                                    static_cast<VkAccessFlags>(~VK_ACCESS_NONE_KHR),
+                                    VK_IMAGE_LAYOUT_UNDEFINED, content.layout);
+        return;
+    }
+
+    const VkDeviceSize alignment = getImageCopyAlignment(imageCreateInfo.format);
+    VkDeviceSize offset =
+        reserve(stateBlock, getImageStagingSize(imageCreateInfo), alignment);
+    Slot& slot = currentSlot();
+
+    recordImageLayoutTransition(dispatch, slot.commandBuffer, image, aspects,
+                                static_cast<VkAccessFlags>(~VK_ACCESS_NONE_KHR),
+                                VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    std::vector<VkBufferImageCopy> regions;
+    const uint8_t* src = content.data.data();
+    for (uint32_t mipLevel = 0; mipLevel < imageCreateInfo.mipLevels; mipLevel++) {
+        for (uint32_t arrayLayer = 0; arrayLayer < imageCreateInfo.arrayLayers; arrayLayer++) {
+            offset = alignUp(offset, alignment);
+            const VkDeviceSize size = getSubresourceSize(imageCreateInfo, mipLevel);
+            memcpy(slot.mapped + offset, src, size);
+            src += size;
+            regions.push_back(VkBufferImageCopy{
+                .bufferOffset = offset,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = VkImageSubresourceLayers{.aspectMask = aspects,
+                                                             .mipLevel = mipLevel,
+                                                             .baseArrayLayer = arrayLayer,
+                                                             .layerCount = 1},
+                .imageOffset = VkOffset3D{.x = 0, .y = 0, .z = 0},
+                .imageExtent = getMipmapExtent(imageCreateInfo.extent, mipLevel),
+            });
+            offset += size;
+        }
+    }
+    dispatch->vkCmdCopyBufferToImage(slot.commandBuffer, slot.buffer, image,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                     static_cast<uint32_t>(regions.size()), regions.data());
+
+    // Cannot really translate it back to VK_IMAGE_LAYOUT_PREINITIALIZED
+    if (content.layout != VK_IMAGE_LAYOUT_PREINITIALIZED) {
+        recordImageLayoutTransition(dispatch, slot.commandBuffer, image, aspects,
+                                    VK_ACCESS_TRANSFER_WRITE_BIT,
+                                    static_cast<VkAccessFlags>(~VK_ACCESS_NONE_KHR),
+                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, content.layout);
+    }
+}
+
+void SnapshotContentLoader::loadBuffer(StateBlock* stateBlock, VkBuffer buffer,
+                                       const SnapshotPendingContents::Buffer& content) {
+    const VkDeviceSize size = content.data.size();
+    const VkDeviceSize offset = reserve(stateBlock, size, 1);
+    Slot& slot = currentSlot();
+    memcpy(slot.mapped + offset, content.data.data(), size);
 
     VkBufferCopy bufferCopy = {
-        .srcOffset = 0,
+        .srcOffset = offset,
         .dstOffset = 0,
-        .size = bufferInfo->size,
-    };
-
-    VkCommandBufferBeginInfo beginInfo{
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .size = size,
     };
-    if (dispatch->vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-        GFXSTREAM_ABORT(emugl::FatalError(emugl::ABORT_REASON_OTHER))
-            << "Failed to start command buffer on snapshot load";
-    }
-    dispatch->vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer, 1, &bufferCopy);
+    VulkanDispatch* dispatch = stateBlock->deviceDispatch;
+    dispatch->vkCmdCopyBuffer(slot.commandBuffer, slot.buffer, buffer, 1, &bufferCopy);
     VkBufferMemoryBarrier barrier{.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
                                   .pNext = nullptr,
                                   .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
                                   .dstAccessMask = static_cast<VkAccessFlags>(~VK_ACCESS_NONE_KHR),
-                                  .srcQueueFamilyIndex = 0xFFFFFFFF,
-                                  .dstQueueFamilyIndex = 0xFFFFFFFF,
+                                  .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                                  .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                                   .buffer = buffer,
                                   .offset = 0,
-                                  .size = bufferInfo->size};
-    dispatch->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                  .size = size};
+    dispatch->vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
                                    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &barrier,
                                    0, nullptr);
+}
 
-    // Execute the command to copy buffer
-    VkSubmitInfo submitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &commandBuffer,
-    };
-    _RUN_AND_CHECK(dispatch->vkEndCommandBuffer(commandBuffer));
-    _RUN_AND_CHECK(dispatch->vkQueueSubmit(stateBlock->queue, 1, &submitInfo, fence));
-    _RUN_AND_CHECK(dispatch->vkWaitForFences(stateBlock->device, 1, &fence, VK_TRUE, 3000000000L));
-    _RUN_AND_CHECK(dispatch->vkResetFences(stateBlock->device, 1, &fence));
-
-    dispatch->vkDestroyFence(stateBlock->device, fence, nullptr);
-    dispatch->vkUnmapMemory(stateBlock->device, stagingMemory);
-    dispatch->vkDestroyBuffer(stateBlock->device, stagingBuffer, nullptr);
-    dispatch->vkFreeMemory(stateBlock->device, stagingMemory, nullptr);
-    dispatch->vkFreeCommandBuffers(stateBlock->device, stateBlock->commandPool, 1, &commandBuffer);
+void SnapshotContentLoader::load(StateBlock* stateBlock,
+                                 const SnapshotPendingContents::Batch& batch) {
+    for (const auto& [image, content] : batch.images) {
+        loadImage(stateBlock, image, content);
+    }
+    for (const auto& [buffer, content] : batch.buffers) {
+        loadBuffer(stateBlock, buffer, content);
+    }
 }
 
 }  // namespace vk
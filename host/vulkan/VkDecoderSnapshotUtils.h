@@ -14,6 +14,13 @@
 
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "vulkan/VkDecoderInternalStructs.h"
 
 namespace gfxstream {
@@ -26,13 +33,185 @@ struct StateBlock {
     VkQueue queue;
     VkCommandPool commandPool;
 };
-void saveImageContent(android::base::Stream* stream, StateBlock* stateBlock, VkImage image,
-                      const ImageInfo* imageInfo);
-void loadImageContent(android::base::Stream* stream, StateBlock* stateBlock, VkImage image,
-                      const ImageInfo* imageInfo);
-void saveBufferContent(android::base::Stream* stream, StateBlock* stateBlock, VkBuffer buffer,
-                       const BufferInfo* bufferInfo);
-void loadBufferContent(android::base::Stream* stream, StateBlock* stateBlock, VkBuffer buffer,
-                       const BufferInfo* bufferInfo);
+
+// Batches the copies between a snapshot stream and the contents of images and buffers.
+//
+// Copies are recorded into one of two staging slots, each a large host visible buffer with its
+// own command buffer. Once a slot is full it is submitted and recording moves on to the other
+// slot, so that the stream is read or written while the GPU works on the previous batch. A few
+// submissions are enough for thousands of images.
+class SnapshotContentTransfer {
+   public:
+    SnapshotContentTransfer(const SnapshotContentTransfer&) = delete;
+    SnapshotContentTransfer& operator=(const SnapshotContentTransfer&) = delete;
+
+    // Waits for all the copies and releases the staging resources. Must be called before the
+    // StateBlocks used with this object are released.
+    void finish();
+
+   protected:
+    struct Slot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        uint8_t* mapped = nullptr;
+        VkDeviceSize capacity = 0;
+        VkDeviceSize used = 0;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        bool recording = false;
+        bool submitted = false;
+    };
+
+    // `operation` is only used for logging.
+    SnapshotContentTransfer(const char* operation, VkBufferUsageFlags stagingUsage);
+    virtual ~SnapshotContentTransfer() = default;
+
+    // Makes room for `size` bytes of staging memory in the current slot, switching slots if it
+    // is full, and starts recording its command buffer. Returns the offset of the reserved
+    // memory. The slot uses the device, queue and command pool of `stateBlock`.
+    VkDeviceSize reserve(StateBlock* stateBlock, VkDeviceSize size, VkDeviceSize alignment);
+
+    uint32_t currentSlotIndex() const { return mCurrent; }
+    Slot& currentSlot() { return mSlots[mCurrent]; }
+    StateBlock* stateBlock() const { return mStateBlock; }
+
+    // Records commands needed before the slot's command buffer ends.
+    virtual void onSlotSubmit(Slot& slot) {}
+    // Called, in recording order, once the GPU is done with a slot's copies.
+    virtual void onSlotDone(uint32_t slotIndex, Slot& slot) {}
+
+    uint64_t mTransferredBytes = 0;
+
+   private:
+    void flush();
+    void switchSlot();
+    void submit(Slot& slot);
+    void wait(Slot& slot);
+    void allocateStaging(Slot& slot, VkDeviceSize size);
+    void destroySlots();
+
+    const char* const mOperation;
+    const VkBufferUsageFlags mStagingUsage;
+    StateBlock* mStateBlock = nullptr;
+    std::array<Slot, 2> mSlots;
+    uint32_t mCurrent = 0;
+
+    const std::chrono::steady_clock::time_point mStartTime = std::chrono::steady_clock::now();
+    uint32_t mSubmitCount = 0;
+};
+
+// Saves the contents of images and buffers to a snapshot stream. Everything, including the
+// values written with putBe32(), reaches the stream in the order it was queued.
+class SnapshotContentSaver : public SnapshotContentTransfer {
+   public:
+    explicit SnapshotContentSaver(android::base::Stream* stream);
+
+    void putBe32(uint32_t value);
+    void saveImage(StateBlock* stateBlock, VkImage image, const ImageInfo* imageInfo);
+    void saveBuffer(StateBlock* stateBlock, VkBuffer buffer, const BufferInfo* bufferInfo);
+
+   private:
+    struct PendingWrite {
+        bool isBe32;
+        uint32_t value;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    void onSlotSubmit(Slot& slot) override;
+    void onSlotDone(uint32_t slotIndex, Slot& slot) override;
+
+    android::base::Stream* mStream;
+    std::array<std::vector<PendingWrite>, 2> mPendingWrites;
+};
+
+// Image and buffer contents read from a snapshot but not uploaded yet.
+//
+// Uploading everything while loading makes resuming take longer the more GPU memory the guest
+// uses. Instead, the contents wait here until the resource is first used, or until a background
+// thread gets to them.
+class SnapshotPendingContents {
+   public:
+    struct Image {
+        VkDevice device;
+        VkDeviceMemory memory;
+        // Only the format, extent, levels, layers, samples and usage are used.
+        VkImageCreateInfo createInfo;
+        VkImageLayout layout;
+        // Every mip level and array layer, tightly packed. Empty for multisampled images, which
+        // only get their layout back.
+        std::vector<uint8_t> data;
+    };
+    struct Buffer {
+        VkDevice device;
+        VkDeviceMemory memory;
+        std::vector<uint8_t> data;
+    };
+    struct Batch {
+        std::vector<std::pair<VkImage, Image>> images;
+        std::vector<std::pair<VkBuffer, Buffer>> buffers;
+
+        bool empty() const { return images.empty() && buffers.empty(); }
+    };
+    // Which of a device's pending contents to take.
+    struct Selection {
+        // Only these resources, when either is not empty.
+        std::vector<VkImage> images;
+        std::vector<VkBuffer> buffers;
+        // Only the resources bound to this memory, when set.
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        // Stop once about this many bytes were taken.
+        VkDeviceSize maxBytes = std::numeric_limits<VkDeviceSize>::max();
+    };
+
+    // Read what SnapshotContentSaver::saveImage() and saveBuffer() wrote. Return false if the
+    // resource has nothing to restore.
+    bool readImage(android::base::Stream* stream, VkImage image, const ImageInfo& imageInfo);
+    bool readBuffer(android::base::Stream* stream, VkBuffer buffer, const BufferInfo& bufferInfo);
+
+    // Devices stay pending while a batch taken from them is being uploaded, see markUploaded().
+    bool empty() const { return mDevices.empty(); }
+    VkDeviceSize bytes() const { return mBytes; }
+    bool hasDevice(VkDevice device) const { return mDevices.count(device) != 0; }
+    // Returns a device with contents that were not taken yet, or VK_NULL_HANDLE.
+    VkDevice anyDevice() const;
+
+    // The device stays pending until markUploaded() is called for a non-empty batch.
+    Batch take(VkDevice device, const Selection& selection);
+    void markUploaded(VkDevice device);
+
+    // Drop the contents of destroyed resources.
+    void forgetImage(VkDevice device, VkImage image);
+    void forgetBuffer(VkDevice device, VkBuffer buffer);
+    void forgetDevice(VkDevice device);
+    void clear();
+
+   private:
+    struct DeviceContents {
+        std::unordered_map<VkImage, Image> images;
+        std::unordered_map<VkBuffer, Buffer> buffers;
+        // Batches taken but not uploaded yet.
+        uint32_t batchesInFlight = 0;
+    };
+    // Removes the device once it has nothing left to upload.
+    void eraseIfDone(std::unordered_map<VkDevice, DeviceContents>::iterator it);
+
+    std::unordered_map<VkDevice, DeviceContents> mDevices;
+    VkDeviceSize mBytes = 0;
+};
+
+// Uploads the contents held by SnapshotPendingContents to their images and buffers.
+class SnapshotContentLoader : public SnapshotContentTransfer {
+   public:
+    // `operation` is only used for logging.
+    explicit SnapshotContentLoader(const char* operation = "load");
+
+    void loadImage(StateBlock* stateBlock, VkImage image,
+                   const SnapshotPendingContents::Image& content);
+    void loadBuffer(StateBlock* stateBlock, VkBuffer buffer,
+                    const SnapshotPendingContents::Buffer& content);
+    // Loads every resource of `batch`, which must all belong to `stateBlock`'s device.
+    void load(StateBlock* stateBlock, const SnapshotPendingContents::Batch& batch);
+};
 }  // namespace vk
-}  // namespace gfxstream
\ No newline at end of file
+}  // namespace gfxstream
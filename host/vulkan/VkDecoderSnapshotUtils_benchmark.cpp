@@ -0,0 +1,310 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "aemu/base/files/Stream.h"
+#include "gfxstream/host/Features.h"
+#include "vk_util.h"
+#include "vulkan/VkDecoderSnapshotUtils.h"
+#include "vulkan/VkEmulatedPhysicalDeviceMemory.h"
+#include "vulkan/testing/VulkanTestHelper.h"
+
+namespace gfxstream {
+namespace vk {
+namespace {
+
+using testing::VulkanTestHelper;
+
+// The snapshot stream, kept in memory so that only the copies are timed.
+class MemoryStream : public android::base::Stream {
+   public:
+    ssize_t read(void* buffer, size_t size) override {
+        size = std::min(size, mData.size() - mReadPos);
+        memcpy(buffer, mData.data() + mReadPos, size);
+        mReadPos += size;
+        return static_cast<ssize_t>(size);
+    }
+
+    ssize_t write(const void* buffer, size_t size) override {
+        const uint8_t* bytes = static_cast<const uint8_t*>(buffer);
+        mData.insert(mData.end(), bytes, bytes + size);
+        return static_cast<ssize_t>(size);
+    }
+
+    size_t size() const { return mData.size(); }
+    void rewind() { mReadPos = 0; }
+    void clear() {
+        mData.clear();
+        mReadPos = 0;
+    }
+
+   private:
+    std::vector<uint8_t> mData;
+    size_t mReadPos = 0;
+};
+
+// state.range(0) R8G8B8A8 images of state.range(1) x state.range(1) pixels, and as many buffers
+// of the same size, in device local memory, as a guest would leave them when it is snapshotted.
+class SnapshotResources {
+   public:
+    SnapshotResources(uint32_t count, uint32_t extent) {
+        mHelper.initialize();
+        const VkDevice boxedDevice = mHelper.device();
+        mDevice = unbox_VkDevice(boxedDevice);
+        mDispatch = dispatch_VkDevice(boxedDevice);
+
+        // The raw driver's memory types, not the ones VkDecoderGlobalState exposes to guests.
+        const VkPhysicalDevice physicalDevice = unbox_VkPhysicalDevice(mHelper.physDev());
+        dispatch_VkPhysicalDevice(mHelper.physDev())
+            ->vkGetPhysicalDeviceMemoryProperties(physicalDevice, &mMemoryProperties);
+        mPhysicalDeviceInfo.memoryPropertiesHelper =
+            std::make_unique<EmulatedPhysicalDeviceMemoryProperties>(
+                mMemoryProperties, 0, gfxstream::host::FeatureSet());
+
+        const VkCommandPoolCreateInfo poolInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            .queueFamilyIndex = mHelper.getQueueFamilyIndex(VK_QUEUE_GRAPHICS_BIT),
+        };
+        mStateBlock = StateBlock{
+            .physicalDevice = physicalDevice,
+            .physicalDeviceInfo = &mPhysicalDeviceInfo,
+            .device = mDevice,
+            .deviceDispatch = mDispatch,
+            .queue = unbox_VkQueue(mHelper.graphicsQueue()),
+            .commandPool = VK_NULL_HANDLE,
+        };
+        VK_CHECK(mDispatch->vkCreateCommandPool(mDevice, &poolInfo, nullptr,
+                                                &mStateBlock.commandPool));
+
+        const VkDeviceSize size = static_cast<VkDeviceSize>(extent) * extent * 4;
+        mImageInfos.resize(count);
+        mBufferInfos.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            createImage(extent, &mImageInfos[i]);
+            createBuffer(size, &mBufferInfos[i]);
+        }
+        mContentBytes = count * size * 2;
+
+        // Gives the images a layout and the resources some contents, as a first load would.
+        SnapshotContentLoader loader("benchmark setup");
+        const std::vector<uint8_t> data(size, 0x5a);
+        for (uint32_t i = 0; i < count; i++) {
+            loader.loadImage(&mStateBlock, mImages[i],
+                             SnapshotPendingContents::Image{
+                                 .device = mDevice,
+                                 .memory = mImageInfos[i].memory,
+                                 .createInfo = mImageInfos[i].imageCreateInfoShallow,
+                                 .layout = mImageInfos[i].layout,
+                                 .data = data,
+                             });
+            loader.loadBuffer(&mStateBlock, mBuffers[i],
+                              SnapshotPendingContents::Buffer{
+                                  .device = mDevice,
+                                  .memory = mBufferInfos[i].memory,
+                                  .data = data,
+                              });
+        }
+        loader.finish();
+    }
+
+    ~SnapshotResources() {
+        mDispatch->vkDeviceWaitIdle(mDevice);
+        for (VkImage image : mImages) {
+            mDispatch->vkDestroyImage(mDevice, image, nullptr);
+        }
+        for (VkBuffer buffer : mBuffers) {
+            mDispatch->vkDestroyBuffer(mDevice, buffer, nullptr);
+        }
+        for (VkDeviceMemory memory : mMemories) {
+            mDispatch->vkFreeMemory(mDevice, memory, nullptr);
+        }
+        mDispatch->vkDestroyCommandPool(mDevice, mStateBlock.commandPool, nullptr);
+    }
+
+    // Writes the contents of every resource to `stream`, as VkDecoderGlobalState does.
+    void save(android::base::Stream* stream) {
+        SnapshotContentSaver saver(stream);
+        for (size_t i = 0; i < mImages.size(); i++) {
+            saver.putBe32(mImageInfos[i].layout);
+            saver.saveImage(&mStateBlock, mImages[i], &mImageInfos[i]);
+        }
+        for (size_t i = 0; i < mBuffers.size(); i++) {
+            saver.saveBuffer(&mStateBlock, mBuffers[i], &mBufferInfos[i]);
+        }
+        saver.finish();
+    }
+
+    // Reads back what save() wrote and uploads all of it.
+    void load(android::base::Stream* stream) {
+        SnapshotPendingContents pendingContents;
+        for (size_t i = 0; i < mImages.size(); i++) {
+            mImageInfos[i].layout = static_cast<VkImageLayout>(stream->getBe32());
+            pendingContents.readImage(stream, mImages[i], mImageInfos[i]);
+        }
+        for (size_t i = 0; i < mBuffers.size(); i++) {
+            pendingContents.readBuffer(stream, mBuffers[i], mBufferInfos[i]);
+        }
+        SnapshotContentLoader loader;
+        loader.load(&mStateBlock, pendingContents.take(mDevice, {}));
+        loader.finish();
+        pendingContents.markUploaded(mDevice);
+    }
+
+    // Bytes of image and buffer contents, without the snapshot's own framing.
+    int64_t contentBytes() const { return static_cast<int64_t>(mContentBytes); }
+
+   private:
+    VkDeviceMemory allocate(const VkMemoryRequirements& requirements) {
+        uint32_t memoryTypeIndex = 0;
+        while (!(requirements.memoryTypeBits & (1u << memoryTypeIndex)) ||
+               !(mMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+            memoryTypeIndex++;
+        }
+        const VkMemoryAllocateInfo allocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize = requirements.size,
+            .memoryTypeIndex = memoryTypeIndex,
+        };
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VK_CHECK(mDispatch->vkAllocateMemory(mDevice, &allocateInfo, nullptr, &memory));
+        mMemories.push_back(memory);
+        return memory;
+    }
+
+    void createImage(uint32_t extent, ImageInfo* imageInfo) {
+        const VkImageCreateInfo createInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = VK_FORMAT_R8G8B8A8_UNORM,
+            .extent = {extent, extent, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                     VK_IMAGE_USAGE_SAMPLED_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        VkImage image = VK_NULL_HANDLE;
+        VK_CHECK(mDispatch->vkCreateImage(mDevice, &createInfo, nullptr, &image));
+        VkMemoryRequirements requirements;
+        mDispatch->vkGetImageMemoryRequirements(mDevice, image, &requirements);
+        const VkDeviceMemory memory = allocate(requirements);
+        VK_CHECK(mDispatch->vkBindImageMemory(mDevice, image, memory, 0));
+
+        imageInfo->device = mDevice;
+        imageInfo->imageCreateInfoShallow = createInfo;
+        imageInfo->layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo->memory = memory;
+        mImages.push_back(image);
+    }
+
+    void createBuffer(VkDeviceSize size, BufferInfo* bufferInfo) {
+        const VkBufferCreateInfo createInfo = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = size,
+            .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        };
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VK_CHECK(mDispatch->vkCreateBuffer(mDevice, &createInfo, nullptr, &buffer));
+        VkMemoryRequirements requirements;
+        mDispatch->vkGetBufferMemoryRequirements(mDevice, buffer, &requirements);
+        const VkDeviceMemory memory = allocate(requirements);
+        VK_CHECK(mDispatch->vkBindBufferMemory(mDevice, buffer, memory, 0));
+
+        bufferInfo->device = mDevice;
+        bufferInfo->usage = createInfo.usage;
+        bufferInfo->memory = memory;
+        bufferInfo->size = size;
+        mBuffers.push_back(buffer);
+    }
+
+    VulkanTestHelper mHelper;
+    VkDevice mDevice = VK_NULL_HANDLE;
+    VulkanDispatch* mDispatch = nullptr;
+    VkPhysicalDeviceMemoryProperties mMemoryProperties;
+    PhysicalDeviceInfo mPhysicalDeviceInfo;
+    StateBlock mStateBlock;
+    std::vector<VkImage> mImages;
+    std::vector<ImageInfo> mImageInfos;
+    std::vector<VkBuffer> mBuffers;
+    std::vector<BufferInfo> mBufferInfos;
+    std::vector<VkDeviceMemory> mMemories;
+    VkDeviceSize mContentBytes = 0;
+};
+
+// Saving the contents of the images and buffers of a snapshot: copying them to the staging
+// slots and writing them to the stream.
+void BM_SaveContents(benchmark::State& state) {
+    SnapshotResources resources(state.range(0), state.range(1));
+    MemoryStream stream;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        stream.clear();
+        state.ResumeTiming();
+
+        resources.save(&stream);
+    }
+
+    state.counters["stream_bytes"] = static_cast<double>(stream.size());
+    state.SetItemsProcessed(state.iterations() * state.range(0) * 2);
+    state.SetBytesProcessed(state.iterations() * resources.contentBytes());
+}
+
+// Loading the same contents, all of them uploaded right away, which is the worst case of a
+// snapshot load since most contents are normally deferred until first use.
+void BM_LoadContents(benchmark::State& state) {
+    SnapshotResources resources(state.range(0), state.range(1));
+    MemoryStream stream;
+    resources.save(&stream);
+
+    for (auto _ : state) {
+        stream.rewind();
+        resources.load(&stream);
+    }
+
+    state.counters["stream_bytes"] = static_cast<double>(stream.size());
+    state.SetItemsProcessed(state.iterations() * state.range(0) * 2);
+    state.SetBytesProcessed(state.iterations() * resources.contentBytes());
+}
+
+void contentArgs(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"count", "extent"});
+    // Many small textures, and a few render targets.
+    benchmark->Args({1000, 64});
+    benchmark->Args({16, 1024});
+}
+
+// The copies run on the GPU, so use the wall time.
+BENCHMARK(BM_SaveContents)->Apply(contentArgs)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LoadContents)->Apply(contentArgs)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace vk
+}  // namespace gfxstream
+
+BENCHMARK_MAIN();
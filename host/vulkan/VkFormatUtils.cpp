@@ -197,5 +197,37 @@ bool getFormatTransferInfo(VkFormat format, uint32_t width, uint32_t height,
     return true;
 }
 
+bool getFormatSubrectTransferInfo(VkFormat format, uint32_t x, uint32_t y, uint32_t width,
+                                  uint32_t height, VkDeviceSize* outStagingBufferCopySize,
+                                  std::vector<VkBufferImageCopy>* outBufferImageCopies) {
+    const FormatPlaneLayouts* formatInfo = getFormatPlaneLayouts(format);
+    if (formatInfo == nullptr) {
+        ERR("Unhandled format: %s [%d]", string_VkFormat(format), format);
+        return false;
+    }
+
+    // Subsampled planes and aligned strides would need the region to be adjusted per plane.
+    if (formatInfo->planeLayouts.size() != 1 || formatInfo->horizontalAlignmentPixels != 1) {
+        ERR("Unhandled subrect transfer for format: %s [%d]", string_VkFormat(format), format);
+        return false;
+    }
+
+    std::vector<VkBufferImageCopy> bufferImageCopies;
+    if (!getFormatTransferInfo(format, width, height, outStagingBufferCopySize,
+                               &bufferImageCopies)) {
+        return false;
+    }
+
+    if (outBufferImageCopies) {
+        for (VkBufferImageCopy& bufferImageCopy : bufferImageCopies) {
+            bufferImageCopy.imageOffset.x = static_cast<int32_t>(x);
+            bufferImageCopy.imageOffset.y = static_cast<int32_t>(y);
+            outBufferImageCopies->push_back(bufferImageCopy);
+        }
+    }
+
+    return true;
+}
+
 }  // namespace vk
 }  // namespace gfxstream
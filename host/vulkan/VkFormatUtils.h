@@ -372,6 +372,13 @@ bool getFormatTransferInfo(VkFormat format, uint32_t width, uint32_t height,
                            VkDeviceSize* outStagingBufferCopySize,
                            std::vector<VkBufferImageCopy>* outBufferImageCopies);
 
+// Like getFormatTransferInfo() but for the `width` x `height` region of the image at
+// (`x`, `y`), tightly packed in the staging buffer. Only single plane formats without a
+// horizontal alignment requirement are supported.
+bool getFormatSubrectTransferInfo(VkFormat format, uint32_t x, uint32_t y, uint32_t width,
+                                  uint32_t height, VkDeviceSize* outStagingBufferCopySize,
+                                  std::vector<VkBufferImageCopy>* outBufferImageCopies);
+
 }  // namespace vk
 }  // namespace gfxstream
 
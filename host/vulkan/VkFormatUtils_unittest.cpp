@@ -258,6 +258,46 @@ TEST(VkFormatUtilsTest, GetTransferInfoYV12OrYV21) {
                             })));
 }
 
+TEST(VkFormatUtilsTest, GetSubrectTransferInfoRGBA) {
+    const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+
+    VkDeviceSize bufferCopySize;
+    std::vector<VkBufferImageCopy> bufferImageCopies;
+    ASSERT_THAT(getFormatSubrectTransferInfo(format, 8, 4, 3, 2, &bufferCopySize,
+                                             &bufferImageCopies),
+                IsTrue());
+    EXPECT_THAT(bufferCopySize, Eq(24));
+    ASSERT_THAT(bufferImageCopies, ElementsAre(EqsVkBufferImageCopy(VkBufferImageCopy{
+                                       .bufferOffset = 0,
+                                       .bufferRowLength = 3,
+                                       .bufferImageHeight = 0,
+                                       .imageSubresource =
+                                           {
+                                               .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                               .mipLevel = 0,
+                                               .baseArrayLayer = 0,
+                                               .layerCount = 1,
+                                           },
+                                       .imageOffset =
+                                           {
+                                               .x = 8,
+                                               .y = 4,
+                                               .z = 0,
+                                           },
+                                       .imageExtent =
+                                           {
+                                               .width = 3,
+                                               .height = 2,
+                                               .depth = 1,
+                                           },
+                                   })));
+}
+
+TEST(VkFormatUtilsTest, GetSubrectTransferInfoMultiPlaneUnsupported) {
+    const VkFormat format = VK_FORMAT_G8_B8R8_2PLANE_420_UNORM;
+    ASSERT_THAT(getFormatSubrectTransferInfo(format, 0, 0, 16, 16, nullptr, nullptr), IsFalse());
+}
+
 }  // namespace
 }  // namespace vk
 }  // namespace gfxstream
@@ -58,7 +58,6 @@ void BoxedHandleManager::replayHandles(std::vector<BoxedHandle> handles) {
 }
 
 void BoxedHandleManager::clear() {
-    std::lock_guard<std::mutex> lock(mMutex);
     mReverseMap.clear();
     mStore.clear();
 }
@@ -76,8 +75,7 @@ BoxedHandle BoxedHandleManager::add(const BoxedHandleInfo& item, BoxedHandleType
         handle = (BoxedHandle)mStore.add(item, (size_t)tag);
     }
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    mReverseMap[(BoxedHandle)(item.underlying)] = handle;
+    mReverseMap.set((UnboxedHandle)(item.underlying), handle);
     return handle;
 }
 
@@ -86,18 +84,16 @@ void BoxedHandleManager::update(BoxedHandle handle, const BoxedHandleInfo& item,
     auto storedItem = mStore.get(handle);
     UnboxedHandle oldHandle = (UnboxedHandle)storedItem->underlying;
     *storedItem = item;
-    std::lock_guard<std::mutex> lock(mMutex);
     if (oldHandle) {
-        mReverseMap.erase(oldHandle);
+        mReverseMap.remove(oldHandle);
     }
-    mReverseMap[(UnboxedHandle)(item.underlying)] = handle;
+    mReverseMap.set((UnboxedHandle)(item.underlying), handle);
 }
 
 void BoxedHandleManager::remove(BoxedHandle h) {
     auto item = get(h);
     if (item) {
-        std::lock_guard<std::mutex> lock(mMutex);
-        mReverseMap.erase((UnboxedHandle)(item->underlying));
+        mReverseMap.remove((UnboxedHandle)(item->underlying));
     }
     mStore.remove(h);
 }
@@ -138,14 +134,7 @@ BoxedHandleInfo* BoxedHandleManager::get(BoxedHandle handle) {
 }
 
 BoxedHandle BoxedHandleManager::getBoxedFromUnboxed(UnboxedHandle unboxed) {
-    std::lock_guard<std::mutex> lock(mMutex);
-
-    auto it = mReverseMap.find(unboxed);
-    if (it == mReverseMap.end()) {
-        return 0;
-    }
-
-    return it->second;
+    return mReverseMap.get(unboxed);
 }
 
 BoxedHandleManager sBoxedHandleManager;
@@ -17,6 +17,7 @@
 #include <deque>
 #include <mutex>
 
+#include "VkConcurrentHandleMap.h"
 #include "VulkanDispatch.h"
 #include "VulkanHandles.h"
 #include "VulkanStream.h"
@@ -107,8 +108,11 @@ class BoxedHandleManager {
    private:
     mutable Store mStore;
 
+    // Looked up by the decoders for every handle returned to the guest, so lookups must not
+    // serialize the render threads.
+    ConcurrentHandleMap mReverseMap;
+
     std::mutex mMutex;
-    std::unordered_map<UnboxedHandle, BoxedHandle> mReverseMap GUARDED_BY(mMutex);
 
     struct DelayedRemove {
         BoxedHandle handle;
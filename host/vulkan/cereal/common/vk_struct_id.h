@@ -147,5 +147,7 @@ REGISTER_VK_STRUCT_ID(VkPhysicalDeviceVulkan12Features,
                       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES);
 REGISTER_VK_STRUCT_ID(VkPhysicalDeviceVulkan13Features,
                       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES);
+REGISTER_VK_STRUCT_ID(VkPipelineCreationFeedbackCreateInfo,
+                      VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO);
 
 #undef REGISTER_VK_STRUCT_ID
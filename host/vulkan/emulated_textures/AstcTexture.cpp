@@ -64,15 +64,18 @@ bool isRegionValid(const VkBufferImageCopy& region, uint32_t width, uint32_t hei
 }  // namespace
 
 AstcTexture::AstcTexture(VulkanDispatch* vk, VkDevice device, VkPhysicalDevice physicalDevice,
-                         VkExtent3D imgSize, uint32_t blockWidth, uint32_t blockHeight,
-                         AstcCpuDecompressor* decompressor)
+                         VkFormat format, VkExtent3D imgSize, uint32_t blockWidth,
+                         uint32_t blockHeight, AstcCpuDecompressor* decompressor,
+                         DecompressedTextureCache* cache)
     : mVk(vk),
       mDevice(device),
       mPhysicalDevice(physicalDevice),
+      mFormat(format),
       mImgSize(imgSize),
       mBlockWidth(blockWidth),
       mBlockHeight(blockHeight),
-      mDecompressor(decompressor) {}
+      mDecompressor(decompressor),
+      mCache(cache) {}
 
 AstcTexture::~AstcTexture() { destroyVkBuffer(); }
 
@@ -228,10 +231,18 @@ void AstcTexture::on_vkCmdCopyBufferToImageImpl(VkCommandBuffer commandBuffer, u
         const auto& decompRegion = decompRegions[i];
         const auto& regionInfo = regionInfos[i];
 
+        const uint8_t* compressed = srcAstcData + compRegion.bufferOffset;
+        uint8_t* decompressed = decompData + decompRegion.bufferOffset;
+        const size_t decompressedSize = regionInfo.width * regionInfo.height * 4;
+
+        if (mCache && mCache->lookup(mFormat, regionInfo.width, regionInfo.height, compressed,
+                                     regionInfo.compressedSize, decompressed, decompressedSize)) {
+            continue;
+        }
+
         int32_t status = mDecompressor->decompress(
-            regionInfo.width, regionInfo.height, mBlockWidth, mBlockHeight,
-            srcAstcData + compRegion.bufferOffset, regionInfo.compressedSize,
-            decompData + decompRegion.bufferOffset);
+            regionInfo.width, regionInfo.height, mBlockWidth, mBlockHeight, compressed,
+            regionInfo.compressedSize, decompressed);
 
         if (status != 0) {
             WARN("ASTC CPU decompression failed: %s.", mDecompressor->getStatusString(status));
@@ -239,6 +250,11 @@ void AstcTexture::on_vkCmdCopyBufferToImageImpl(VkCommandBuffer commandBuffer, u
             destroyVkBuffer();
             return;
         }
+
+        if (mCache) {
+            mCache->insert(mFormat, regionInfo.width, regionInfo.height, compressed,
+                           regionInfo.compressedSize, decompressed, decompressedSize);
+        }
     }
 
     mVk->vkUnmapMemory(mDevice, mDecompBufferMemory);
@@ -263,6 +279,13 @@ void AstcTexture::on_vkCmdCopyBufferToImageImpl(VkCommandBuffer commandBuffer, u
         INFO("ASTC CPU decompression: %.2f Mpix in %.2f seconds (%.2f Mpix/s). Total mem: %.2f MB",
              total_pixels / 1'000'000.0, total_time / 1000.0,
              (float)total_pixels / total_time / 1000.0, bytes_used / 1000000.0);
+        if (mCache) {
+            const DecompressedTextureCache::Stats stats = mCache->stats();
+            INFO("ASTC CPU decompression cache: %llu hits, %llu misses, %llu entries, %.2f MB",
+                 static_cast<unsigned long long>(stats.hits),
+                 static_cast<unsigned long long>(stats.misses),
+                 static_cast<unsigned long long>(stats.entries), stats.bytes / 1000000.0);
+        }
     }
 }
 
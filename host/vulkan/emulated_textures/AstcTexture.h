@@ -14,6 +14,7 @@
 #pragma once
 
 #include "compressedTextureFormats/AstcCpuDecompressor.h"
+#include "vulkan/emulated_textures/DecompressedTextureCache.h"
 #include "vulkan/VkDecoderContext.h"
 #include "goldfish_vk_dispatch.h"
 #include "vulkan/vulkan.h"
@@ -24,9 +25,10 @@ namespace vk {
 // Holds the resources necessary to perform CPU ASTC decompression of a single texture.
 class AstcTexture {
    public:
+    // Decompressed mip levels are looked up in and added to `cache`, which may be null.
     AstcTexture(VulkanDispatch* vk, VkDevice device, VkPhysicalDevice physicalDevice,
-                VkExtent3D imgSize, uint32_t blockWidth, uint32_t blockHeight,
-                AstcCpuDecompressor* decompressor);
+                VkFormat format, VkExtent3D imgSize, uint32_t blockWidth, uint32_t blockHeight,
+                AstcCpuDecompressor* decompressor, DecompressedTextureCache* cache);
 
     ~AstcTexture();
 
@@ -61,6 +63,7 @@ class AstcTexture {
     VulkanDispatch* mVk;
     VkDevice mDevice;
     VkPhysicalDevice mPhysicalDevice;
+    VkFormat mFormat;
     VkExtent3D mImgSize;
     uint32_t mBlockWidth;
     uint32_t mBlockHeight;
@@ -68,6 +71,7 @@ class AstcTexture {
     VkDeviceMemory mDecompBufferMemory = VK_NULL_HANDLE;  // Memory of the decompressed image
     uint64_t mBufferSize = 0;                             // Size of the decompressed image
     AstcCpuDecompressor* mDecompressor;
+    DecompressedTextureCache* mCache;
 };
 
 }  // namespace vk
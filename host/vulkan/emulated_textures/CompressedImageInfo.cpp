@@ -444,8 +444,9 @@ void CompressedImageInfo::createCompressedMipmapImages(VulkanDispatch* vk,
 
 void CompressedImageInfo::initAstcCpuDecompression(VulkanDispatch* vk,
                                                    VkPhysicalDevice physicalDevice) {
-    mAstcTexture = std::make_unique<AstcTexture>(vk, mDevice, physicalDevice, mExtent, mBlock.width,
-                                                 mBlock.height, &AstcCpuDecompressor::get());
+    mAstcTexture = std::make_unique<AstcTexture>(
+        vk, mDevice, physicalDevice, mCompressedFormat, mExtent, mBlock.width, mBlock.height,
+        &AstcCpuDecompressor::get(), &DecompressedTextureCache::get());
 }
 
 bool CompressedImageInfo::decompressIfNeeded(VulkanDispatch* vk, VkCommandBuffer commandBuffer,
@@ -0,0 +1,146 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "DecompressedTextureCache.h"
+
+#include <cstring>
+
+namespace gfxstream {
+namespace vk {
+namespace {
+
+// Enough for a few hundred typical icon and font atlases.
+constexpr size_t kDefaultMaxBytes = 64 * 1024 * 1024;
+
+uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Hashes 8 bytes at a time, compressed textures are always a multiple of 8 bytes in size.
+uint64_t hashBytes(const uint8_t* data, size_t size) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ size;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        h = (h ^ mix(word)) * 0x100000001b3ULL;
+    }
+    for (; i < size; ++i) {
+        h = (h ^ data[i]) * 0x100000001b3ULL;
+    }
+    return mix(h);
+}
+
+}  // namespace
+
+DecompressedTextureCache::DecompressedTextureCache(size_t maxBytes) : mMaxBytes(maxBytes) {}
+
+// static
+DecompressedTextureCache& DecompressedTextureCache::get() {
+    static DecompressedTextureCache* sCache = new DecompressedTextureCache(kDefaultMaxBytes);
+    return *sCache;
+}
+
+// static
+DecompressedTextureCache::Key DecompressedTextureCache::makeKey(VkFormat format, uint32_t width,
+                                                                uint32_t height,
+                                                                const uint8_t* compressed,
+                                                                size_t compressedSize) {
+    return Key{
+        .hash = hashBytes(compressed, compressedSize),
+        .format = format,
+        .width = width,
+        .height = height,
+        .compressedSize = compressedSize,
+    };
+}
+
+bool DecompressedTextureCache::lookup(VkFormat format, uint32_t width, uint32_t height,
+                                      const uint8_t* compressed, size_t compressedSize,
+                                      uint8_t* dst, size_t dstSize) {
+    const Key key = makeKey(format, width, height, compressed, compressedSize);
+
+    std::shared_ptr<const std::vector<uint8_t>> decompressed;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mEntries.find(key);
+        if (it == mEntries.end() ||
+            memcmp(it->second->compressed.data(), compressed, compressedSize) != 0 ||
+            it->second->decompressed->size() != dstSize) {
+            ++mMisses;
+            return false;
+        }
+        ++mHits;
+        mLru.splice(mLru.begin(), mLru, it->second);
+        decompressed = it->second->decompressed;
+    }
+
+    // Copy outside of the lock, the entry may be evicted in the meantime but the data stays
+    // alive until we are done with it.
+    memcpy(dst, decompressed->data(), dstSize);
+    return true;
+}
+
+void DecompressedTextureCache::insert(VkFormat format, uint32_t width, uint32_t height,
+                                      const uint8_t* compressed, size_t compressedSize,
+                                      const uint8_t* decompressed, size_t decompressedSize) {
+    // Don't let a single huge texture flush everything else out.
+    if (compressedSize + decompressedSize > mMaxBytes / 4) {
+        return;
+    }
+
+    Entry entry{
+        .key = makeKey(format, width, height, compressed, compressedSize),
+        .compressed = std::vector<uint8_t>(compressed, compressed + compressedSize),
+        .decompressed = std::make_shared<const std::vector<uint8_t>>(
+            decompressed, decompressed + decompressedSize),
+    };
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto existing = mEntries.find(entry.key);
+    if (existing != mEntries.end()) {
+        mBytes -= existing->second->bytes();
+        mLru.erase(existing->second);
+        mEntries.erase(existing);
+    }
+
+    mBytes += entry.bytes();
+    mLru.push_front(std::move(entry));
+    mEntries[mLru.front().key] = mLru.begin();
+
+    while (mBytes > mMaxBytes) {
+        const Entry& oldest = mLru.back();
+        mBytes -= oldest.bytes();
+        mEntries.erase(oldest.key);
+        mLru.pop_back();
+    }
+}
+
+DecompressedTextureCache::Stats DecompressedTextureCache::stats() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return Stats{
+        .hits = mHits,
+        .misses = mMisses,
+        .entries = mEntries.size(),
+        .bytes = mBytes,
+    };
+}
+
+}  // namespace vk
+}  // namespace gfxstream
@@ -0,0 +1,106 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace gfxstream {
+namespace vk {
+
+// Remembers the result of decompressing emulated compressed textures, keyed by their content.
+//
+// Many apps load the same assets (launcher icons, fonts, game atlases...), so the same
+// compressed data is often uploaded over and over by different processes. The cache lets them
+// skip decompression and only copy the result.
+//
+// The least recently used entries are evicted once the cache holds more than its byte budget.
+//
+// Thread-safety: all public methods are thread-safe
+class DecompressedTextureCache {
+   public:
+    explicit DecompressedTextureCache(size_t maxBytes);
+
+    // Returns the cache shared by all devices.
+    static DecompressedTextureCache& get();
+
+    // Copies the decompressed data of `compressed`, a `width`x`height` image in `format`, into
+    // `dst`. Returns false, leaving `dst` untouched, if it is not in the cache or is not
+    // `dstSize` bytes.
+    bool lookup(VkFormat format, uint32_t width, uint32_t height, const uint8_t* compressed,
+                size_t compressedSize, uint8_t* dst, size_t dstSize);
+
+    // Adds the result of decompressing `compressed`.
+    void insert(VkFormat format, uint32_t width, uint32_t height, const uint8_t* compressed,
+                size_t compressedSize, const uint8_t* decompressed, size_t decompressedSize);
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t entries = 0;
+        uint64_t bytes = 0;
+    };
+    Stats stats();
+
+   private:
+    struct Key {
+        uint64_t hash;
+        VkFormat format;
+        uint32_t width;
+        uint32_t height;
+        size_t compressedSize;
+
+        bool operator==(const Key& other) const {
+            return hash == other.hash && format == other.format && width == other.width &&
+                   height == other.height && compressedSize == other.compressedSize;
+        }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& k) const { return static_cast<std::size_t>(k.hash); }
+    };
+
+    struct Entry {
+        Key key;
+        // The compressed data is kept to tell hash collisions apart. It is much smaller than
+        // the decompressed data.
+        std::vector<uint8_t> compressed;
+        std::shared_ptr<const std::vector<uint8_t>> decompressed;
+
+        size_t bytes() const { return compressed.size() + decompressed->size(); }
+    };
+
+    static Key makeKey(VkFormat format, uint32_t width, uint32_t height, const uint8_t* compressed,
+                       size_t compressedSize);
+
+    const size_t mMaxBytes;
+
+    std::mutex mMutex;
+    // Most recently used first.
+    std::list<Entry> mLru;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> mEntries;
+    size_t mBytes = 0;
+    uint64_t mHits = 0;
+    uint64_t mMisses = 0;
+};
+
+}  // namespace vk
+}  // namespace gfxstream
@@ -0,0 +1,122 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "DecompressedTextureCache.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace gfxstream {
+namespace vk {
+namespace {
+
+using ::testing::ElementsAreArray;
+using ::testing::Field;
+
+constexpr VkFormat kFormat = VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+constexpr uint32_t kWidth = 8;
+constexpr uint32_t kHeight = 8;
+
+// 2x2 blocks of 16 bytes.
+std::vector<uint8_t> makeCompressed(uint8_t seed) {
+    std::vector<uint8_t> data(4 * 16);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<uint8_t>(seed + i);
+    return data;
+}
+
+std::vector<uint8_t> makeDecompressed(uint8_t seed) {
+    std::vector<uint8_t> data(kWidth * kHeight * 4);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<uint8_t>(seed * 3 + i);
+    return data;
+}
+
+TEST(DecompressedTextureCache, LookupReturnsInsertedData) {
+    DecompressedTextureCache cache(1024 * 1024);
+    const std::vector<uint8_t> compressed = makeCompressed(1);
+    const std::vector<uint8_t> decompressed = makeDecompressed(1);
+
+    std::vector<uint8_t> output(decompressed.size());
+    EXPECT_FALSE(cache.lookup(kFormat, kWidth, kHeight, compressed.data(), compressed.size(),
+                              output.data(), output.size()));
+
+    cache.insert(kFormat, kWidth, kHeight, compressed.data(), compressed.size(),
+                 decompressed.data(), decompressed.size());
+    ASSERT_TRUE(cache.lookup(kFormat, kWidth, kHeight, compressed.data(), compressed.size(),
+                             output.data(), output.size()));
+    EXPECT_THAT(output, ElementsAreArray(decompressed));
+
+    const DecompressedTextureCache::Stats stats = cache.stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.entries, 1u);
+    EXPECT_EQ(stats.bytes, compressed.size() + decompressed.size());
+}
+
+TEST(DecompressedTextureCache, KeyIncludesContentFormatAndExtent) {
+    DecompressedTextureCache cache(1024 * 1024);
+    const std::vector<uint8_t> compressed = makeCompressed(1);
+    const std::vector<uint8_t> decompressed = makeDecompressed(1);
+    cache.insert(kFormat, kWidth, kHeight, compressed.data(), compressed.size(),
+                 decompressed.data(), decompressed.size());
+
+    std::vector<uint8_t> output(decompressed.size());
+    const std::vector<uint8_t> otherCompressed = makeCompressed(2);
+    EXPECT_FALSE(cache.lookup(kFormat, kWidth, kHeight, otherCompressed.data(),
+                              otherCompressed.size(), output.data(), output.size()));
+    EXPECT_FALSE(cache.lookup(VK_FORMAT_ASTC_4x4_SRGB_BLOCK, kWidth, kHeight, compressed.data(),
+                              compressed.size(), output.data(), output.size()));
+    EXPECT_FALSE(cache.lookup(kFormat, kWidth - 1, kHeight, compressed.data(), compressed.size(),
+                              output.data(), output.size()));
+    EXPECT_FALSE(cache.lookup(kFormat, kWidth, kHeight, compressed.data(), compressed.size(),
+                              output.data(), output.size() - 4));
+}
+
+TEST(DecompressedTextureCache, EvictsLeastRecentlyUsed) {
+    const size_t entrySize = makeCompressed(0).size() + makeDecompressed(0).size();
+    // Room for 4 entries, so that none of them is too big to be cached.
+    DecompressedTextureCache cache(entrySize * 4);
+
+    for (uint8_t i = 0; i < 4; ++i) {
+        const std::vector<uint8_t> compressed = makeCompressed(i);
+        const std::vector<uint8_t> decompressed = makeDecompressed(i);
+        cache.insert(kFormat, kWidth, kHeight, compressed.data(), compressed.size(),
+                     decompressed.data(), decompressed.size());
+    }
+
+    // Use entry 0 so that entry 1 is the least recently used one.
+    std::vector<uint8_t> output(makeDecompressed(0).size());
+    const std::vector<uint8_t> compressed0 = makeCompressed(0);
+    EXPECT_TRUE(cache.lookup(kFormat, kWidth, kHeight, compressed0.data(), compressed0.size(),
+                             output.data(), output.size()));
+
+    const std::vector<uint8_t> compressed4 = makeCompressed(4);
+    const std::vector<uint8_t> decompressed4 = makeDecompressed(4);
+    cache.insert(kFormat, kWidth, kHeight, compressed4.data(), compressed4.size(),
+                 decompressed4.data(), decompressed4.size());
+
+    EXPECT_THAT(cache.stats(), Field(&DecompressedTextureCache::Stats::entries, 4u));
+    const std::vector<uint8_t> compressed1 = makeCompressed(1);
+    EXPECT_FALSE(cache.lookup(kFormat, kWidth, kHeight, compressed1.data(), compressed1.size(),
+                              output.data(), output.size()));
+    EXPECT_TRUE(cache.lookup(kFormat, kWidth, kHeight, compressed0.data(), compressed0.size(),
+                             output.data(), output.size()));
+    EXPECT_TRUE(cache.lookup(kFormat, kWidth, kHeight, compressed4.data(), compressed4.size(),
+                             output.data(), output.size()));
+}
+
+}  // namespace
+}  // namespace vk
+}  // namespace gfxstream
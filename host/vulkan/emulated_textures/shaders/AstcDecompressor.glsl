@@ -572,7 +572,9 @@ uint decode1Endpoint(uvec4 data, uint startOffset, uint index, uvec3 encoding) {
 uvec4 buildBitmask(uint bits) {
     ivec4 numBits = int(bits) - ivec4(96, 64, 32, 0);
     uvec4 mask = (uvec4(1) << clamp(numBits, ivec4(0), ivec4(31))) - 1;
-    return mix(mask, uvec4(0xffffffffu), greaterThanEqual(uvec4(bits), uvec4(128, 96, 64, 32)));
+    // All ones where there are 32 bits or more. Not using mix(), which needs GLSL 4.50 for
+    // integer vectors.
+    return mask | (uvec4(0) - uvec4(greaterThanEqual(uvec4(bits), uvec4(128, 96, 64, 32))));
 }
 
 // Main function to decode the texel at a given position in the block
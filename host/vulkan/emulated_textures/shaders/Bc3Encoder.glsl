@@ -0,0 +1,64 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Helpers to encode 4x4 blocks of RGBA texels to BC3, shared by AstcToBc3.comp and the GLES
+// translator's GPU texture decoder. See AstcToBc3.comp for the details of the algorithm.
+//
+// They don't use subgroup operations, so that they also build for OpenGL.
+
+// Returns the 2-bit index of the BC1 color that's the closest to the input color.
+// color: the color that we want to approximate
+// maxEndpoint / minEndpoint: the BC1 endpoint values we've chosen
+uint getColorIndex(vec3 color, vec3 minEndpoint, vec3 maxEndpoint) {
+    // Project `color` on the line that goes between `minEndpoint` and `maxEndpoint`.
+    //
+    // TODO(gregschlom): this doesn't account for the fact that the color palette is actually
+    // quantisized as RGB565 instead of RGB8. A slower but potentially slightly higher quality
+    // approach would be to compute all 4 RGB565 colors in the palette, then find the closest one.
+    vec3 colorLine = maxEndpoint - minEndpoint;
+    float x = dot(color - minEndpoint, colorLine) / dot(colorLine, colorLine);
+
+    // x is now a float in [0, 1] indicating where `color` lies when projected on the line between
+    // the min and max endpoint. Remap x as an integer between 0 and 3.
+    int index = int(round(clamp(x * 3, 0, 3)));
+
+    // Finally, we need to convert to the somewhat unintuitive BC1 indexing scheme, where:
+    //  0 is maxEndpoint, 1 is minEndpoint, 2 is (1/3)*minEndpoint + (2/3)*maxEndpoint and 3 is
+    // (2/3)*minEndpoint + (1/3)*maxEndpoint. The lookup table for this is [1, 3, 2, 0], which we
+    // bit-pack into 8 bits.
+    //
+    // Alternatively, we could use this formula:
+    // `index = -index & 3; return index ^ uint(index < 2);` but the  lookup table method is faster.
+    return bitfieldExtract(45u, index * 2, 2);
+}
+
+// Same as above, but for alpha values, using BC4's encoding scheme.
+uint getAlphaIndex(uint alpha, uint minAlpha, uint maxAlpha) {
+    float x = float(alpha - minAlpha) / float(maxAlpha - minAlpha);
+    int index = int(round(clamp(x * 7, 0, 7)));
+
+    // Like for getColorIndex, we need to remap the index according to BC4's indexing scheme, where
+    //  0 is maxAlpha, 1 is minAlpha, 2 is (1/7)*minAlpha + (6/7)*maxAlpha, etc...
+    // The lookup table for this is [1, 7, 6, 5, 4, 3, 2, 0], which we bit-pack into 32 bits using
+    // 4 bits for each value.
+    //
+    // Alternatively, we could use this formula:
+    // `index = -index & 7; return index ^ uint(index < 2);` but the lookup table method is faster.
+    return bitfieldExtract(36984433u, index * 4, 3);
+}
+
+uint packColorToRGB565(uvec3 color) {
+    uvec3 quant = uvec3(round(vec3(color) * vec3(31.0, 63.0, 31.0) / vec3(255.0)));
+    return (quant.r << 11) | (quant.g << 5) | quant.b;
+}
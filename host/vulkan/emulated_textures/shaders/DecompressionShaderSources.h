@@ -0,0 +1,43 @@
+// Copyright 2025 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+namespace gfxstream {
+namespace decompression_shader_sources {
+
+// GLSL code of the image decompression shader libraries, for the decoders that compile them at
+// runtime, like the GLES translator's GpuTextureDecoder.
+//
+// The `#include` directives are stripped, so the libraries have to be concatenated in the order
+// below. They use GLSL 4.20 features, like initializer lists, so they need desktop OpenGL 4.3 for
+// compute shaders.
+//
+// Generated by build_shaders.py.
+
+inline constexpr char AstcLookupTables[] =
+#include "compiled/AstcLookupTables.glsl.inl"
+    ;
+inline constexpr char AstcDecompressor[] =
+#include "compiled/AstcDecompressor.glsl.inl"
+    ;
+inline constexpr char Bc3Encoder[] =
+#include "compiled/Bc3Encoder.glsl.inl"
+    ;
+inline constexpr char Etc2ShaderLib[] =
+#include "compiled/Etc2ShaderLib.comp.inl"
+    ;
+
+}  // namespace decompression_shader_sources
+}  // namespace gfxstream
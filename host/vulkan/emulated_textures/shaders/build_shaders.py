@@ -30,6 +30,18 @@ shaders = [
     "Etc2RGBA8",
 ]
 
+# The shader libraries that the GLES translator compiles at runtime, in dependency order. See
+# DecompressionShaderSources.h
+glsl_sources = [
+    "AstcLookupTables.glsl",
+    "AstcDecompressor.glsl",
+    "Bc3Encoder.glsl",
+    "Etc2ShaderLib.comp",
+]
+
+# MSVC limits string literals to 16380 bytes, so the sources are split into several literals.
+max_literal_size = 8192
+
 # Template for the compilation command
 command = "glslc -DDIM={dim} --target-env=vulkan1.1 -mfmt=num {input} -o {output}"
 
@@ -50,6 +62,27 @@ def compile(shader: str, dim: int):
         exit(ret)
 
 
+# Writes `source` as a C++ string literal, without its `#include` directives since OpenGL doesn't
+# support them. The users concatenate the sources in the order of `glsl_sources` instead.
+# source: file name, with its extension
+def write_glsl_source(source: str):
+    output = os.path.join(output_dir, "{}.inl".format(source))
+    print("Writing: {}".format(output))
+    with open(source) as f:
+        lines = [line for line in f if not line.startswith("#include")]
+    literals = [[]]
+    size = 0
+    for line in lines:
+        if size + len(line) > max_literal_size:
+            literals.append([])
+            size = 0
+        literals[-1].append(line)
+        size += len(line)
+    with open(output, "w") as f:
+        for literal in literals:
+            f.write('R"glsl({})glsl"\n'.format("".join(literal)))
+
+
 def main():
     # Set the current working directory where the script is located
     os.chdir(os.path.dirname(os.path.realpath(__file__)))
@@ -67,6 +100,9 @@ def main():
         for dim in range(1, 4):
             compile(shader, dim)
 
+    for source in glsl_sources:
+        write_glsl_source(source)
+
 
 if __name__ == "__main__":
     main()
@@ -17,6 +17,7 @@
   X(void, eglUseOsEglApi, (EGLBoolean enable, EGLBoolean nullEgl)) \
   X(void, eglSetMaxGLESVersion, (EGLint glesVersion)) \
   X(void, eglFillUsages, (void* usages)) \
+  X(void, eglShutdownBlobCache, ()) \
 
 EGLAPI EGLConfig EGLAPIENTRY eglLoadConfig(EGLDisplay display, EGLStreamKHR stream);
 EGLAPI EGLContext EGLAPIENTRY eglLoadContext(EGLDisplay display, const EGLint * attrib_list, EGLStreamKHR stream);
@@ -30,5 +31,6 @@ EGLAPI EGLBoolean EGLAPIENTRY eglPostSaveContext(EGLDisplay display, EGLConfig c
 EGLAPI void EGLAPIENTRY eglUseOsEglApi(EGLBoolean enable, EGLBoolean nullEgl);
 EGLAPI void EGLAPIENTRY eglSetMaxGLESVersion(EGLint glesVersion);
 EGLAPI void EGLAPIENTRY eglFillUsages(void* usages);
+EGLAPI void EGLAPIENTRY eglShutdownBlobCache();
 
 #endif  // RENDER_EGL_SNAPSHOT_FUNCTIONS_H
@@ -103,6 +103,18 @@ public:
     virtual void* getDmaForReading(uint64_t guest_paddr) = 0;
     virtual void unlockDma(uint64_t guest_paddr) = 0;
 
+    // Zero copy reads. Streams backed by memory shared with the guest can hand out the next
+    // contiguous chunk of guest data in place instead of copying it out. Returns nullptr if
+    // no chunk of at least |minLen| bytes is available right now, in which case the caller
+    // should use read() instead. A returned chunk stays valid, and is not handed back to the
+    // guest, until releaseInPlace() is called. At most one chunk can be held at a time.
+    // The guest can still write to the chunk while it is held, so callers must not rely on
+    // values they validated earlier; streams only enable this for trusted guests.
+    virtual const unsigned char* readInPlace(size_t /*minLen*/, size_t* /*outLen*/) {
+        return nullptr;
+    }
+    virtual void releaseInPlace() {}
+
 protected:
     virtual const unsigned char *readRaw(void *buf, size_t *inout_len) = 0;
     virtual void onSave(android::base::Stream* stream) = 0;